@@ -0,0 +1,258 @@
+#ifndef _MDR_BIT_TRANSPOSE_HPP
+#define _MDR_BIT_TRANSPOSE_HPP
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define MDR_BIT_TRANSPOSE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace MDR {
+    // bit-matrix transpose kernels used for block bitplane coding
+    // transpose(a): bit j of a[i] <-> bit i of a[j]
+    namespace BitTranspose {
+
+        // portable kernels: swap off-diagonal blocks of size 32 (16), 16, ..., 1
+        inline void transpose64_scalar(uint64_t * a){
+            uint64_t m = 0x00000000FFFFFFFFull;
+            for(int j=32; j!=0; j>>=1, m^=(m << j)){
+                for(int k=0; k<64; k=((k | j) + 1) & ~j){
+                    uint64_t t = ((a[k] >> j) ^ a[k | j]) & m;
+                    a[k] ^= t << j;
+                    a[k | j] ^= t;
+                }
+            }
+        }
+        inline void transpose32_scalar(uint32_t * a){
+            uint32_t m = 0x0000FFFFu;
+            for(int j=16; j!=0; j>>=1, m^=(m << j)){
+                for(int k=0; k<32; k=((k | j) + 1) & ~j){
+                    uint32_t t = ((a[k] >> j) ^ a[k | j]) & m;
+                    a[k] ^= t << j;
+                    a[k | j] ^= t;
+                }
+            }
+        }
+
+#ifdef MDR_BIT_TRANSPOSE_X86
+        // AVX2: 64x64 as 16 vectors of 4 rows, 32x32 as 4 vectors of 8 rows
+        // in-vector rounds pair row i with row i^j through a permutation and a blend
+        __attribute__((target("avx2"))) inline __m256i transpose_round_avx2_epi64(__m256i x, __m256i y, __m256i mask, int j, int blend){
+            __m256i lower = _mm256_xor_si256(x, _mm256_slli_epi64(_mm256_and_si256(_mm256_xor_si256(_mm256_srli_epi64(x, j), y), mask), j));
+            __m256i upper = _mm256_xor_si256(x, _mm256_and_si256(_mm256_xor_si256(_mm256_srli_epi64(y, j), x), mask));
+            return (blend == 0xF0) ? _mm256_blend_epi32(lower, upper, 0xF0) : _mm256_blend_epi32(lower, upper, 0xCC);
+        }
+        __attribute__((target("avx2"))) inline void transpose64_avx2(uint64_t * a){
+            __m256i v[16];
+            for(int i=0; i<16; i++) v[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + 4*i));
+            uint64_t m = 0x00000000FFFFFFFFull;
+            for(int j=32; j>=4; j>>=1, m^=(m << j)){
+                const __m256i mask = _mm256_set1_epi64x(m);
+                const int vj = j / 4;
+                for(int k=0; k<16; k=((k | vj) + 1) & ~vj){
+                    __m256i t = _mm256_and_si256(_mm256_xor_si256(_mm256_srli_epi64(v[k], j), v[k | vj]), mask);
+                    v[k] = _mm256_xor_si256(v[k], _mm256_slli_epi64(t, j));
+                    v[k | vj] = _mm256_xor_si256(v[k | vj], t);
+                }
+            }
+            // j = 2: rows {0,1} pair with rows {2,3} inside each vector
+            {
+                const __m256i mask = _mm256_set1_epi64x(0x3333333333333333ull);
+                for(int k=0; k<16; k++){
+                    __m256i y = _mm256_permute4x64_epi64(v[k], 0x4E);
+                    v[k] = transpose_round_avx2_epi64(v[k], y, mask, 2, 0xF0);
+                }
+            }
+            // j = 1: rows {0,2} pair with rows {1,3}
+            {
+                const __m256i mask = _mm256_set1_epi64x(0x5555555555555555ull);
+                for(int k=0; k<16; k++){
+                    __m256i y = _mm256_permute4x64_epi64(v[k], 0xB1);
+                    v[k] = transpose_round_avx2_epi64(v[k], y, mask, 1, 0xCC);
+                }
+            }
+            for(int i=0; i<16; i++) _mm256_storeu_si256(reinterpret_cast<__m256i*>(a + 4*i), v[i]);
+        }
+        __attribute__((target("avx2"))) inline __m256i transpose_round_avx2_epi32(__m256i x, __m256i y, __m256i mask, int j, int blend){
+            __m256i lower = _mm256_xor_si256(x, _mm256_slli_epi32(_mm256_and_si256(_mm256_xor_si256(_mm256_srli_epi32(x, j), y), mask), j));
+            __m256i upper = _mm256_xor_si256(x, _mm256_and_si256(_mm256_xor_si256(_mm256_srli_epi32(y, j), x), mask));
+            if(blend == 0xF0) return _mm256_blend_epi32(lower, upper, 0xF0);
+            if(blend == 0xCC) return _mm256_blend_epi32(lower, upper, 0xCC);
+            return _mm256_blend_epi32(lower, upper, 0xAA);
+        }
+        __attribute__((target("avx2"))) inline void transpose32_avx2(uint32_t * a){
+            __m256i v[4];
+            for(int i=0; i<4; i++) v[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + 8*i));
+            uint32_t m = 0x0000FFFFu;
+            for(int j=16; j>=8; j>>=1, m^=(m << j)){
+                const __m256i mask = _mm256_set1_epi32(m);
+                const int vj = j / 8;
+                for(int k=0; k<4; k=((k | vj) + 1) & ~vj){
+                    __m256i t = _mm256_and_si256(_mm256_xor_si256(_mm256_srli_epi32(v[k], j), v[k | vj]), mask);
+                    v[k] = _mm256_xor_si256(v[k], _mm256_slli_epi32(t, j));
+                    v[k | vj] = _mm256_xor_si256(v[k | vj], t);
+                }
+            }
+            const __m256i mask4 = _mm256_set1_epi32(0x0F0F0F0F);
+            const __m256i mask2 = _mm256_set1_epi32(0x33333333);
+            const __m256i mask1 = _mm256_set1_epi32(0x55555555);
+            for(int k=0; k<4; k++){
+                v[k] = transpose_round_avx2_epi32(v[k], _mm256_permute4x64_epi64(v[k], 0x4E), mask4, 4, 0xF0);
+                v[k] = transpose_round_avx2_epi32(v[k], _mm256_shuffle_epi32(v[k], 0x4E), mask2, 2, 0xCC);
+                v[k] = transpose_round_avx2_epi32(v[k], _mm256_shuffle_epi32(v[k], 0xB1), mask1, 1, 0xAA);
+            }
+            for(int i=0; i<4; i++) _mm256_storeu_si256(reinterpret_cast<__m256i*>(a + 8*i), v[i]);
+        }
+
+        // AVX-512: 64x64 as 8 vectors of 8 rows, 32x32 as 2 vectors of 16 rows
+        __attribute__((target("avx512f"))) inline __m512i transpose_round_avx512_epi64(__m512i x, __m512i y, __m512i mask, int j, __mmask8 upper_lanes){
+            __m512i lower = _mm512_xor_si512(x, _mm512_slli_epi64(_mm512_and_si512(_mm512_xor_si512(_mm512_srli_epi64(x, j), y), mask), j));
+            __m512i upper = _mm512_xor_si512(x, _mm512_and_si512(_mm512_xor_si512(_mm512_srli_epi64(y, j), x), mask));
+            return _mm512_mask_blend_epi64(upper_lanes, lower, upper);
+        }
+        __attribute__((target("avx512f"))) inline void transpose64_avx512(uint64_t * a){
+            __m512i v[8];
+            for(int i=0; i<8; i++) v[i] = _mm512_loadu_si512(a + 8*i);
+            uint64_t m = 0x00000000FFFFFFFFull;
+            for(int j=32; j>=8; j>>=1, m^=(m << j)){
+                const __m512i mask = _mm512_set1_epi64(m);
+                const int vj = j / 8;
+                for(int k=0; k<8; k=((k | vj) + 1) & ~vj){
+                    __m512i t = _mm512_and_si512(_mm512_xor_si512(_mm512_srli_epi64(v[k], j), v[k | vj]), mask);
+                    v[k] = _mm512_xor_si512(v[k], _mm512_slli_epi64(t, j));
+                    v[k | vj] = _mm512_xor_si512(v[k | vj], t);
+                }
+            }
+            const __m512i mask4 = _mm512_set1_epi64(0x0F0F0F0F0F0F0F0Full);
+            const __m512i mask2 = _mm512_set1_epi64(0x3333333333333333ull);
+            const __m512i mask1 = _mm512_set1_epi64(0x5555555555555555ull);
+            for(int k=0; k<8; k++){
+                v[k] = transpose_round_avx512_epi64(v[k], _mm512_shuffle_i64x2(v[k], v[k], 0x4E), mask4, 4, 0xF0);
+                v[k] = transpose_round_avx512_epi64(v[k], _mm512_permutex_epi64(v[k], 0x4E), mask2, 2, 0xCC);
+                v[k] = transpose_round_avx512_epi64(v[k], _mm512_permutex_epi64(v[k], 0xB1), mask1, 1, 0xAA);
+            }
+            for(int i=0; i<8; i++) _mm512_storeu_si512(a + 8*i, v[i]);
+        }
+        __attribute__((target("avx512f"))) inline __m512i transpose_round_avx512_epi32(__m512i x, __m512i y, __m512i mask, int j, __mmask16 upper_lanes){
+            __m512i lower = _mm512_xor_si512(x, _mm512_slli_epi32(_mm512_and_si512(_mm512_xor_si512(_mm512_srli_epi32(x, j), y), mask), j));
+            __m512i upper = _mm512_xor_si512(x, _mm512_and_si512(_mm512_xor_si512(_mm512_srli_epi32(y, j), x), mask));
+            return _mm512_mask_blend_epi32(upper_lanes, lower, upper);
+        }
+        __attribute__((target("avx512f"))) inline void transpose32_avx512(uint32_t * a){
+            __m512i v0 = _mm512_loadu_si512(a);
+            __m512i v1 = _mm512_loadu_si512(a + 16);
+            {
+                const __m512i mask = _mm512_set1_epi32(0x0000FFFF);
+                __m512i t = _mm512_and_si512(_mm512_xor_si512(_mm512_srli_epi32(v0, 16), v1), mask);
+                v0 = _mm512_xor_si512(v0, _mm512_slli_epi32(t, 16));
+                v1 = _mm512_xor_si512(v1, t);
+            }
+            const __m512i mask8 = _mm512_set1_epi32(0x00FF00FF);
+            const __m512i mask4 = _mm512_set1_epi32(0x0F0F0F0F);
+            const __m512i mask2 = _mm512_set1_epi32(0x33333333);
+            const __m512i mask1 = _mm512_set1_epi32(0x55555555);
+            __m512i * v[2] = {&v0, &v1};
+            for(int k=0; k<2; k++){
+                __m512i x = *v[k];
+                x = transpose_round_avx512_epi32(x, _mm512_shuffle_i64x2(x, x, 0x4E), mask8, 8, 0xFF00);
+                x = transpose_round_avx512_epi32(x, _mm512_shuffle_i64x2(x, x, 0xB1), mask4, 4, 0xF0F0);
+                x = transpose_round_avx512_epi32(x, _mm512_shuffle_epi32(x, (_MM_PERM_ENUM) 0x4E), mask2, 2, 0xCCCC);
+                x = transpose_round_avx512_epi32(x, _mm512_shuffle_epi32(x, (_MM_PERM_ENUM) 0xB1), mask1, 1, 0xAAAA);
+                *v[k] = x;
+            }
+            _mm512_storeu_si512(a, v0);
+            _mm512_storeu_si512(a + 16, v1);
+        }
+#endif
+
+        typedef void (*Transpose64Kernel)(uint64_t *);
+        typedef void (*Transpose32Kernel)(uint32_t *);
+
+        // kernels picked once at runtime by CPU detection
+        inline Transpose64Kernel transpose64_kernel(){
+            static const Transpose64Kernel kernel = [](){
+#ifdef MDR_BIT_TRANSPOSE_X86
+                __builtin_cpu_init();
+                if(__builtin_cpu_supports("avx512f")) return (Transpose64Kernel) transpose64_avx512;
+                if(__builtin_cpu_supports("avx2")) return (Transpose64Kernel) transpose64_avx2;
+#endif
+                return (Transpose64Kernel) transpose64_scalar;
+            }();
+            return kernel;
+        }
+        inline Transpose32Kernel transpose32_kernel(){
+            static const Transpose32Kernel kernel = [](){
+#ifdef MDR_BIT_TRANSPOSE_X86
+                __builtin_cpu_init();
+                if(__builtin_cpu_supports("avx512f")) return (Transpose32Kernel) transpose32_avx512;
+                if(__builtin_cpu_supports("avx2")) return (Transpose32Kernel) transpose32_avx2;
+#endif
+                return (Transpose32Kernel) transpose32_scalar;
+            }();
+            return kernel;
+        }
+
+        // bitplanes[k] <- bit k of data[0, n), packed LSB first; only k < num_bitplanes is written
+        // num_bitplanes is at most the number of bits of T_int
+        template <class T_int, class T_stream>
+        inline void encode(T_int const * data, size_t n, uint8_t num_bitplanes, T_stream * bitplanes){
+            assert(num_bitplanes <= sizeof(T_int) * 8);
+            if(sizeof(T_stream) == sizeof(uint32_t) && sizeof(T_int) == sizeof(uint32_t)){
+                alignas(64) uint32_t a[32] = {0};
+                for(int i=0; i<n; i++) a[i] = data[i];
+                transpose32_kernel()(a);
+                const int count = std::min<int>(num_bitplanes, 32);
+                for(int k=0; k<count; k++) bitplanes[k] = a[k];
+            }
+            else if(sizeof(T_stream) >= sizeof(uint32_t)){
+                alignas(64) uint64_t a[64] = {0};
+                for(int i=0; i<n; i++) a[i] = data[i];
+                transpose64_kernel()(a);
+                const int count = std::min<int>(num_bitplanes, 64);
+                for(int k=0; k<count; k++) bitplanes[k] = (T_stream) a[k];
+            }
+            else{
+                for(int k=0; k<num_bitplanes; k++){
+                    T_stream bitplane_value = 0;
+                    for(int i=0; i<n; i++){
+                        bitplane_value += (T_stream)((data[i] >> k) & 1u) << i;
+                    }
+                    bitplanes[k] = bitplane_value;
+                }
+            }
+        }
+
+        // data[i] += sum over k < num_bitplanes of (bit i of bitplanes[k]) << k
+        // num_bitplanes is at most the number of bits of T_int
+        template <class T_int, class T_stream>
+        inline void decode(T_stream const * bitplanes, size_t n, uint8_t num_bitplanes, T_int * data){
+            assert(num_bitplanes <= sizeof(T_int) * 8);
+            if(sizeof(T_stream) == sizeof(uint32_t) && sizeof(T_int) == sizeof(uint32_t)){
+                alignas(64) uint32_t a[32] = {0};
+                const int count = std::min<int>(num_bitplanes, 32);
+                for(int k=0; k<count; k++) a[k] = bitplanes[k];
+                transpose32_kernel()(a);
+                for(int i=0; i<n; i++) data[i] += a[i];
+            }
+            else if(sizeof(T_stream) >= sizeof(uint32_t)){
+                alignas(64) uint64_t a[64] = {0};
+                const int count = std::min<int>(num_bitplanes, 64);
+                for(int k=0; k<count; k++) a[k] = bitplanes[k];
+                transpose64_kernel()(a);
+                for(int i=0; i<n; i++) data[i] += (T_int) a[i];
+            }
+            else{
+                for(int k=0; k<num_bitplanes; k++){
+                    for(int i=0; i<n; i++){
+                        data[i] += (T_int)((bitplanes[k] >> i) & 1u) << k;
+                    }
+                }
+            }
+        }
+    }
+}
+#endif
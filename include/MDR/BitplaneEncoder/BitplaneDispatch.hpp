@@ -0,0 +1,38 @@
+#ifndef _MDR_BITPLANE_DISPATCH_HPP
+#define _MDR_BITPLANE_DISPATCH_HPP
+
+#include <cstdint>
+#include <type_traits>
+
+namespace MDR {
+    // compile-time bitplane counts for the encoding kernels
+    // kernels are instantiated for FixedBitplanes<NB> so that their bitplane loops have constant trip counts;
+    // GenericBitplanes (NB = 0) instantiates the kernel for the runtime count
+    template <uint8_t NB>
+    using FixedBitplanes = std::integral_constant<uint8_t, NB>;
+    using GenericBitplanes = FixedBitplanes<0>;
+
+    // number of bitplanes seen by a kernel instantiated for NB
+    template <uint8_t NB>
+    constexpr uint8_t kernel_bitplanes(FixedBitplanes<NB>, uint8_t num_bitplanes){
+        return NB ? NB : num_bitplanes;
+    }
+
+    // f(FixedBitplanes<num_bitplanes>()) for the common counts (32 for float, 60 and 64 for double)
+    // that do not exceed MAX_BITPLANES, f(GenericBitplanes()) otherwise or when fixed is false
+    // only the counts up to MAX_BITPLANES are instantiated, so MAX_BITPLANES = 0 keeps the generic kernel only
+    template <uint8_t MAX_BITPLANES, class Func>
+    inline auto dispatch_bitplanes(uint8_t num_bitplanes, bool fixed, Func f){
+        if constexpr(MAX_BITPLANES >= 64){
+            if(fixed && num_bitplanes == 64) return f(FixedBitplanes<64>());
+        }
+        if constexpr(MAX_BITPLANES >= 60){
+            if(fixed && num_bitplanes == 60) return f(FixedBitplanes<60>());
+        }
+        if constexpr(MAX_BITPLANES >= 32){
+            if(fixed && num_bitplanes == 32) return f(FixedBitplanes<32>());
+        }
+        return f(GenericBitplanes());
+    }
+}
+#endif
@@ -4,5 +4,6 @@
 #include "GroupedBPEncoder.hpp"
 #include "PerBitBPEncoder.hpp"
 #include "NegaBinaryBPEncoder.hpp"
+#include "SignificanceMapBPEncoder.hpp"
 
 #endif
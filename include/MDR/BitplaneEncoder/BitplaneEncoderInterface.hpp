@@ -3,6 +3,10 @@
 
 #include <cassert>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "MDR/Interleaver/LevelView.hpp"
+#include "MDR/StreamPool.hpp"
 
 namespace MDR {
     namespace concepts {
@@ -20,6 +24,48 @@ namespace MDR {
 
             virtual T_data * progressive_decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, int level) = 0;
 
+            // encoding that also reports range_offsets, the per-range stream offsets needed for parallel decoding;
+            // empty range_offsets means the streams decode serially
+            virtual std::vector<uint8_t *> encode(T_data const * data, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<uint32_t>& streams_sizes, std::vector<uint32_t>& range_offsets) const {
+                range_offsets.clear();
+                return encode(data, n, exp, num_bitplanes, streams_sizes);
+            }
+
+            // encoding that reads the level straight from a view of the decomposed grid
+            virtual std::vector<uint8_t *> encode(LevelView<T_data> view, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<uint32_t>& streams_sizes, std::vector<uint32_t>& range_offsets) const {
+                T_data * data = (T_data *) malloc(n * sizeof(T_data));
+                view.read(data, n);
+                auto streams = encode(data, n, exp, num_bitplanes, streams_sizes, range_offsets);
+                free(data);
+                return streams;
+            }
+
+            virtual T_data * progressive_decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, int level, const std::vector<uint32_t>& range_offsets) {
+                return progressive_decode(streams, n, exp, starting_bitplane, num_bitplanes, level);
+            }
+
+            // progressive decoding that writes the level straight into a view of the output grid
+            virtual void progressive_decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, int level, const std::vector<uint32_t>& range_offsets, LevelView<T_data> view) {
+                T_data * data = progressive_decode(streams, n, exp, starting_bitplane, num_bitplanes, level, range_offsets);
+                view.write(data, n);
+                free(data);
+            }
+
+            // progressive decoding of the element ranges (begin, count) of the level only, packed into values in order;
+            // encoders without random access decode the whole level
+            virtual void progressive_decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, int level, const std::vector<uint32_t>& range_offsets, const std::vector<std::pair<uint32_t, uint32_t>>& ranges, T_data * values) {
+                T_data * data = progressive_decode(streams, n, exp, starting_bitplane, num_bitplanes, level, range_offsets);
+                for(const auto& range:ranges){
+                    memcpy(values, data + range.first, range.second * sizeof(T_data));
+                    values += range.second;
+                }
+                free(data);
+            }
+
+            // pool to allocate the encoded streams from (NULL: system allocation);
+            // streams of encoders that ignore it are still released correctly by the pool
+            virtual void set_stream_pool(StreamPool * pool) {}
+
             virtual void print() const = 0;
 
         };
@@ -0,0 +1,15 @@
+#ifndef _MDR_BLOCK_SIZE_HPP
+#define _MDR_BLOCK_SIZE_HPP
+
+#include <cstdint>
+#include <type_traits>
+
+namespace MDR {
+    // number of elements per block for blocks coded in T_stream words
+    template <class T_stream>
+    constexpr uint32_t block_size_of_stream_type(){
+        static_assert(std::is_same<T_stream, uint64_t>::value || std::is_same<T_stream, uint32_t>::value || std::is_same<T_stream, uint16_t>::value || std::is_same<T_stream, uint8_t>::value, "Integer type not supported.");
+        return sizeof(T_stream) * 8;
+    }
+}
+#endif
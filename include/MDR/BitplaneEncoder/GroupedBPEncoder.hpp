@@ -2,13 +2,21 @@
 #define _MDR_GROUPED_BP_ENCODER_HPP
 
 #include "BitplaneEncoderInterface.hpp"
+#include "BlockSize.hpp"
+#include "BitTranspose.hpp"
+#include "RangeEncoding.hpp"
+#include "Quantizer.hpp"
 
 namespace MDR {
     // general bitplane encoder that encodes data by block using T_stream type buffer
     template<class T_data, class T_stream>
     class GroupedBPEncoder : public concepts::BitplaneEncoderInterface<T_data> {
     public:
-        GroupedBPEncoder(){
+        // levels read from a view are gathered by the interface
+        using concepts::BitplaneEncoderInterface<T_data>::encode;
+        using concepts::BitplaneEncoderInterface<T_data>::progressive_decode;
+
+        GroupedBPEncoder(int num_threads=1) : num_threads(num_threads) {
             static_assert(std::is_floating_point<T_data>::value, "GeneralBPEncoder: input data must be floating points.");
             static_assert(!std::is_same<T_data, long double>::value, "GeneralBPEncoder: long double is not supported.");
             static_assert(std::is_unsigned<T_stream>::value, "GroupedBPBlockEncoder: streams must be unsigned integers.");
@@ -16,57 +24,41 @@ namespace MDR {
         }
 
         std::vector<uint8_t *> encode(T_data const * data, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<uint32_t>& stream_sizes) const {
+            std::vector<uint32_t> range_offsets;
+            return encode(data, n, exp, num_bitplanes, stream_sizes, range_offsets);
+        }
+
+        // encode element ranges in parallel; range_offsets records the starting byte of each range in every bitplane
+        std::vector<uint8_t *> encode(T_data const * data, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<uint32_t>& stream_sizes, std::vector<uint32_t>& range_offsets) const {
             assert(num_bitplanes > 0);
             // determine block size based on bitplane integer type
-            uint32_t block_size = block_size_based_on_bitplane_int_type<T_stream>();
+            constexpr uint32_t block_size = block_size_of_stream_type<T_stream>();
             std::vector<uint8_t> starting_bitplanes = std::vector<uint8_t>((n - 1)/block_size + 1, 0);
-            stream_sizes = std::vector<uint32_t>(num_bitplanes, 0);
-            // define fixed point type
-            using T_fp = typename std::conditional<std::is_same<T_data, double>::value, uint64_t, uint32_t>::type;
+            const uint32_t range_size = compute_range_size(n, num_threads);
+            const uint32_t num_ranges = get_num_ranges(n, range_size);
             std::vector<uint8_t *> streams;
-            for(int i=0; i<num_bitplanes; i++){
-                streams.push_back((uint8_t *) malloc(2 * n / UINT8_BITS + sizeof(T_stream)));
+            if(num_ranges == 1){
+                range_offsets.clear();
+                streams = encode_range(data, n, exp, num_bitplanes, starting_bitplanes.data(), stream_sizes, NULL);
             }
-            std::vector<T_fp> int_data_buffer(block_size, 0);
-            std::vector<T_stream *> streams_pos(streams.size());
-            for(int i=0; i<streams.size(); i++){
-                streams_pos[i] = reinterpret_cast<T_stream*>(streams[i]);
-            }
-            T_data const * data_pos = data;
-            int block_id=0;
-            for(int i=0; i<n - block_size; i+=block_size){
-                T_stream sign_bitplane = 0;
-                for(int j=0; j<block_size; j++){
-                    T_data cur_data = *(data_pos++);
-                    T_data shifted_data = ldexp(cur_data, num_bitplanes - exp);
-                    int64_t fix_point = (int64_t) shifted_data;
-                    T_stream sign = cur_data < 0;
-                    int_data_buffer[j] = sign ? -fix_point : +fix_point;
-                    sign_bitplane += sign << j;
-                }
-                starting_bitplanes[block_id ++] = encode_block(int_data_buffer.data(), block_size, num_bitplanes, sign_bitplane, streams_pos);
-            }
-            // leftover
-            {
-                int rest_size = n - block_size * block_id;
-                T_stream sign_bitplane = 0;
-                for(int j=0; j<rest_size; j++){
-                    T_data cur_data = *(data_pos++);
-                    T_data shifted_data = ldexp(cur_data, num_bitplanes - exp);
-                    int64_t fix_point = (int64_t) shifted_data;
-                    T_stream sign = cur_data < 0;
-                    int_data_buffer[j] = sign ? -fix_point : +fix_point;
-                    sign_bitplane += sign << j;
+            else{
+                std::vector<std::vector<uint8_t *>> range_streams(num_ranges);
+                std::vector<std::vector<uint32_t>> range_stream_sizes(num_ranges);
+                parallel_for(num_ranges, num_threads, [&](uint32_t r){
+                    uint32_t begin = r * range_size;
+                    uint32_t size = std::min(range_size, n - begin);
+                    range_streams[r] = encode_range(data + begin, size, exp, num_bitplanes, starting_bitplanes.data() + begin / block_size, range_stream_sizes[r], NULL);
+                });
+                streams = stitch_range_streams(range_streams, range_stream_sizes, range_size, num_threads, stream_sizes, range_offsets, stream_pool);
+                // the first bitplane is prefixed by the starting bitplanes
+                for(int r=0; r<num_ranges; r++){
+                    range_offsets[1 + r] += sizeof(uint32_t) + starting_bitplanes.size() * sizeof(uint8_t);
                 }
-                starting_bitplanes[block_id ++] = encode_block(int_data_buffer.data(), rest_size, num_bitplanes, sign_bitplane, streams_pos);
-            }
-            for(int i=0; i<num_bitplanes; i++){
-                stream_sizes[i] = reinterpret_cast<uint8_t*>(streams_pos[i]) - streams[i];
             }
             // merge starting_bitplane with the first bitplane
             uint32_t merged_size = 0;
             uint8_t * merged = merge_arrays(reinterpret_cast<uint8_t const*>(starting_bitplanes.data()), starting_bitplanes.size() * sizeof(uint8_t), reinterpret_cast<uint8_t*>(streams[0]), stream_sizes[0], merged_size);
-            free(streams[0]);
+            release_stream(stream_pool, streams[0]);
             streams[0] = merged;
             stream_sizes[0] = merged_size;
             return streams;
@@ -76,65 +68,19 @@ namespace MDR {
         std::vector<uint8_t *> encode(T_data const * data, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<uint32_t>& stream_sizes, std::vector<double>& level_errors) const {
             assert(num_bitplanes > 0);
             // determine block size based on bitplane integer type
-            uint32_t block_size = block_size_based_on_bitplane_int_type<T_stream>();
+            constexpr uint32_t block_size = block_size_of_stream_type<T_stream>();
             std::vector<uint8_t> starting_bitplanes = std::vector<uint8_t>((n - 1)/block_size + 1, 0);
-            stream_sizes = std::vector<uint32_t>(num_bitplanes, 0);
-            // define fixed point type
-            using T_fp = typename std::conditional<std::is_same<T_data, double>::value, uint64_t, uint32_t>::type;
-            std::vector<uint8_t *> streams;
-            for(int i=0; i<num_bitplanes; i++){
-                streams.push_back((uint8_t *) malloc(2 * n / UINT8_BITS + sizeof(T_stream)));
-            }
-            std::vector<T_fp> int_data_buffer(block_size, 0);
-            std::vector<T_stream *> streams_pos(streams.size());
-            for(int i=0; i<streams.size(); i++){
-                streams_pos[i] = reinterpret_cast<T_stream*>(streams[i]);
-            }
             // init level errors
             level_errors.clear();
             level_errors.resize(num_bitplanes + 1);
             for(int i=0; i<level_errors.size(); i++){
                 level_errors[i] = 0;
             }
-            T_data const * data_pos = data;
-            int block_id=0;
-            for(int i=0; i<n - block_size; i+=block_size){
-                T_stream sign_bitplane = 0;
-                for(int j=0; j<block_size; j++){
-                    T_data cur_data = *(data_pos++);
-                    T_data shifted_data = ldexp(cur_data, num_bitplanes - exp);
-                    // compute level errors
-                    collect_level_errors(level_errors, fabs(shifted_data), num_bitplanes);
-                    int64_t fix_point = (int64_t) shifted_data;
-                    T_stream sign = cur_data < 0;
-                    int_data_buffer[j] = sign ? -fix_point : +fix_point;
-                    sign_bitplane += sign << j;
-                }
-                starting_bitplanes[block_id ++] = encode_block(int_data_buffer.data(), block_size, num_bitplanes, sign_bitplane, streams_pos);
-            }
-            // leftover
-            {
-                int rest_size = n - block_size * block_id;
-                T_stream sign_bitplane = 0;
-                for(int j=0; j<rest_size; j++){
-                    T_data cur_data = *(data_pos++);
-                    T_data shifted_data = ldexp(cur_data, num_bitplanes - exp);
-                    // compute level errors
-                    collect_level_errors(level_errors, fabs(shifted_data), num_bitplanes);
-                    int64_t fix_point = (int64_t) shifted_data;
-                    T_stream sign = cur_data < 0;
-                    int_data_buffer[j] = sign ? -fix_point : +fix_point;
-                    sign_bitplane += sign << j;
-                }
-                starting_bitplanes[block_id ++] = encode_block(int_data_buffer.data(), rest_size, num_bitplanes, sign_bitplane, streams_pos);
-            }
-            for(int i=0; i<num_bitplanes; i++){
-                stream_sizes[i] = reinterpret_cast<uint8_t*>(streams_pos[i]) - streams[i];
-            }
+            auto streams = encode_range(data, n, exp, num_bitplanes, starting_bitplanes.data(), stream_sizes, &level_errors);
             // merge starting_bitplane with the first bitplane
             uint32_t merged_size = 0;
             uint8_t * merged = merge_arrays(reinterpret_cast<uint8_t const*>(starting_bitplanes.data()), starting_bitplanes.size() * sizeof(uint8_t), reinterpret_cast<uint8_t*>(streams[0]), stream_sizes[0], merged_size);
-            free(streams[0]);
+            release_stream(stream_pool, streams[0]);
             streams[0] = merged;
             stream_sizes[0] = merged_size;
             // translate level errors
@@ -145,205 +91,187 @@ namespace MDR {
         }
 
         T_data * decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t num_bitplanes) {
-            uint32_t block_size = block_size_based_on_bitplane_int_type<T_stream>();
-            // define fixed point type
-            using T_fp = typename std::conditional<std::is_same<T_data, double>::value, uint64_t, uint32_t>::type;
+            return decode(streams, n, exp, num_bitplanes, std::vector<uint32_t>());
+        }
+
+        T_data * decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t num_bitplanes, const std::vector<uint32_t>& range_offsets) {
             T_data * data = (T_data *) malloc(n * sizeof(T_data));
             if(num_bitplanes == 0){
                 memset(data, 0, n * sizeof(T_data));
                 return data;
             }
-            std::vector<T_stream const *> streams_pos(streams.size());
-            for(int i=0; i<streams.size(); i++){
-                streams_pos[i] = reinterpret_cast<T_stream const *>(streams[i]);
-            }
             // deinterleave the first bitplane
-            uint32_t recording_bitplane_size = *reinterpret_cast<int32_t const*>(streams_pos[0]);
-            uint8_t const * recording_bitplanes = reinterpret_cast<uint8_t const*>(streams_pos[0]) + sizeof(uint32_t);
-            streams_pos[0] = reinterpret_cast<T_stream const *>(recording_bitplanes + recording_bitplane_size);
-
-            std::vector<T_fp> int_data_buffer(block_size, 0);
-            // decode
-            T_data * data_pos = data;
-            int block_id = 0;
-            for(int i=0; i<n - block_size; i+=block_size){
-                uint8_t recording_bitplane = recording_bitplanes[block_id ++];
-                if(recording_bitplane < num_bitplanes){
-                    memset(int_data_buffer.data(), 0, block_size * sizeof(T_fp));
-                    T_stream sign_bitplane = *(streams_pos[recording_bitplane] ++);
-                    decode_block(streams_pos, block_size, recording_bitplane, num_bitplanes - recording_bitplane, int_data_buffer.data());
-                    for(int j=0; j<block_size; j++, sign_bitplane >>= 1){
-                        T_data cur_data = ldexp((T_data)int_data_buffer[j], - num_bitplanes + exp);
-                        *(data_pos++) = (sign_bitplane & 1u) ? -cur_data : cur_data;
-                    }
-                }
-                else{
-                    for(int j=0; j<block_size; j++){
-                        *(data_pos ++) = 0;
-                    }
-                }
-            }
-            // leftover
-            {
-                int rest_size = n - block_size * block_id;
-                int recording_bitplane = recording_bitplanes[block_id];
-                T_stream sign_bitplane = 0;
-                if(recording_bitplane < num_bitplanes){
-                    memset(int_data_buffer.data(), 0, block_size * sizeof(T_fp));
-                    sign_bitplane = *(streams_pos[recording_bitplane] ++);
-                    decode_block(streams_pos, block_size, recording_bitplane, num_bitplanes - recording_bitplane, int_data_buffer.data());
-                    for(int j=0; j<rest_size; j++, sign_bitplane >>= 1){
-                        T_data cur_data = ldexp((T_data)int_data_buffer[j], - num_bitplanes + exp);
-                        *(data_pos++) = (sign_bitplane & 1u) ? -cur_data : cur_data;
-                    }
-                }
-                else{
-                    for(int j=0; j<block_size; j++){
-                        *(data_pos ++) = 0;
-                    }
-                }
-            }
+            uint32_t recording_bitplane_size = *reinterpret_cast<int32_t const*>(streams[0]);
+            uint8_t const * recording_bitplanes = streams[0] + sizeof(uint32_t);
+            std::vector<uint64_t> signs(get_num_sign_words(n), 0);
+            decode_ranges(streams, n, exp, 0, num_bitplanes, recording_bitplanes, sizeof(uint32_t) + recording_bitplane_size, signs.data(), range_offsets, LevelView<T_data>(data, n));
             return data;
         }
 
         // decode the data and record necessary information for progressiveness
         T_data * progressive_decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, int level) {
-            uint32_t block_size = block_size_based_on_bitplane_int_type<T_stream>();
-            // define fixed point type
-            using T_fp = typename std::conditional<std::is_same<T_data, double>::value, uint64_t, uint32_t>::type;
+            return progressive_decode(streams, n, exp, starting_bitplane, num_bitplanes, level, std::vector<uint32_t>());
+        }
+
+        // decode element ranges in parallel using the range offsets recorded at encoding
+        T_data * progressive_decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, int level, const std::vector<uint32_t>& range_offsets) {
             T_data * data = (T_data *) malloc(n * sizeof(T_data));
+            progressive_decode(streams, n, exp, starting_bitplane, num_bitplanes, level, range_offsets, LevelView<T_data>(data, n));
+            return data;
+        }
+
+        // decode block by block straight into the level view
+        void progressive_decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, int level, const std::vector<uint32_t>& range_offsets, LevelView<T_data> view) {
             if(num_bitplanes == 0){
-                memset(data, 0, n * sizeof(T_data));
-                return data;
-            }
-            std::vector<T_stream const *> streams_pos(streams.size());
-            for(int i=0; i<streams.size(); i++){
-                streams_pos[i] = reinterpret_cast<T_stream const *>(streams[i]);
+                view.fill(0, n);
+                return;
             }
+            uint32_t header_size = 0;
             if(level_recording_bitplanes.size() == level){
                 // deinterleave the first bitplane
-                uint32_t recording_bitplane_size = *reinterpret_cast<int32_t const*>(streams_pos[0]);
-                uint8_t const * recording_bitplanes_pos = reinterpret_cast<uint8_t const*>(streams_pos[0]) + sizeof(uint32_t);
+                uint32_t recording_bitplane_size = *reinterpret_cast<int32_t const*>(streams[0]);
+                uint8_t const * recording_bitplanes_pos = streams[0] + sizeof(uint32_t);
                 auto recording_bitplanes = std::vector<uint8_t>(recording_bitplanes_pos, recording_bitplanes_pos + recording_bitplane_size);
                 level_recording_bitplanes.push_back(recording_bitplanes);
-                streams_pos[0] = reinterpret_cast<T_stream const *>(recording_bitplanes_pos + recording_bitplane_size);
+                header_size = sizeof(uint32_t) + recording_bitplane_size;
+            }
+            if(level_signs.size() == level){
+                level_signs.push_back(std::vector<uint64_t>(get_num_sign_words(n), 0));
             }
+            decode_ranges(streams, n, exp, starting_bitplane, num_bitplanes, level_recording_bitplanes[level].data(), header_size, level_signs[level].data(), range_offsets, view);
+        }
+
+        void set_stream_pool(StreamPool * pool) {
+            stream_pool = pool;
+        }
 
+        void print() const {
+            std::cout << "Grouped bitplane encoder" << std::endl;
+        }
+    private:
+        // encode n elements into newly allocated streams, recording the starting bitplane of each block
+        std::vector<uint8_t *> encode_range(T_data const * data, int32_t n, int32_t exp, uint8_t num_bitplanes, uint8_t * starting_bitplanes, std::vector<uint32_t>& stream_sizes, std::vector<double> * level_errors) const {
+            // determine block size based on bitplane integer type
+            constexpr uint32_t block_size = block_size_of_stream_type<T_stream>();
+            stream_sizes = std::vector<uint32_t>(num_bitplanes, 0);
+            // define fixed point type
+            using T_fp = typename std::conditional<std::is_same<T_data, double>::value, uint64_t, uint32_t>::type;
+            std::vector<uint8_t *> streams;
+            // at most a sign word and a bitplane word per block
+            const uint32_t num_blocks = (n - 1) / block_size + 1;
+            for(int i=0; i<num_bitplanes; i++){
+                streams.push_back(allocate_stream(stream_pool, 2 * num_blocks * sizeof(T_stream)));
+            }
             std::vector<T_fp> int_data_buffer(block_size, 0);
-            if(level_signs.size() == level){
-                level_signs.push_back(std::vector<bool>(n, false));
+            std::vector<T_stream *> streams_pos(streams.size());
+            for(int i=0; i<streams.size(); i++){
+                streams_pos[i] = reinterpret_cast<T_stream*>(streams[i]);
             }
-            const std::vector<uint8_t>& recording_bitplanes = level_recording_bitplanes[level];
-            std::vector<bool>& signs = level_signs[level];
-            const uint8_t ending_bitplane = starting_bitplane + num_bitplanes;
-            // decode
-            T_data * data_pos = data;
-            int block_id = 0;
-            for(int i=0; i<n - block_size; i+=block_size){
-                uint8_t recording_bitplane = recording_bitplanes[block_id ++];
-                if(recording_bitplane < ending_bitplane){
-                    memset(int_data_buffer.data(), 0, block_size * sizeof(T_fp));
-                    if(recording_bitplane >= starting_bitplane){
-                        // have not recorded signs for this block
-                        T_stream sign_bitplane = *(streams_pos[recording_bitplane - starting_bitplane] ++);
-                        for(int j=0; j<block_size; j++, sign_bitplane >>= 1){
-                            signs[i + j] = sign_bitplane & 1u;
-                        }
-                        decode_block(streams_pos, block_size, recording_bitplane - starting_bitplane, ending_bitplane - recording_bitplane, int_data_buffer.data());
-                    }                    
-                    else{
-                        decode_block(streams_pos, block_size, 0, num_bitplanes, int_data_buffer.data());                    
-                    }
-                    for(int j=0; j<block_size; j++){
-                        T_data cur_data = ldexp((T_data)int_data_buffer[j], - ending_bitplane + exp);
-                        *(data_pos++) = signs[i + j] ? -cur_data : cur_data;
+            const int32_t shift = num_bitplanes - exp;
+            int block_id=0;
+            for(int i=0; i<n; i+=block_size){
+                uint32_t cur_block_size = std::min<uint32_t>(block_size, n - i);
+                uint64_t sign_bitplane = 0;
+                Quantizer::quantize(data + i, cur_block_size, shift, int_data_buffer.data(), &sign_bitplane);
+                if(level_errors){
+                    // compute level errors; the integer parts are the quantized magnitudes
+                    for(int j=0; j<cur_block_size; j++){
+                        Quantizer::collect_level_errors<T_data>(*level_errors, int_data_buffer[j], fabs(Quantizer::scale(data[i + j], shift)), num_bitplanes);
                     }
                 }
-                else{
-                    for(int j=0; j<block_size; j++){
-                        *(data_pos ++) = 0;
-                    }
+                starting_bitplanes[block_id ++] = encode_block(int_data_buffer.data(), cur_block_size, num_bitplanes, (T_stream) sign_bitplane, streams_pos);
+            }
+            for(int i=0; i<num_bitplanes; i++){
+                stream_sizes[i] = reinterpret_cast<uint8_t*>(streams_pos[i]) - streams[i];
+            }
+            return streams;
+        }
+
+        // signs of n elements packed in 64-bit words
+        static uint32_t get_num_sign_words(int32_t n){
+            return (n + 63) / 64;
+        }
+
+        // decode all element ranges; without range offsets the level is decoded as a single range
+        // header_size is the size of the starting bitplanes prefixed to streams[0] (0 if absent)
+        // signs hold the recorded sign bits of the level (bit i % 64 of word i / 64 for element i);
+        // ranges start at multiples of RANGE_ALIGNMENT, so threads never write the same sign word
+        void decode_ranges(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, uint8_t const * recording_bitplanes, uint32_t header_size, uint64_t * signs, const std::vector<uint32_t>& range_offsets, const LevelView<T_data>& view) const {
+            constexpr uint32_t block_size = block_size_of_stream_type<T_stream>();
+            if(range_offsets.empty()){
+                std::vector<T_stream const *> streams_pos(streams.size());
+                for(int i=0; i<streams.size(); i++){
+                    streams_pos[i] = reinterpret_cast<T_stream const *>(streams[i]);
                 }
+                streams_pos[0] = reinterpret_cast<T_stream const *>(streams[0] + header_size);
+                decode_range(streams_pos, n, exp, starting_bitplane, num_bitplanes, recording_bitplanes, signs, view);
+                return;
+            }
+            const uint32_t range_size = range_offsets[0];
+            if(range_size % RANGE_ALIGNMENT){
+                std::cerr << "GroupedBPEncoder: range size " << range_size << " is not a multiple of " << RANGE_ALIGNMENT << std::endl;
+                exit(-1);
             }
-            // leftover
-            {
-                int rest_size = n - block_size * block_id;
-                uint8_t recording_bitplane = recording_bitplanes[block_id];
+            const uint32_t num_ranges = get_num_ranges(n, range_size);
+            parallel_for(num_ranges, num_threads, [&](uint32_t r){
+                std::vector<T_stream const *> streams_pos(streams.size());
+                for(int i=0; i<streams.size(); i++){
+                    streams_pos[i] = reinterpret_cast<T_stream const *>(streams[i] + get_range_offset(range_offsets, num_ranges, starting_bitplane + i, r));
+                }
+                uint32_t begin = r * range_size;
+                decode_range(streams_pos, std::min(range_size, n - begin), exp, starting_bitplane, num_bitplanes, recording_bitplanes + begin / block_size, signs + begin / 64, view.at(begin));
+            });
+        }
+
+        // decode n elements; signs point to the sign word of the first element
+        void decode_range(std::vector<T_stream const *>& streams_pos, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, uint8_t const * recording_bitplanes, uint64_t * signs, LevelView<T_data> view) const {
+            constexpr uint32_t block_size = block_size_of_stream_type<T_stream>();
+            // define fixed point type
+            using T_fp = typename std::conditional<std::is_same<T_data, double>::value, uint64_t, uint32_t>::type;
+            std::vector<T_fp> int_data_buffer(block_size, 0);
+            std::vector<T_data> block_data(block_size, 0);
+            const uint8_t ending_bitplane = starting_bitplane + num_bitplanes;
+            constexpr uint64_t block_mask = (block_size == 64) ? ~(uint64_t) 0 : ((uint64_t) 1 << block_size) - 1;
+            // decode
+            int block_id = 0;
+            for(int i=0; i<n; i+=block_size){
+                uint32_t cur_block_size = std::min<uint32_t>(block_size, n - i);
+                uint8_t recording_bitplane = recording_bitplanes[block_id ++];
+                // blocks divide 64 elements, so the signs of a block lie in one word
+                uint64_t& sign_word = signs[i / 64];
+                const uint32_t sign_shift = i % 64;
                 if(recording_bitplane < ending_bitplane){
                     memset(int_data_buffer.data(), 0, block_size * sizeof(T_fp));
+                    uint64_t sign_bitplane = 0;
                     if(recording_bitplane >= starting_bitplane){
                         // have not recorded signs for this block
-                        T_stream sign_bitplane = *(streams_pos[recording_bitplane - starting_bitplane] ++);
-                        for(int j=0; j<rest_size; j++, sign_bitplane >>= 1){
-                            signs[block_size * block_id + j] = sign_bitplane & 1u;
-                        }
-                        decode_block(streams_pos, rest_size, recording_bitplane - starting_bitplane, ending_bitplane - recording_bitplane, int_data_buffer.data());
+                        sign_bitplane = *(streams_pos[recording_bitplane - starting_bitplane] ++);
+                        sign_word |= sign_bitplane << sign_shift;
+                        decode_block(streams_pos, cur_block_size, recording_bitplane - starting_bitplane, ending_bitplane - recording_bitplane, int_data_buffer.data());
                     }
                     else{
-                        decode_block(streams_pos, rest_size, 0, num_bitplanes, int_data_buffer.data());                    
-                    }
-                    for(int j=0; j<rest_size; j++){
-                        T_data cur_data = ldexp((T_data)int_data_buffer[j], - ending_bitplane + exp);
-                        *(data_pos++) = signs[block_size * block_id + j] ? -cur_data : cur_data;
+                        sign_bitplane = (sign_word >> sign_shift) & block_mask;
+                        decode_block(streams_pos, cur_block_size, 0, num_bitplanes, int_data_buffer.data());
                     }
+                    Quantizer::dequantize(int_data_buffer.data(), cur_block_size, exp - ending_bitplane, &sign_bitplane, block_data.data());
+                    view.write(block_data.data(), cur_block_size);
                 }
                 else{
-                    for(int j=0; j<rest_size; j++){
-                        *(data_pos ++) = 0;
-                    }
+                    view.fill(0, cur_block_size);
                 }
             }
-            return data;
-        }
-
-        void print() const {
-            std::cout << "Grouped bitplane encoder" << std::endl;
-        }
-    private:
-        template<class T>
-        uint32_t block_size_based_on_bitplane_int_type() const {
-            uint32_t block_size = 0;
-            if(std::is_same<T, uint64_t>::value){
-                block_size = 64;
-            }
-            else if(std::is_same<T, uint32_t>::value){
-                block_size = 32;
-            }
-            else if(std::is_same<T, uint16_t>::value){
-                block_size = 16;
-            }
-            else if(std::is_same<T, uint8_t>::value){
-                block_size = 8;
-            }
-            else{
-                std::cerr << "Integer type not supported." << std::endl;
-                exit(0);
-            }
-            return block_size;
-        }
-        inline void collect_level_errors(std::vector<double>& level_errors, float data, int num_bitplanes) const {
-            uint32_t fp_data = (uint32_t) data;
-            double mantissa = data - (uint32_t) data;
-            level_errors[num_bitplanes] += mantissa * mantissa;
-            for(int k=1; k<num_bitplanes; k++){
-                uint32_t mask = (1 << k) - 1;
-                double diff = (double) (fp_data & mask) + mantissa;
-                level_errors[num_bitplanes - k] += diff * diff;
-            }
-            double diff = fp_data + mantissa;
-            level_errors[0] += data * data;
         }
 
         template <class T_int>
         inline uint8_t encode_block(T_int const * data, size_t n, uint8_t num_bitplanes, T_stream sign, std::vector<T_stream *>& streams_pos) const {
+            // bit-matrix transpose of the block: bitplanes[k] holds bit k of all elements
+            T_stream bitplanes[64];
+            BitTranspose::encode(data, n, num_bitplanes, bitplanes);
             bool recorded = false;
             uint8_t recording_bitplane = num_bitplanes;
             for(int k=num_bitplanes - 1; k>=0; k--){
-                T_stream bitplane_value = 0;
+                T_stream bitplane_value = bitplanes[k];
                 T_stream bitplane_index = num_bitplanes - 1 - k;
-                for (int i=0; i<n; i++){
-                    bitplane_value += (T_stream)((data[i] >> k) & 1u) << i;
-                }
                 if(bitplane_value || recorded){
                     if(!recorded){
                         recorded = true;
@@ -358,25 +286,26 @@ namespace MDR {
 
         template <class T_int>
         inline void decode_block(std::vector<T_stream const *>& streams_pos, size_t n, uint8_t recording_bitplane, uint8_t num_bitplanes, T_int * data) const {
+            T_stream bitplanes[64];
             for(int k=num_bitplanes - 1; k>=0; k--){
                 T_stream bitplane_index = recording_bitplane + num_bitplanes - 1 - k;
-                T_stream bitplane_value = *(streams_pos[bitplane_index] ++);
-                for (int i=0; i<n; i++){
-                    data[i] += ((bitplane_value >> i) & 1u) << k;
-                }
+                bitplanes[k] = *(streams_pos[bitplane_index] ++);
             }
+            BitTranspose::decode(bitplanes, n, num_bitplanes, data);
         }
 
         uint8_t * merge_arrays(uint8_t const * array1, uint32_t size1, uint8_t const * array2, uint32_t size2, uint32_t& merged_size) const {
             merged_size = sizeof(uint32_t) + size1 + size2;
-            uint8_t * merged_array = (uint8_t *) malloc(merged_size);
+            uint8_t * merged_array = allocate_stream(stream_pool, merged_size);
             *reinterpret_cast<uint32_t*>(merged_array) = size1;
             memcpy(merged_array + sizeof(uint32_t), array1, size1);
             memcpy(merged_array + sizeof(uint32_t) + size1, array2, size2);
             return merged_array;
         }
 
-        std::vector<std::vector<bool>> level_signs;
+        int num_threads = 1;
+        StreamPool * stream_pool = NULL;
+        std::vector<std::vector<uint64_t>> level_signs;
         std::vector<std::vector<uint8_t>> level_recording_bitplanes;
     };
 }
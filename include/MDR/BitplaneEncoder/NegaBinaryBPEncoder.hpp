@@ -2,13 +2,18 @@
 #define _MDR_NEGABINARY_BP_ENCODER_HPP
 
 #include "BitplaneEncoderInterface.hpp"
+#include "BlockSize.hpp"
+#include "BitplaneDispatch.hpp"
+#include "BitTranspose.hpp"
+#include "RangeEncoding.hpp"
+#include "Quantizer.hpp"
 
 namespace MDR {
     // general bitplane encoder that encodes data by block using T_stream type buffer
     template<class T_data, class T_stream>
     class NegaBinaryBPEncoder : public concepts::BitplaneEncoderInterface<T_data> {
     public:
-        NegaBinaryBPEncoder(){
+        NegaBinaryBPEncoder(int num_threads=1) : num_threads(num_threads) {
             static_assert(std::is_floating_point<T_data>::value, "NegaBinaryBPEncoder: input data must be floating points.");
             static_assert(!std::is_same<T_data, long double>::value, "NegaBinaryBPEncoder: long double is not supported.");
             static_assert(std::is_unsigned<T_stream>::value, "NegaBinaryEncoder: streams must be unsigned integers.");
@@ -16,68 +21,59 @@ namespace MDR {
         }
 
         std::vector<uint8_t *> encode(T_data const * data, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<uint32_t>& stream_sizes) const {
+            // only read through the view
+            return encode(LevelView<T_data>(const_cast<T_data *>(data), n), n, exp, num_bitplanes, stream_sizes);
+        }
+
+        // every block occupies one word in every bitplane, so element ranges are encoded in parallel
+        // in place and no range offsets are needed for decoding
+        // blocks are quantized as they are read from the view, so a level is encoded straight from the decomposed grid
+        std::vector<uint8_t *> encode(LevelView<T_data> view, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<uint32_t>& stream_sizes) const {
             assert(num_bitplanes > 0);
             // leave room for negabinary format
             exp += 2;
             // determine block size based on bitplane integer type
-            uint32_t block_size = block_size_based_on_bitplane_int_type<T_stream>();
-            std::vector<uint8_t> starting_bitplanes = std::vector<uint8_t>((n - 1)/block_size + 1, 0);
+            constexpr uint32_t block_size = block_size_of_stream_type<T_stream>();
             stream_sizes = std::vector<uint32_t>(num_bitplanes, 0);
-            // define fixed point type
-            using T_fps = typename std::conditional<std::is_same<T_data, double>::value, int64_t, int32_t>::type;
-            using T_fp = typename std::conditional<std::is_same<T_data, double>::value, uint64_t, uint32_t>::type;
             std::vector<uint8_t *> streams;
             for(int i=0; i<num_bitplanes; i++){
-                streams.push_back((uint8_t *) malloc(n / UINT8_BITS + sizeof(T_stream)));
-            }
-            std::vector<T_fp> int_data_buffer(block_size, 0);
-            std::vector<T_stream *> streams_pos(streams.size());
-            for(int i=0; i<streams.size(); i++){
-                streams_pos[i] = reinterpret_cast<T_stream*>(streams[i]);
-            }
-            T_data const * data_pos = data;
-            for(int i=0; i<n - block_size; i+=block_size){
-                for(int j=0; j<block_size; j++){
-                    T_data cur_data = *(data_pos++);
-                    T_data shifted_data = ldexp(cur_data, num_bitplanes - exp);
-                    int_data_buffer[j] = binary2negabinary((T_fps) shifted_data);
-                }
-                encode_block(int_data_buffer.data(), block_size, num_bitplanes, streams_pos);
+                streams.push_back(allocate_stream(stream_pool, n / UINT8_BITS + sizeof(T_stream)));
             }
-            // leftover
-            {
-                int rest_size = n % block_size;
-                if(rest_size == 0) rest_size = block_size;
-                for(int j=0; j<rest_size; j++){
-                    T_data cur_data = *(data_pos++);
-                    T_data shifted_data = ldexp(cur_data, num_bitplanes - exp);
-                    int_data_buffer[j] = binary2negabinary((T_fps) shifted_data);
+            const uint32_t range_size = compute_range_size(n, num_threads);
+            parallel_for(get_num_ranges(n, range_size), num_threads, [&](uint32_t r){
+                uint32_t begin = r * range_size;
+                std::vector<T_stream *> streams_pos(streams.size());
+                for(int i=0; i<streams.size(); i++){
+                    streams_pos[i] = reinterpret_cast<T_stream*>(streams[i]) + begin / block_size;
                 }
-                encode_block(int_data_buffer.data(), rest_size, num_bitplanes, streams_pos);
-            }
+                encode_range(view.at(begin), std::min(range_size, n - begin), exp, num_bitplanes, streams_pos, NULL);
+            });
             for(int i=0; i<num_bitplanes; i++){
-                stream_sizes[i] = reinterpret_cast<uint8_t*>(streams_pos[i]) - streams[i];
+                stream_sizes[i] = ((n - 1) / block_size + 1) * sizeof(T_stream);
             }
             return streams;
         }
 
+        std::vector<uint8_t *> encode(T_data const * data, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<uint32_t>& stream_sizes, std::vector<uint32_t>& range_offsets) const {
+            range_offsets.clear();
+            return encode(data, n, exp, num_bitplanes, stream_sizes);
+        }
+
+        std::vector<uint8_t *> encode(LevelView<T_data> view, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<uint32_t>& stream_sizes, std::vector<uint32_t>& range_offsets) const {
+            range_offsets.clear();
+            return encode(view, n, exp, num_bitplanes, stream_sizes);
+        }
+
         // only differs in error collection
         std::vector<uint8_t *> encode(T_data const * data, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<uint32_t>& stream_sizes, std::vector<double>& level_errors) const {
             assert(num_bitplanes > 0);
             // leave room for negabinary format
             exp += 2;
-            // determine block size based on bitplane integer type
-            uint32_t block_size = block_size_based_on_bitplane_int_type<T_stream>();
-            std::vector<uint8_t> starting_bitplanes = std::vector<uint8_t>((n - 1)/block_size + 1, 0);
             stream_sizes = std::vector<uint32_t>(num_bitplanes, 0);
-            // define fixed point type
-            using T_fps = typename std::conditional<std::is_same<T_data, double>::value, int64_t, int32_t>::type;
-            using T_fp = typename std::conditional<std::is_same<T_data, double>::value, uint64_t, uint32_t>::type;
             std::vector<uint8_t *> streams;
             for(int i=0; i<num_bitplanes; i++){
-                streams.push_back((uint8_t *) malloc(n / UINT8_BITS + sizeof(T_stream)));
+                streams.push_back(allocate_stream(stream_pool, n / UINT8_BITS + sizeof(T_stream)));
             }
-            std::vector<T_fp> int_data_buffer(block_size, 0);
             std::vector<T_stream *> streams_pos(streams.size());
             for(int i=0; i<streams.size(); i++){
                 streams_pos[i] = reinterpret_cast<T_stream*>(streams[i]);
@@ -88,32 +84,7 @@ namespace MDR {
             for(int i=0; i<level_errors.size(); i++){
                 level_errors[i] = 0;
             }
-            T_data const * data_pos = data;
-            for(int i=0; i<n - block_size; i+=block_size){
-                for(int j=0; j<block_size; j++){
-                    T_data cur_data = *(data_pos++);
-                    T_data shifted_data = ldexp(cur_data, num_bitplanes - exp);
-                    T_fps signed_int_data = (T_fps) shifted_data;
-                    int_data_buffer[j] = binary2negabinary(signed_int_data);
-                    // compute level errors
-                    collect_level_errors(level_errors, int_data_buffer[j], shifted_data, shifted_data - signed_int_data, num_bitplanes);
-                }
-                encode_block(int_data_buffer.data(), block_size, num_bitplanes, streams_pos);
-            }
-            // leftover
-            {
-                int rest_size = n % block_size;
-                if(rest_size == 0) rest_size = block_size;
-                for(int j=0; j<rest_size; j++){
-                    T_data cur_data = *(data_pos++);
-                    T_data shifted_data = ldexp(cur_data, num_bitplanes - exp);
-                    T_fps signed_int_data = (T_fps) shifted_data;
-                    int_data_buffer[j] = binary2negabinary(signed_int_data);
-                    // compute level errors
-                    collect_level_errors(level_errors, int_data_buffer[j], shifted_data, shifted_data - signed_int_data, num_bitplanes);
-                }
-                encode_block(int_data_buffer.data(), rest_size, num_bitplanes, streams_pos);
-            }
+            encode_range(LevelView<T_data>(const_cast<T_data *>(data), n), n, exp, num_bitplanes, streams_pos, &level_errors);
             for(int i=0; i<num_bitplanes; i++){
                 stream_sizes[i] = reinterpret_cast<uint8_t*>(streams_pos[i]) - streams[i];
             }
@@ -130,92 +101,148 @@ namespace MDR {
 
         // decode the data and record necessary information for progressiveness
         T_data * progressive_decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, int level) {
-            uint32_t block_size = block_size_based_on_bitplane_int_type<T_stream>();
             T_data * data = (T_data *) malloc(n * sizeof(T_data));
+            progressive_decode(streams, n, exp, starting_bitplane, num_bitplanes, level, std::vector<uint32_t>(), LevelView<T_data>(data, n));
+            return data;
+        }
+
+        T_data * progressive_decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, int level, const std::vector<uint32_t>& range_offsets) {
+            return progressive_decode(streams, n, exp, starting_bitplane, num_bitplanes, level);
+        }
+
+        // decode block by block straight into the level view
+        void progressive_decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, int level, const std::vector<uint32_t>& range_offsets, LevelView<T_data> view) {
+            constexpr uint32_t block_size = block_size_of_stream_type<T_stream>();
             if(num_bitplanes == 0){
-                memset(data, 0, n * sizeof(T_data));
-                return data;
+                view.fill(0, n);
+                return;
             }
-            // leave room for negabinary format
-            exp += 2;
+            const uint32_t range_size = compute_range_size(n, num_threads);
+            parallel_for(get_num_ranges(n, range_size), num_threads, [&](uint32_t r){
+                uint32_t begin = r * range_size;
+                std::vector<T_stream const *> streams_pos(streams.size());
+                for(int i=0; i<streams.size(); i++){
+                    streams_pos[i] = reinterpret_cast<T_stream const *>(streams[i]) + begin / block_size;
+                }
+                decode_range(streams_pos, std::min(range_size, n - begin), exp, starting_bitplane, num_bitplanes, view.at(begin));
+            });
+        }
+
+        // every block occupies one word in every bitplane, so only the blocks covering the ranges are decoded
+        void progressive_decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, int level, const std::vector<uint32_t>& range_offsets, const std::vector<std::pair<uint32_t, uint32_t>>& ranges, T_data * values) {
+            constexpr uint32_t block_size = block_size_of_stream_type<T_stream>();
+            std::vector<size_t> value_offsets(ranges.size() + 1, 0);
+            for(int r=0; r<ranges.size(); r++){
+                value_offsets[r + 1] = value_offsets[r] + ranges[r].second;
+            }
+            if(num_bitplanes == 0){
+                memset(values, 0, value_offsets.back() * sizeof(T_data));
+                return;
+            }
+            parallel_for(ranges.size(), num_threads, [&](uint32_t r){
+                const uint32_t first_block = ranges[r].first / block_size;
+                const uint32_t end = std::min<uint32_t>(n, ((ranges[r].first + ranges[r].second - 1) / block_size + 1) * block_size);
+                std::vector<T_stream const *> streams_pos(streams.size());
+                for(int i=0; i<streams.size(); i++){
+                    streams_pos[i] = reinterpret_cast<T_stream const *>(streams[i]) + first_block;
+                }
+                std::vector<T_data> blocks(end - first_block * block_size);
+                decode_range(streams_pos, blocks.size(), exp, starting_bitplane, num_bitplanes, LevelView<T_data>(blocks.data(), blocks.size()));
+                memcpy(values + value_offsets[r], blocks.data() + ranges[r].first - first_block * block_size, ranges[r].second * sizeof(T_data));
+            });
+        }
+
+        void set_stream_pool(StreamPool * pool) {
+            stream_pool = pool;
+        }
+
+        // switch between the kernels specialized on the bitplane count and the generic ones
+        void set_fixed_bitplane_kernels(bool enabled) {
+            fixed_bitplane_kernels = enabled;
+        }
+
+        void print() const {
+            std::cout << "NegaBinary bitplane encoder" << std::endl;
+        }
+    private:
+        // the specialized kernels only pay off for float data; double keeps the generic kernels
+        static constexpr uint8_t max_fixed_bitplanes = std::is_same<T_data, float>::value ? std::min(sizeof(T_data), sizeof(T_stream)) * UINT8_BITS : 0;
+
+        // encode n elements; exp already includes the room for negabinary format
+        void encode_range(LevelView<T_data> view, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<T_stream *>& streams_pos, std::vector<double> * level_errors) const {
+            dispatch_bitplanes<max_fixed_bitplanes>(num_bitplanes, fixed_bitplane_kernels, [&](auto bitplanes){
+                encode_range(bitplanes, view, n, exp, num_bitplanes, streams_pos, level_errors);
+            });
+        }
+        // instantiated for NB bitplanes (NB = 0: runtime num_bitplanes)
+        template <uint8_t NB>
+        void encode_range(FixedBitplanes<NB> bitplanes, LevelView<T_data>& view, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<T_stream *>& streams_pos, std::vector<double> * level_errors) const {
+            num_bitplanes = kernel_bitplanes(bitplanes, num_bitplanes);
+            // determine block size based on bitplane integer type
+            constexpr uint32_t block_size = block_size_of_stream_type<T_stream>();
             // define fixed point type
             using T_fps = typename std::conditional<std::is_same<T_data, double>::value, int64_t, int32_t>::type;
             using T_fp = typename std::conditional<std::is_same<T_data, double>::value, uint64_t, uint32_t>::type;
-            std::vector<T_stream const *> streams_pos(streams.size());
-            for(int i=0; i<streams.size(); i++){
-                streams_pos[i] = reinterpret_cast<T_stream const *>(streams[i]);
-            }
+            std::vector<T_fps> signed_int_buffer(block_size, 0);
             std::vector<T_fp> int_data_buffer(block_size, 0);
-            // decode
-            const uint8_t ending_bitplane = starting_bitplane + num_bitplanes;
-            T_data * data_pos = data;
-            // std::cout << "ending_bitplane = " << +ending_bitplane << std::endl;
-            if(ending_bitplane % 2 == 0){
-                for(int i=0; i<n - block_size; i+=block_size){
-                    memset(int_data_buffer.data(), 0, block_size * sizeof(T_fp));
-                    decode_block(streams_pos, block_size, num_bitplanes, int_data_buffer.data());
-                    for(int j=0; j<block_size; j++){
-                        *(data_pos++) = ldexp((T_data) negabinary2binary(int_data_buffer[j]), - ending_bitplane + exp);
-                    }
+            T_data data[block_size];
+            for(int i=0; i<n; i+=block_size){
+                uint32_t cur_block_size = std::min<uint32_t>(block_size, n - i);
+                view.read(data, cur_block_size);
+                Quantizer::quantize_signed(data, cur_block_size, num_bitplanes - exp, signed_int_buffer.data());
+                for(int j=0; j<cur_block_size; j++){
+                    int_data_buffer[j] = binary2negabinary(signed_int_buffer[j]);
                 }
-                // leftover
-                {
-                    int rest_size = n % block_size;
-                    if(rest_size == 0) rest_size = block_size;
-                    memset(int_data_buffer.data(), 0, rest_size * sizeof(T_fp));
-                    decode_block(streams_pos, rest_size, num_bitplanes, int_data_buffer.data());
-                    for(int j=0; j<rest_size; j++){
-                        *(data_pos++) = ldexp((T_data) negabinary2binary(int_data_buffer[j]), - ending_bitplane + exp);
-                    }
-                }                
-            }
-            else{
-                for(int i=0; i<n - block_size; i+=block_size){
-                    memset(int_data_buffer.data(), 0, block_size * sizeof(T_fp));
-                    decode_block(streams_pos, block_size, num_bitplanes, int_data_buffer.data());
-                    for(int j=0; j<block_size; j++){
-                        *(data_pos++) = - ldexp((T_data) negabinary2binary(int_data_buffer[j]), - ending_bitplane + exp);
+                if(level_errors){
+                    // compute level errors
+                    for(int j=0; j<cur_block_size; j++){
+                        T_data shifted_data = Quantizer::scale(data[j], num_bitplanes - exp);
+                        collect_level_errors(*level_errors, int_data_buffer[j], shifted_data, shifted_data - signed_int_buffer[j], num_bitplanes);
                     }
                 }
-                // leftover
-                {
-                    int rest_size = n % block_size;
-                    if(rest_size == 0) rest_size = block_size;
-                    memset(int_data_buffer.data(), 0, rest_size * sizeof(T_fp));
-                    decode_block(streams_pos, rest_size, num_bitplanes, int_data_buffer.data());
-                    for(int j=0; j<rest_size; j++){
-                        *(data_pos++) = - ldexp((T_data) negabinary2binary(int_data_buffer[j]), - ending_bitplane + exp);
-                    }
-                }                
+                encode_block(int_data_buffer.data(), cur_block_size, num_bitplanes, streams_pos);
             }
-            return data;
         }
 
-        void print() const {
-            std::cout << "NegaBinary bitplane encoder" << std::endl;
+        // decode n elements; exp is the level exponent
+        void decode_range(std::vector<T_stream const *>& streams_pos, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, LevelView<T_data> view) const {
+            dispatch_bitplanes<max_fixed_bitplanes>(num_bitplanes, fixed_bitplane_kernels, [&](auto bitplanes){
+                decode_range(bitplanes, streams_pos, n, exp, starting_bitplane, num_bitplanes, view);
+            });
         }
-    private:
-        template<class T>
-        uint32_t block_size_based_on_bitplane_int_type() const {
-            uint32_t block_size = 0;
-            if(std::is_same<T, uint64_t>::value){
-                block_size = 64;
-            }
-            else if(std::is_same<T, uint32_t>::value){
-                block_size = 32;
-            }
-            else if(std::is_same<T, uint16_t>::value){
-                block_size = 16;
-            }
-            else if(std::is_same<T, uint8_t>::value){
-                block_size = 8;
-            }
-            else{
-                std::cerr << "Integer type not supported." << std::endl;
-                exit(0);
+        // instantiated for NB bitplanes (NB = 0: runtime num_bitplanes)
+        template <uint8_t NB>
+        void decode_range(FixedBitplanes<NB> bitplanes, std::vector<T_stream const *>& streams_pos, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, LevelView<T_data>& view) const {
+            num_bitplanes = kernel_bitplanes(bitplanes, num_bitplanes);
+            constexpr uint32_t block_size = block_size_of_stream_type<T_stream>();
+            // leave room for negabinary format
+            exp += 2;
+            // define fixed point type
+            using T_fps = typename std::conditional<std::is_same<T_data, double>::value, int64_t, int32_t>::type;
+            using T_fp = typename std::conditional<std::is_same<T_data, double>::value, uint64_t, uint32_t>::type;
+            std::vector<T_fp> int_data_buffer(block_size, 0);
+            std::vector<T_fps> signed_int_buffer(block_size, 0);
+            std::vector<T_data> block_data(block_size, 0);
+            const uint8_t ending_bitplane = starting_bitplane + num_bitplanes;
+            // the sign of negabinary values flips with the parity of the ending bitplane
+            const bool negate = (ending_bitplane % 2 != 0);
+            for(int i=0; i<n; i+=block_size){
+                uint32_t cur_block_size = std::min<uint32_t>(block_size, n - i);
+                memset(int_data_buffer.data(), 0, cur_block_size * sizeof(T_fp));
+                decode_block(streams_pos, cur_block_size, num_bitplanes, int_data_buffer.data());
+                for(int j=0; j<cur_block_size; j++){
+                    signed_int_buffer[j] = negabinary2binary(int_data_buffer[j]);
+                }
+                Quantizer::dequantize_signed(signed_int_buffer.data(), cur_block_size, exp - ending_bitplane, block_data.data());
+                if(negate){
+                    for(int j=0; j<cur_block_size; j++){
+                        block_data[j] = -block_data[j];
+                    }
+                }
+                view.write(block_data.data(), cur_block_size);
             }
-            return block_size;
         }
+
         inline uint64_t binary2negabinary(const int64_t x) const {
             return (x + (uint64_t)0xaaaaaaaaaaaaaaaaull) ^ (uint64_t)0xaaaaaaaaaaaaaaaaull;
         }
@@ -239,25 +266,27 @@ namespace MDR {
         }
         template <class T_int>
         inline void encode_block(T_int const * data, size_t n, uint8_t num_bitplanes, std::vector<T_stream *>& streams_pos) const {
+            // bit-matrix transpose of the block: bitplanes[k] holds bit k of all elements
+            T_stream bitplanes[64];
+            BitTranspose::encode(data, n, num_bitplanes, bitplanes);
             for(int k=num_bitplanes - 1; k>=0; k--){
-                T_stream bitplane_value = 0;
                 T_stream bitplane_index = num_bitplanes - 1 - k;
-                for (int i=0; i<n; i++){
-                    bitplane_value += (T_stream)((data[i] >> k) & 1u) << i;
-                }
-                *(streams_pos[bitplane_index] ++) = bitplane_value;
+                *(streams_pos[bitplane_index] ++) = bitplanes[k];
             }
         }
         template <class T_int>
         inline void decode_block(std::vector<T_stream const *>& streams_pos, size_t n, uint8_t num_bitplanes, T_int * data) const {
+            T_stream bitplanes[64];
             for(int k=num_bitplanes - 1; k>=0; k--){
                 T_stream bitplane_index = num_bitplanes - 1 - k;
-                T_stream bitplane_value = *(streams_pos[bitplane_index] ++);
-                for (int i=0; i<n; i++){
-                    data[i] += ((bitplane_value >> i) & 1u) << k;
-                }
+                bitplanes[k] = *(streams_pos[bitplane_index] ++);
             }
+            BitTranspose::decode(bitplanes, n, num_bitplanes, data);
         }
+
+        int num_threads = 1;
+        bool fixed_bitplane_kernels = true;
+        StreamPool * stream_pool = NULL;
     };
 }
 #endif
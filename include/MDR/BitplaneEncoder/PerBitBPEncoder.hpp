@@ -2,6 +2,11 @@
 #define _MDR_PERBIT_BP_ENCODER_HPP
 
 #include "BitplaneEncoderInterface.hpp"
+#include "BlockSize.hpp"
+#include "BitplaneDispatch.hpp"
+#include "BitTranspose.hpp"
+#include "RangeEncoding.hpp"
+#include "Quantizer.hpp"
 #include <bitset>
 namespace MDR {
     class BitEncoder{
@@ -21,6 +26,17 @@ namespace MDR {
                 position = 0;
             }
         }
+        // append the lowest len (<= 64) bits of bits
+        void encode(uint64_t bits, uint8_t len){
+            if(len < 64) bits &= (1ull << len) - 1;
+            buffer += bits << position;
+            position += len;
+            if(position >= 64){
+                *(stream_pos ++) = buffer;
+                position -= 64;
+                buffer = position ? bits >> (len - position) : 0;
+            }
+        }
         void flush(){
             if(position){
                 *(stream_pos ++) = buffer;
@@ -31,6 +47,10 @@ namespace MDR {
         uint32_t size(){
             return (stream_pos - stream_begin);
         }
+        // number of bits encoded so far
+        uint64_t bit_size() const {
+            return (stream_pos - stream_begin) * 64 + position;
+        }
     private:
         uint64_t buffer = 0;
         uint8_t position = 0;
@@ -46,6 +66,14 @@ namespace MDR {
             buffer = 0;
             position = 0;
         }
+        // start decoding at bit_offset of the stream
+        BitDecoder(uint64_t const * stream_begin_pos, uint64_t bit_offset) : BitDecoder(stream_begin_pos) {
+            stream_pos = stream_begin + bit_offset / 64;
+            if(bit_offset % 64){
+                position = 64 - bit_offset % 64;
+                buffer = *(stream_pos ++) >> (bit_offset % 64);
+            }
+        }
         uint8_t decode(){
             if(position == 0){
                 buffer = *(stream_pos ++);
@@ -56,6 +84,24 @@ namespace MDR {
             position --;
             return b;
         }
+        // next len (<= 64) bits without consuming them; they must lie within the stream
+        uint64_t peek(uint8_t len) const {
+            uint64_t bits = buffer;
+            if(position < len) bits += *stream_pos << position;
+            return (len < 64) ? bits & ((1ull << len) - 1) : bits;
+        }
+        void skip(uint8_t len){
+            if(position >= len){
+                buffer = (len < 64) ? buffer >> len : 0;
+                position -= len;
+            }
+            else{
+                uint8_t consumed = len - position;
+                uint64_t next = *(stream_pos ++);
+                buffer = (consumed < 64) ? next >> consumed : 0;
+                position = 64 - consumed;
+            }
+        }
         uint32_t size(){
             return (stream_pos - stream_begin);
         }
@@ -66,12 +112,15 @@ namespace MDR {
         uint64_t const * stream_begin = NULL;
     };
 
-    #define PER_BIT_BLOCK_SIZE 1
+    #define PER_BIT_GROUP_SIZE 64
     // per bit bitplane encoder that encodes data by bit using T_stream type buffer
+    // elements are processed in groups of 64 as bit-sliced words: bitplane k of a group is one
+    // uint64_t, and the sign of an element is spliced in right after its first nonzero bit
     template<class T_data, class T_stream>
     class PerBitBPEncoder : public concepts::BitplaneEncoderInterface<T_data> {
     public:
-        PerBitBPEncoder(){
+        using concepts::BitplaneEncoderInterface<T_data>::progressive_decode;
+        PerBitBPEncoder(int num_threads=1) : num_threads(num_threads) {
             static_assert(std::is_floating_point<T_data>::value, "PerBitBPEncoder: input data must be floating points.");
             static_assert(!std::is_same<T_data, long double>::value, "PerBitBPEncoder: long double is not supported.");
             static_assert(std::is_unsigned<T_stream>::value, "PerBitBPEncoder: streams must be unsigned integers.");
@@ -79,145 +128,47 @@ namespace MDR {
         }
 
         std::vector<uint8_t *> encode(T_data const * data, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<uint32_t>& stream_sizes) const {
+            std::vector<uint32_t> range_offsets;
+            return encode(data, n, exp, num_bitplanes, stream_sizes, range_offsets);
+        }
+
+        std::vector<uint8_t *> encode(T_data const * data, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<uint32_t>& stream_sizes, std::vector<uint32_t>& range_offsets) const {
+            // only read through the view
+            return encode(LevelView<T_data>(const_cast<T_data *>(data), n), n, exp, num_bitplanes, stream_sizes, range_offsets);
+        }
+
+        // encode element ranges in parallel; range_offsets records the starting bit of each range in every bitplane
+        // groups are quantized as they are read from the view, so a level is encoded straight from the decomposed grid
+        std::vector<uint8_t *> encode(LevelView<T_data> view, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<uint32_t>& stream_sizes, std::vector<uint32_t>& range_offsets) const {
             assert(num_bitplanes > 0);
-            // determine block size based on bitplane integer type
-            const int32_t block_size = PER_BIT_BLOCK_SIZE;
-            stream_sizes = std::vector<uint32_t>(num_bitplanes, 0);
-            // define fixed point type
-            using T_fp = typename std::conditional<std::is_same<T_data, double>::value, uint64_t, uint32_t>::type;
-            std::vector<uint8_t *> streams;
-            for(int i=0; i<num_bitplanes; i++){
-                streams.push_back((uint8_t *) malloc(2 * n / UINT8_BITS + sizeof(uint64_t)));
-            }
-            std::vector<BitEncoder> encoders;
-            for(int i=0; i<streams.size(); i++){
-                encoders.push_back(BitEncoder(reinterpret_cast<uint64_t*>(streams[i])));
-            }
-            T_data const * data_pos = data;
-            for(int i=0; i<n - block_size; i+=block_size){
-                T_stream sign_bitplane = 0;
-                for(int j=0; j<block_size; j++){
-                    T_data cur_data = *(data_pos++);
-                    T_data shifted_data = ldexp(cur_data, num_bitplanes - exp);
-                    bool sign = cur_data < 0;
-                    int64_t fix_point = (int64_t) shifted_data;
-                    T_fp fp_data = sign ? -fix_point : +fix_point;
-                    // compute level errors
-                    bool first_bit = true;
-                    for(int k=num_bitplanes - 1; k>=0; k--){
-                        uint8_t index = num_bitplanes - 1 - k;
-                        uint8_t bit = (fp_data >> k) & 1u;
-                        encoders[index].encode(bit);
-                        if(bit && first_bit){
-                            encoders[index].encode(sign);
-                            first_bit = false;
-                        }
-                    }                    
-                }
-            }
-            // leftover
-            {
-                int rest_size = n % block_size;
-                if(rest_size == 0) rest_size = block_size;
-                for(int j=0; j<rest_size; j++){
-                    T_data cur_data = *(data_pos++);
-                    T_data shifted_data = ldexp(cur_data, num_bitplanes - exp);
-                    bool sign = cur_data < 0;
-                    int64_t fix_point = (int64_t) shifted_data;
-                    T_fp fp_data = sign ? -fix_point : +fix_point;
-                    // compute level errors
-                    bool first_bit = true;
-                    for(int k=num_bitplanes - 1; k>=0; k--){
-                        uint8_t index = num_bitplanes - 1 - k;
-                        uint8_t bit = (fp_data >> k) & 1u;
-                        encoders[index].encode(bit);
-                        if(bit && first_bit){
-                            encoders[index].encode(sign);
-                            first_bit = false;
-                        }
-                    }                    
-                }
-            }
-            for(int i=0; i<num_bitplanes; i++){
-                encoders[i].flush();
-                stream_sizes[i] = encoders[i].size() * sizeof(uint64_t);
+            const uint32_t range_size = compute_range_size(n, num_threads);
+            const uint32_t num_ranges = get_num_ranges(n, range_size);
+            if(num_ranges == 1){
+                range_offsets.clear();
+                std::vector<uint32_t> stream_bits;
+                return encode_range(view, n, exp, num_bitplanes, stream_sizes, stream_bits, NULL);
             }
-            return streams;
+            std::vector<std::vector<uint8_t *>> range_streams(num_ranges);
+            std::vector<std::vector<uint32_t>> range_stream_bits(num_ranges);
+            parallel_for(num_ranges, num_threads, [&](uint32_t r){
+                uint32_t begin = r * range_size;
+                std::vector<uint32_t> range_stream_sizes;
+                range_streams[r] = encode_range(view.at(begin), std::min(range_size, n - begin), exp, num_bitplanes, range_stream_sizes, range_stream_bits[r], NULL);
+            });
+            return stitch_range_bitstreams(range_streams, range_stream_bits, range_size, num_threads, stream_sizes, range_offsets, stream_pool);
         }
 
         // only differs in error collection
         std::vector<uint8_t *> encode(T_data const * data, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<uint32_t>& stream_sizes, std::vector<double>& level_errors) const {
             assert(num_bitplanes > 0);
-            // determine block size based on bitplane integer type
-            const int32_t block_size = PER_BIT_BLOCK_SIZE;
-            stream_sizes = std::vector<uint32_t>(num_bitplanes, 0);
-            // define fixed point type
-            using T_fp = typename std::conditional<std::is_same<T_data, double>::value, uint64_t, uint32_t>::type;
-            std::vector<uint8_t *> streams;
-            for(int i=0; i<num_bitplanes; i++){
-                streams.push_back((uint8_t *) malloc(2 * n / UINT8_BITS + sizeof(uint64_t)));
-            }
-            std::vector<BitEncoder> encoders;
-            for(int i=0; i<streams.size(); i++){
-                encoders.push_back(BitEncoder(reinterpret_cast<uint64_t*>(streams[i])));
-            }
             // init level errors
             level_errors.clear();
             level_errors.resize(num_bitplanes + 1);
             for(int i=0; i<level_errors.size(); i++){
                 level_errors[i] = 0;
             }
-            T_data const * data_pos = data;
-            for(int i=0; i<n - block_size; i+=block_size){
-                T_stream sign_bitplane = 0;
-                for(int j=0; j<block_size; j++){
-                    T_data cur_data = *(data_pos++);
-                    T_data shifted_data = ldexp(cur_data, num_bitplanes - exp);
-                    bool sign = cur_data < 0;
-                    int64_t fix_point = (int64_t) shifted_data;
-                    T_fp fp_data = sign ? -fix_point : +fix_point;
-                    // compute level errors
-                    collect_level_errors(level_errors, fabs(shifted_data), num_bitplanes);
-                    bool first_bit = true;
-                    for(int k=num_bitplanes - 1; k>=0; k--){
-                        uint8_t index = num_bitplanes - 1 - k;
-                        uint8_t bit = (fp_data >> k) & 1u;
-                        encoders[index].encode(bit);
-                        if(bit && first_bit){
-                            encoders[index].encode(sign);
-                            first_bit = false;
-                        }
-                    }                    
-                }
-            }
-            // leftover
-            {
-                int rest_size = n % block_size;
-                if(rest_size == 0) rest_size = block_size;
-                for(int j=0; j<rest_size; j++){
-                    T_data cur_data = *(data_pos++);
-                    T_data shifted_data = ldexp(cur_data, num_bitplanes - exp);
-                    bool sign = cur_data < 0;
-                    int64_t fix_point = (int64_t) shifted_data;
-                    T_fp fp_data = sign ? -fix_point : +fix_point;
-                    // compute level errors
-                    collect_level_errors(level_errors, fabs(shifted_data), num_bitplanes);
-                    bool first_bit = true;
-                    for(int k=num_bitplanes - 1; k>=0; k--){
-                        uint8_t index = num_bitplanes - 1 - k;
-                        uint8_t bit = (fp_data >> k) & 1u;
-                        encoders[index].encode(bit);
-                        if(bit && first_bit){
-                            encoders[index].encode(sign);
-                            first_bit = false;
-                        }
-                    }                    
-                }
-            }
-            for(int i=0; i<num_bitplanes; i++){
-                encoders[i].flush();
-                stream_sizes[i] = encoders[i].size() * sizeof(uint64_t);
-            }
+            std::vector<uint32_t> stream_bits;
+            auto streams = encode_range(LevelView<T_data>(const_cast<T_data *>(data), n), n, exp, num_bitplanes, stream_sizes, stream_bits, &level_errors);
             // translate level errors
             for(int i=0; i<level_errors.size(); i++){
                 level_errors[i] = ldexp(level_errors[i], 2*(- num_bitplanes + exp));
@@ -226,178 +177,213 @@ namespace MDR {
         }
 
         T_data * decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t num_bitplanes) {
-            const int32_t block_size = PER_BIT_BLOCK_SIZE;
-            // define fixed point type
-            using T_fp = typename std::conditional<std::is_same<T_data, double>::value, uint64_t, uint32_t>::type;
+            return decode(streams, n, exp, num_bitplanes, std::vector<uint32_t>());
+        }
+
+        T_data * decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t num_bitplanes, const std::vector<uint32_t>& range_offsets) {
             T_data * data = (T_data *) malloc(n * sizeof(T_data));
             if(num_bitplanes == 0){
                 memset(data, 0, n * sizeof(T_data));
                 return data;
             }
-            std::vector<BitDecoder> decoders;
-            for(int i=0; i<streams.size(); i++){
-                decoders.push_back(BitDecoder(reinterpret_cast<uint64_t const*>(streams[i])));
-                decoders[i].size();
-            }
-            // decode
-            T_data * data_pos = data;
-            for(int i=0; i<n - block_size; i+=block_size){
-                for(int j=0; j<block_size; j++){
-                    T_fp fp_data = 0;
-                    // decode each bit of the data for each level component
-                    bool first_bit = true;
-                    bool sign = false;
-                    for(int k=num_bitplanes - 1; k>=0; k--){
-                        uint8_t index = num_bitplanes - 1 - k;
-                        uint8_t bit = decoders[index].decode();
-                        fp_data += bit << k;
-                        if(bit && first_bit){
-                            // decode sign
-                            sign = decoders[index].decode();
-                            first_bit = false;
-                        }
-                    }
-                    T_data cur_data = ldexp((T_data)fp_data, - num_bitplanes + exp);
-                    *(data_pos++) = sign ? -cur_data : cur_data;
-                }
-            }
-            // leftover
-            {
-                int rest_size = n % block_size;
-                if(rest_size == 0) rest_size = block_size;
-                for(int j=0; j<rest_size; j++){
-                    T_fp fp_data = 0;
-                    // decode each bit of the data for each level component
-                    bool first_bit = true;
-                    bool sign = false;
-                    for(int k=num_bitplanes - 1; k>=0; k--){
-                        uint8_t index = num_bitplanes - 1 - k;
-                        uint8_t bit = decoders[index].decode();
-                        fp_data += bit << k;
-                        if(bit && first_bit){
-                            // decode sign
-                            sign = decoders[index].decode();
-                            first_bit = false;
-                        }
-                    }
-                    T_data cur_data = ldexp((T_data)fp_data, - num_bitplanes + exp);
-                    *(data_pos++) = sign ? -cur_data : cur_data;
-                }
-            }
+            decode_ranges(streams, n, exp - num_bitplanes, 0, num_bitplanes, NULL, NULL, range_offsets, LevelView<T_data>(data, n));
             return data;
         }
 
         T_data * progressive_decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, int level) {
-            const int32_t block_size = PER_BIT_BLOCK_SIZE;
-            // define fixed point type
-            using T_fp = typename std::conditional<std::is_same<T_data, double>::value, uint64_t, uint32_t>::type;
+            return progressive_decode(streams, n, exp, starting_bitplane, num_bitplanes, level, std::vector<uint32_t>());
+        }
+
+        // decode element ranges in parallel using the range offsets recorded at encoding
+        T_data * progressive_decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, int level, const std::vector<uint32_t>& range_offsets) {
             T_data * data = (T_data *) malloc(n * sizeof(T_data));
+            progressive_decode(streams, n, exp, starting_bitplane, num_bitplanes, level, range_offsets, LevelView<T_data>(data, n));
+            return data;
+        }
+
+        // decode group by group straight into the level view
+        void progressive_decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, int level, const std::vector<uint32_t>& range_offsets, LevelView<T_data> view) {
             if(num_bitplanes == 0){
-                memset(data, 0, n * sizeof(T_data));
-                return data;
-            }
-            std::vector<BitDecoder> decoders;
-            for(int i=0; i<streams.size(); i++){
-                decoders.push_back(BitDecoder(reinterpret_cast<uint64_t const*>(streams[i])));
-                decoders[i].size();
+                view.fill(0, n);
+                return;
             }
             if(level_signs.size() == level){
-                level_signs.push_back(std::vector<bool>(n, false));
-                sign_flags.push_back(std::vector<bool>(n, false));
+                const uint32_t num_groups = (n + PER_BIT_GROUP_SIZE - 1) / PER_BIT_GROUP_SIZE;
+                level_signs.push_back(std::vector<uint64_t>(num_groups, 0));
+                level_significance.push_back(std::vector<uint64_t>(num_groups, 0));
             }
-            std::vector<bool>& signs = level_signs[level];
-            std::vector<bool>& flags = sign_flags[level];
             const uint8_t ending_bitplane = starting_bitplane + num_bitplanes;
-            // decode
-            T_data * data_pos = data;
-            for(int i=0; i<n - block_size; i+=block_size){
-                for(int j=0; j<block_size; j++){
-                    T_fp fp_data = 0;
-                    // decode each bit of the data for each level component
-                    bool sign = false;
-                    if(flags[i + j]){
-                        // sign recorded
-                        sign = signs[i + j];
-                        for(int k=num_bitplanes - 1; k>=0; k--){
-                            uint8_t index = num_bitplanes - 1 - k;
-                            T_fp bit = decoders[index].decode();
-                            fp_data += bit << k;
-                        }
-                    }
-                    else{
-                        // decode sign if possible
-                        bool first_bit = true;
-                        for(int k=num_bitplanes - 1; k>=0; k--){
-                            uint8_t index = num_bitplanes - 1 - k;
-                            T_fp bit = decoders[index].decode();
-                            fp_data += bit << k;
-                            if(bit && first_bit){
-                                // decode sign
-                                sign = decoders[index].decode();
-                                first_bit = false;
-                                flags[i + j] = true;
-                            }
-                        }
-                        signs[i + j] = sign;
-                    }
-                    T_data cur_data = ldexp((T_data)fp_data, - ending_bitplane + exp);
-                    *(data_pos++) = sign ? -cur_data : cur_data;
+            decode_ranges(streams, n, exp - ending_bitplane, starting_bitplane, num_bitplanes, level_significance[level].data(), level_signs[level].data(), range_offsets, view);
+        }
+        void set_stream_pool(StreamPool * pool) {
+            stream_pool = pool;
+        }
+        // switch between the kernels specialized on the bitplane count and the generic ones
+        void set_fixed_bitplane_kernels(bool enabled) {
+            fixed_bitplane_kernels = enabled;
+        }
+        void print() const {
+            std::cout << "Per-bit bitplane encoder" << std::endl;
+        }
+    private:
+        using T_fp = typename std::conditional<std::is_same<T_data, double>::value, uint64_t, uint32_t>::type;
+        // the specialized kernels only pay off for float data; double keeps the generic kernels
+        static constexpr uint8_t max_fixed_bitplanes = std::is_same<T_data, float>::value ? std::min(sizeof(T_data), sizeof(T_stream)) * UINT8_BITS : 0;
+
+        // encode n elements into newly allocated streams; stream_bits receives the number of bits in each stream
+        std::vector<uint8_t *> encode_range(LevelView<T_data> view, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<uint32_t>& stream_sizes, std::vector<uint32_t>& stream_bits, std::vector<double> * level_errors) const {
+            return dispatch_bitplanes<max_fixed_bitplanes>(num_bitplanes, fixed_bitplane_kernels, [&](auto bitplanes){
+                return encode_range(bitplanes, view, n, exp, num_bitplanes, stream_sizes, stream_bits, level_errors);
+            });
+        }
+        // instantiated for NB bitplanes (NB = 0: runtime num_bitplanes)
+        template <uint8_t NB>
+        std::vector<uint8_t *> encode_range(FixedBitplanes<NB> bitplanes, LevelView<T_data>& view, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<uint32_t>& stream_sizes, std::vector<uint32_t>& stream_bits, std::vector<double> * level_errors) const {
+            num_bitplanes = kernel_bitplanes(bitplanes, num_bitplanes);
+            stream_sizes = std::vector<uint32_t>(num_bitplanes, 0);
+            stream_bits = std::vector<uint32_t>(num_bitplanes, 0);
+            std::vector<uint8_t *> streams;
+            for(int i=0; i<num_bitplanes; i++){
+                streams.push_back(allocate_stream(stream_pool, 2 * n / UINT8_BITS + sizeof(uint64_t)));
+            }
+            std::vector<BitEncoder> encoders;
+            for(int i=0; i<streams.size(); i++){
+                encoders.push_back(BitEncoder(reinterpret_cast<uint64_t*>(streams[i])));
+            }
+            T_data group_data[PER_BIT_GROUP_SIZE];
+            for(int i=0; i<n; i+=PER_BIT_GROUP_SIZE){
+                int32_t size = std::min(n - i, PER_BIT_GROUP_SIZE);
+                view.read(group_data, size);
+                encode_group(group_data, size, exp, num_bitplanes, encoders, level_errors);
+            }
+            for(int i=0; i<num_bitplanes; i++){
+                stream_bits[i] = encoders[i].bit_size();
+                encoders[i].flush();
+                stream_sizes[i] = encoders[i].size() * sizeof(uint64_t);
+            }
+            return streams;
+        }
+
+        // decode all element ranges; without range offsets the level is decoded as a single range
+        // significance and signs hold the progressive state (one word per group), or NULL when decoding from scratch
+        void decode_ranges(const std::vector<uint8_t const *>& streams, int32_t n, int scale_exp, uint8_t starting_bitplane, uint8_t num_bitplanes, uint64_t * significance, uint64_t * signs, const std::vector<uint32_t>& range_offsets, const LevelView<T_data>& view) const {
+            if(range_offsets.empty()){
+                std::vector<BitDecoder> decoders;
+                for(int i=0; i<streams.size(); i++){
+                    decoders.push_back(BitDecoder(reinterpret_cast<uint64_t const*>(streams[i])));
                 }
+                decode_range(decoders, n, scale_exp, num_bitplanes, significance, signs, view);
+                return;
             }
-            // leftover
-            {
-                int rest_size = n % block_size;
-                if(rest_size == 0) rest_size = block_size;
-                for(int j=0; j<rest_size; j++){
-                    T_fp fp_data = 0;
-                    // decode each bit of the data for each level component
-                    bool sign = false;
-                    if(flags[n - rest_size + j]){
-                        sign = signs[n - rest_size + j];
-                        for(int k=num_bitplanes - 1; k>=0; k--){
-                            uint8_t index = num_bitplanes - 1 - k;
-                            T_fp bit = decoders[index].decode();
-                            fp_data += bit << k;
-                        }
-                    }
-                    else{
-                        bool first_bit = true;
-                        for(int k=num_bitplanes - 1; k>=0; k--){
-                            uint8_t index = num_bitplanes - 1 - k;
-                            T_fp bit = decoders[index].decode();
-                            fp_data += bit << k;
-                            if(bit && first_bit){
-                                // decode sign
-                                sign = decoders[index].decode();
-                                first_bit = false;
-                                flags[n - rest_size + j] = true;
-                            }
-                        }
-                        signs[n - rest_size + j] = sign;
-                    }
-                    T_data cur_data = ldexp((T_data)fp_data, - ending_bitplane + exp);
-                    *(data_pos++) = sign ? -cur_data : cur_data;
+            const uint32_t range_size = range_offsets[0];
+            const uint32_t num_ranges = get_num_ranges(n, range_size);
+            parallel_for(num_ranges, num_threads, [&](uint32_t r){
+                std::vector<BitDecoder> decoders;
+                for(int i=0; i<streams.size(); i++){
+                    decoders.push_back(BitDecoder(reinterpret_cast<uint64_t const*>(streams[i]), get_range_bit_offset(range_offsets, num_ranges, starting_bitplane + i, r)));
+                }
+                uint32_t begin = r * range_size;
+                uint32_t group_begin = begin / PER_BIT_GROUP_SIZE;
+                decode_range(decoders, std::min(range_size, n - begin), scale_exp, num_bitplanes, significance ? significance + group_begin : NULL, signs ? signs + group_begin : NULL, view.at(begin));
+            });
+        }
+
+        // decode n elements; significance and signs point to the state words of their groups
+        void decode_range(std::vector<BitDecoder>& decoders, int32_t n, int scale_exp, uint8_t num_bitplanes, uint64_t * significance, uint64_t * signs, LevelView<T_data> view) const {
+            dispatch_bitplanes<max_fixed_bitplanes>(num_bitplanes, fixed_bitplane_kernels, [&](auto bitplanes){
+                decode_range(bitplanes, decoders, n, scale_exp, num_bitplanes, significance, signs, view);
+            });
+        }
+        // instantiated for NB bitplanes (NB = 0: runtime num_bitplanes)
+        template <uint8_t NB>
+        void decode_range(FixedBitplanes<NB> bitplanes, std::vector<BitDecoder>& decoders, int32_t n, int scale_exp, uint8_t num_bitplanes, uint64_t * significance, uint64_t * signs, LevelView<T_data>& view) const {
+            num_bitplanes = kernel_bitplanes(bitplanes, num_bitplanes);
+            T_data group_data[PER_BIT_GROUP_SIZE];
+            for(int i=0; i<n; i+=PER_BIT_GROUP_SIZE){
+                int32_t size = std::min(n - i, PER_BIT_GROUP_SIZE);
+                if(significance){
+                    const uint32_t group = i / PER_BIT_GROUP_SIZE;
+                    decode_group(decoders, size, num_bitplanes, significance[group], signs[group], scale_exp, group_data);
                 }
+                else{
+                    uint64_t group_significance = 0;
+                    uint64_t group_signs = 0;
+                    decode_group(decoders, size, num_bitplanes, group_significance, group_signs, scale_exp, group_data);
+                }
+                view.write(group_data, size);
             }
-            return data;
         }
-        void print() const {
-            std::cout << "Per-bit bitplane encoder" << std::endl;
+
+        // encode one group of size <= 64 elements
+        inline void encode_group(T_data const * data, int32_t size, int32_t exp, uint8_t num_bitplanes, std::vector<BitEncoder>& encoders, std::vector<double> * level_errors) const {
+            T_fp fp_data[PER_BIT_GROUP_SIZE];
+            uint64_t signs = 0;
+            Quantizer::quantize(data, size, num_bitplanes - exp, fp_data, &signs);
+            if(level_errors){
+                for(int j=0; j<size; j++){
+                    Quantizer::collect_level_errors(*level_errors, fabs(Quantizer::scale(data[j], num_bitplanes - exp)), num_bitplanes);
+                }
+            }
+            uint64_t bitplanes[PER_BIT_GROUP_SIZE];
+            BitTranspose::encode(fp_data, size, num_bitplanes, bitplanes);
+            uint64_t significance = 0;
+            for(int k=num_bitplanes - 1; k>=0; k--){
+                BitEncoder& encoder = encoders[num_bitplanes - 1 - k];
+                uint64_t bitplane = bitplanes[k];
+                uint64_t newly_significant = bitplane & ~significance;
+                significance |= bitplane;
+                // copy runs of bits up to each newly significant element, then its sign
+                int pos = 0;
+                while(newly_significant){
+                    int j = __builtin_ctzll(newly_significant);
+                    newly_significant &= newly_significant - 1;
+                    encoder.encode(bitplane >> pos, j + 1 - pos);
+                    encoder.encode((signs >> j) & 1u);
+                    pos = j + 1;
+                }
+                if(pos < size) encoder.encode(bitplane >> pos, size - pos);
+            }
         }
-    private:
-        inline void collect_level_errors(std::vector<double>& level_errors, float data, int num_bitplanes) const {
-            uint32_t fp_data = (uint32_t) data;
-            double mantissa = data - (uint32_t) data;
-            level_errors[num_bitplanes] += mantissa * mantissa;
-            for(int k=1; k<num_bitplanes; k++){
-                uint32_t mask = (1 << k) - 1;
-                double diff = (double) (fp_data & mask) + mantissa;
-                level_errors[num_bitplanes - k] += diff * diff;
+
+        // decode one group of size <= 64 elements into data, scaled by 2^scale_exp
+        // significance and signs carry the elements whose signs are already known
+        inline void decode_group(std::vector<BitDecoder>& decoders, int32_t size, uint8_t num_bitplanes, uint64_t& significance, uint64_t& signs, int scale_exp, T_data * data) const {
+            uint64_t bitplanes[PER_BIT_GROUP_SIZE];
+            for(int k=num_bitplanes - 1; k>=0; k--){
+                BitDecoder& decoder = decoders[num_bitplanes - 1 - k];
+                uint64_t bitplane = 0;
+                int pos = 0;
+                while(pos < size){
+                    // bits of the remaining elements, assuming no sign bit in between
+                    uint8_t len = size - pos;
+                    uint64_t bits = decoder.peek(len);
+                    uint64_t newly_significant = bits & ~(significance >> pos);
+                    if(!newly_significant){
+                        bitplane |= bits << pos;
+                        decoder.skip(len);
+                        break;
+                    }
+                    int j = __builtin_ctzll(newly_significant);
+                    if(j < 63) bits &= (1ull << (j + 1)) - 1;
+                    bitplane |= bits << pos;
+                    decoder.skip(j + 1);
+                    signs |= (uint64_t) decoder.decode() << (pos + j);
+                    pos += j + 1;
+                }
+                significance |= bitplane;
+                bitplanes[k] = bitplane;
             }
-            level_errors[0] += data * data;
+            T_fp fp_data[PER_BIT_GROUP_SIZE] = {0};
+            BitTranspose::decode(bitplanes, size, num_bitplanes, fp_data);
+            Quantizer::dequantize(fp_data, size, scale_exp, &signs, data);
         }
-        std::vector<std::vector<bool>> level_signs;
-        std::vector<std::vector<bool>> sign_flags;
+
+        int num_threads = 1;
+        bool fixed_bitplane_kernels = true;
+        StreamPool * stream_pool = NULL;
+        // progressive state per level: bit j of word g is for element g * PER_BIT_GROUP_SIZE + j
+        std::vector<std::vector<uint64_t>> level_signs;
+        std::vector<std::vector<uint64_t>> level_significance;
     };
 }
 #endif
@@ -0,0 +1,206 @@
+#ifndef _MDR_QUANTIZER_HPP
+#define _MDR_QUANTIZER_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <limits>
+#include <type_traits>
+#include <algorithm>
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define MDR_QUANTIZER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace MDR {
+    // conversion between floating-point data and the fixed-point integers coded by bitplane encoders
+    // scaling by 2^e multiplies by a power of two assembled from exponent bits, which equals ldexp(x, e)
+    // whenever 2^e is a normal number; other exponents (levels of denormal data) fall back to ldexp
+    namespace Quantizer {
+
+        template <class T>
+        inline bool exp2_is_normal(int e){
+            return (e >= std::numeric_limits<T>::min_exponent - 1) && (e <= std::numeric_limits<T>::max_exponent - 1);
+        }
+
+        // 2^e for exp2_is_normal<T>(e)
+        template <class T>
+        inline T exp2(int e){
+            using T_bits = typename std::conditional<std::is_same<T, double>::value, uint64_t, uint32_t>::type;
+            const int mantissa_bits = std::numeric_limits<T>::digits - 1;
+            const int bias = std::numeric_limits<T>::max_exponent - 1;
+            T_bits bits = (T_bits) (e + bias) << mantissa_bits;
+            T value;
+            memcpy(&value, &bits, sizeof(T));
+            return value;
+        }
+
+        // x * 2^e
+        template <class T>
+        inline T scale(T x, int e){
+            return exp2_is_normal<T>(e) ? x * exp2<T>(e) : ldexp(x, e);
+        }
+
+        // max |data[i]| (0 for n = 0), NaNs skipped; independent lanes keep the scalar loop free of a serial dependency
+        template <class T>
+        inline T max_abs_scalar(T const * data, size_t n){
+            T lanes[8] = {0};
+            size_t i = 0;
+            for(; i + 8 <= n; i += 8){
+                for(int j=0; j<8; j++){
+                    T value = std::fabs(data[i + j]);
+                    if(value > lanes[j]) lanes[j] = value;
+                }
+            }
+            for(; i<n; i++){
+                T value = std::fabs(data[i]);
+                if(value > lanes[0]) lanes[0] = value;
+            }
+            return *std::max_element(lanes, lanes + 8);
+        }
+
+#ifdef MDR_QUANTIZER_X86
+        // AVX: sign bits cleared by a mask, max with the data first so that NaNs are skipped
+        __attribute__((target("avx"))) inline float max_abs_avx(float const * data, size_t n){
+            const __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+            __m256 m0 = _mm256_setzero_ps();
+            __m256 m1 = _mm256_setzero_ps();
+            size_t i = 0;
+            for(; i + 16 <= n; i += 16){
+                m0 = _mm256_max_ps(_mm256_and_ps(_mm256_loadu_ps(data + i), mask), m0);
+                m1 = _mm256_max_ps(_mm256_and_ps(_mm256_loadu_ps(data + i + 8), mask), m1);
+            }
+            alignas(32) float lanes[8];
+            _mm256_store_ps(lanes, _mm256_max_ps(m0, m1));
+            return std::max(*std::max_element(lanes, lanes + 8), max_abs_scalar(data + i, n - i));
+        }
+        __attribute__((target("avx"))) inline double max_abs_avx(double const * data, size_t n){
+            const __m256d mask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7FFFFFFFFFFFFFFFll));
+            __m256d m0 = _mm256_setzero_pd();
+            __m256d m1 = _mm256_setzero_pd();
+            size_t i = 0;
+            for(; i + 8 <= n; i += 8){
+                m0 = _mm256_max_pd(_mm256_and_pd(_mm256_loadu_pd(data + i), mask), m0);
+                m1 = _mm256_max_pd(_mm256_and_pd(_mm256_loadu_pd(data + i + 4), mask), m1);
+            }
+            alignas(32) double lanes[4];
+            _mm256_store_pd(lanes, _mm256_max_pd(m0, m1));
+            return std::max(*std::max_element(lanes, lanes + 4), max_abs_scalar(data + i, n - i));
+        }
+#endif
+
+        template <class T>
+        using MaxAbsKernel = T (*)(T const *, size_t);
+
+        // kernel picked once at runtime by CPU detection
+        template <class T>
+        inline MaxAbsKernel<T> max_abs_kernel(){
+            static const MaxAbsKernel<T> kernel = [](){
+#ifdef MDR_QUANTIZER_X86
+                __builtin_cpu_init();
+                if(__builtin_cpu_supports("avx")) return (MaxAbsKernel<T>) max_abs_avx;
+#endif
+                return (MaxAbsKernel<T>) max_abs_scalar<T>;
+            }();
+            return kernel;
+        }
+
+        // max |data[i]|, which determines the exponent of the level
+        template <class T>
+        inline T max_abs(T const * data, size_t n){
+            return max_abs_kernel<T>()(data, n);
+        }
+
+        // magnitudes[i] = |trunc(data[i] * 2^e)|, bit i of signs = (data[i] < 0)
+        // signs holds (n + 63) / 64 words
+        template <class T, class T_fp>
+        inline void quantize(T const * data, uint32_t n, int e, T_fp * magnitudes, uint64_t * signs){
+            if(exp2_is_normal<T>(e)){
+                const T multiplier = exp2<T>(e);
+                for(uint32_t i=0; i<n; i++){
+                    magnitudes[i] = (T_fp) (int64_t) std::fabs(data[i] * multiplier);
+                }
+            }
+            else{
+                for(uint32_t i=0; i<n; i++){
+                    magnitudes[i] = (T_fp) (int64_t) std::fabs(ldexp(data[i], e));
+                }
+            }
+            for(uint32_t i=0; i<n; i+=64){
+                uint32_t size = std::min<uint32_t>(64, n - i);
+                uint64_t sign_word = 0;
+                for(uint32_t j=0; j<size; j++){
+                    sign_word |= (uint64_t) (data[i + j] < 0) << j;
+                }
+                signs[i / 64] = sign_word;
+            }
+        }
+
+        // values[i] = trunc(data[i] * 2^e)
+        template <class T, class T_fps>
+        inline void quantize_signed(T const * data, uint32_t n, int e, T_fps * values){
+            if(exp2_is_normal<T>(e)){
+                const T multiplier = exp2<T>(e);
+                for(uint32_t i=0; i<n; i++){
+                    values[i] = (T_fps) (data[i] * multiplier);
+                }
+            }
+            else{
+                for(uint32_t i=0; i<n; i++){
+                    values[i] = (T_fps) ldexp(data[i], e);
+                }
+            }
+        }
+
+        // data[i] = (bit i of signs ? -1 : 1) * magnitudes[i] * 2^e
+        template <class T, class T_fp>
+        inline void dequantize(T_fp const * magnitudes, uint32_t n, int e, uint64_t const * signs, T * data){
+            const bool normal = exp2_is_normal<T>(e);
+            const T multiplier = normal ? exp2<T>(e) : 0;
+            for(uint32_t i=0; i<n; i+=64){
+                uint32_t size = std::min<uint32_t>(64, n - i);
+                uint64_t sign_word = signs[i / 64];
+                for(uint32_t j=0; j<size; j++){
+                    T value = normal ? (T) magnitudes[i + j] * multiplier : ldexp((T) magnitudes[i + j], e);
+                    data[i + j] = ((sign_word >> j) & 1u) ? -value : value;
+                }
+            }
+        }
+
+        // data[i] = values[i] * 2^e
+        template <class T, class T_fps>
+        inline void dequantize_signed(T_fps const * values, uint32_t n, int e, T * data){
+            if(exp2_is_normal<T>(e)){
+                const T multiplier = exp2<T>(e);
+                for(uint32_t i=0; i<n; i++){
+                    data[i] = (T) values[i] * multiplier;
+                }
+            }
+            else{
+                for(uint32_t i=0; i<n; i++){
+                    data[i] = ldexp((T) values[i], e);
+                }
+            }
+        }
+
+        // accumulate the squared errors of a magnitude scaled to num_bitplanes integer bits when it is
+        // truncated after each bitplane: level_errors[k] for k bitplanes kept
+        // fp_data is the integer part of data when the caller has already quantized it
+        template <class T>
+        inline void collect_level_errors(std::vector<double>& level_errors, uint32_t fp_data, T data, int num_bitplanes){
+            double mantissa = data - (T) fp_data;
+            level_errors[num_bitplanes] += mantissa * mantissa;
+            for(int k=1; k<num_bitplanes; k++){
+                uint32_t mask = (1 << k) - 1;
+                double diff = (double) (fp_data & mask) + mantissa;
+                level_errors[num_bitplanes - k] += diff * diff;
+            }
+            level_errors[0] += data * data;
+        }
+        inline void collect_level_errors(std::vector<double>& level_errors, float data, int num_bitplanes){
+            collect_level_errors(level_errors, (uint32_t) data, data, num_bitplanes);
+        }
+    }
+}
+#endif
@@ -0,0 +1,108 @@
+#ifndef _MDR_RANGE_ENCODING_HPP
+#define _MDR_RANGE_ENCODING_HPP
+
+#include <vector>
+#include <cstring>
+#include "MDR/ParallelUtils.hpp"
+#include "MDR/StreamPool.hpp"
+
+namespace MDR {
+    // element-range parallel encoding
+    // a level is split into ranges of range_size elements which are encoded independently
+    // and stitched into the serial stream layout; range sizes are multiples of RANGE_ALIGNMENT
+    // so that no group of 64 elements crosses a range boundary, or of the block size of encoders with larger blocks
+    // range offsets layout: [range_size, offset of range r in bitplane p at 1 + p * num_ranges + r]
+    // for bit streams, offsets are 64-bit bit counts stored as (low, high) words at 1 + 2 * (p * num_ranges + r)
+    #define RANGE_ALIGNMENT 64
+    #define MIN_RANGE_SIZE 65536
+
+    // size of element ranges to use for n elements with num_threads threads (n if not split), a multiple of alignment
+    inline uint32_t compute_range_size(uint32_t n, int num_threads, uint32_t alignment=RANGE_ALIGNMENT){
+        if(num_threads <= 1) return n;
+        uint32_t range_size = (n - 1) / num_threads + 1;
+        range_size = (range_size + alignment - 1) / alignment * alignment;
+        return std::max<uint32_t>(range_size, MIN_RANGE_SIZE);
+    }
+
+    inline uint32_t get_num_ranges(uint32_t n, uint32_t range_size){
+        return (n == 0) ? 1 : (n - 1) / range_size + 1;
+    }
+
+    inline uint32_t get_range_offset(const std::vector<uint32_t>& range_offsets, uint32_t num_ranges, uint32_t bitplane, uint32_t range){
+        return range_offsets[1 + bitplane * num_ranges + range];
+    }
+
+    inline uint64_t get_range_bit_offset(const std::vector<uint32_t>& range_offsets, uint32_t num_ranges, uint32_t bitplane, uint32_t range){
+        const size_t index = 1 + 2 * ((size_t) bitplane * num_ranges + range);
+        return ((uint64_t) range_offsets[index + 1] << 32) | range_offsets[index];
+    }
+
+    // concatenate the byte streams of each range bitplane by bitplane; range streams are released
+    // streams are allocated from and released to pool (NULL: system allocation)
+    inline std::vector<uint8_t *> stitch_range_streams(std::vector<std::vector<uint8_t *>>& range_streams, const std::vector<std::vector<uint32_t>>& range_stream_sizes, uint32_t range_size, int num_threads, std::vector<uint32_t>& stream_sizes, std::vector<uint32_t>& range_offsets, StreamPool * pool=NULL){
+        const uint32_t num_ranges = range_streams.size();
+        const uint32_t num_bitplanes = range_streams[0].size();
+        std::vector<uint8_t *> streams(num_bitplanes);
+        stream_sizes = std::vector<uint32_t>(num_bitplanes, 0);
+        range_offsets = std::vector<uint32_t>(1 + num_bitplanes * num_ranges, 0);
+        range_offsets[0] = range_size;
+        parallel_for(num_bitplanes, num_threads, [&](uint32_t i){
+            uint32_t size = 0;
+            for(int r=0; r<num_ranges; r++){
+                range_offsets[1 + i * num_ranges + r] = size;
+                size += range_stream_sizes[r][i];
+            }
+            streams[i] = allocate_stream(pool, std::max<uint32_t>(size, 1));
+            for(int r=0; r<num_ranges; r++){
+                memcpy(streams[i] + range_offsets[1 + i * num_ranges + r], range_streams[r][i], range_stream_sizes[r][i]);
+                release_stream(pool, range_streams[r][i]);
+            }
+            stream_sizes[i] = size;
+        });
+        return streams;
+    }
+
+    // concatenate the bit streams (LSB first in uint64_t words) of each range bitplane by bitplane;
+    // range_stream_bits and the recorded offsets are in bits; range streams are released
+    inline std::vector<uint8_t *> stitch_range_bitstreams(std::vector<std::vector<uint8_t *>>& range_streams, const std::vector<std::vector<uint32_t>>& range_stream_bits, uint32_t range_size, int num_threads, std::vector<uint32_t>& stream_sizes, std::vector<uint32_t>& range_offsets, StreamPool * pool=NULL){
+        const uint32_t num_ranges = range_streams.size();
+        const uint32_t num_bitplanes = range_streams[0].size();
+        std::vector<uint8_t *> streams(num_bitplanes);
+        stream_sizes = std::vector<uint32_t>(num_bitplanes, 0);
+        range_offsets = std::vector<uint32_t>(1 + 2 * num_bitplanes * num_ranges, 0);
+        range_offsets[0] = range_size;
+        parallel_for(num_bitplanes, num_threads, [&](uint32_t i){
+            uint64_t num_bits = 0;
+            for(int r=0; r<num_ranges; r++){
+                const size_t index = 1 + 2 * ((size_t) i * num_ranges + r);
+                range_offsets[index] = (uint32_t) num_bits;
+                range_offsets[index + 1] = (uint32_t) (num_bits >> 32);
+                num_bits += range_stream_bits[r][i];
+            }
+            uint64_t num_words = (num_bits + 63) / 64;
+            // one spare word for the spill of the last shifted word
+            uint64_t * stream = reinterpret_cast<uint64_t *>(allocate_zeroed_stream(pool, (num_words + 1) * sizeof(uint64_t)));
+            for(int r=0; r<num_ranges; r++){
+                uint64_t const * range_stream = reinterpret_cast<uint64_t const *>(range_streams[r][i]);
+                uint64_t offset = get_range_bit_offset(range_offsets, num_ranges, i, r);
+                uint32_t range_words = (range_stream_bits[r][i] + 63) / 64;
+                uint64_t * stream_pos = stream + offset / 64;
+                uint8_t shift = offset % 64;
+                if(shift == 0){
+                    memcpy(stream_pos, range_stream, range_words * sizeof(uint64_t));
+                }
+                else{
+                    for(int w=0; w<range_words; w++){
+                        stream_pos[w] |= range_stream[w] << shift;
+                        stream_pos[w + 1] |= range_stream[w] >> (64 - shift);
+                    }
+                }
+                release_stream(pool, range_streams[r][i]);
+            }
+            streams[i] = reinterpret_cast<uint8_t *>(stream);
+            stream_sizes[i] = num_words * sizeof(uint64_t);
+        });
+        return streams;
+    }
+}
+#endif
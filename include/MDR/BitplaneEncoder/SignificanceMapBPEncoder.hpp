@@ -0,0 +1,348 @@
+#ifndef _MDR_SIGNIFICANCE_MAP_BP_ENCODER_HPP
+#define _MDR_SIGNIFICANCE_MAP_BP_ENCODER_HPP
+
+#include "BitplaneEncoderInterface.hpp"
+#include "BitTranspose.hpp"
+#include "RangeEncoding.hpp"
+#include "Quantizer.hpp"
+#include "PerBitBPEncoder.hpp"
+
+namespace MDR {
+    #define SIG_MAP_GROUP_SIZE 64
+    #define SIG_MAP_BLOCK_SIZE 4096
+    // bitplane encoder with hierarchical significance maps (set partitioning as in SPECK)
+    // each bitplane is coded block by block: refinement bits for elements that are already significant,
+    // then a significance test for the set of insignificant elements which is recursively halved
+    // down to the newly significant elements, whose signs follow their significance bit
+    // sets without insignificant elements cost nothing, so all-zero regions take one bit per block
+    template<class T_data, class T_stream>
+    class SignificanceMapBPEncoder : public concepts::BitplaneEncoderInterface<T_data> {
+    public:
+        // levels read from a view are gathered by the interface
+        using concepts::BitplaneEncoderInterface<T_data>::encode;
+        using concepts::BitplaneEncoderInterface<T_data>::progressive_decode;
+
+        SignificanceMapBPEncoder(int num_threads=1) : num_threads(num_threads) {
+            static_assert(std::is_floating_point<T_data>::value, "SignificanceMapBPEncoder: input data must be floating points.");
+            static_assert(!std::is_same<T_data, long double>::value, "SignificanceMapBPEncoder: long double is not supported.");
+            static_assert(std::is_unsigned<T_stream>::value, "SignificanceMapBPEncoder: streams must be unsigned integers.");
+            static_assert(std::is_integral<T_stream>::value, "SignificanceMapBPEncoder: streams must be unsigned integers.");
+        }
+
+        std::vector<uint8_t *> encode(T_data const * data, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<uint32_t>& stream_sizes) const {
+            std::vector<uint32_t> range_offsets;
+            return encode(data, n, exp, num_bitplanes, stream_sizes, range_offsets);
+        }
+
+        // encode element ranges in parallel; range_offsets records the starting bit of each range in every bitplane
+        // ranges are whole blocks, so the stitched streams are the same as the serial ones
+        std::vector<uint8_t *> encode(T_data const * data, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<uint32_t>& stream_sizes, std::vector<uint32_t>& range_offsets) const {
+            assert(num_bitplanes > 0);
+            const uint32_t range_size = compute_range_size(n, num_threads, SIG_MAP_BLOCK_SIZE);
+            const uint32_t num_ranges = get_num_ranges(n, range_size);
+            if(num_ranges == 1){
+                range_offsets.clear();
+                std::vector<uint32_t> stream_bits;
+                return encode_range(data, n, exp, num_bitplanes, stream_sizes, stream_bits, NULL);
+            }
+            std::vector<std::vector<uint8_t *>> range_streams(num_ranges);
+            std::vector<std::vector<uint32_t>> range_stream_bits(num_ranges);
+            parallel_for(num_ranges, num_threads, [&](uint32_t r){
+                uint32_t begin = r * range_size;
+                std::vector<uint32_t> range_stream_sizes;
+                range_streams[r] = encode_range(data + begin, std::min(range_size, n - begin), exp, num_bitplanes, range_stream_sizes, range_stream_bits[r], NULL);
+            });
+            return stitch_range_bitstreams(range_streams, range_stream_bits, range_size, num_threads, stream_sizes, range_offsets, stream_pool);
+        }
+
+        // only differs in error collection
+        std::vector<uint8_t *> encode(T_data const * data, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<uint32_t>& stream_sizes, std::vector<double>& level_errors) const {
+            assert(num_bitplanes > 0);
+            // init level errors
+            level_errors.clear();
+            level_errors.resize(num_bitplanes + 1);
+            for(int i=0; i<level_errors.size(); i++){
+                level_errors[i] = 0;
+            }
+            std::vector<uint32_t> stream_bits;
+            auto streams = encode_range(data, n, exp, num_bitplanes, stream_sizes, stream_bits, &level_errors);
+            // translate level errors
+            for(int i=0; i<level_errors.size(); i++){
+                level_errors[i] = ldexp(level_errors[i], 2*(- num_bitplanes + exp));
+            }
+            return streams;
+        }
+
+        T_data * decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t num_bitplanes) {
+            return decode(streams, n, exp, num_bitplanes, std::vector<uint32_t>());
+        }
+
+        T_data * decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t num_bitplanes, const std::vector<uint32_t>& range_offsets) {
+            T_data * data = (T_data *) malloc(n * sizeof(T_data));
+            if(num_bitplanes == 0){
+                memset(data, 0, n * sizeof(T_data));
+                return data;
+            }
+            decode_ranges(streams, n, exp - num_bitplanes, 0, num_bitplanes, NULL, NULL, range_offsets, LevelView<T_data>(data, n));
+            return data;
+        }
+
+        T_data * progressive_decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, int level) {
+            return progressive_decode(streams, n, exp, starting_bitplane, num_bitplanes, level, std::vector<uint32_t>());
+        }
+
+        // decode element ranges in parallel using the range offsets recorded at encoding
+        T_data * progressive_decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, int level, const std::vector<uint32_t>& range_offsets) {
+            T_data * data = (T_data *) malloc(n * sizeof(T_data));
+            progressive_decode(streams, n, exp, starting_bitplane, num_bitplanes, level, range_offsets, LevelView<T_data>(data, n));
+            return data;
+        }
+
+        // decode straight into the level view
+        void progressive_decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, int level, const std::vector<uint32_t>& range_offsets, LevelView<T_data> view) {
+            if(num_bitplanes == 0){
+                view.fill(0, n);
+                return;
+            }
+            if(level_signs.size() == level){
+                const uint32_t num_groups = (n + SIG_MAP_GROUP_SIZE - 1) / SIG_MAP_GROUP_SIZE;
+                level_signs.push_back(std::vector<uint64_t>(num_groups, 0));
+                level_significance.push_back(std::vector<uint64_t>(num_groups, 0));
+            }
+            const uint8_t ending_bitplane = starting_bitplane + num_bitplanes;
+            decode_ranges(streams, n, exp - ending_bitplane, starting_bitplane, num_bitplanes, level_significance[level].data(), level_signs[level].data(), range_offsets, view);
+        }
+
+        void set_stream_pool(StreamPool * pool) {
+            stream_pool = pool;
+        }
+
+        void print() const {
+            std::cout << "Significance map bitplane encoder" << std::endl;
+        }
+    private:
+        using T_fp = typename std::conditional<std::is_same<T_data, double>::value, uint64_t, uint32_t>::type;
+
+        // encode n elements into newly allocated streams; stream_bits receives the number of bits in each stream
+        std::vector<uint8_t *> encode_range(T_data const * data, int32_t n, int32_t exp, uint8_t num_bitplanes, std::vector<uint32_t>& stream_sizes, std::vector<uint32_t>& stream_bits, std::vector<double> * level_errors) const {
+            const uint32_t num_groups = (n + SIG_MAP_GROUP_SIZE - 1) / SIG_MAP_GROUP_SIZE;
+            const uint32_t num_blocks = (n + SIG_MAP_BLOCK_SIZE - 1) / SIG_MAP_BLOCK_SIZE;
+            const uint32_t words_per_block = SIG_MAP_BLOCK_SIZE / SIG_MAP_GROUP_SIZE;
+            // quantize and transpose: plane_words[p * num_groups + g] holds bitplane p (MSB first) of group g
+            std::vector<T_fp> fp_data(n);
+            std::vector<uint64_t> signs(num_groups, 0);
+            Quantizer::quantize(data, n, num_bitplanes - exp, fp_data.data(), signs.data());
+            if(level_errors){
+                for(int i=0; i<n; i++){
+                    Quantizer::collect_level_errors(*level_errors, fabs(Quantizer::scale(data[i], num_bitplanes - exp)), num_bitplanes);
+                }
+            }
+            std::vector<uint64_t> plane_words(num_bitplanes * num_groups);
+            for(int g=0; g<num_groups; g++){
+                uint64_t bitplanes[SIG_MAP_GROUP_SIZE];
+                BitTranspose::encode(fp_data.data() + g * SIG_MAP_GROUP_SIZE, group_size(n, g), num_bitplanes, bitplanes);
+                for(int k=num_bitplanes - 1; k>=0; k--){
+                    plane_words[(num_bitplanes - 1 - k) * num_groups + g] = bitplanes[k];
+                }
+            }
+            // significance state, padded with zeros to whole blocks
+            std::vector<uint64_t> significance(num_blocks * words_per_block, 0);
+            std::vector<uint64_t> candidates(num_blocks * words_per_block, 0);
+            std::vector<uint64_t> newly_significant(num_blocks * words_per_block, 0);
+
+            stream_sizes = std::vector<uint32_t>(num_bitplanes, 0);
+            stream_bits = std::vector<uint32_t>(num_bitplanes, 0);
+            std::vector<uint8_t *> streams;
+            for(int p=0; p<num_bitplanes; p++){
+                // refinement and signs take one bit per element, set tests at most two per element plus a path per block
+                streams.push_back(allocate_stream(stream_pool, 3 * (size_t) n / UINT8_BITS + 2 * num_blocks * sizeof(uint64_t) + sizeof(uint64_t)));
+                BitEncoder encoder(reinterpret_cast<uint64_t*>(streams[p]));
+                uint64_t const * plane = plane_words.data() + p * num_groups;
+                for(int g=0; g<num_groups; g++){
+                    candidates[g] = ~significance[g] & group_mask(n, g);
+                    newly_significant[g] = plane[g] & candidates[g];
+                }
+                for(int b=0; b<num_blocks; b++){
+                    const uint32_t group_begin = b * words_per_block;
+                    const uint32_t group_end = std::min(group_begin + words_per_block, num_groups);
+                    // refinement pass
+                    for(int g=group_begin; g<group_end; g++){
+                        if(significance[g]) encoder.encode(extract_bits(plane[g], significance[g]), __builtin_popcountll(significance[g]));
+                    }
+                    // sorting pass
+                    encode_set(encoder, candidates.data(), newly_significant.data(), signs.data(), b * SIG_MAP_BLOCK_SIZE, SIG_MAP_BLOCK_SIZE, false);
+                }
+                for(int g=0; g<num_groups; g++){
+                    significance[g] |= plane[g];
+                }
+                stream_bits[p] = encoder.bit_size();
+                encoder.flush();
+                stream_sizes[p] = encoder.size() * sizeof(uint64_t);
+            }
+            return streams;
+        }
+
+        // decode all element ranges; without range offsets the level is decoded as a single range
+        // significance and signs hold the progressive state (one word per group), or NULL when decoding from scratch
+        void decode_ranges(const std::vector<uint8_t const *>& streams, int32_t n, int scale_exp, uint8_t starting_bitplane, uint8_t num_bitplanes, uint64_t * significance, uint64_t * signs, const std::vector<uint32_t>& range_offsets, const LevelView<T_data>& view) const {
+            if(range_offsets.empty()){
+                std::vector<BitDecoder> decoders;
+                for(int i=0; i<streams.size(); i++){
+                    decoders.push_back(BitDecoder(reinterpret_cast<uint64_t const*>(streams[i])));
+                }
+                decode_range(decoders, n, scale_exp, num_bitplanes, significance, signs, view);
+                return;
+            }
+            const uint32_t range_size = range_offsets[0];
+            const uint32_t num_ranges = get_num_ranges(n, range_size);
+            parallel_for(num_ranges, num_threads, [&](uint32_t r){
+                std::vector<BitDecoder> decoders;
+                for(int i=0; i<streams.size(); i++){
+                    decoders.push_back(BitDecoder(reinterpret_cast<uint64_t const*>(streams[i]), get_range_bit_offset(range_offsets, num_ranges, starting_bitplane + i, r)));
+                }
+                uint32_t begin = r * range_size;
+                uint32_t group_begin = begin / SIG_MAP_GROUP_SIZE;
+                decode_range(decoders, std::min(range_size, n - begin), scale_exp, num_bitplanes, significance ? significance + group_begin : NULL, signs ? signs + group_begin : NULL, view.at(begin));
+            });
+        }
+
+        // decode n elements; significance and signs point to the state words of their groups
+        void decode_range(std::vector<BitDecoder>& decoders, int32_t n, int scale_exp, uint8_t num_bitplanes, uint64_t * significance_state, uint64_t * signs_state, LevelView<T_data> view) const {
+            const uint32_t num_groups = (n + SIG_MAP_GROUP_SIZE - 1) / SIG_MAP_GROUP_SIZE;
+            const uint32_t num_blocks = (n + SIG_MAP_BLOCK_SIZE - 1) / SIG_MAP_BLOCK_SIZE;
+            const uint32_t words_per_block = SIG_MAP_BLOCK_SIZE / SIG_MAP_GROUP_SIZE;
+            std::vector<uint64_t> significance(num_blocks * words_per_block, 0);
+            std::vector<uint64_t> signs(num_groups, 0);
+            if(significance_state){
+                memcpy(significance.data(), significance_state, num_groups * sizeof(uint64_t));
+                memcpy(signs.data(), signs_state, num_groups * sizeof(uint64_t));
+            }
+            std::vector<uint64_t> candidates(num_blocks * words_per_block, 0);
+            std::vector<uint64_t> newly_significant(num_blocks * words_per_block, 0);
+            std::vector<uint64_t> plane_words(num_bitplanes * num_groups);
+            for(int p=0; p<num_bitplanes; p++){
+                BitDecoder& decoder = decoders[p];
+                uint64_t * plane = plane_words.data() + p * num_groups;
+                for(int g=0; g<num_groups; g++){
+                    candidates[g] = ~significance[g] & group_mask(n, g);
+                    newly_significant[g] = 0;
+                }
+                for(int b=0; b<num_blocks; b++){
+                    const uint32_t group_begin = b * words_per_block;
+                    const uint32_t group_end = std::min(group_begin + words_per_block, num_groups);
+                    // refinement pass
+                    for(int g=group_begin; g<group_end; g++){
+                        plane[g] = 0;
+                        if(significance[g]){
+                            uint8_t count = __builtin_popcountll(significance[g]);
+                            plane[g] = deposit_bits(decoder.peek(count), significance[g]);
+                            decoder.skip(count);
+                        }
+                    }
+                    // sorting pass
+                    decode_set(decoder, candidates.data(), newly_significant.data(), signs.data(), b * SIG_MAP_BLOCK_SIZE, SIG_MAP_BLOCK_SIZE, false);
+                }
+                for(int g=0; g<num_groups; g++){
+                    plane[g] |= newly_significant[g];
+                    significance[g] |= newly_significant[g];
+                }
+            }
+            T_data group_data[SIG_MAP_GROUP_SIZE];
+            for(int g=0; g<num_groups; g++){
+                uint64_t bitplanes[SIG_MAP_GROUP_SIZE];
+                for(int k=num_bitplanes - 1; k>=0; k--){
+                    bitplanes[k] = plane_words[(num_bitplanes - 1 - k) * num_groups + g];
+                }
+                T_fp fp_data[SIG_MAP_GROUP_SIZE] = {0};
+                BitTranspose::decode(bitplanes, group_size(n, g), num_bitplanes, fp_data);
+                Quantizer::dequantize(fp_data, group_size(n, g), scale_exp, &signs[g], group_data);
+                view.write(group_data, group_size(n, g));
+            }
+            if(significance_state){
+                memcpy(significance_state, significance.data(), num_groups * sizeof(uint64_t));
+                memcpy(signs_state, signs.data(), num_groups * sizeof(uint64_t));
+            }
+        }
+
+        // code the set of len (power of 2) elements starting at begin; returns whether the set is significant
+        // known: the set is known to be significant because its sibling is not
+        bool encode_set(BitEncoder& encoder, uint64_t const * candidates, uint64_t const * newly_significant, uint64_t const * signs, uint32_t begin, uint32_t len, bool known) const {
+            if(!any_bits(candidates, begin, len)) return false;
+            bool significant = known || any_bits(newly_significant, begin, len);
+            if(!known) encoder.encode(significant);
+            if(!significant) return false;
+            if(len == 1){
+                encoder.encode((signs[begin / SIG_MAP_GROUP_SIZE] >> (begin % SIG_MAP_GROUP_SIZE)) & 1u);
+                return true;
+            }
+            bool first = encode_set(encoder, candidates, newly_significant, signs, begin, len / 2, false);
+            encode_set(encoder, candidates, newly_significant, signs, begin + len / 2, len / 2, !first);
+            return true;
+        }
+
+        bool decode_set(BitDecoder& decoder, uint64_t const * candidates, uint64_t * newly_significant, uint64_t * signs, uint32_t begin, uint32_t len, bool known) const {
+            if(!any_bits(candidates, begin, len)) return false;
+            bool significant = known || decoder.decode();
+            if(!significant) return false;
+            if(len == 1){
+                uint64_t bit = 1ull << (begin % SIG_MAP_GROUP_SIZE);
+                newly_significant[begin / SIG_MAP_GROUP_SIZE] |= bit;
+                if(decoder.decode()) signs[begin / SIG_MAP_GROUP_SIZE] |= bit;
+                return true;
+            }
+            bool first = decode_set(decoder, candidates, newly_significant, signs, begin, len / 2, false);
+            decode_set(decoder, candidates, newly_significant, signs, begin + len / 2, len / 2, !first);
+            return true;
+        }
+
+        // whether any of the len (power of 2) bits starting at bit begin is set
+        inline bool any_bits(uint64_t const * words, uint32_t begin, uint32_t len) const {
+            if(len < SIG_MAP_GROUP_SIZE){
+                return (words[begin / SIG_MAP_GROUP_SIZE] >> (begin % SIG_MAP_GROUP_SIZE)) & ((1ull << len) - 1);
+            }
+            uint64_t bits = 0;
+            for(int i=begin / SIG_MAP_GROUP_SIZE; i<(begin + len) / SIG_MAP_GROUP_SIZE; i++){
+                bits |= words[i];
+            }
+            return bits;
+        }
+
+        // bits of word at the positions set in mask, packed into the lowest bits
+        inline uint64_t extract_bits(uint64_t word, uint64_t mask) const {
+            if(mask == ~0ull) return word;
+            uint64_t bits = 0;
+            for(int i=0; mask; i++){
+                if(word & mask & -mask) bits |= 1ull << i;
+                mask &= mask - 1;
+            }
+            return bits;
+        }
+
+        // inverse of extract_bits
+        inline uint64_t deposit_bits(uint64_t bits, uint64_t mask) const {
+            if(mask == ~0ull) return bits;
+            uint64_t word = 0;
+            for(int i=0; mask; i++){
+                if((bits >> i) & 1u) word |= mask & -mask;
+                mask &= mask - 1;
+            }
+            return word;
+        }
+
+        inline uint32_t group_size(int32_t n, uint32_t group) const {
+            return std::min<uint32_t>(SIG_MAP_GROUP_SIZE, n - group * SIG_MAP_GROUP_SIZE);
+        }
+
+        inline uint64_t group_mask(int32_t n, uint32_t group) const {
+            uint32_t size = group_size(n, group);
+            return (size < 64) ? (1ull << size) - 1 : ~0ull;
+        }
+
+        int num_threads = 1;
+        StreamPool * stream_pool = NULL;
+        // progressive state per level: bit j of word g is for element g * SIG_MAP_GROUP_SIZE + j
+        std::vector<std::vector<uint64_t>> level_signs;
+        std::vector<std::vector<uint64_t>> level_significance;
+    };
+}
+#endif
@@ -2,12 +2,17 @@
 #define _MDR_WEIGHTEDNEGABINARY_BP_ENCODER_HPP
 
 #include "BitplaneEncoderInterface.hpp"
+#include "BlockSize.hpp"
+#include "Quantizer.hpp"
 
 namespace MDR {
     // general bitplane encoder that encodes data by block using T_stream type buffer
     template<class T_data, class T_stream>
     class WeightedNegaBinaryBPEncoder : public concepts::BitplaneEncoderInterface<T_data> {
     public:
+        using concepts::BitplaneEncoderInterface<T_data>::encode;
+        using concepts::BitplaneEncoderInterface<T_data>::progressive_decode;
+
         WeightedNegaBinaryBPEncoder(){
             static_assert(std::is_floating_point<T_data>::value, "WeightedNegaBinaryBPEncoder: input data must be floating points.");
             static_assert(!std::is_same<T_data, long double>::value, "WeightedNegaBinaryBPEncoder: long double is not supported.");
@@ -29,7 +34,7 @@ namespace MDR {
             // leave room for multiplication
             exp += 1;
             // determine block size based on bitplane integer type
-            uint32_t block_size = block_size_based_on_bitplane_int_type<T_stream>();
+            constexpr uint32_t block_size = block_size_of_stream_type<T_stream>();
             std::vector<uint8_t> starting_bitplanes = std::vector<uint8_t>((n - 1)/block_size + 1, 0);
             stream_sizes = std::vector<uint32_t>(num_bitplanes, 0);
             // define fixed point type
@@ -56,7 +61,7 @@ namespace MDR {
                 for(int j=0; j<block_size; j++){
                     T_data cur_data = *(data_pos++);
                     cur_data *= 2;
-                    T_data shifted_data = ldexp(cur_data, num_bitplanes - exp);
+                    T_data shifted_data = Quantizer::scale(cur_data, num_bitplanes - exp);
                     T_fps signed_int_data = (T_fps) shifted_data;
                     int_data_buffer[j] = binary2negabinary(signed_int_data);
                     // compute level errors
@@ -71,7 +76,7 @@ namespace MDR {
                 for(int j=0; j<rest_size; j++){
                     T_data cur_data = *(data_pos++);
                     cur_data *= 2;
-                    T_data shifted_data = ldexp(cur_data, num_bitplanes - exp);
+                    T_data shifted_data = Quantizer::scale(cur_data, num_bitplanes - exp);
                     T_fps signed_int_data = (T_fps) shifted_data;
                     int_data_buffer[j] = binary2negabinary(signed_int_data);
                     // compute level errors
@@ -98,7 +103,7 @@ namespace MDR {
         }
         // decode the data and record necessary information for progressiveness
         T_data * progressive_decode(const std::vector<uint8_t const *>& streams, int32_t n, int exp, uint8_t starting_bitplane, uint8_t num_bitplanes, int level, int * weights=NULL) {
-            uint32_t block_size = block_size_based_on_bitplane_int_type<T_stream>();
+            constexpr uint32_t block_size = block_size_of_stream_type<T_stream>();
             T_data * data = (T_data *) malloc(n * sizeof(T_data));
             if(num_bitplanes == 0){
                 memset(data, 0, n * sizeof(T_data));
@@ -126,7 +131,7 @@ namespace MDR {
                     memset(int_data_buffer.data(), 0, block_size * sizeof(T_fp));
                     decode_block(streams_pos, block_size, num_bitplanes, int_data_buffer.data());
                     for(int j=0; j<block_size; j++){
-                        *(data_pos++) = ldexp((T_data) negabinary2binary(int_data_buffer[j]), - ending_bitplane + exp) / 2;
+                        *(data_pos++) = Quantizer::scale((T_data) negabinary2binary(int_data_buffer[j]), - ending_bitplane + exp) / 2;
                     }
                 }
                 // leftover
@@ -136,7 +141,7 @@ namespace MDR {
                     memset(int_data_buffer.data(), 0, rest_size * sizeof(T_fp));
                     decode_block(streams_pos, rest_size, num_bitplanes, int_data_buffer.data());
                     for(int j=0; j<rest_size; j++){
-                        *(data_pos++) = ldexp((T_data) negabinary2binary(int_data_buffer[j]), - ending_bitplane + exp) / 2;
+                        *(data_pos++) = Quantizer::scale((T_data) negabinary2binary(int_data_buffer[j]), - ending_bitplane + exp) / 2;
                     }
                 }                
             }
@@ -145,7 +150,7 @@ namespace MDR {
                     memset(int_data_buffer.data(), 0, block_size * sizeof(T_fp));
                     decode_block(streams_pos, block_size, num_bitplanes, int_data_buffer.data());
                     for(int j=0; j<block_size; j++){
-                        *(data_pos++) = - ldexp((T_data) negabinary2binary(int_data_buffer[j]), - ending_bitplane + exp) / 2;
+                        *(data_pos++) = - Quantizer::scale((T_data) negabinary2binary(int_data_buffer[j]), - ending_bitplane + exp) / 2;
                     }
                 }
                 // leftover
@@ -155,7 +160,7 @@ namespace MDR {
                     memset(int_data_buffer.data(), 0, rest_size * sizeof(T_fp));
                     decode_block(streams_pos, rest_size, num_bitplanes, int_data_buffer.data());
                     for(int j=0; j<rest_size; j++){
-                        *(data_pos++) = - ldexp((T_data) negabinary2binary(int_data_buffer[j]), - ending_bitplane + exp) / 2;
+                        *(data_pos++) = - Quantizer::scale((T_data) negabinary2binary(int_data_buffer[j]), - ending_bitplane + exp) / 2;
                     }
                 }                
             }
@@ -172,27 +177,6 @@ namespace MDR {
     private:
         int weight_bitplane = 0;
 
-        template<class T>
-        uint32_t block_size_based_on_bitplane_int_type() const {
-            uint32_t block_size = 0;
-            if(std::is_same<T, uint64_t>::value){
-                block_size = 64;
-            }
-            else if(std::is_same<T, uint32_t>::value){
-                block_size = 32;
-            }
-            else if(std::is_same<T, uint16_t>::value){
-                block_size = 16;
-            }
-            else if(std::is_same<T, uint8_t>::value){
-                block_size = 8;
-            }
-            else{
-                std::cerr << "Integer type not supported." << std::endl;
-                exit(0);
-            }
-            return block_size;
-        }
         inline uint64_t binary2negabinary(const int64_t x) const {
             return (x + (uint64_t)0xaaaaaaaaaaaaaaaaull) ^ (uint64_t)0xaaaaaaaaaaaaaaaaull;
         }
@@ -3,6 +3,7 @@
 
 #include "BitplaneEncoderInterface.hpp"
 #include "PerBitBPEncoder.hpp"
+#include "Quantizer.hpp"
 #include <bitset>
 namespace MDR {
 
@@ -11,6 +12,9 @@ namespace MDR {
     template<class T_data, class T_stream>
     class WeightedPerBitBPEncoder : public concepts::BitplaneEncoderInterface<T_data> {
     public:
+        using concepts::BitplaneEncoderInterface<T_data>::encode;
+        using concepts::BitplaneEncoderInterface<T_data>::progressive_decode;
+
         WeightedPerBitBPEncoder(){
             static_assert(std::is_floating_point<T_data>::value, "PerBitBPEncoder: input data must be floating points.");
             static_assert(!std::is_same<T_data, long double>::value, "PerBitBPEncoder: long double is not supported.");
@@ -51,7 +55,7 @@ namespace MDR {
                 T_stream sign_bitplane = 0;
                 for(int j=0; j<block_size; j++){
                     T_data cur_data = *(data_pos++);
-                    T_data shifted_data = ldexp(cur_data, num_bitplanes - exp);
+                    T_data shifted_data = Quantizer::scale(cur_data, num_bitplanes - exp);
                     bool sign = cur_data < 0;
                     int64_t fix_point = (int64_t) shifted_data;
                     T_fp fp_data = sign ? -fix_point : +fix_point;
@@ -75,7 +79,7 @@ namespace MDR {
                 if(rest_size == 0) rest_size = block_size;
                 for(int j=0; j<rest_size; j++){
                     T_data cur_data = *(data_pos++);
-                    T_data shifted_data = ldexp(cur_data, num_bitplanes - exp);
+                    T_data shifted_data = Quantizer::scale(cur_data, num_bitplanes - exp);
                     bool sign = cur_data < 0;
                     int64_t fix_point = (int64_t) shifted_data;
                     T_fp fp_data = sign ? -fix_point : +fix_point;
@@ -139,7 +143,7 @@ namespace MDR {
                     T_data cur_data = *(data_pos++);
                     // cur_data *= exp2(*(weights_pos++));
                     // T_data shifted_data = ldexp(cur_data, num_bitplanes - exp);
-                    T_data shifted_data = ldexp(cur_data, num_bitplanes - exp + *(weights_pos++));
+                    T_data shifted_data = Quantizer::scale(cur_data, num_bitplanes - exp + *(weights_pos++));
                     bool sign = cur_data < 0;
                     int64_t fix_point = (int64_t) shifted_data;
                     T_fp fp_data = sign ? -fix_point : +fix_point;
@@ -178,7 +182,7 @@ namespace MDR {
                     T_data cur_data = *(data_pos++);
                     cur_data *= exp2(*(weights_pos++));
                     // T_data shifted_data = ldexp(cur_data, num_bitplanes - exp);
-                    T_data shifted_data = ldexp(cur_data, num_bitplanes - exp + *(weights_pos++));
+                    T_data shifted_data = Quantizer::scale(cur_data, num_bitplanes - exp + *(weights_pos++));
                     bool sign = cur_data < 0;
                     int64_t fix_point = (int64_t) shifted_data;
                     T_fp fp_data = sign ? -fix_point : +fix_point;
@@ -265,7 +269,7 @@ namespace MDR {
                         }
                         signs[i + j] = sign;
                     }
-                    T_data cur_data = ldexp((T_data)fp_data, - ending_bitplane + exp);
+                    T_data cur_data = Quantizer::scale((T_data)fp_data, - ending_bitplane + exp);
                     *(data_pos++) = sign ? -cur_data : cur_data;
                 }
             }
@@ -300,7 +304,7 @@ namespace MDR {
                         }
                         signs[n - rest_size + j] = sign;
                     }
-                    T_data cur_data = ldexp((T_data)fp_data, - ending_bitplane + exp);
+                    T_data cur_data = Quantizer::scale((T_data)fp_data, - ending_bitplane + exp);
                     *(data_pos++) = sign ? -cur_data : cur_data;
                 }
             }
@@ -366,7 +370,7 @@ namespace MDR {
                     }
                     // T_data cur_data = ldexp((T_data)fp_data, - ending_bitplane + exp);
                     // cur_data /= exp2(*(weights_pos++));
-                    T_data cur_data = ldexp((T_data)fp_data, - ending_bitplane + exp - *(weights_pos++));
+                    T_data cur_data = Quantizer::scale((T_data)fp_data, - ending_bitplane + exp - *(weights_pos++));
                     *(data_pos++) = sign ? -cur_data : cur_data;
                     // if(i+j == 67989643){
                     //     std::cout << "starting_bitplane = " << +starting_bitplane << std::endl;
@@ -413,7 +417,7 @@ namespace MDR {
                     }
                     // T_data cur_data = ldexp((T_data)fp_data, - ending_bitplane + exp);
                     // cur_data /= exp2(*(weights_pos++));
-                    T_data cur_data = ldexp((T_data)fp_data, - ending_bitplane + exp - *(weights_pos++));
+                    T_data cur_data = Quantizer::scale((T_data)fp_data, - ending_bitplane + exp - *(weights_pos++));
                     *(data_pos++) = sign ? -cur_data : cur_data;
                 }
             }
@@ -2,5 +2,6 @@
 #define _MDR_DECOMPOSER_HPP
 
 #include "MGARD.hpp"
+#include "ParallelHierarchicalDecomposer.hpp"
 
 #endif
@@ -0,0 +1,261 @@
+#ifndef _MDR_PARALLEL_HIERARCHICAL_DECOMPOSER_HPP
+#define _MDR_PARALLEL_HIERARCHICAL_DECOMPOSER_HPP
+
+#include "DecomposerInterface.hpp"
+#include "MDR/Interleaver/LevelShape.hpp"
+#include "MDR/ParallelUtils.hpp"
+#include <vector>
+#include <memory>
+#include <cstring>
+
+namespace MDR {
+    // columns of the rows of a line that the decomposer moves together when reordering the dimensions other than the last
+    #define REORDER_COLUMNS 256
+
+    // multilevel decomposer with hierarchical basis that runs on num_threads threads
+    // on every level, a node outside the coarse grid (even indices and the last index of every dimension)
+    // is replaced by its value minus the multilinear interpolant of the coarse nodes, and the level box is
+    // reordered with the coarse nodes first, so the next level is the box of compute_level_dims
+    // the interpolants only read coarse nodes, which are not changed, so the nodes are updated in place by rows
+    // of the last dimension; the box is then reordered one dimension at a time through small per-task buffers
+    template<class T>
+    class ParallelHierarchicalDecomposer : public concepts::DecomposerInterface<T> {
+    public:
+        ParallelHierarchicalDecomposer(int num_threads=1) : thread_pool(std::make_shared<ThreadPool>(num_threads)) {}
+        void decompose(T * data, const std::vector<uint32_t>& dimensions, uint32_t target_level, std::vector<uint32_t> strides=std::vector<uint32_t>()) const {
+            auto boxes = compute_boxes(dimensions, target_level);
+            strides = get_strides(dimensions, strides);
+            for(int l=0; l<target_level; l++){
+                Level level(boxes[l], strides);
+                update_level<true>(data, level);
+                reorder_level<true>(data, level);
+            }
+        }
+        void recompose(T * data, const std::vector<uint32_t>& dimensions, uint32_t target_level, std::vector<uint32_t> strides=std::vector<uint32_t>()) const {
+            auto boxes = compute_boxes(dimensions, target_level);
+            strides = get_strides(dimensions, strides);
+            for(int l=target_level-1; l>=0; l--){
+                Level level(boxes[l], strides);
+                reorder_level<false>(data, level);
+                update_level<false>(data, level);
+            }
+        }
+        void print() const {
+            std::cout << "Parallel hierarchical decomposer" << std::endl;
+        }
+    private:
+        // box of every level, from the finest
+        static std::vector<std::vector<uint32_t>> compute_boxes(const std::vector<uint32_t>& dimensions, uint32_t target_level){
+            std::vector<std::vector<uint32_t>> boxes(1, dimensions);
+            for(int l=0; l<target_level; l++){
+                std::vector<uint32_t> coarse = boxes.back();
+                for(auto& n:coarse){
+                    n = (n >> 1) + 1;
+                }
+                boxes.push_back(coarse);
+            }
+            return boxes;
+        }
+
+        static std::vector<uint32_t> get_strides(const std::vector<uint32_t>& dimensions, const std::vector<uint32_t>& strides){
+            if(strides.size()) return strides;
+            std::vector<uint32_t> natural(dimensions.size());
+            uint32_t stride = 1;
+            for(int i=dimensions.size()-1; i>=0; i--){
+                natural[i] = stride;
+                stride *= dimensions[i];
+            }
+            return natural;
+        }
+
+        // level box with a 1D box viewed as 1 x n, as in LevelShape
+        struct Level {
+            Level(const std::vector<uint32_t>& box, const std::vector<uint32_t>& strides){
+                const int pad = (box.size() == 1);
+                num_dims = box.size() + pad;
+                for(int d=num_dims-1; d>=pad; d--){
+                    n[d] = box[d - pad];
+                    offsets[d] = strides[d - pad];
+                }
+                num_rows = 1;
+                for(int d=num_dims-2; d>=0; d--){
+                    row_strides[d] = num_rows;
+                    num_rows *= n[d];
+                }
+                for(int d=0; d<num_dims; d++){
+                    const uint32_t num_coarse = (n[d] >> 1) + 1;
+                    coarse[d] = std::vector<uint8_t>(n[d]);
+                    position[d] = std::vector<uint32_t>(n[d]);
+                    for(uint32_t k=0; k<n[d]; k++){
+                        coarse[d][k] = (k % 2 == 0) || (k == n[d] - 1);
+                        position[d][k] = coarse[d][k] ? ((k == n[d] - 1) ? num_coarse - 1 : k / 2) : num_coarse + k / 2;
+                    }
+                }
+            }
+            // offset in data of a row of the last dimension
+            size_t row_offset(uint64_t row) const {
+                size_t offset = 0;
+                for(int d=0; d<num_dims-1; d++){
+                    offset += row / row_strides[d] * offsets[d];
+                    row %= row_strides[d];
+                }
+                return offset;
+            }
+            int num_dims = 2;
+            uint32_t n[MAX_LEVEL_DIMS] = {1};
+            size_t offsets[MAX_LEVEL_DIMS] = {0};
+            // rows of the last dimension in the box, and the row stride of the other dimensions
+            uint64_t num_rows = 1;
+            uint64_t row_strides[MAX_LEVEL_DIMS] = {0};
+            // whether every index is on the coarse grid, and its position after reordering
+            std::vector<uint8_t> coarse[MAX_LEVEL_DIMS];
+            std::vector<uint32_t> position[MAX_LEVEL_DIMS];
+        };
+
+        // tasks of row_end - row_begin rows or lines each, for about 16 tasks per thread
+        uint64_t get_rows_per_task(uint64_t num_rows) const {
+            const uint32_t num_threads = thread_pool->get_num_threads();
+            return (num_rows + 16 * num_threads - 1) / (16 * num_threads);
+        }
+
+        // one level of decomposition (forward) or recomposition of the nodes, in natural order
+        template <bool forward>
+        void update_level(T * data, const Level& level) const {
+            const uint32_t length = level.n[level.num_dims - 1];
+            // blocks of rows, or column ranges of the single row of a 1D box
+            const uint32_t num_columns = (level.num_rows == 1) ? std::min<uint32_t>(thread_pool->get_num_threads(), (length + 4095) / 4096) : 1;
+            const uint64_t rows_per_task = get_rows_per_task(level.num_rows);
+            const uint32_t num_row_blocks = (level.num_rows + rows_per_task - 1) / rows_per_task;
+            thread_pool->parallel_for(num_row_blocks * num_columns, [&](uint32_t task){
+                const uint32_t column = task % num_columns;
+                const uint32_t begin = (uint64_t) length * column / num_columns;
+                const uint32_t end = (uint64_t) length * (column + 1) / num_columns;
+                std::vector<T> average(length);
+                const uint64_t row_end = std::min(level.num_rows, (task / num_columns + 1) * rows_per_task);
+                for(uint64_t row=task / num_columns * rows_per_task; row<row_end; row++){
+                    update_row<forward>(level, row, begin, end, data, average.data());
+                }
+            });
+        }
+
+        // columns [begin, end) of the row; only the coarse nodes of the coarse neighbouring rows are read
+        template <bool forward>
+        void update_row(const Level& level, uint64_t row, uint32_t begin, uint32_t end, T * data, T * average) const {
+            const int last = level.num_dims - 1;
+            const uint32_t length = level.n[last];
+            const uint8_t * coarse = level.coarse[last].data();
+            // index of the row and its fine dimensions
+            uint32_t index[MAX_LEVEL_DIMS];
+            int fine_dims[MAX_LEVEL_DIMS];
+            int num_fine = 0;
+            uint64_t remaining = row;
+            for(int d=0; d<last; d++){
+                index[d] = remaining / level.row_strides[d];
+                remaining %= level.row_strides[d];
+                if(!level.coarse[d][index[d]]) fine_dims[num_fine ++] = d;
+            }
+            auto data_row = [&](uint32_t const * row_index){
+                size_t offset = 0;
+                for(int d=0; d<last; d++){
+                    offset += row_index[d] * level.offsets[d];
+                }
+                return data + offset;
+            };
+            T * own = data_row(index);
+            // average of the coarse neighbouring rows, or the row itself when it is on the coarse grid,
+            // at the coarse columns in [begin - 1, end + 1): the interpolant only uses these
+            const uint32_t average_begin = begin ? begin - 1 : 0;
+            const uint32_t average_end = std::min(end + 1, length);
+            if(num_fine == 0){
+                for(uint32_t k=average_begin; k<average_end; k++){
+                    if(coarse[k]) average[k] = own[k];
+                }
+                // coarse nodes of the coarse grid are kept
+                for(uint32_t k=begin; k<end; k++){
+                    if(coarse[k]) continue;
+                    T interpolant = (average[k - 1] + average[k + 1]) / 2;
+                    if(forward) own[k] -= interpolant;
+                    else own[k] += interpolant;
+                }
+                return;
+            }
+            for(uint32_t k=average_begin; k<average_end; k++){
+                average[k] = 0;
+            }
+            uint32_t neighbour[MAX_LEVEL_DIMS];
+            for(uint32_t corner=0; corner<(1u << num_fine); corner++){
+                memcpy(neighbour, index, last * sizeof(uint32_t));
+                for(int j=0; j<num_fine; j++){
+                    if((corner >> j) & 1u) neighbour[fine_dims[j]] ++;
+                    else neighbour[fine_dims[j]] --;
+                }
+                T const * neighbour_row = data_row(neighbour);
+                for(uint32_t k=average_begin; k<average_end; k++){
+                    if(coarse[k]) average[k] += neighbour_row[k];
+                }
+            }
+            const T scale = (T) 1 / (1u << num_fine);
+            for(uint32_t k=average_begin; k<average_end; k++){
+                average[k] *= scale;
+            }
+            for(uint32_t k=begin; k<end; k++){
+                T interpolant = coarse[k] ? average[k] : (average[k - 1] + average[k + 1]) / 2;
+                if(forward) own[k] -= interpolant;
+                else own[k] += interpolant;
+            }
+        }
+
+        // reorder the level box from natural order to coarse nodes first (forward) or back, one dimension at a time:
+        // rows are permuted through a row buffer, and the lines of rows along the other dimensions through
+        // a buffer of REORDER_COLUMNS columns of every row of the line
+        template <bool forward>
+        void reorder_level(T * data, const Level& level) const {
+            const int last = level.num_dims - 1;
+            const uint32_t length = level.n[last];
+            for(int d=0; d<level.num_dims; d++){
+                const uint32_t n = level.n[d];
+                // every index is on the coarse grid
+                if(n <= 2) continue;
+                const uint32_t * position = level.position[d].data();
+                // lines of rows along d (the rows themselves for the last dimension) times blocks of columns
+                const uint64_t num_lines = (d == last) ? level.num_rows : level.num_rows / n;
+                const uint32_t width = (d == last) ? length : std::min<uint32_t>(length, REORDER_COLUMNS);
+                const uint32_t num_blocks = (length + width - 1) / width;
+                const uint64_t num_items = num_lines * num_blocks;
+                const uint64_t items_per_task = get_rows_per_task(num_items);
+                thread_pool->parallel_for((num_items + items_per_task - 1) / items_per_task, [&](uint32_t task){
+                    std::vector<T> buffer((d == last) ? length : (size_t) n * width);
+                    const uint64_t item_end = std::min(num_items, (task + 1) * items_per_task);
+                    for(uint64_t item=task * items_per_task; item<item_end; item++){
+                        const uint64_t line = item / num_blocks;
+                        if(d == last){
+                            T * row = data + level.row_offset(line);
+                            memcpy(buffer.data(), row, length * sizeof(T));
+                            for(uint32_t k=0; k<length; k++){
+                                if(forward) row[position[k]] = buffer[k];
+                                else row[k] = buffer[position[k]];
+                            }
+                            continue;
+                        }
+                        const uint32_t begin = item % num_blocks * width;
+                        const uint32_t block_width = std::min(width, length - begin);
+                        // first row of the line: index 0 in dimension d
+                        const uint64_t first_row = line / level.row_strides[d] * n * level.row_strides[d] + line % level.row_strides[d];
+                        T * line_data = data + level.row_offset(first_row) + begin;
+                        for(uint32_t k=0; k<n; k++){
+                            memcpy(buffer.data() + (size_t) k * width, line_data + k * level.offsets[d], block_width * sizeof(T));
+                        }
+                        for(uint32_t k=0; k<n; k++){
+                            if(forward) memcpy(line_data + position[k] * level.offsets[d], buffer.data() + (size_t) k * width, block_width * sizeof(T));
+                            else memcpy(line_data + k * level.offsets[d], buffer.data() + (size_t) position[k] * width, block_width * sizeof(T));
+                        }
+                    }
+                });
+            }
+        }
+
+        // shared by copies
+        std::shared_ptr<ThreadPool> thread_pool;
+    };
+}
+#endif
@@ -2,6 +2,7 @@
 #define _MDR_INTERLEAVER_INTERFACE_HPP
 
 #include <cstdint>
+#include "LevelView.hpp"
 
 namespace MDR {
     namespace concepts {
@@ -17,6 +18,19 @@ namespace MDR {
 
             virtual void reposition(T const * buffer, const std::vector<uint32_t>& dims, const std::vector<uint32_t>& dims_fine, const std::vector<uint32_t>& dims_coasre, T * data, std::vector<uint32_t> strides=std::vector<uint32_t>()) const = 0;
 
+            // view of the level coefficients inside data, written in the order of reposition;
+            // data may be NULL when the view only tells its order (LevelView::raster)
+            // by default, the coefficients are gathered by interleave into a buffer owned by the view and
+            // repositioned into data when the last copy of the view is destroyed, so the view must not outlive the interleaver
+            virtual LevelView<T> level_view(const std::vector<uint32_t>& dims, const std::vector<uint32_t>& dims_fine, const std::vector<uint32_t>& dims_coasre, T * data, std::vector<uint32_t> strides=std::vector<uint32_t>()) const {
+                std::vector<T> buffer(LevelShape(dims, dims_fine, dims_coasre, strides).size());
+                if(data == NULL) return LevelView<T>(std::move(buffer), [](T const *){});
+                interleave(data, dims, dims_fine, dims_coasre, buffer.data(), strides);
+                return LevelView<T>(std::move(buffer), [=](T const * values){
+                    reposition(values, dims, dims_fine, dims_coasre, data, strides);
+                });
+            }
+
             virtual void print() const = 0;
         };
     }
@@ -0,0 +1,119 @@
+#ifndef _MDR_LEVEL_SHAPE_HPP
+#define _MDR_LEVEL_SHAPE_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+namespace MDR {
+    #define MAX_LEVEL_DIMS 8
+
+    // elements of the fine box that are not in the coarse box (both anchored at the origin) inside a strided grid,
+    // in interleaving order: row by row in the last dimension; a 1D grid is viewed as a 2D grid of 1 x n
+    // a row is either outside the coarse box or starts with it, so its level elements are one contiguous span
+    struct LevelShape {
+        LevelShape(){}
+
+        LevelShape(const std::vector<uint32_t>& dims, const std::vector<uint32_t>& dims_fine, const std::vector<uint32_t>& dims_coarse, const std::vector<uint32_t>& strides=std::vector<uint32_t>()){
+            if(dims.size() > MAX_LEVEL_DIMS){
+                std::cout << "Dimension higher than " << MAX_LEVEL_DIMS << " is not supported\n";
+                exit(-1);
+            }
+            const int pad = (dims.size() == 1);
+            num_dims = dims.size() + pad;
+            size_t stride = 1;
+            for(int d=num_dims-1; d>=pad; d--){
+                fine[d] = dims_fine[d - pad];
+                coarse[d] = std::min(dims_coarse[d - pad], fine[d]);
+                offsets[d] = strides.size() ? strides[d - pad] : stride;
+                stride *= dims[d - pad];
+            }
+            offsets[num_dims - 1] = 1;
+        }
+
+        // number of elements in the level
+        uint64_t size() const {
+            return product(fine, 0) - product(coarse, 0);
+        }
+
+        // number of level elements in slice i of the slowest dimension
+        uint64_t slice_size(uint32_t i) const {
+            return (i < coarse[0]) ? product(fine, 1) - product(coarse, 1) : product(fine, 1);
+        }
+
+        // index of the first level element of slice i of the slowest dimension
+        uint64_t slice_begin(uint32_t i) const {
+            uint32_t coarse_slices = std::min(i, coarse[0]);
+            return coarse_slices * (product(fine, 1) - product(coarse, 1)) + (uint64_t) (i - coarse_slices) * product(fine, 1);
+        }
+
+        // first level element of the row at index, which is in the coarse box for all but the last dimension or not
+        uint32_t row_start(uint32_t const * index) const {
+            for(int d=0; d<num_dims-1; d++){
+                if(index[d] >= coarse[d]) return 0;
+            }
+            return coarse[num_dims - 1];
+        }
+
+        // index of the level element at position (unpadded) in interleaving order
+        uint64_t element_index(const std::vector<uint32_t>& position) const {
+            const int pad = num_dims - position.size();
+            uint64_t index = 0;
+            bool in_coarse = true;
+            for(int d=pad; d<num_dims; d++){
+                const uint32_t p = position[d - pad];
+                index += p * product(fine, d + 1);
+                if(in_coarse) index -= std::min(p, coarse[d]) * product(coarse, d + 1);
+                in_coarse = in_coarse && (p < coarse[d]);
+            }
+            return index;
+        }
+
+        // offset of the row at index in the grid
+        size_t row_offset(uint32_t const * index) const {
+            size_t offset = 0;
+            for(int d=0; d<num_dims-1; d++){
+                offset += index[d] * offsets[d];
+            }
+            return offset;
+        }
+
+        // advance index to the next row; false past the last row
+        bool next_row(uint32_t * index) const {
+            for(int d=num_dims-2; d>0; d--){
+                if(++index[d] < fine[d]) return true;
+                index[d] = 0;
+            }
+            return ++index[0] < fine[0];
+        }
+
+        // f(data_offset, length) for the non-empty row spans of slice i of the slowest dimension, in order
+        template <class Func>
+        void for_each_span(uint32_t i, Func f) const {
+            if(!product(fine, 1)) return;
+            uint32_t index[MAX_LEVEL_DIMS] = {0};
+            index[0] = i;
+            const uint32_t row_length = fine[num_dims - 1];
+            do{
+                uint32_t start = row_start(index);
+                if(start < row_length) f(row_offset(index) + start, row_length - start);
+            } while(next_row(index) && (index[0] == i));
+        }
+
+        int num_dims = 2;
+        uint32_t fine[MAX_LEVEL_DIMS] = {1, 0};
+        uint32_t coarse[MAX_LEVEL_DIMS] = {1, 0};
+        size_t offsets[MAX_LEVEL_DIMS] = {0, 1};
+
+    private:
+        uint64_t product(uint32_t const * dims, int begin) const {
+            uint64_t result = 1;
+            for(int d=begin; d<num_dims; d++){
+                result *= dims[d];
+            }
+            return result;
+        }
+    };
+}
+#endif
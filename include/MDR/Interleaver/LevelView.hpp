@@ -0,0 +1,265 @@
+#ifndef _MDR_LEVEL_VIEW_HPP
+#define _MDR_LEVEL_VIEW_HPP
+
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include "LevelShape.hpp"
+#include "MortonLayout.hpp"
+
+namespace MDR {
+    // strided view of the coefficients of one level inside the output grid, in interleaving order:
+    // raster order of LevelShape, the curve order of a MortonLayout, or any order of values gathered into a buffer
+    // values are written or read sequentially from a cursor
+    template<class T>
+    class LevelView {
+    public:
+        LevelView(){
+            row_begin();
+        }
+
+        // contiguous view of n elements
+        LevelView(T * data, uint32_t n) : LevelView(data, {n}, {n}, {0}) {}
+
+        LevelView(T * data, const std::vector<uint32_t>& dims, const std::vector<uint32_t>& dims_fine, const std::vector<uint32_t>& dims_coarse, std::vector<uint32_t> strides=std::vector<uint32_t>()) : data(data), shape(dims, dims_fine, dims_coarse, strides) {
+            row_begin();
+        }
+
+        // view in the order of layout
+        LevelView(T * data, std::shared_ptr<const MortonLayout> layout) : data(data), curve(layout) {
+            curve_seek(0);
+        }
+
+        // view of values gathered into a buffer owned by the view, in their order; write_back(values) is called
+        // when the last copy of the view is destroyed, e.g. to store values written through the view in the grid
+        LevelView(std::vector<T>&& values, std::function<void(T const *)> write_back) : gathered(std::make_shared<Gathered>(std::move(values), write_back)) {
+            const uint32_t n = gathered->values.size();
+            data = gathered->values.data();
+            shape = LevelShape({n}, {n}, {0});
+            row_begin();
+        }
+
+        // number of elements in the view
+        uint32_t size() const {
+            return curve ? curve->size() : shape.size();
+        }
+
+        // raster order, where LevelShape::element_index locates the elements
+        bool raster() const {
+            return !curve && !gathered;
+        }
+
+        // view with the cursor at element index
+        LevelView at(uint32_t index) const {
+            LevelView view(*this);
+            if(curve){
+                view.curve_seek(index);
+                return view;
+            }
+            std::fill(view.index, view.index + MAX_LEVEL_DIMS, 0);
+            view.row_begin();
+            view.skip(index);
+            return view;
+        }
+
+        // write count values at the cursor and advance it
+        void write(T const * values, uint32_t count){
+            if(curve){
+                curve_runs(count, [&](T * dst, size_t const * offsets, uint32_t len){
+                    for(uint32_t t=0; t<len; t++){
+                        dst[offsets[t]] = values[t];
+                    }
+                    values += len;
+                });
+                return;
+            }
+            while(count){
+                uint32_t len = std::min(row_length() - k, count);
+                T * dst = data + offset + k;
+                for(uint32_t t=0; t<len; t++){
+                    dst[t] = values[t];
+                }
+                values += len;
+                count -= len;
+                advance(len);
+            }
+        }
+
+        // write count copies of value at the cursor and advance it
+        void fill(T value, uint32_t count){
+            if(curve){
+                curve_runs(count, [&](T * dst, size_t const * offsets, uint32_t len){
+                    for(uint32_t t=0; t<len; t++){
+                        dst[offsets[t]] = value;
+                    }
+                });
+                return;
+            }
+            while(count){
+                uint32_t len = std::min(row_length() - k, count);
+                T * dst = data + offset + k;
+                for(uint32_t t=0; t<len; t++){
+                    dst[t] = value;
+                }
+                count -= len;
+                advance(len);
+            }
+        }
+
+        // read count values at the cursor into values and advance it
+        void read(T * values, uint32_t count){
+            if(curve){
+                curve_runs(count, [&](T const * src, size_t const * offsets, uint32_t len){
+                    for(uint32_t t=0; t<len; t++){
+                        values[t] = src[offsets[t]];
+                    }
+                    values += len;
+                });
+                return;
+            }
+            while(count){
+                uint32_t len = std::min(row_length() - k, count);
+                T const * src = data + offset + k;
+                for(uint32_t t=0; t<len; t++){
+                    values[t] = src[t];
+                }
+                values += len;
+                count -= len;
+                advance(len);
+            }
+        }
+
+        // f(span, length) over contiguous spans covering all elements of the view, in raster order
+        // whatever the order of the view; the cursor is not used
+        template <class Func>
+        void for_each_span(Func f) const {
+            const LevelShape& raster = curve ? curve->get_shape() : shape;
+            for(uint32_t i=0; i<raster.fine[0]; i++){
+                raster.for_each_span(i, [&](size_t span_offset, uint32_t length){
+                    f(data + span_offset, length);
+                });
+            }
+        }
+
+        // advance the cursor by count elements
+        void skip(uint32_t count){
+            if(curve){
+                curve_seek(curve_index + count);
+                return;
+            }
+            // whole slices of the slowest dimension from the start of a slice
+            if((k == shape.row_start(index)) && std::all_of(index + 1, index + shape.num_dims - 1, [](uint32_t i){ return i == 0; })){
+                uint32_t i = index[0];
+                while((i < shape.fine[0]) && (count >= shape.slice_size(i))){
+                    count -= shape.slice_size(i);
+                    i ++;
+                }
+                if(i != index[0]){
+                    index[0] = i;
+                    row_begin();
+                }
+            }
+            while(count){
+                uint32_t len = std::min(row_length() - k, count);
+                count -= len;
+                advance(len);
+            }
+        }
+
+    private:
+        inline uint32_t row_length() const {
+            return shape.fine[shape.num_dims - 1];
+        }
+
+        // move the cursor to the first level element at or after the row at index
+        inline void row_begin(){
+            k = shape.row_start(index);
+            while((k == row_length()) && shape.next_row(index)){
+                k = shape.row_start(index);
+            }
+            offset = shape.row_offset(index);
+        }
+
+        inline void advance(uint32_t len){
+            k += len;
+            if(k == row_length()){
+                if(shape.next_row(index)) row_begin();
+            }
+        }
+
+        // move the cursor to the given level element of the curve
+        void curve_seek(uint64_t element){
+            curve_index = element;
+            tile_index = curve->find_tile(element);
+            if(tile_index >= curve->get_num_tiles()) return;
+            curve->get_tile(tile_index, tile);
+            uint64_t remaining = element - curve->get_tile_begin(tile_index);
+            if(tile.full){
+                code = remaining;
+                return;
+            }
+            code = 0;
+            while(true){
+                while(!curve->is_level_element(tile, code)) code ++;
+                if(!remaining) return;
+                remaining --;
+                code ++;
+            }
+        }
+
+        // move the cursor from the current code to the next level element
+        void curve_settle(){
+            while(true){
+                if(code == curve->get_tile_size()){
+                    if(++tile_index == curve->get_num_tiles()) return;
+                    if(curve->get_tile_begin(tile_index + 1) == curve->get_tile_begin(tile_index)) continue;
+                    curve->get_tile(tile_index, tile);
+                    code = 0;
+                }
+                if(curve->is_level_element(tile, code)) return;
+                code ++;
+            }
+        }
+
+        // f(tile data, offsets, len) for runs of level elements of full tiles and single elements of partial tiles
+        template <class Func>
+        void curve_runs(uint32_t count, Func f){
+            curve_index += count;
+            while(count){
+                uint32_t len = tile.full ? std::min(curve->get_tile_size() - code, count) : 1;
+                f(data + tile.offset, curve->get_local_offsets() + code, len);
+                count -= len;
+                code += len;
+                curve_settle();
+            }
+        }
+
+        // gathered values and the call that stores them
+        struct Gathered {
+            Gathered(std::vector<T>&& values, std::function<void(T const *)> write_back) : values(std::move(values)), write_back(write_back) {}
+            ~Gathered(){
+                write_back(values.data());
+            }
+            std::vector<T> values;
+            std::function<void(T const *)> write_back;
+        };
+
+        T * data = NULL;
+        LevelShape shape;
+        // cursor: row index in all but the last dimension, its offset in data, and position in the row
+        uint32_t index[MAX_LEVEL_DIMS] = {0};
+        size_t offset = 0;
+        uint32_t k = 0;
+        // curve order (NULL: raster order) and its cursor: level element, tile and Morton code in the tile
+        std::shared_ptr<const MortonLayout> curve;
+        uint64_t curve_index = 0;
+        uint64_t tile_index = 0;
+        MortonLayout::Tile tile;
+        uint32_t code = 0;
+        // owner of the values of a gathered view (NULL: data is the grid)
+        std::shared_ptr<Gathered> gathered;
+    };
+}
+#endif
@@ -0,0 +1,171 @@
+#ifndef _MDR_MORTON_LAYOUT_HPP
+#define _MDR_MORTON_LAYOUT_HPP
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "LevelShape.hpp"
+
+namespace MDR {
+    #define MORTON_TILE_BITS 12
+
+    // order of the level elements along a space-filling curve: the fine box is cut into tiles of up to
+    // 2^MORTON_TILE_BITS elements visited in raster order, and the elements of a tile follow its Morton (Z-order) curve;
+    // elements outside the fine box or in the coarse box are skipped
+    class MortonLayout {
+    public:
+        struct Tile {
+            // offset of the tile origin in the grid
+            size_t offset = 0;
+            uint32_t origin[MAX_LEVEL_DIMS] = {0};
+            // all elements of the tile are level elements
+            bool full = false;
+        };
+
+        MortonLayout(const std::vector<uint32_t>& dims, const std::vector<uint32_t>& dims_fine, const std::vector<uint32_t>& dims_coarse, const std::vector<uint32_t>& strides=std::vector<uint32_t>())
+            : shape(dims, dims_fine, dims_coarse, strides) {
+            const int num_dims = shape.num_dims;
+            // tile bits are given to the dimensions in turn from the fastest, as long as the tile fits in the level
+            int total_bits = 0;
+            bool grown = true;
+            while(grown && (total_bits < MORTON_TILE_BITS)){
+                grown = false;
+                for(int d=num_dims-1; (d>=0) && (total_bits < MORTON_TILE_BITS); d--){
+                    if((1u << tile_bits[d]) < shape.fine[d]){
+                        tile_bits[d] ++;
+                        total_bits ++;
+                        grown = true;
+                    }
+                }
+            }
+            tile_size = 1u << total_bits;
+            // local coordinates of every Morton code: code bits go to the dimensions in the same turns
+            local_coords = std::vector<uint16_t>(tile_size * num_dims, 0);
+            local_offsets = std::vector<size_t>(tile_size, 0);
+            for(uint32_t code=0; code<tile_size; code++){
+                uint16_t * coords = &local_coords[code * num_dims];
+                int bit = 0;
+                for(int b=0; bit<total_bits; b++){
+                    for(int d=num_dims-1; d>=0; d--){
+                        if(b >= tile_bits[d]) continue;
+                        coords[d] |= ((code >> bit) & 1) << b;
+                        bit ++;
+                    }
+                }
+                for(int d=0; d<num_dims; d++){
+                    local_offsets[code] += coords[d] * shape.offsets[d];
+                }
+            }
+            num_tiles = 1;
+            for(int d=0; d<num_dims; d++){
+                tile_dims[d] = (shape.fine[d] + (1u << tile_bits[d]) - 1) >> tile_bits[d];
+                num_tiles *= tile_dims[d];
+            }
+            // first level element of every tile
+            tile_begin = std::vector<uint64_t>(num_tiles + 1, 0);
+            Tile tile;
+            for(uint64_t t=0; t<num_tiles; t++){
+                get_tile(t, tile);
+                uint64_t fine_volume = 1;
+                uint64_t coarse_volume = 1;
+                for(int d=0; d<num_dims; d++){
+                    uint32_t end = tile.origin[d] + (1u << tile_bits[d]);
+                    fine_volume *= std::min(end, shape.fine[d]) - tile.origin[d];
+                    coarse_volume *= (tile.origin[d] < shape.coarse[d]) ? std::min(end, shape.coarse[d]) - tile.origin[d] : 0;
+                }
+                tile_begin[t + 1] = tile_begin[t] + fine_volume - coarse_volume;
+            }
+        }
+
+        // number of elements in the level
+        uint64_t size() const {
+            return tile_begin[num_tiles];
+        }
+
+        uint64_t get_num_tiles() const {
+            return num_tiles;
+        }
+
+        uint32_t get_tile_size() const {
+            return tile_size;
+        }
+
+        // first level element of tile t
+        uint64_t get_tile_begin(uint64_t t) const {
+            return tile_begin[t];
+        }
+
+        // raster shape of the level: the same elements in raster order
+        const LevelShape& get_shape() const {
+            return shape;
+        }
+
+        // tile containing level element index
+        uint64_t find_tile(uint64_t index) const {
+            return std::upper_bound(tile_begin.begin(), tile_begin.end(), index) - tile_begin.begin() - 1;
+        }
+
+        void get_tile(uint64_t t, Tile& tile) const {
+            tile.offset = 0;
+            tile.full = true;
+            for(int d=shape.num_dims-1; d>=0; d--){
+                tile.origin[d] = (t % tile_dims[d]) << tile_bits[d];
+                t /= tile_dims[d];
+                tile.offset += tile.origin[d] * shape.offsets[d];
+                if(tile.origin[d] + (1u << tile_bits[d]) > shape.fine[d]) tile.full = false;
+            }
+            if(in_coarse(tile.origin)) tile.full = false;
+        }
+
+        // whether the element of Morton code code in the tile is a level element
+        bool is_level_element(const Tile& tile, uint32_t code) const {
+            if(tile.full) return true;
+            uint16_t const * coords = &local_coords[code * shape.num_dims];
+            uint32_t index[MAX_LEVEL_DIMS];
+            for(int d=0; d<shape.num_dims; d++){
+                index[d] = tile.origin[d] + coords[d];
+                if(index[d] >= shape.fine[d]) return false;
+            }
+            return !in_coarse(index);
+        }
+
+        // offset in the grid of the element of Morton code code in the tile
+        size_t get_offset(const Tile& tile, uint32_t code) const {
+            return tile.offset + local_offsets[code];
+        }
+
+        // offsets of the Morton codes relative to the tile origin
+        size_t const * get_local_offsets() const {
+            return local_offsets.data();
+        }
+
+        // f(offset) for the level elements of tile t, in order
+        template <class Func>
+        void for_each_element(uint64_t t, Func f) const {
+            if(tile_begin[t + 1] == tile_begin[t]) return;
+            Tile tile;
+            get_tile(t, tile);
+            for(uint32_t code=0; code<tile_size; code++){
+                if(is_level_element(tile, code)) f(get_offset(tile, code));
+            }
+        }
+
+    private:
+        bool in_coarse(uint32_t const * index) const {
+            for(int d=0; d<shape.num_dims; d++){
+                if(index[d] >= shape.coarse[d]) return false;
+            }
+            return true;
+        }
+
+        LevelShape shape;
+        int tile_bits[MAX_LEVEL_DIMS] = {0};
+        uint32_t tile_dims[MAX_LEVEL_DIMS] = {0};
+        uint32_t tile_size = 1;
+        uint64_t num_tiles = 0;
+        std::vector<uint16_t> local_coords;
+        std::vector<size_t> local_offsets;
+        std::vector<uint64_t> tile_begin;
+    };
+}
+#endif
@@ -0,0 +1,45 @@
+#ifndef _MDR_SFC_INTERLEAVER_HPP
+#define _MDR_SFC_INTERLEAVER_HPP
+
+#include "InterleaverInterface.hpp"
+#include "MDR/ParallelUtils.hpp"
+#include <memory>
+
+namespace MDR {
+    // space-filling curve interleaver: level elements in Morton order within cache-sized tiles (MortonLayout),
+    // so that neighbors in all dimensions stay close in the bitplanes
+    template<class T>
+    class SFCInterleaver : public concepts::InterleaverInterface<T> {
+    public:
+        // tiles are copied concurrently by num_threads threads
+        SFCInterleaver(int num_threads = 1) : thread_pool(std::make_shared<ThreadPool>(num_threads)) {}
+        void interleave(T const * data, const std::vector<uint32_t>& dims, const std::vector<uint32_t>& dims_fine, const std::vector<uint32_t>& dims_coasre, T * buffer, std::vector<uint32_t> strides=std::vector<uint32_t>()) const {
+            MortonLayout layout(dims, dims_fine, dims_coasre, strides);
+            thread_pool->parallel_for(layout.get_num_tiles(), [&](uint32_t t){
+                T * buffer_pos = buffer + layout.get_tile_begin(t);
+                layout.for_each_element(t, [&](size_t offset){
+                    *(buffer_pos ++) = data[offset];
+                });
+            });
+        }
+        void reposition(T const * buffer, const std::vector<uint32_t>& dims, const std::vector<uint32_t>& dims_fine, const std::vector<uint32_t>& dims_coasre, T * data, std::vector<uint32_t> strides=std::vector<uint32_t>()) const {
+            MortonLayout layout(dims, dims_fine, dims_coasre, strides);
+            thread_pool->parallel_for(layout.get_num_tiles(), [&](uint32_t t){
+                T const * buffer_pos = buffer + layout.get_tile_begin(t);
+                layout.for_each_element(t, [&](size_t offset){
+                    data[offset] = *(buffer_pos ++);
+                });
+            });
+        }
+        LevelView<T> level_view(const std::vector<uint32_t>& dims, const std::vector<uint32_t>& dims_fine, const std::vector<uint32_t>& dims_coasre, T * data, std::vector<uint32_t> strides=std::vector<uint32_t>()) const {
+            return LevelView<T>(data, std::make_shared<MortonLayout>(dims, dims_fine, dims_coasre, strides));
+        }
+        void print() const {
+            std::cout << "SFC interleaver" << std::endl;
+        }
+    private:
+        // shared by copies
+        std::shared_ptr<ThreadPool> thread_pool;
+    };
+}
+#endif
@@ -3,65 +3,107 @@
 
 #include "LevelCompressorInterface.hpp"
 #include "LosslessCompressor.hpp"
+#include "MDR/ParallelUtils.hpp"
+#include <memory>
 
 namespace MDR {
     #define CR_THRESHOLD 1.05
     // compress all layers
     class AdaptiveLevelCompressor : public concepts::LevelCompressorInterface {
     public:
-        AdaptiveLevelCompressor(int l = 26) : latter_index(l) {}
+        using concepts::LevelCompressorInterface::compress_level;
+        using concepts::LevelCompressorInterface::decompress_level;
+        // l: index of the first bitplane always compressed; ZSTD compression level and strategy (0: default strategy of the level);
+        // bitplanes are compressed and decompressed concurrently by num_threads threads
+        AdaptiveLevelCompressor(int l = 26, int level = ZSTD_LEVEL, int strategy = 0, int num_threads = 1) : latter_index(l), level(level), strategy(strategy), thread_pool(std::make_shared<ThreadPool>(num_threads)) {}
         uint8_t compress_level(std::vector<uint8_t*>& streams, std::vector<uint32_t>& stream_sizes) const {
-            int stopping_index = stream_sizes.size();
-            for(int i=0; i<streams.size(); i++){
-                uint8_t * compressed = NULL;
-                auto compressed_size = ZSTD::compress(streams[i], stream_sizes[i], &compressed);
-                free(streams[i]);
-                // std::cout << compressed_size << " " << stream_sizes[i] << " " << stream_sizes[i] * 1.0 / compressed_size << std::endl;
-                // skip the first
-                float ratio = stream_sizes[i] * 1.0 / compressed_size;
-                streams[i] = compressed;
-                stream_sizes[i] = compressed_size;
-                if(i && (ratio < CR_THRESHOLD)){
-                    stopping_index = i;
-                    break;
+            const int num_streams = streams.size();
+            std::vector<uint8_t *> compressed(num_streams, NULL);
+            std::vector<uint32_t> compressed_sizes(num_streams, 0);
+            auto compress_range = [&](int begin, int end){
+                thread_pool->parallel_for(std::max(end - begin, 0), [&](uint32_t t){
+                    compressed_sizes[begin + t] = ZSTD::compress(streams[begin + t], stream_sizes[begin + t], &compressed[begin + t], stream_pool, level, strategy);
+                });
+            };
+            // stop at the first bitplane (skipping the first) with ratio below CR_THRESHOLD;
+            // bitplanes are compressed speculatively one window of num_threads at a time and checked in order
+            int stopping_index = num_streams;
+            int num_compressed = 0;
+            const int window_size = thread_pool->get_num_threads();
+            while((num_compressed < num_streams) && (stopping_index == num_streams)){
+                int window_begin = num_compressed;
+                num_compressed = std::min(num_streams, num_compressed + window_size);
+                compress_range(window_begin, num_compressed);
+                for(int i=window_begin; i<num_compressed; i++){
+                    float ratio = stream_sizes[i] * 1.0 / compressed_sizes[i];
+                    if(i && (ratio < CR_THRESHOLD)){
+                        stopping_index = i;
+                        break;
+                    }
                 }
             }
             int latter_start_index = (stopping_index < latter_index) ? latter_index : stopping_index + 1;
-            for(int i=latter_start_index; i<streams.size(); i++){
-                uint8_t * compressed = NULL;
-                auto compressed_size = ZSTD::compress(streams[i], stream_sizes[i], &compressed);
-                free(streams[i]);
-                streams[i] = compressed;
-                stream_sizes[i] = compressed_size;
+            compress_range(std::max(latter_start_index, num_compressed), num_streams);
+            // keep compressed bitplanes up to the stopping index and from the latter start index,
+            // discard the speculation in between
+            for(int i=0; i<num_streams; i++){
+                if(!compressed[i]) continue;
+                if((i <= stopping_index) || (i >= latter_start_index)){
+                    release_stream(stream_pool, streams[i]);
+                    streams[i] = compressed[i];
+                    stream_sizes[i] = compressed_sizes[i];
+                }
+                else{
+                    release_stream(stream_pool, compressed[i]);
+                }
             }
             return stopping_index;
         }
         void decompress_level(std::vector<const uint8_t*>& streams, const std::vector<uint32_t>& stream_sizes, uint8_t starting_bitplane, uint8_t num_bitplanes, uint8_t stopping_index) {
+            compressed_bitplanes.clear();
+            decompressed_sizes.clear();
             for(int i=0; i<num_bitplanes; i++){
                 int bitplane_index = starting_bitplane + i;
                 if((bitplane_index <= stopping_index) || (bitplane_index >= latter_index)){
-                    uint8_t * decompressed = NULL;
-                    auto decompressed_size = ZSTD::decompress(streams[i], stream_sizes[bitplane_index], &decompressed);
-                    buffer.push_back(decompressed);
-                    streams[i] = decompressed;                    
+                    compressed_bitplanes.push_back(i);
+                    decompressed_sizes.push_back(ZSTD::get_decompressed_size(streams[i]));
                 }
             }
-        }
-        void decompress_release(){
-            for(int i=0; i<buffer.size(); i++){
-                if(buffer[i]) free(buffer[i]);
+            get_scratch_buffer().carve(decompressed_sizes, decompressed);
+            thread_pool->parallel_for(compressed_bitplanes.size(), [&](uint32_t t){
+                int i = compressed_bitplanes[t];
+                ZSTD::decompress_into(streams[i], stream_sizes[starting_bitplane + i], decompressed[t]);
+            });
+            for(int t=0; t<compressed_bitplanes.size(); t++){
+                streams[compressed_bitplanes[t]] = decompressed[t];
             }
-            buffer.clear();
+        }
+        void decompress_release(){}
+        void set_stream_pool(StreamPool * pool){
+            stream_pool = pool;
+        }
+        void set_scratch_buffer(ScratchBuffer * scratch){
+            scratch_buffer = scratch;
         }
         void print() const {
             std::cout << "Adaptive level lossless compressor" << std::endl;
         }
-        ~AdaptiveLevelCompressor(){
-            decompress_release();
-        }
     private:
+        ScratchBuffer& get_scratch_buffer(){
+            return scratch_buffer ? *scratch_buffer : default_scratch_buffer;
+        }
+
+        StreamPool * stream_pool = NULL;
         int latter_index;
-        std::vector<uint8_t*> buffer;
+        int level;
+        int strategy;
+        // shared by copies
+        std::shared_ptr<ThreadPool> thread_pool;
+        ScratchBuffer * scratch_buffer = NULL;
+        ScratchBuffer default_scratch_buffer;
+        std::vector<int> compressed_bitplanes;
+        std::vector<size_t> decompressed_sizes;
+        std::vector<uint8_t*> decompressed;
     };
 }
 #endif
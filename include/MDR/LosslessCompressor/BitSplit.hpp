@@ -0,0 +1,178 @@
+#ifndef _MDR_BIT_SPLIT_HPP
+#define _MDR_BIT_SPLIT_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MDR_BIT_SPLIT_X86 1
+#include <immintrin.h>
+#endif
+
+namespace MDR {
+    // split of bitplanes by the significance context of their bits and the reverse merge
+    // bit i of a bitplane word belongs to element i of the word; an element is significant once one of
+    // the previous bitplanes has its bit set
+    // contexts: 0 refinement of significant elements, 1 significance next to a significant element, 2 other significance
+    namespace BitSplit {
+        #define NUM_BIT_CONTEXTS 3
+
+        // bitstream of 64-bit words, LSB first
+        class BitWriter {
+        public:
+            // append the lowest num_bits bits of value (higher bits must be 0)
+            void write(uint64_t value, int num_bits){
+                if(!num_bits) return;
+                const int offset = size & 63;
+                if(!offset) words.push_back(value);
+                else{
+                    words.back() |= value << offset;
+                    if(offset + num_bits > 64) words.push_back(value >> (64 - offset));
+                }
+                size += num_bits;
+            }
+            std::vector<uint64_t> words;
+            uint64_t size = 0;
+        };
+        class BitReader {
+        public:
+            BitReader(uint64_t const * words = NULL) : words(words) {}
+            uint64_t read(int num_bits){
+                if(!num_bits) return 0;
+                const uint64_t index = position >> 6;
+                const int offset = position & 63;
+                uint64_t value = words[index] >> offset;
+                if(offset && (offset + num_bits > 64)) value |= words[index + 1] << (64 - offset);
+                position += num_bits;
+                return (num_bits == 64) ? value : value & ((1ull << num_bits) - 1);
+            }
+        private:
+            uint64_t const * words;
+            uint64_t position = 0;
+        };
+
+        // masks of the contexts of word w; valid masks the bits of the word in the bitplane
+        inline void context_masks(uint64_t const * significance, uint32_t w, uint32_t num_words, uint64_t valid, uint64_t * masks){
+            const uint64_t sig = significance[w];
+            const uint64_t left = (w > 0) ? significance[w - 1] >> 63 : 0;
+            const uint64_t right = (w + 1 < num_words) ? significance[w + 1] << 63 : 0;
+            const uint64_t neighbor = (sig << 1) | left | (sig >> 1) | right;
+            masks[0] = sig & valid;
+            masks[1] = ~sig & neighbor & valid;
+            masks[2] = ~sig & ~neighbor & valid;
+        }
+
+        struct ScalarBits {
+            static inline uint64_t extract(uint64_t value, uint64_t mask){
+                uint64_t result = 0;
+                for(uint64_t bit=1; mask; bit<<=1){
+                    uint64_t lowest = mask & -mask;
+                    if(value & lowest) result |= bit;
+                    mask ^= lowest;
+                }
+                return result;
+            }
+            static inline uint64_t deposit(uint64_t value, uint64_t mask){
+                uint64_t result = 0;
+                for(uint64_t bit=1; mask; bit<<=1){
+                    uint64_t lowest = mask & -mask;
+                    if(value & bit) result |= lowest;
+                    mask ^= lowest;
+                }
+                return result;
+            }
+            static inline int count(uint64_t mask){
+                return __builtin_popcountll(mask);
+            }
+        };
+
+        // split bits[0, num_words) into the context bitstreams
+        template <class Bits>
+        __attribute__((always_inline)) inline void split_words(uint64_t const * bits, uint64_t const * significance, uint32_t num_words, uint64_t last_valid, BitWriter * writers){
+            uint64_t masks[NUM_BIT_CONTEXTS];
+            for(uint32_t w=0; w<num_words; w++){
+                context_masks(significance, w, num_words, (w + 1 == num_words) ? last_valid : ~0ull, masks);
+                for(int c=0; c<NUM_BIT_CONTEXTS; c++){
+                    writers[c].write(Bits::extract(bits[w], masks[c]), Bits::count(masks[c]));
+                }
+            }
+        }
+        // merge the context bitstreams into bits[0, num_words)
+        template <class Bits>
+        __attribute__((always_inline)) inline void merge_words(BitReader * readers, uint64_t const * significance, uint32_t num_words, uint64_t last_valid, uint64_t * bits){
+            uint64_t masks[NUM_BIT_CONTEXTS];
+            for(uint32_t w=0; w<num_words; w++){
+                context_masks(significance, w, num_words, (w + 1 == num_words) ? last_valid : ~0ull, masks);
+                uint64_t word = 0;
+                for(int c=0; c<NUM_BIT_CONTEXTS; c++){
+                    word |= Bits::deposit(readers[c].read(Bits::count(masks[c])), masks[c]);
+                }
+                bits[w] = word;
+            }
+        }
+
+        inline void split_scalar(uint64_t const * bits, uint64_t const * significance, uint32_t num_words, uint64_t last_valid, BitWriter * writers){
+            split_words<ScalarBits>(bits, significance, num_words, last_valid, writers);
+        }
+        inline void merge_scalar(BitReader * readers, uint64_t const * significance, uint32_t num_words, uint64_t last_valid, uint64_t * bits){
+            merge_words<ScalarBits>(readers, significance, num_words, last_valid, bits);
+        }
+
+#ifdef MDR_BIT_SPLIT_X86
+        // BMI2: pext/pdep
+        struct BMI2Bits {
+            __attribute__((target("bmi2,popcnt"))) static inline uint64_t extract(uint64_t value, uint64_t mask){
+                return _pext_u64(value, mask);
+            }
+            __attribute__((target("bmi2,popcnt"))) static inline uint64_t deposit(uint64_t value, uint64_t mask){
+                return _pdep_u64(value, mask);
+            }
+            __attribute__((target("bmi2,popcnt"))) static inline int count(uint64_t mask){
+                return _mm_popcnt_u64(mask);
+            }
+        };
+        __attribute__((target("bmi2,popcnt"))) inline void split_bmi2(uint64_t const * bits, uint64_t const * significance, uint32_t num_words, uint64_t last_valid, BitWriter * writers){
+            split_words<BMI2Bits>(bits, significance, num_words, last_valid, writers);
+        }
+        __attribute__((target("bmi2,popcnt"))) inline void merge_bmi2(BitReader * readers, uint64_t const * significance, uint32_t num_words, uint64_t last_valid, uint64_t * bits){
+            merge_words<BMI2Bits>(readers, significance, num_words, last_valid, bits);
+        }
+#endif
+
+        typedef void (*SplitKernel)(uint64_t const *, uint64_t const *, uint32_t, uint64_t, BitWriter *);
+        typedef void (*MergeKernel)(BitReader *, uint64_t const *, uint32_t, uint64_t, uint64_t *);
+
+        // kernels picked once at runtime by CPU detection
+        inline SplitKernel split_kernel(){
+            static const SplitKernel kernel = [](){
+#ifdef MDR_BIT_SPLIT_X86
+                __builtin_cpu_init();
+                if(__builtin_cpu_supports("bmi2") && __builtin_cpu_supports("popcnt")) return (SplitKernel) split_bmi2;
+#endif
+                return (SplitKernel) split_scalar;
+            }();
+            return kernel;
+        }
+        inline MergeKernel merge_kernel(){
+            static const MergeKernel kernel = [](){
+#ifdef MDR_BIT_SPLIT_X86
+                __builtin_cpu_init();
+                if(__builtin_cpu_supports("bmi2") && __builtin_cpu_supports("popcnt")) return (MergeKernel) merge_bmi2;
+#endif
+                return (MergeKernel) merge_scalar;
+            }();
+            return kernel;
+        }
+
+        // split the bitplane of num_words words into NUM_BIT_CONTEXTS bitstreams;
+        // last_valid masks the bits of the last word in the bitplane
+        inline void split(uint64_t const * bits, uint64_t const * significance, uint32_t num_words, uint64_t last_valid, BitWriter * writers){
+            split_kernel()(bits, significance, num_words, last_valid, writers);
+        }
+        // merge the NUM_BIT_CONTEXTS bitstreams read by readers into the bitplane
+        inline void merge(BitReader * readers, uint64_t const * significance, uint32_t num_words, uint64_t last_valid, uint64_t * bits){
+            merge_kernel()(readers, significance, num_words, last_valid, bits);
+        }
+    }
+}
+#endif
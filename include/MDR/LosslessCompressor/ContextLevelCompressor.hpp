@@ -0,0 +1,308 @@
+#ifndef _MDR_CONTEXT_LEVEL_COMPRESSOR_HPP
+#define _MDR_CONTEXT_LEVEL_COMPRESSOR_HPP
+
+#include "LevelCompressorInterface.hpp"
+#include "LosslessCompressor.hpp"
+#include "BitSplit.hpp"
+#include "MDR/ParallelUtils.hpp"
+#include <memory>
+#include <iostream>
+
+namespace MDR {
+    // compress every bitplane with ZSTD or, if smaller, by significance context: the bits are split by the
+    // significance of their elements in the previous bitplanes of the level (BitSplit) and each context is
+    // coded on its own with the smallest of raw, Huffman and ZSTD.
+    // contexts need bitplanes that hold the bit of element i at the same position (NegaBinaryBPEncoder);
+    // levels with bitplanes of different sizes are compressed with ZSTD only.
+    // context-coded format: [original size (size_t)][(codec (uint8_t), size (uint32_t), data) of every context]
+    // the significance of the decompressed bitplanes is kept per level index, so one instance serves the levels of one field:
+    // fields decompressed concurrently or in turns need their own instances
+    class ContextLevelCompressor : public concepts::LevelCompressorInterface {
+    public:
+        using concepts::LevelCompressorInterface::compress_level;
+        using concepts::LevelCompressorInterface::decompress_level;
+        // ZSTD compression level; bitplanes are compressed and decompressed concurrently by num_threads threads
+        ContextLevelCompressor(int level = ZSTD_LEVEL, int num_threads = 1) : level(level), thread_pool(std::make_shared<ThreadPool>(num_threads)) {}
+        // codecs and level indices are needed for decompression, so levels must be compressed with the codec-reporting overload
+        uint8_t compress_level(std::vector<uint8_t*>& streams, std::vector<uint32_t>& stream_sizes) const {
+            std::cerr << "ContextLevelCompressor: bitplane codecs must be recorded." << std::endl;
+            exit(-1);
+        }
+        uint8_t compress_level(std::vector<uint8_t*>& streams, std::vector<uint32_t>& stream_sizes, std::vector<uint8_t>& codecs, uint8_t level_index) const {
+            const int num_streams = streams.size();
+            codecs = std::vector<uint8_t>(num_streams, CODEC_ZSTD);
+            bool use_context = (num_streams > 0) && (stream_sizes[0] > 0);
+            for(int i=1; i<num_streams; i++){
+                if(stream_sizes[i] != stream_sizes[0]) use_context = false;
+            }
+            // significance before every bitplane
+            std::vector<std::vector<uint64_t>> significances;
+            if(use_context){
+                std::vector<uint64_t> significance(get_num_words(stream_sizes[0]), 0);
+                for(int i=0; i<num_streams; i++){
+                    significances.push_back(significance);
+                    update_significance(streams[i], stream_sizes[i], significance);
+                }
+            }
+            thread_pool->parallel_for(num_streams, [&](uint32_t i){
+                uint8_t * compressed = NULL;
+                auto compressed_size = ZSTD::compress(streams[i], stream_sizes[i], &compressed, stream_pool, level);
+                if(use_context){
+                    uint8_t * context_compressed = NULL;
+                    auto context_compressed_size = compress_by_context(streams[i], stream_sizes[i], significances[i].data(), &context_compressed);
+                    if(context_compressed_size < compressed_size){
+                        std::swap(compressed, context_compressed);
+                        compressed_size = context_compressed_size;
+                        codecs[i] = CODEC_SIGNIFICANCE_CONTEXT;
+                    }
+                    release_stream(stream_pool, context_compressed);
+                }
+                release_stream(stream_pool, streams[i]);
+                streams[i] = compressed;
+                stream_sizes[i] = compressed_size;
+            });
+            return 0;
+        }
+        void decompress_level(std::vector<const uint8_t*>& streams, const std::vector<uint32_t>& stream_sizes, uint8_t starting_bitplane, uint8_t num_bitplanes, uint8_t stopping_index) {
+            std::cerr << "ContextLevelCompressor: bitplane codecs and level index are required for decompression." << std::endl;
+            exit(-1);
+        }
+        // bitplanes of a level are decompressed in order as the significance is carried from one call to the next
+        bool decompress_level(std::vector<const uint8_t*>& streams, const std::vector<uint32_t>& stream_sizes, uint8_t starting_bitplane, uint8_t num_bitplanes, uint8_t stopping_index, const std::vector<uint8_t>& codecs, uint32_t dictionary_set, uint8_t level_index) {
+            if(level_index >= level_significances.size()){
+                level_significances.resize(level_index + 1);
+                level_num_bitplanes.resize(level_index + 1, 0);
+            }
+            if(starting_bitplane == 0){
+                level_significances[level_index].clear();
+                level_num_bitplanes[level_index] = 0;
+            }
+            if(starting_bitplane != level_num_bitplanes[level_index]){
+                std::cerr << "ContextLevelCompressor: bitplane " << (int) starting_bitplane << " of level " << (int) level_index << " is requested, but " << (int) level_num_bitplanes[level_index] << " bitplanes are decompressed; bitplanes must be decompressed in order." << std::endl;
+                return false;
+            }
+            // scratch: the decompressed bitplanes, then the context bitstreams of the context-coded bitplanes
+            decompressed_sizes.resize(num_bitplanes);
+            context_indices.resize(num_bitplanes);
+            for(int i=0; i<num_bitplanes; i++){
+                if(codecs[starting_bitplane + i] == CODEC_SIGNIFICANCE_CONTEXT){
+                    // merged in whole words
+                    decompressed_sizes[i] = get_num_words(get_decompressed_size(streams[i])) * sizeof(uint64_t);
+                }
+                else decompressed_sizes[i] = ZSTD::get_decompressed_size(streams[i]);
+            }
+            for(int i=0; i<num_bitplanes; i++){
+                if(codecs[starting_bitplane + i] != CODEC_SIGNIFICANCE_CONTEXT) continue;
+                context_indices[i] = decompressed_sizes.size();
+                add_context_sizes(streams[i], decompressed_sizes);
+            }
+            get_scratch_buffer().carve(decompressed_sizes, decompressed);
+            // entropy decoding of all bitplanes and context bitstreams in parallel
+            thread_pool->parallel_for(num_bitplanes, [&](uint32_t i){
+                if(codecs[starting_bitplane + i] == CODEC_SIGNIFICANCE_CONTEXT){
+                    decompress_contexts(streams[i], &decompressed[context_indices[i]]);
+                }
+                else{
+                    ZSTD::decompress_into(streams[i], stream_sizes[starting_bitplane + i], decompressed[i]);
+                }
+            });
+            // merge of the contexts in order of bitplanes, then the significance update
+            std::vector<uint64_t>& significance = level_significances[level_index];
+            for(int i=0; i<num_bitplanes; i++){
+                uint32_t size = 0;
+                if(codecs[starting_bitplane + i] == CODEC_SIGNIFICANCE_CONTEXT){
+                    size = get_decompressed_size(streams[i]);
+                    if(significance.size() < get_num_words(size)) significance.resize(get_num_words(size), 0);
+                    merge_contexts(&decompressed[context_indices[i]], size, significance.data(), decompressed[i]);
+                }
+                else size = ZSTD::get_decompressed_size(streams[i]);
+                update_significance(decompressed[i], size, significance);
+            }
+            level_num_bitplanes[level_index] += num_bitplanes;
+            for(int i=0; i<num_bitplanes; i++){
+                streams[i] = decompressed[i];
+            }
+            return true;
+        }
+        void decompress_release(){}
+        void set_stream_pool(StreamPool * pool){
+            stream_pool = pool;
+        }
+        void set_scratch_buffer(ScratchBuffer * scratch){
+            scratch_buffer = scratch;
+        }
+        void print() const {
+            std::cout << "Context level lossless compressor" << std::endl;
+        }
+    private:
+        ScratchBuffer& get_scratch_buffer(){
+            return scratch_buffer ? *scratch_buffer : default_scratch_buffer;
+        }
+
+        static uint32_t get_num_words(uint32_t size){
+            return (size + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+        }
+
+        // mask of the bits of the last word within size bytes
+        static uint64_t get_last_valid(uint32_t size){
+            const uint32_t tail_bits = (size % sizeof(uint64_t)) * 8;
+            return tail_bits ? (1ull << tail_bits) - 1 : ~0ull;
+        }
+
+        static uint32_t get_decompressed_size(uint8_t const * compressed){
+            size_t size = 0;
+            memcpy(&size, compressed, sizeof(size_t));
+            return size;
+        }
+
+        // significance |= bits of the bitplane
+        static void update_significance(uint8_t const * stream, uint32_t size, std::vector<uint64_t>& significance){
+            if(significance.size() < get_num_words(size)) significance.resize(get_num_words(size), 0);
+            const uint32_t num_full_words = size / sizeof(uint64_t);
+            for(uint32_t w=0; w<num_full_words; w++){
+                uint64_t word;
+                memcpy(&word, stream + w * sizeof(uint64_t), sizeof(uint64_t));
+                significance[w] |= word;
+            }
+            if(num_full_words < get_num_words(size)){
+                uint64_t word = 0;
+                memcpy(&word, stream + num_full_words * sizeof(uint64_t), size - num_full_words * sizeof(uint64_t));
+                significance[num_full_words] |= word;
+            }
+        }
+
+        uint32_t compress_by_context(uint8_t const * stream, uint32_t size, uint64_t const * significance, uint8_t ** compressed) const {
+            const uint32_t num_words = get_num_words(size);
+            std::vector<uint64_t> bits(num_words, 0);
+            memcpy(bits.data(), stream, size);
+            BitSplit::BitWriter writers[NUM_BIT_CONTEXTS];
+            BitSplit::split(bits.data(), significance, num_words, get_last_valid(size), writers);
+            // smallest of raw, Huffman and ZSTD for every context
+            uint8_t codecs[NUM_BIT_CONTEXTS];
+            uint8_t * context_compressed[NUM_BIT_CONTEXTS];
+            uint32_t context_sizes[NUM_BIT_CONTEXTS];
+            uint32_t total_size = sizeof(size_t);
+            for(int c=0; c<NUM_BIT_CONTEXTS; c++){
+                uint8_t const * data = reinterpret_cast<uint8_t const *>(writers[c].words.data());
+                const uint32_t data_size = (writers[c].size + 7) / 8;
+                codecs[c] = CODEC_RAW;
+                context_compressed[c] = NULL;
+                context_sizes[c] = data_size;
+                if(data_size){
+                    uint8_t * huffman_compressed = NULL;
+                    uint32_t huffman_size = Huffman::compress(data, data_size, &huffman_compressed, stream_pool);
+                    uint8_t * zstd_compressed = NULL;
+                    uint32_t zstd_size = ZSTD::compress(data, data_size, &zstd_compressed, stream_pool, level);
+                    if(zstd_size < huffman_size){
+                        std::swap(huffman_compressed, zstd_compressed);
+                        std::swap(huffman_size, zstd_size);
+                        codecs[c] = CODEC_ZSTD;
+                    }
+                    else codecs[c] = CODEC_HUFFMAN;
+                    release_stream(stream_pool, zstd_compressed);
+                    if(huffman_size < data_size){
+                        context_compressed[c] = huffman_compressed;
+                        context_sizes[c] = huffman_size;
+                    }
+                    else{
+                        release_stream(stream_pool, huffman_compressed);
+                        codecs[c] = CODEC_RAW;
+                    }
+                }
+                total_size += sizeof(uint8_t) + sizeof(uint32_t) + context_sizes[c];
+            }
+            *compressed = allocate_stream(stream_pool, total_size);
+            uint8_t * compressed_pos = *compressed;
+            const size_t original_size = size;
+            memcpy(compressed_pos, &original_size, sizeof(size_t));
+            compressed_pos += sizeof(size_t);
+            for(int c=0; c<NUM_BIT_CONTEXTS; c++){
+                *(compressed_pos ++) = codecs[c];
+                memcpy(compressed_pos, &context_sizes[c], sizeof(uint32_t));
+                compressed_pos += sizeof(uint32_t);
+                if(codecs[c] == CODEC_RAW){
+                    if(context_sizes[c]) memcpy(compressed_pos, writers[c].words.data(), context_sizes[c]);
+                }
+                else{
+                    memcpy(compressed_pos, context_compressed[c], context_sizes[c]);
+                    release_stream(stream_pool, context_compressed[c]);
+                }
+                compressed_pos += context_sizes[c];
+            }
+            return total_size;
+        }
+
+        // append the sizes of the context bitstreams of a context-coded bitplane
+        static void add_context_sizes(uint8_t const * compressed, std::vector<size_t>& sizes){
+            uint8_t const * compressed_pos = compressed + sizeof(size_t);
+            for(int c=0; c<NUM_BIT_CONTEXTS; c++){
+                uint8_t codec = *(compressed_pos ++);
+                uint32_t size = 0;
+                memcpy(&size, compressed_pos, sizeof(uint32_t));
+                compressed_pos += sizeof(uint32_t);
+                switch(codec){
+                    case CODEC_RAW:
+                        sizes.push_back(size);
+                        break;
+                    case CODEC_HUFFMAN:
+                        sizes.push_back(Huffman::get_decompressed_size(compressed_pos));
+                        break;
+                    case CODEC_ZSTD:
+                        sizes.push_back(ZSTD::get_decompressed_size(compressed_pos));
+                        break;
+                    default:
+                        std::cerr << "ContextLevelCompressor: unknown codec " << (int) codec << std::endl;
+                        exit(-1);
+                }
+                compressed_pos += size;
+            }
+        }
+
+        // decode the context bitstreams of a context-coded bitplane into contexts[0, NUM_BIT_CONTEXTS)
+        static void decompress_contexts(uint8_t const * compressed, uint8_t * const * contexts){
+            uint8_t const * compressed_pos = compressed + sizeof(size_t);
+            for(int c=0; c<NUM_BIT_CONTEXTS; c++){
+                uint8_t codec = *(compressed_pos ++);
+                uint32_t size = 0;
+                memcpy(&size, compressed_pos, sizeof(uint32_t));
+                compressed_pos += sizeof(uint32_t);
+                switch(codec){
+                    case CODEC_RAW:
+                        if(size) memcpy(contexts[c], compressed_pos, size);
+                        break;
+                    case CODEC_HUFFMAN:
+                        Huffman::decompress_into(compressed_pos, size, contexts[c]);
+                        break;
+                    case CODEC_ZSTD:
+                        ZSTD::decompress_into(compressed_pos, size, contexts[c]);
+                        break;
+                }
+                compressed_pos += size;
+            }
+        }
+
+        // merge the context bitstreams into the bitplane of size bytes, written in whole words
+        static void merge_contexts(uint8_t * const * contexts, uint32_t size, uint64_t const * significance, uint8_t * bitplane){
+            BitSplit::BitReader readers[NUM_BIT_CONTEXTS];
+            for(int c=0; c<NUM_BIT_CONTEXTS; c++){
+                readers[c] = BitSplit::BitReader(reinterpret_cast<uint64_t const *>(contexts[c]));
+            }
+            BitSplit::merge(readers, significance, get_num_words(size), get_last_valid(size), reinterpret_cast<uint64_t *>(bitplane));
+        }
+
+        int level;
+        StreamPool * stream_pool = NULL;
+        // shared by copies
+        std::shared_ptr<ThreadPool> thread_pool;
+        ScratchBuffer * scratch_buffer = NULL;
+        ScratchBuffer default_scratch_buffer;
+        std::vector<size_t> decompressed_sizes;
+        std::vector<uint8_t*> decompressed;
+        // index of the first context bitstream of every bitplane in the scratch pieces
+        std::vector<uint32_t> context_indices;
+        // significance of the decompressed bitplanes of every level
+        std::vector<std::vector<uint64_t>> level_significances;
+        std::vector<uint8_t> level_num_bitplanes;
+    };
+}
+#endif
@@ -4,48 +4,65 @@
 #include "LevelCompressorInterface.hpp"
 #include "LosslessCompressor.hpp"
 #include "MDR/RefactorUtils.hpp"
+#include "MDR/ParallelUtils.hpp"
+#include <memory>
 
 namespace MDR {
     // compress all layers
     class DefaultLevelCompressor : public concepts::LevelCompressorInterface {
     public:
-        DefaultLevelCompressor(){}
+        using concepts::LevelCompressorInterface::compress_level;
+        using concepts::LevelCompressorInterface::decompress_level;
+        // ZSTD compression level and strategy (0: default strategy of the level);
+        // bitplanes are compressed and decompressed concurrently by num_threads threads
+        DefaultLevelCompressor(int level = ZSTD_LEVEL, int strategy = 0, int num_threads = 1) : level(level), strategy(strategy), thread_pool(std::make_shared<ThreadPool>(num_threads)) {}
         uint8_t compress_level(std::vector<uint8_t*>& streams, std::vector<uint32_t>& stream_sizes) const {
-            // Timer timer;
-            for(int i=0; i<streams.size(); i++){
+            thread_pool->parallel_for(streams.size(), [&](uint32_t i){
                 uint8_t * compressed = NULL;
-                // timer.start();
-                auto compressed_size = ZSTD::compress(streams[i], stream_sizes[i], &compressed);
-                free(streams[i]);
-                // timer.end();
+                auto compressed_size = ZSTD::compress(streams[i], stream_sizes[i], &compressed, stream_pool, level, strategy);
+                release_stream(stream_pool, streams[i]);
                 streams[i] = compressed;
                 stream_sizes[i] = compressed_size;
-            }
-            // timer.print("Lossless: ");
+            });
             return 0;
         }
         void decompress_level(std::vector<const uint8_t*>& streams, const std::vector<uint32_t>& stream_sizes, uint8_t starting_bitplane, uint8_t num_bitplanes, uint8_t stopping_index) {
+            decompressed_sizes.resize(num_bitplanes);
             for(int i=0; i<num_bitplanes; i++){
-                uint8_t * decompressed = NULL;
-                auto decompressed_size = ZSTD::decompress(streams[i], stream_sizes[starting_bitplane + i], &decompressed);
-                buffer.push_back(decompressed);
-                streams[i] = decompressed;
+                decompressed_sizes[i] = ZSTD::get_decompressed_size(streams[i]);
             }
-        }
-        void decompress_release(){
-            for(int i=0; i<buffer.size(); i++){
-                free(buffer[i]);
+            get_scratch_buffer().carve(decompressed_sizes, decompressed);
+            thread_pool->parallel_for(num_bitplanes, [&](uint32_t i){
+                ZSTD::decompress_into(streams[i], stream_sizes[starting_bitplane + i], decompressed[i]);
+            });
+            for(int i=0; i<num_bitplanes; i++){
+                streams[i] = decompressed[i];
             }
-            buffer.clear();
+        }
+        void decompress_release(){}
+        void set_stream_pool(StreamPool * pool){
+            stream_pool = pool;
+        }
+        void set_scratch_buffer(ScratchBuffer * scratch){
+            scratch_buffer = scratch;
         }
         void print() const {
             std::cout << "Default level lossless compressor" << std::endl;
         }
-        ~DefaultLevelCompressor(){
-            decompress_release();
-        }
     private:
-        std::vector<uint8_t*> buffer;
+        ScratchBuffer& get_scratch_buffer(){
+            return scratch_buffer ? *scratch_buffer : default_scratch_buffer;
+        }
+
+        int level;
+        int strategy;
+        StreamPool * stream_pool = NULL;
+        // shared by copies
+        std::shared_ptr<ThreadPool> thread_pool;
+        ScratchBuffer * scratch_buffer = NULL;
+        ScratchBuffer default_scratch_buffer;
+        std::vector<size_t> decompressed_sizes;
+        std::vector<uint8_t*> decompressed;
     };
 }
 #endif
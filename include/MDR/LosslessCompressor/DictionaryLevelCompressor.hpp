@@ -0,0 +1,120 @@
+#ifndef _MDR_DICTIONARY_LEVEL_COMPRESSOR_HPP
+#define _MDR_DICTIONARY_LEVEL_COMPRESSOR_HPP
+
+#include "LevelCompressorInterface.hpp"
+#include "LosslessCompressor.hpp"
+#include "ZSTDDictionary.hpp"
+#include "MDR/ParallelUtils.hpp"
+#include <memory>
+
+namespace MDR {
+    // compress all layers, small bitplanes also with the ZSTD dictionary of their level keeping the smaller result;
+    // while the dictionaries are not trained, the streams to compress are collected as training samples;
+    // a level compressed with a trained set records the set id, checked when the level is decompressed
+    class DictionaryLevelCompressor : public concepts::LevelCompressorInterface {
+    public:
+        using concepts::LevelCompressorInterface::compress_level;
+        using concepts::LevelCompressorInterface::decompress_level;
+        // dictionaries: shared with other compressors and reconstructors of the same variables;
+        // bitplanes are compressed and decompressed concurrently by num_threads threads
+        DictionaryLevelCompressor(std::shared_ptr<ZSTDDictionaries> dictionaries, int level = ZSTD_LEVEL, int num_threads = 1) : dictionaries(dictionaries), level(level), thread_pool(std::make_shared<ThreadPool>(num_threads)) {}
+        // without the level index, the dictionary of level 0 is used
+        uint8_t compress_level(std::vector<uint8_t*>& streams, std::vector<uint32_t>& stream_sizes) const {
+            std::vector<uint8_t> codecs;
+            return compress_level(streams, stream_sizes, codecs, 0);
+        }
+        uint8_t compress_level(std::vector<uint8_t*>& streams, std::vector<uint32_t>& stream_sizes, std::vector<uint8_t>& codecs, uint8_t level_index) const {
+            codecs.clear();
+            if(!dictionaries->trained()) dictionaries->add_samples(level_index, streams, stream_sizes);
+            const ZSTD_CDict * cdict = dictionaries->get_cdict(level_index, level);
+            thread_pool->parallel_for(streams.size(), [&](uint32_t i){
+                uint8_t * compressed = NULL;
+                auto compressed_size = ZSTD::compress(streams[i], stream_sizes[i], &compressed, stream_pool, level);
+                if(cdict && (stream_sizes[i] <= ZSTD_DICTIONARY_MAX_STREAM_SIZE)){
+                    uint8_t * dictionary_compressed = NULL;
+                    auto dictionary_compressed_size = ZSTD::compress(streams[i], stream_sizes[i], &dictionary_compressed, stream_pool, cdict);
+                    if(dictionary_compressed_size < compressed_size){
+                        std::swap(compressed, dictionary_compressed);
+                        compressed_size = dictionary_compressed_size;
+                    }
+                    release_stream(stream_pool, dictionary_compressed);
+                }
+                release_stream(stream_pool, streams[i]);
+                streams[i] = compressed;
+                stream_sizes[i] = compressed_size;
+            });
+            return 0;
+        }
+        uint32_t get_dictionary_set(uint8_t level_index) const {
+            return dictionaries->get_cdict(level_index, level) ? dictionaries->get_set_id() : 0;
+        }
+        void decompress_level(std::vector<const uint8_t*>& streams, const std::vector<uint32_t>& stream_sizes, uint8_t starting_bitplane, uint8_t num_bitplanes, uint8_t stopping_index) {
+            if(!load_ddicts(streams, stream_sizes, starting_bitplane, num_bitplanes)) exit(-1);
+            decompress_streams(streams, stream_sizes, starting_bitplane, num_bitplanes);
+        }
+        bool decompress_level(std::vector<const uint8_t*>& streams, const std::vector<uint32_t>& stream_sizes, uint8_t starting_bitplane, uint8_t num_bitplanes, uint8_t stopping_index, const std::vector<uint8_t>& codecs, uint32_t dictionary_set, uint8_t level_index) {
+            if(dictionary_set && (dictionary_set != dictionaries->get_set_id())){
+                std::cerr << "Level " << (int) level_index << " is compressed with ZSTD dictionary set " << dictionary_set << ", but set " << dictionaries->get_set_id() << " is loaded." << std::endl;
+                return false;
+            }
+            if(!load_ddicts(streams, stream_sizes, starting_bitplane, num_bitplanes)) return false;
+            decompress_streams(streams, stream_sizes, starting_bitplane, num_bitplanes);
+            return true;
+        }
+        void decompress_release(){}
+        void set_stream_pool(StreamPool * pool){
+            stream_pool = pool;
+        }
+        void set_scratch_buffer(ScratchBuffer * scratch){
+            scratch_buffer = scratch;
+        }
+        void print() const {
+            std::cout << "Dictionary level lossless compressor" << std::endl;
+        }
+    private:
+        // dictionaries are looked up by the id recorded in every frame
+        // return false if a dictionary is not loaded
+        bool load_ddicts(const std::vector<const uint8_t*>& streams, const std::vector<uint32_t>& stream_sizes, uint8_t starting_bitplane, uint8_t num_bitplanes){
+            ddicts.assign(num_bitplanes, NULL);
+            for(int i=0; i<num_bitplanes; i++){
+                uint32_t id = ZSTD::get_dictionary_id(streams[i], stream_sizes[starting_bitplane + i]);
+                if(!id) continue;
+                ddicts[i] = dictionaries->get_ddict(id);
+                if(!ddicts[i]){
+                    std::cerr << "ZSTD dictionary " << id << " is not loaded." << std::endl;
+                    return false;
+                }
+            }
+            return true;
+        }
+        void decompress_streams(std::vector<const uint8_t*>& streams, const std::vector<uint32_t>& stream_sizes, uint8_t starting_bitplane, uint8_t num_bitplanes){
+            decompressed_sizes.resize(num_bitplanes);
+            for(int i=0; i<num_bitplanes; i++){
+                decompressed_sizes[i] = ZSTD::get_decompressed_size(streams[i]);
+            }
+            get_scratch_buffer().carve(decompressed_sizes, decompressed);
+            thread_pool->parallel_for(num_bitplanes, [&](uint32_t i){
+                if(ddicts[i]) ZSTD::decompress_into(streams[i], stream_sizes[starting_bitplane + i], decompressed[i], ddicts[i]);
+                else ZSTD::decompress_into(streams[i], stream_sizes[starting_bitplane + i], decompressed[i]);
+            });
+            for(int i=0; i<num_bitplanes; i++){
+                streams[i] = decompressed[i];
+            }
+        }
+        ScratchBuffer& get_scratch_buffer(){
+            return scratch_buffer ? *scratch_buffer : default_scratch_buffer;
+        }
+
+        std::shared_ptr<ZSTDDictionaries> dictionaries;
+        int level;
+        StreamPool * stream_pool = NULL;
+        // shared by copies
+        std::shared_ptr<ThreadPool> thread_pool;
+        ScratchBuffer * scratch_buffer = NULL;
+        ScratchBuffer default_scratch_buffer;
+        std::vector<size_t> decompressed_sizes;
+        std::vector<uint8_t*> decompressed;
+        std::vector<const ZSTD_DDict *> ddicts;
+    };
+}
+#endif
@@ -0,0 +1,212 @@
+#ifndef _MDR_HUFFMAN_HPP
+#define _MDR_HUFFMAN_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include "MDR/StreamPool.hpp"
+
+namespace MDR {
+    namespace Huffman{
+        // canonical Huffman coding of bytes with code lengths limited to HUFFMAN_MAX_CODE_LENGTH
+        // the input is split into HUFFMAN_NUM_STREAMS segments coded as separate bitstreams (LSB first) so that they decode in lockstep
+        // compressed format: [original size (size_t)][code length of the 256 symbols, 4 bits each][sizes of all but the last bitstream (uint32_t)][bitstreams]
+        #define HUFFMAN_MAX_CODE_LENGTH 12
+        #define HUFFMAN_NUM_STREAMS 4
+        #define HUFFMAN_HEADER_SIZE (sizeof(size_t) + 128 + (HUFFMAN_NUM_STREAMS - 1) * sizeof(uint32_t))
+
+        // code lengths of the symbols (0 if absent); frequencies are flattened until the lengths fit the limit
+        inline void build_code_lengths(const uint64_t * frequencies, uint8_t * lengths){
+            std::vector<uint64_t> freq(frequencies, frequencies + 256);
+            memset(lengths, 0, 256);
+            std::vector<int> symbols;
+            for(int s=0; s<256; s++){
+                if(freq[s]) symbols.push_back(s);
+            }
+            if(symbols.size() == 0) return;
+            if(symbols.size() == 1){
+                lengths[symbols[0]] = 1;
+                return;
+            }
+            while(true){
+                // nodes 0..255 are leaves; parent[] links internal nodes
+                std::vector<int> parent(512, -1);
+                using Node = std::pair<uint64_t, int>;
+                std::priority_queue<Node, std::vector<Node>, std::greater<Node>> heap;
+                for(int s:symbols) heap.push(Node(freq[s], s));
+                int next_node = 256;
+                while(heap.size() > 1){
+                    Node a = heap.top(); heap.pop();
+                    Node b = heap.top(); heap.pop();
+                    parent[a.second] = next_node;
+                    parent[b.second] = next_node;
+                    heap.push(Node(a.first + b.first, next_node ++));
+                }
+                int max_length = 0;
+                for(int s:symbols){
+                    int length = 0;
+                    for(int node=s; parent[node] >= 0; node=parent[node]) length ++;
+                    lengths[s] = length;
+                    max_length = std::max(max_length, length);
+                }
+                if(max_length <= HUFFMAN_MAX_CODE_LENGTH) return;
+                for(int s:symbols) freq[s] = (freq[s] + 1) / 2;
+            }
+        }
+
+        // canonical codes from code lengths, bit-reversed for LSB-first streams
+        inline void build_codes(const uint8_t * lengths, uint32_t * codes){
+            uint32_t length_count[HUFFMAN_MAX_CODE_LENGTH + 1] = {0};
+            for(int s=0; s<256; s++) length_count[lengths[s]] ++;
+            length_count[0] = 0;
+            uint32_t next_code[HUFFMAN_MAX_CODE_LENGTH + 2] = {0};
+            for(int l=1; l<=HUFFMAN_MAX_CODE_LENGTH; l++){
+                next_code[l + 1] = (next_code[l] + length_count[l]) << 1;
+            }
+            for(int s=0; s<256; s++){
+                uint8_t length = lengths[s];
+                if(!length) continue;
+                uint32_t code = next_code[length] ++;
+                uint32_t reversed = 0;
+                for(int b=0; b<length; b++){
+                    reversed |= ((code >> b) & 1u) << (length - 1 - b);
+                }
+                codes[s] = reversed;
+            }
+        }
+
+        // size of the buffer needed to compress dataLength bytes
+        inline size_t compress_bound(uint32_t dataLength){
+            return HUFFMAN_HEADER_SIZE + ((size_t) dataLength * HUFFMAN_MAX_CODE_LENGTH + 7) / 8 + HUFFMAN_NUM_STREAMS + sizeof(uint64_t);
+        }
+
+        // original size of compressed data
+        inline uint32_t get_decompressed_size(const uint8_t* compressBytes){
+            size_t size = 0;
+            memcpy(&size, compressBytes, sizeof(size_t));
+            return size;
+        }
+
+        // compress into compressBytes of at least compress_bound(dataLength) bytes
+        inline uint32_t compress_into(const uint8_t* data, uint32_t dataLength, uint8_t* compressBytes) {
+            uint64_t frequencies[256] = {0};
+            for(uint32_t i=0; i<dataLength; i++) frequencies[data[i]] ++;
+            uint8_t lengths[256];
+            build_code_lengths(frequencies, lengths);
+            uint32_t codes[256] = {0};
+            build_codes(lengths, codes);
+            const size_t size = dataLength;
+            memcpy(compressBytes, &size, sizeof(size_t));
+            uint8_t * header = compressBytes + sizeof(size_t);
+            for(int s=0; s<256; s+=2){
+                header[s / 2] = lengths[s] | (lengths[s + 1] << 4);
+            }
+            uint8_t * stream_sizes = header + 128;
+            uint8_t * out = compressBytes + HUFFMAN_HEADER_SIZE;
+            const uint32_t segment_size = (dataLength + HUFFMAN_NUM_STREAMS - 1) / HUFFMAN_NUM_STREAMS;
+            for(int k=0; k<HUFFMAN_NUM_STREAMS; k++){
+                uint8_t * stream_begin = out;
+                uint64_t buffer = 0;
+                int num_bits = 0;
+                const uint32_t end = std::min<uint64_t>((uint64_t) (k + 1) * segment_size, dataLength);
+                for(uint32_t i=std::min(k * segment_size, end); i<end; i++){
+                    buffer |= (uint64_t) codes[data[i]] << num_bits;
+                    num_bits += lengths[data[i]];
+                    if(num_bits >= 32){
+                        uint32_t word = buffer;
+                        memcpy(out, &word, sizeof(uint32_t));
+                        out += sizeof(uint32_t);
+                        buffer >>= 32;
+                        num_bits -= 32;
+                    }
+                }
+                memcpy(out, &buffer, sizeof(uint64_t));
+                out += (num_bits + 7) / 8;
+                if(k < HUFFMAN_NUM_STREAMS - 1){
+                    uint32_t stream_size = out - stream_begin;
+                    memcpy(stream_sizes + k * sizeof(uint32_t), &stream_size, sizeof(uint32_t));
+                }
+            }
+            // zero padding for the 64-bit reads of the decoder
+            memset(out, 0, sizeof(uint64_t));
+            return out + sizeof(uint64_t) - compressBytes;
+        }
+
+        // decompress into oriData of at least get_decompressed_size(compressBytes) bytes
+        inline uint32_t decompress_into(const uint8_t* compressBytes, uint32_t cmpSize, uint8_t* oriData) {
+            uint32_t outSize = get_decompressed_size(compressBytes);
+            uint8_t const * header = compressBytes + sizeof(size_t);
+            uint8_t lengths[256];
+            for(int s=0; s<256; s+=2){
+                lengths[s] = header[s / 2] & 0xf;
+                lengths[s + 1] = header[s / 2] >> 4;
+            }
+            uint32_t codes[256] = {0};
+            build_codes(lengths, codes);
+            // table of the symbol and code length for every HUFFMAN_MAX_CODE_LENGTH-bit prefix
+            uint16_t table[1u << HUFFMAN_MAX_CODE_LENGTH] = {0};
+            for(int s=0; s<256; s++){
+                if(!lengths[s]) continue;
+                for(uint32_t prefix=codes[s]; prefix<(1u << HUFFMAN_MAX_CODE_LENGTH); prefix+=(1u << lengths[s])){
+                    table[prefix] = (lengths[s] << 8) | s;
+                }
+            }
+            const uint64_t mask = (1u << HUFFMAN_MAX_CODE_LENGTH) - 1;
+            uint32_t stream_sizes[HUFFMAN_NUM_STREAMS - 1];
+            memcpy(stream_sizes, header + 128, sizeof(stream_sizes));
+            const uint32_t segment_size = (outSize + HUFFMAN_NUM_STREAMS - 1) / HUFFMAN_NUM_STREAMS;
+            uint8_t const * in[HUFFMAN_NUM_STREAMS];
+            uint8_t * out[HUFFMAN_NUM_STREAMS];
+            uint32_t segment_lengths[HUFFMAN_NUM_STREAMS];
+            uint64_t bit_pos[HUFFMAN_NUM_STREAMS] = {0};
+            in[0] = compressBytes + HUFFMAN_HEADER_SIZE;
+            for(int k=0; k<HUFFMAN_NUM_STREAMS; k++){
+                if(k) in[k] = in[k - 1] + stream_sizes[k - 1];
+                uint32_t begin = std::min<uint64_t>((uint64_t) k * segment_size, outSize);
+                out[k] = oriData + begin;
+                segment_lengths[k] = std::min<uint64_t>((uint64_t) (k + 1) * segment_size, outSize) - begin;
+            }
+            // the streams are decoded in lockstep, 4 symbols per 64-bit read (at least 56 valid bits after the byte shift)
+            const uint32_t lockstep_length = segment_lengths[HUFFMAN_NUM_STREAMS - 1] / 4 * 4;
+            for(uint32_t i=0; i<lockstep_length; i+=4){
+                uint64_t bits[HUFFMAN_NUM_STREAMS];
+                for(int k=0; k<HUFFMAN_NUM_STREAMS; k++){
+                    memcpy(&bits[k], in[k] + (bit_pos[k] >> 3), sizeof(uint64_t));
+                    bits[k] >>= (bit_pos[k] & 7);
+                }
+                for(int t=0; t<4; t++){
+                    for(int k=0; k<HUFFMAN_NUM_STREAMS; k++){
+                        uint16_t entry = table[bits[k] & mask];
+                        out[k][i + t] = entry & 0xff;
+                        bits[k] >>= (entry >> 8);
+                        bit_pos[k] += (entry >> 8);
+                    }
+                }
+            }
+            for(int k=0; k<HUFFMAN_NUM_STREAMS; k++){
+                for(uint32_t i=lockstep_length; i<segment_lengths[k]; i++){
+                    uint64_t bits;
+                    memcpy(&bits, in[k] + (bit_pos[k] >> 3), sizeof(uint64_t));
+                    uint16_t entry = table[(bits >> (bit_pos[k] & 7)) & mask];
+                    out[k][i] = entry & 0xff;
+                    bit_pos[k] += (entry >> 8);
+                }
+            }
+            return outSize;
+        }
+
+        // Huffman lossless compressor; the compressed buffer is allocated from pool (NULL: system allocation)
+        inline uint32_t compress(const uint8_t* data, uint32_t dataLength, uint8_t** compressBytes, StreamPool * pool=NULL) {
+            *compressBytes = allocate_stream(pool, compress_bound(dataLength));
+            return compress_into(data, dataLength, *compressBytes);
+        }
+        inline uint32_t decompress(const uint8_t* compressBytes, uint32_t cmpSize, uint8_t** oriData) {
+            *oriData = (uint8_t*)malloc(get_decompressed_size(compressBytes));
+            return decompress_into(compressBytes, cmpSize, *oriData);
+        }
+    }
+}
+#endif
@@ -4,5 +4,8 @@
 #include "DefaultLevelCompressor.hpp"
 #include "AdaptiveLevelCompressor.hpp"
 #include "NullLevelCompressor.hpp"
+#include "SelectiveLevelCompressor.hpp"
+#include "DictionaryLevelCompressor.hpp"
+#include "ContextLevelCompressor.hpp"
 
 #endif
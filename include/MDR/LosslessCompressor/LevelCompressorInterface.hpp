@@ -2,8 +2,20 @@
 #define _MDR_LEVEL_COMPRESSOR_INTERFACE_HPP
 
 #include <cstdint>
+#include <vector>
+#include "MDR/StreamPool.hpp"
+#include "MDR/ScratchBuffer.hpp"
 
 namespace MDR {
+    // codec of a bitplane stream, recorded per bitplane with the level
+    enum BitplaneCodec : uint8_t {
+        CODEC_RAW = 0,
+        CODEC_ZERO_RUN = 1,
+        CODEC_ZSTD = 2,
+        CODEC_HUFFMAN = 3,
+        CODEC_SIGNIFICANCE_CONTEXT = 4
+    };
+
     namespace concepts {
 
         // interface for lossless compressor 
@@ -15,12 +27,38 @@ namespace MDR {
             // compress level, overwrite and free original streams; rewrite streams sizes
             virtual uint8_t compress_level(std::vector<uint8_t*>& streams, std::vector<uint32_t>& stream_sizes) const = 0;
 
-            // decompress level, create new buffer and overwrite original streams; will not change stream sizes
+            // decompress level into the scratch buffer and overwrite original streams; will not change stream sizes
+            // decompressed streams stay valid until the next decompression
             virtual void decompress_level(std::vector<const uint8_t*>& streams, const std::vector<uint32_t>& stream_sizes, uint8_t starting_bitplane, uint8_t num_bitplanes, uint8_t stopping_index) = 0;
 
+            // compression of level level_index that also reports the codec chosen for every bitplane, stored with the level;
+            // empty codecs means decompression relies on the stopping index
+            virtual uint8_t compress_level(std::vector<uint8_t*>& streams, std::vector<uint32_t>& stream_sizes, std::vector<uint8_t>& codecs, uint8_t level_index) const {
+                codecs.clear();
+                return compress_level(streams, stream_sizes);
+            }
+
+            // id of the dictionary set that level level_index is compressed with, stored with the level (0: no dictionary)
+            virtual uint32_t get_dictionary_set(uint8_t level_index) const {
+                return 0;
+            }
+
+            // decompression of level level_index with the recorded codecs and dictionary set
+            // return false if the level cannot be decompressed from the state of the compressor
+            virtual bool decompress_level(std::vector<const uint8_t*>& streams, const std::vector<uint32_t>& stream_sizes, uint8_t starting_bitplane, uint8_t num_bitplanes, uint8_t stopping_index, const std::vector<uint8_t>& codecs, uint32_t dictionary_set, uint8_t level_index) {
+                decompress_level(streams, stream_sizes, starting_bitplane, num_bitplanes, stopping_index);
+                return true;
+            }
+
             // release the buffer created
             virtual void decompress_release() = 0;
 
+            // pool that streams are allocated from and released to when compressing levels (NULL: system allocation)
+            virtual void set_stream_pool(StreamPool * pool) {}
+
+            // scratch region that levels are decompressed into (NULL: a region owned by the compressor)
+            virtual void set_scratch_buffer(ScratchBuffer * scratch) {}
+
             virtual void print() const = 0;
         };
     }
@@ -2,5 +2,7 @@
 #define _MDR_LOSSLESS_COMPRESSOR_HPP
 
 #include "ZSTD.hpp"
+#include "Huffman.hpp"
+#include "ZeroRun.hpp"
 
 #endif
@@ -7,6 +7,8 @@ namespace MDR {
     // Null lossless compressor
     class NullLevelCompressor : public concepts::LevelCompressorInterface {
     public:
+        using concepts::LevelCompressorInterface::compress_level;
+        using concepts::LevelCompressorInterface::decompress_level;
         NullLevelCompressor(){}
         uint8_t compress_level(std::vector<uint8_t*>& streams, std::vector<uint32_t>& stream_sizes) const { return 0;}
         void decompress_level(std::vector<const uint8_t*>& streams, const std::vector<uint32_t>& stream_sizes, uint8_t starting_bitplane, uint8_t num_bitplanes, uint8_t stopping_index){}
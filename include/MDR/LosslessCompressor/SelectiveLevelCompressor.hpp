@@ -0,0 +1,213 @@
+#ifndef _MDR_SELECTIVE_LEVEL_COMPRESSOR_HPP
+#define _MDR_SELECTIVE_LEVEL_COMPRESSOR_HPP
+
+#include "LevelCompressorInterface.hpp"
+#include "LosslessCompressor.hpp"
+#include "MDR/ParallelUtils.hpp"
+#include <memory>
+#include <iostream>
+
+namespace MDR {
+    #define SELECTION_SAMPLE_SIZE 65536
+    #define SELECTION_NUM_SAMPLES 4
+
+    // compress every bitplane with the codec of least estimated retrieval time, estimated on a sample of the stream:
+    // compressed size / bandwidth + original size / decode throughput of the codec
+    class SelectiveLevelCompressor : public concepts::LevelCompressorInterface {
+    public:
+        using concepts::LevelCompressorInterface::compress_level;
+        using concepts::LevelCompressorInterface::decompress_level;
+        // bandwidth: retrieval bandwidth in bytes per second; zstd_levels: ZSTD compression levels to try;
+        // bitplanes are compressed and decompressed concurrently by num_threads threads;
+        // *_throughput: single-thread decode throughput of each codec in bytes of original stream per second on the retrieving machine
+        SelectiveLevelCompressor(double bandwidth = 2e8, std::vector<int> zstd_levels = {1, ZSTD_LEVEL}, int num_threads = 1,
+                double zero_run_throughput = 8e9, double zstd_throughput = 1e9, double huffman_throughput = 1e9)
+            : bandwidth(bandwidth), thread_pool(std::make_shared<ThreadPool>(num_threads)) {
+            candidates.push_back(Candidate(CODEC_ZERO_RUN, 0, zero_run_throughput));
+            candidates.push_back(Candidate(CODEC_HUFFMAN, 0, huffman_throughput));
+            for(int level:zstd_levels){
+                candidates.push_back(Candidate(CODEC_ZSTD, level, zstd_throughput));
+            }
+        }
+        // without recorded codecs every bitplane is compressed with ZSTD
+        uint8_t compress_level(std::vector<uint8_t*>& streams, std::vector<uint32_t>& stream_sizes) const {
+            thread_pool->parallel_for(streams.size(), [&](uint32_t i){
+                uint8_t * compressed = NULL;
+                auto compressed_size = ZSTD::compress(streams[i], stream_sizes[i], &compressed, stream_pool);
+                release_stream(stream_pool, streams[i]);
+                streams[i] = compressed;
+                stream_sizes[i] = compressed_size;
+            });
+            return 0;
+        }
+        uint8_t compress_level(std::vector<uint8_t*>& streams, std::vector<uint32_t>& stream_sizes, std::vector<uint8_t>& codecs, uint8_t) const {
+            codecs = std::vector<uint8_t>(streams.size(), CODEC_RAW);
+            thread_pool->parallel_for(streams.size(), [&](uint32_t i){
+                codecs[i] = compress_bitplane(streams[i], stream_sizes[i]);
+            });
+            return streams.size();
+        }
+        // levels compressed without recorded codecs are ZSTD
+        void decompress_level(std::vector<const uint8_t*>& streams, const std::vector<uint32_t>& stream_sizes, uint8_t starting_bitplane, uint8_t num_bitplanes, uint8_t stopping_index) {
+            decompress_level(streams, stream_sizes, starting_bitplane, num_bitplanes, stopping_index, std::vector<uint8_t>(starting_bitplane + num_bitplanes, CODEC_ZSTD), 0, 0);
+        }
+        bool decompress_level(std::vector<const uint8_t*>& streams, const std::vector<uint32_t>& stream_sizes, uint8_t starting_bitplane, uint8_t num_bitplanes, uint8_t stopping_index, const std::vector<uint8_t>& codecs, uint32_t dictionary_set, uint8_t level_index) {
+            if(codecs.empty()){
+                decompress_level(streams, stream_sizes, starting_bitplane, num_bitplanes, stopping_index);
+                return true;
+            }
+            // raw bitplanes are used in place and take no scratch, unless they are not word-aligned for the decoders
+            decompressed_sizes.resize(num_bitplanes);
+            for(int i=0; i<num_bitplanes; i++){
+                uint8_t codec = codecs[starting_bitplane + i];
+                if(codec != CODEC_RAW) decompressed_sizes[i] = get_decompressed_size(codec, streams[i]);
+                else decompressed_sizes[i] = is_aligned(streams[i]) ? 0 : stream_sizes[starting_bitplane + i];
+            }
+            get_scratch_buffer().carve(decompressed_sizes, decompressed);
+            thread_pool->parallel_for(num_bitplanes, [&](uint32_t i){
+                uint8_t codec = codecs[starting_bitplane + i];
+                if(codec != CODEC_RAW){
+                    decompress_stream(codec, streams[i], stream_sizes[starting_bitplane + i], decompressed[i]);
+                }
+                else if(decompressed_sizes[i]){
+                    memcpy(decompressed[i], streams[i], decompressed_sizes[i]);
+                }
+            });
+            for(int i=0; i<num_bitplanes; i++){
+                if(decompressed_sizes[i]){
+                    streams[i] = decompressed[i];
+                }
+            }
+            return true;
+        }
+        void decompress_release(){}
+        void set_stream_pool(StreamPool * pool){
+            stream_pool = pool;
+        }
+        void set_scratch_buffer(ScratchBuffer * scratch){
+            scratch_buffer = scratch;
+        }
+        void print() const {
+            std::cout << "Selective level lossless compressor" << std::endl;
+        }
+    private:
+        struct Candidate {
+            Candidate(uint8_t codec, int level, double throughput) : codec(codec), level(level), throughput(throughput) {}
+            uint8_t codec;
+            int level;
+            // decode throughput in bytes of original stream per second
+            double throughput;
+        };
+
+        uint32_t compress_stream(const Candidate& candidate, uint8_t const * data, uint32_t size, uint8_t ** compressed) const {
+            switch(candidate.codec){
+                case CODEC_ZERO_RUN:
+                    return ZeroRun::compress(data, size, compressed, stream_pool);
+                case CODEC_ZSTD:
+                    return ZSTD::compress(data, size, compressed, stream_pool, candidate.level);
+                case CODEC_HUFFMAN:
+                    return Huffman::compress(data, size, compressed, stream_pool);
+                default:
+                    std::cerr << "SelectiveLevelCompressor: unknown codec " << (int) candidate.codec << std::endl;
+                    exit(-1);
+            }
+        }
+
+        static uint32_t get_decompressed_size(uint8_t codec, uint8_t const * data){
+            switch(codec){
+                case CODEC_ZERO_RUN:
+                    return ZeroRun::get_decompressed_size(data);
+                case CODEC_ZSTD:
+                    return ZSTD::get_decompressed_size(data);
+                case CODEC_HUFFMAN:
+                    return Huffman::get_decompressed_size(data);
+                default:
+                    std::cerr << "SelectiveLevelCompressor: unknown codec " << (int) codec << std::endl;
+                    exit(-1);
+            }
+        }
+
+        static uint32_t decompress_stream(uint8_t codec, uint8_t const * data, uint32_t size, uint8_t * decompressed){
+            switch(codec){
+                case CODEC_ZERO_RUN:
+                    return ZeroRun::decompress_into(data, size, decompressed);
+                case CODEC_ZSTD:
+                    return ZSTD::decompress_into(data, size, decompressed);
+                case CODEC_HUFFMAN:
+                    return Huffman::decompress_into(data, size, decompressed);
+                default:
+                    std::cerr << "SelectiveLevelCompressor: unknown codec " << (int) codec << std::endl;
+                    exit(-1);
+            }
+        }
+
+        static bool is_aligned(uint8_t const * stream){
+            return reinterpret_cast<uintptr_t>(stream) % sizeof(uint64_t) == 0;
+        }
+
+        ScratchBuffer& get_scratch_buffer(){
+            return scratch_buffer ? *scratch_buffer : default_scratch_buffer;
+        }
+
+        // compress the stream in place with the selected codec and return the codec
+        uint8_t compress_bitplane(uint8_t *& stream, uint32_t& size) const {
+            // sample: the whole stream if small, otherwise SELECTION_NUM_SAMPLES evenly spaced chunks
+            const bool whole = (size <= SELECTION_SAMPLE_SIZE);
+            std::vector<uint8_t> sample_buffer;
+            uint8_t const * sample = stream;
+            uint32_t sample_size = size;
+            if(!whole){
+                const uint32_t chunk_size = SELECTION_SAMPLE_SIZE / SELECTION_NUM_SAMPLES;
+                for(int k=0; k<SELECTION_NUM_SAMPLES; k++){
+                    uint32_t offset = (uint64_t) (size - chunk_size) * k / (SELECTION_NUM_SAMPLES - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+                    sample_buffer.insert(sample_buffer.end(), stream + offset, stream + offset + chunk_size);
+                }
+                sample = sample_buffer.data();
+                sample_size = sample_buffer.size();
+            }
+            int best = -1;
+            double best_cost = sample_size / bandwidth;
+            uint8_t * best_compressed = NULL;
+            uint32_t best_size = 0;
+            for(int c=0; c<candidates.size(); c++){
+                uint8_t * compressed = NULL;
+                uint32_t compressed_size = compress_stream(candidates[c], sample, sample_size, &compressed);
+                double cost = compressed_size / bandwidth + sample_size / candidates[c].throughput;
+                if(cost < best_cost){
+                    release_stream(stream_pool, best_compressed);
+                    best = c;
+                    best_cost = cost;
+                    best_compressed = compressed;
+                    best_size = compressed_size;
+                }
+                else{
+                    release_stream(stream_pool, compressed);
+                }
+            }
+            if(best < 0) return CODEC_RAW;
+            if(!whole){
+                release_stream(stream_pool, best_compressed);
+                best_size = compress_stream(candidates[best], stream, size, &best_compressed);
+                if(best_size >= size){
+                    release_stream(stream_pool, best_compressed);
+                    return CODEC_RAW;
+                }
+            }
+            release_stream(stream_pool, stream);
+            stream = best_compressed;
+            size = best_size;
+            return candidates[best].codec;
+        }
+
+        double bandwidth;
+        std::vector<Candidate> candidates;
+        StreamPool * stream_pool = NULL;
+        // shared by copies
+        std::shared_ptr<ThreadPool> thread_pool;
+        ScratchBuffer * scratch_buffer = NULL;
+        ScratchBuffer default_scratch_buffer;
+        std::vector<size_t> decompressed_sizes;
+        std::vector<uint8_t*> decompressed;
+    };
+}
+#endif
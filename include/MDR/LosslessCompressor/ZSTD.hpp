@@ -3,30 +3,118 @@
 
 #include "zstd.h"
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "MDR/StreamPool.hpp"
 
 namespace MDR {
     namespace ZSTD{
         #define ZSTD_LEVEL 3 //default setting of level is 3
-        // ZSTD lossless compressor
-        uint32_t compress(const uint8_t* data, uint32_t dataLength, uint8_t** compressBytes) {
-            uint32_t outSize = 0; 
-            size_t estimatedCompressedSize = 0;
-            if(dataLength < 1024) 
-                estimatedCompressedSize = 2048;
-            else
-                estimatedCompressedSize = (dataLength*1.2)/8 * 8;
-            *compressBytes = (uint8_t*)malloc(estimatedCompressedSize);
-            *reinterpret_cast<size_t*>(*compressBytes) = dataLength;
-            outSize = ZSTD_compress(*compressBytes + sizeof(size_t), estimatedCompressedSize, data, dataLength, ZSTD_LEVEL); 
+        // compressed format: [original size (size_t)][zstd frame]
+
+        // compression and decompression contexts of the calling thread, reused across calls
+        struct Contexts {
+            ZSTD_CCtx * cctx = ZSTD_createCCtx();
+            ZSTD_DCtx * dctx = ZSTD_createDCtx();
+            ~Contexts(){
+                ZSTD_freeCCtx(cctx);
+                ZSTD_freeDCtx(dctx);
+            }
+        };
+        inline Contexts& get_contexts(){
+            static thread_local Contexts contexts;
+            return contexts;
+        }
+
+        // size of the buffer needed to compress dataLength bytes
+        inline size_t compress_bound(uint32_t dataLength){
+            return sizeof(size_t) + ZSTD_compressBound(dataLength);
+        }
+
+        // original size of compressed data
+        inline uint32_t get_decompressed_size(const uint8_t* compressBytes){
+            size_t size = 0;
+            memcpy(&size, compressBytes, sizeof(size_t));
+            return size;
+        }
+
+        // record the original size; compressBytes may be unaligned
+        inline void set_decompressed_size(uint8_t* compressBytes, uint32_t dataLength){
+            size_t size = dataLength;
+            memcpy(compressBytes, &size, sizeof(size_t));
+        }
+
+        // compress into compressBytes of at least compress_bound(dataLength) bytes
+        // strategy is a ZSTD_strategy value; 0 uses the default strategy of the level
+        inline uint32_t compress_into(const uint8_t* data, uint32_t dataLength, uint8_t* compressBytes, int level=ZSTD_LEVEL, int strategy=0) {
+            ZSTD_CCtx * cctx = get_contexts().cctx;
+            ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+            ZSTD_CCtx_setParameter(cctx, ZSTD_c_strategy, strategy);
+            set_decompressed_size(compressBytes, dataLength);
+            size_t outSize = ZSTD_compress2(cctx, compressBytes + sizeof(size_t), ZSTD_compressBound(dataLength), data, dataLength);
+            if(ZSTD_isError(outSize)){
+                std::cerr << "ZSTD compression failed: " << ZSTD_getErrorName(outSize) << std::endl;
+                exit(-1);
+            }
             return outSize + sizeof(size_t);
         }
-        uint32_t decompress(const uint8_t* compressBytes, uint32_t cmpSize, uint8_t** oriData) {
-            uint32_t outSize = 0;
-            outSize = *reinterpret_cast<const size_t*>(compressBytes);
-            *oriData = (uint8_t*)malloc(outSize);
-            ZSTD_decompress(*oriData, outSize, compressBytes + sizeof(size_t), cmpSize - sizeof(size_t));
+
+        // decompress into oriData of at least get_decompressed_size(compressBytes) bytes
+        inline uint32_t decompress_into(const uint8_t* compressBytes, uint32_t cmpSize, uint8_t* oriData) {
+            uint32_t outSize = get_decompressed_size(compressBytes);
+            size_t ret = ZSTD_decompressDCtx(get_contexts().dctx, oriData, outSize, compressBytes + sizeof(size_t), cmpSize - sizeof(size_t));
+            if(ZSTD_isError(ret)){
+                std::cerr << "ZSTD decompression failed: " << ZSTD_getErrorName(ret) << std::endl;
+                exit(-1);
+            }
             return outSize;
         }
+
+        // compress with a digested dictionary, whose id is recorded in the frame
+        inline uint32_t compress_into(const uint8_t* data, uint32_t dataLength, uint8_t* compressBytes, const ZSTD_CDict * cdict) {
+            set_decompressed_size(compressBytes, dataLength);
+            size_t outSize = ZSTD_compress_usingCDict(get_contexts().cctx, compressBytes + sizeof(size_t), ZSTD_compressBound(dataLength), data, dataLength, cdict);
+            if(ZSTD_isError(outSize)){
+                std::cerr << "ZSTD compression failed: " << ZSTD_getErrorName(outSize) << std::endl;
+                exit(-1);
+            }
+            return outSize + sizeof(size_t);
+        }
+
+        // decompress with the digested dictionary the data was compressed with
+        inline uint32_t decompress_into(const uint8_t* compressBytes, uint32_t cmpSize, uint8_t* oriData, const ZSTD_DDict * ddict) {
+            uint32_t outSize = get_decompressed_size(compressBytes);
+            size_t ret = ZSTD_decompress_usingDDict(get_contexts().dctx, oriData, outSize, compressBytes + sizeof(size_t), cmpSize - sizeof(size_t), ddict);
+            if(ZSTD_isError(ret)){
+                std::cerr << "ZSTD decompression failed: " << ZSTD_getErrorName(ret) << std::endl;
+                exit(-1);
+            }
+            return outSize;
+        }
+
+        // id of the dictionary compressed data needs (0: none)
+        inline uint32_t get_dictionary_id(const uint8_t* compressBytes, uint32_t cmpSize){
+            return ZSTD_getDictID_fromFrame(compressBytes + sizeof(size_t), cmpSize - sizeof(size_t));
+        }
+
+        // ZSTD lossless compressor; the compressed buffer is allocated from pool (NULL: system allocation)
+        inline uint32_t compress(const uint8_t* data, uint32_t dataLength, uint8_t** compressBytes, StreamPool * pool=NULL, int level=ZSTD_LEVEL, int strategy=0) {
+            *compressBytes = allocate_stream(pool, compress_bound(dataLength));
+            return compress_into(data, dataLength, *compressBytes, level, strategy);
+        }
+        inline uint32_t decompress(const uint8_t* compressBytes, uint32_t cmpSize, uint8_t** oriData) {
+            *oriData = (uint8_t*)malloc(get_decompressed_size(compressBytes));
+            return decompress_into(compressBytes, cmpSize, *oriData);
+        }
+        inline uint32_t compress(const uint8_t* data, uint32_t dataLength, uint8_t** compressBytes, StreamPool * pool, const ZSTD_CDict * cdict) {
+            *compressBytes = allocate_stream(pool, compress_bound(dataLength));
+            return compress_into(data, dataLength, *compressBytes, cdict);
+        }
+        inline uint32_t decompress(const uint8_t* compressBytes, uint32_t cmpSize, uint8_t** oriData, const ZSTD_DDict * ddict) {
+            *oriData = (uint8_t*)malloc(get_decompressed_size(compressBytes));
+            return decompress_into(compressBytes, cmpSize, *oriData, ddict);
+        }
     }
 }
 #endif
@@ -0,0 +1,228 @@
+#ifndef _MDR_ZSTD_DICTIONARY_HPP
+#define _MDR_ZSTD_DICTIONARY_HPP
+
+#include "zstd.h"
+#include "zdict.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "MDR/RefactorUtils.hpp"
+
+namespace MDR {
+    #define ZSTD_DICTIONARY_CAPACITY 16384
+    // only streams up to this size are sampled and compressed with dictionaries; longer ones gain nothing from them
+    #define ZSTD_DICTIONARY_MAX_STREAM_SIZE 16384
+    // sample bytes kept per dictionary, in multiples of the capacity
+    #define ZSTD_DICTIONARY_SAMPLE_RATIO 100
+    // dictionary ids are assigned from the first unreserved id up to the last id not reserved for future use
+    #define ZSTD_DICTIONARY_BASE_ID 32768
+    #define ZSTD_DICTIONARY_MAX_ID 0x7FFFFFFF
+
+    // ZSTD dictionaries trained from bitplane streams, one per level index (per_level) or one for all levels;
+    // a set is trained once from the streams of sample refactors, saved to a shared file and loaded wherever
+    // the same variables (per level) or the same variable (single dictionary) are compressed or decompressed
+    // a set is identified by a checksum of its dictionaries, which also offsets the dictionary ids,
+    // so frames of different sets do not share dictionary ids
+    class ZSTDDictionaries {
+    public:
+        ZSTDDictionaries(bool per_level = true, size_t capacity = ZSTD_DICTIONARY_CAPACITY) : per_level(per_level), capacity(capacity) {}
+        ZSTDDictionaries(const ZSTDDictionaries&) = delete;
+        ZSTDDictionaries& operator=(const ZSTDDictionaries&) = delete;
+
+        // collect streams of level level_index as training samples
+        void add_samples(uint8_t level_index, const std::vector<uint8_t*>& streams, const std::vector<uint32_t>& stream_sizes){
+            std::lock_guard<std::mutex> lock(mutex);
+            const int index = dictionary_index(level_index);
+            if(index >= samples.size()){
+                samples.resize(index + 1);
+                sample_sizes.resize(index + 1);
+            }
+            for(int i=0; i<streams.size(); i++){
+                if(samples[index].size() >= capacity * ZSTD_DICTIONARY_SAMPLE_RATIO) break;
+                size_t size = stream_sizes[i];
+                if(!size || (size > ZSTD_DICTIONARY_MAX_STREAM_SIZE)) continue;
+                samples[index].insert(samples[index].end(), streams[i], streams[i] + size);
+                sample_sizes[index].push_back(size);
+            }
+        }
+
+        // train the dictionaries from the collected samples and drop the samples;
+        // levels with too few samples to train from are compressed without a dictionary
+        void train(){
+            std::lock_guard<std::mutex> lock(mutex);
+            clear_digested();
+            dictionaries = std::vector<std::vector<uint8_t>>(samples.size());
+            for(int i=0; i<samples.size(); i++){
+                if(sample_sizes[i].empty()) continue;
+                std::vector<uint8_t> dictionary(capacity);
+                size_t size = ZDICT_trainFromBuffer(dictionary.data(), capacity, samples[i].data(), sample_sizes[i].data(), sample_sizes[i].size());
+                if(ZDICT_isError(size)){
+                    std::cerr << "ZSTD dictionary " << i << " not trained: " << ZDICT_getErrorName(size) << std::endl;
+                    continue;
+                }
+                dictionary.resize(size);
+                dictionaries[i] = dictionary;
+            }
+            // Dictionary_ID field after the magic number, unique within the set
+            set_id = compute_set_id();
+            for(int i=0; i<dictionaries.size(); i++){
+                if(dictionaries[i].empty()) continue;
+                uint32_t id = dictionary_id(i);
+                memcpy(dictionaries[i].data() + sizeof(uint32_t), &id, sizeof(uint32_t));
+            }
+            samples.clear();
+            sample_sizes.clear();
+        }
+
+        // dictionary file format: [per_level (uint8_t)][set id (uint32_t)][number of dictionaries (uint32_t)][(size (uint32_t), dictionary)...]
+        void save(const std::string& filename) const {
+            uint32_t num_dictionaries = dictionaries.size();
+            uint32_t size = sizeof(uint8_t) + 2 * sizeof(uint32_t) + get_size(dictionaries);
+            std::vector<uint8_t> buffer(size);
+            uint8_t * buffer_pos = buffer.data();
+            *(buffer_pos ++) = (uint8_t) per_level;
+            memcpy(buffer_pos, &set_id, sizeof(uint32_t));
+            buffer_pos += sizeof(uint32_t);
+            memcpy(buffer_pos, &num_dictionaries, sizeof(uint32_t));
+            buffer_pos += sizeof(uint32_t);
+            serialize(dictionaries, buffer_pos);
+            FILE * file = fopen(filename.c_str(), "wb");
+            if(!file){
+                std::cerr << "Cannot write ZSTD dictionaries to " << filename << std::endl;
+                exit(-1);
+            }
+            fwrite(buffer.data(), 1, size, file);
+            fclose(file);
+        }
+
+        void load(const std::string& filename){
+            FILE * file = fopen(filename.c_str(), "rb");
+            if(!file){
+                std::cerr << "Cannot read ZSTD dictionaries from " << filename << std::endl;
+                exit(-1);
+            }
+            fseek(file, 0, SEEK_END);
+            uint32_t num_bytes = ftell(file);
+            rewind(file);
+            std::vector<uint8_t> buffer(num_bytes);
+            bool success = (num_bytes >= sizeof(uint8_t) + 2 * sizeof(uint32_t)) && (fread(buffer.data(), 1, num_bytes, file) == num_bytes);
+            fclose(file);
+            if(!success){
+                std::cerr << "Corrupted ZSTD dictionaries in " << filename << std::endl;
+                exit(-1);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            clear_digested();
+            uint8_t const * buffer_pos = buffer.data();
+            per_level = *(buffer_pos ++);
+            memcpy(&set_id, buffer_pos, sizeof(uint32_t));
+            buffer_pos += sizeof(uint32_t);
+            uint32_t num_dictionaries = 0;
+            memcpy(&num_dictionaries, buffer_pos, sizeof(uint32_t));
+            buffer_pos += sizeof(uint32_t);
+            deserialize(buffer_pos, num_dictionaries, dictionaries);
+            // the dictionaries must be the set they were saved as
+            success = (compute_set_id() == set_id);
+            for(int i=0; success && (i<dictionaries.size()); i++){
+                if(dictionaries[i].size()) success = (ZDICT_getDictID(dictionaries[i].data(), dictionaries[i].size()) == dictionary_id(i));
+            }
+            if(!success){
+                std::cerr << "ZSTD dictionaries in " << filename << " do not match their set id " << set_id << std::endl;
+                exit(-1);
+            }
+        }
+
+        // id of the set, recorded with the levels compressed with it (0: not trained)
+        uint32_t get_set_id() const {
+            return set_id;
+        }
+
+        bool trained() const {
+            return dictionaries.size();
+        }
+
+        // total size of the dictionaries, stored once for all data compressed with them
+        size_t get_dictionary_size() const {
+            size_t size = 0;
+            for(const auto& dictionary:dictionaries) size += dictionary.size();
+            return size;
+        }
+
+        // digested dictionary for compressing level level_index at compression level (NULL: no dictionary)
+        const ZSTD_CDict * get_cdict(uint8_t level_index, int level){
+            std::lock_guard<std::mutex> lock(mutex);
+            const int index = dictionary_index(level_index);
+            if((index >= dictionaries.size()) || dictionaries[index].empty()) return NULL;
+            auto key = std::make_pair(index, level);
+            auto it = cdicts.find(key);
+            if(it != cdicts.end()) return it->second;
+            ZSTD_CDict * cdict = ZSTD_createCDict(dictionaries[index].data(), dictionaries[index].size(), level);
+            cdicts[key] = cdict;
+            return cdict;
+        }
+
+        // digested dictionary of the dictionary id recorded in a frame (NULL: not in the set)
+        const ZSTD_DDict * get_ddict(uint32_t id){
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = ddicts.find(id);
+            if(it != ddicts.end()) return it->second;
+            for(const auto& dictionary:dictionaries){
+                if(dictionary.size() && (ZDICT_getDictID(dictionary.data(), dictionary.size()) == id)){
+                    ZSTD_DDict * ddict = ZSTD_createDDict(dictionary.data(), dictionary.size());
+                    ddicts[id] = ddict;
+                    return ddict;
+                }
+            }
+            return NULL;
+        }
+
+        ~ZSTDDictionaries(){
+            clear_digested();
+        }
+    private:
+        int dictionary_index(uint8_t level_index) const {
+            return per_level ? level_index : 0;
+        }
+
+        uint32_t dictionary_id(int index) const {
+            return ZSTD_DICTIONARY_BASE_ID + (uint32_t) (((uint64_t) set_id + index) % (ZSTD_DICTIONARY_MAX_ID - ZSTD_DICTIONARY_BASE_ID + 1));
+        }
+
+        // FNV-1a checksum of the dictionaries without their id fields, never 0
+        uint32_t compute_set_id() const {
+            uint32_t checksum = 2166136261u;
+            for(const auto& dictionary:dictionaries){
+                for(size_t i=0; i<dictionary.size(); i++){
+                    if((i >= sizeof(uint32_t)) && (i < 2 * sizeof(uint32_t))) continue;
+                    checksum = (checksum ^ dictionary[i]) * 16777619u;
+                }
+                checksum = (checksum ^ (uint32_t) dictionary.size()) * 16777619u;
+            }
+            return checksum ? checksum : 1;
+        }
+
+        void clear_digested(){
+            for(auto& it:cdicts) ZSTD_freeCDict(it.second);
+            for(auto& it:ddicts) ZSTD_freeDDict(it.second);
+            cdicts.clear();
+            ddicts.clear();
+        }
+
+        bool per_level;
+        size_t capacity;
+        uint32_t set_id = 0;
+        std::vector<std::vector<uint8_t>> dictionaries;
+        std::vector<std::vector<uint8_t>> samples;
+        std::vector<std::vector<size_t>> sample_sizes;
+        std::map<std::pair<int, int>, ZSTD_CDict *> cdicts;
+        std::map<uint32_t, ZSTD_DDict *> ddicts;
+        std::mutex mutex;
+    };
+}
+#endif
@@ -0,0 +1,109 @@
+#ifndef _MDR_ZERO_RUN_HPP
+#define _MDR_ZERO_RUN_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "MDR/StreamPool.hpp"
+
+namespace MDR {
+    namespace ZeroRun{
+        // run-length coding of zero 64-bit words, for sparse bitplanes
+        // compressed format: [original size (size_t)][(zero words, literal words, literals)...][trailing bytes]
+        // word counts are LEB128 varints; the trailing dataLength % 8 bytes are stored as they are
+
+        inline uint8_t * write_varint(uint32_t value, uint8_t * out){
+            while(value >= 0x80){
+                *(out ++) = (value & 0x7f) | 0x80;
+                value >>= 7;
+            }
+            *(out ++) = value;
+            return out;
+        }
+        inline uint8_t const * read_varint(uint8_t const * in, uint32_t& value){
+            value = 0;
+            for(int shift=0; ; shift+=7){
+                uint8_t byte = *(in ++);
+                value |= (uint32_t) (byte & 0x7f) << shift;
+                if(!(byte & 0x80)) return in;
+            }
+        }
+
+        // size of the buffer needed to compress dataLength bytes
+        inline size_t compress_bound(uint32_t dataLength){
+            // every run pair holds at least one literal word, except the last
+            return sizeof(size_t) + dataLength + (dataLength / sizeof(uint64_t) + 1) * 10;
+        }
+
+        // original size of compressed data
+        inline uint32_t get_decompressed_size(const uint8_t* compressBytes){
+            size_t size = 0;
+            memcpy(&size, compressBytes, sizeof(size_t));
+            return size;
+        }
+
+        // compress into compressBytes of at least compress_bound(dataLength) bytes
+        inline uint32_t compress_into(const uint8_t* data, uint32_t dataLength, uint8_t* compressBytes) {
+            const size_t size = dataLength;
+            memcpy(compressBytes, &size, sizeof(size_t));
+            uint8_t * out = compressBytes + sizeof(size_t);
+            const uint32_t num_words = dataLength / sizeof(uint64_t);
+            uint32_t i = 0;
+            while(i < num_words){
+                uint32_t zero_begin = i;
+                uint64_t word;
+                while(i < num_words){
+                    memcpy(&word, data + i * sizeof(uint64_t), sizeof(uint64_t));
+                    if(word) break;
+                    i ++;
+                }
+                uint32_t literal_begin = i;
+                while(i < num_words){
+                    memcpy(&word, data + i * sizeof(uint64_t), sizeof(uint64_t));
+                    if(!word) break;
+                    i ++;
+                }
+                out = write_varint(literal_begin - zero_begin, out);
+                out = write_varint(i - literal_begin, out);
+                memcpy(out, data + literal_begin * sizeof(uint64_t), (i - literal_begin) * sizeof(uint64_t));
+                out += (i - literal_begin) * sizeof(uint64_t);
+            }
+            const uint32_t num_trailing = dataLength - num_words * sizeof(uint64_t);
+            memcpy(out, data + num_words * sizeof(uint64_t), num_trailing);
+            out += num_trailing;
+            return out - compressBytes;
+        }
+
+        // decompress into oriData of at least get_decompressed_size(compressBytes) bytes
+        inline uint32_t decompress_into(const uint8_t* compressBytes, uint32_t cmpSize, uint8_t* oriData) {
+            const uint32_t outSize = get_decompressed_size(compressBytes);
+            uint8_t const * in = compressBytes + sizeof(size_t);
+            const uint32_t num_words = outSize / sizeof(uint64_t);
+            uint32_t i = 0;
+            while(i < num_words){
+                uint32_t num_zeros = 0;
+                uint32_t num_literals = 0;
+                in = read_varint(in, num_zeros);
+                in = read_varint(in, num_literals);
+                memset(oriData + i * sizeof(uint64_t), 0, num_zeros * sizeof(uint64_t));
+                i += num_zeros;
+                memcpy(oriData + i * sizeof(uint64_t), in, num_literals * sizeof(uint64_t));
+                in += num_literals * sizeof(uint64_t);
+                i += num_literals;
+            }
+            memcpy(oriData + num_words * sizeof(uint64_t), in, outSize - num_words * sizeof(uint64_t));
+            return outSize;
+        }
+
+        // zero-run lossless compressor; the compressed buffer is allocated from pool (NULL: system allocation)
+        inline uint32_t compress(const uint8_t* data, uint32_t dataLength, uint8_t** compressBytes, StreamPool * pool=NULL) {
+            *compressBytes = allocate_stream(pool, compress_bound(dataLength));
+            return compress_into(data, dataLength, *compressBytes);
+        }
+        inline uint32_t decompress(const uint8_t* compressBytes, uint32_t cmpSize, uint8_t** oriData) {
+            *oriData = (uint8_t*)malloc(get_decompressed_size(compressBytes));
+            return decompress_into(compressBytes, cmpSize, *oriData);
+        }
+    }
+}
+#endif
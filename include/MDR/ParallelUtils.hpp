@@ -0,0 +1,134 @@
+#ifndef _MDR_PARALLEL_UTILS_HPP
+#define _MDR_PARALLEL_UTILS_HPP
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+
+namespace MDR {
+
+    // MDR parallel utility functions
+
+    // run f(i) for every i in [0, num_tasks) using up to num_threads threads
+    /*
+        @params num_tasks: number of independent tasks
+        @params num_threads: maximum number of threads; tasks run inline if <= 1
+        @params f: task body, called as f(task_id)
+    */
+    template <class Func>
+    void parallel_for(uint32_t num_tasks, int num_threads, Func f){
+        num_threads = std::min<int64_t>(num_threads, num_tasks);
+        if(num_threads <= 1){
+            for(uint32_t i=0; i<num_tasks; i++){
+                f(i);
+            }
+            return;
+        }
+        std::atomic<uint32_t> next_task(0);
+        std::vector<std::thread> threads;
+        for(int t=0; t<num_threads; t++){
+            threads.push_back(std::thread([&](){
+                for(uint32_t i=next_task++; i<num_tasks; i=next_task++){
+                    f(i);
+                }
+            }));
+        }
+        for(auto& thread:threads){
+            thread.join();
+        }
+    }
+
+    // persistent worker threads for parallel_for calls that are too frequent to spawn threads each time;
+    // workers keep their thread-local state (e.g. compression contexts) between calls
+    class ThreadPool {
+    public:
+        // num_threads threads including the calling thread
+        ThreadPool(int num_threads){
+            for(int t=1; t<num_threads; t++){
+                workers.push_back(std::thread([this](){ work(); }));
+            }
+        }
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+        ~ThreadPool(){
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            start_cv.notify_all();
+            for(auto& worker:workers){
+                worker.join();
+            }
+        }
+
+        int get_num_threads() const {
+            return workers.size() + 1;
+        }
+
+        // run f(i) for every i in [0, num_tasks) on the workers and the calling thread;
+        // calls from different threads are serialized, f must not call parallel_for of the same pool
+        template <class Func>
+        void parallel_for(uint32_t num_tasks, Func f){
+            if(workers.empty() || (num_tasks <= 1)){
+                for(uint32_t i=0; i<num_tasks; i++){
+                    f(i);
+                }
+                return;
+            }
+            std::lock_guard<std::mutex> job_lock(job_mutex);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                task = [&f](uint32_t i){ f(i); };
+                job_size = num_tasks;
+                next_task = 0;
+                num_active = workers.size();
+                generation ++;
+            }
+            start_cv.notify_all();
+            run_tasks();
+            std::unique_lock<std::mutex> lock(mutex);
+            done_cv.wait(lock, [this](){ return num_active == 0; });
+            task = nullptr;
+        }
+
+    private:
+        void run_tasks(){
+            for(uint32_t i=next_task++; i<job_size; i=next_task++){
+                task(i);
+            }
+        }
+
+        void work(){
+            uint64_t seen_generation = 0;
+            while(true){
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    start_cv.wait(lock, [&](){ return stop || (generation != seen_generation); });
+                    if(stop) return;
+                    seen_generation = generation;
+                }
+                run_tasks();
+                std::lock_guard<std::mutex> lock(mutex);
+                if(--num_active == 0) done_cv.notify_one();
+            }
+        }
+
+        std::vector<std::thread> workers;
+        std::mutex job_mutex;
+        std::mutex mutex;
+        std::condition_variable start_cv;
+        std::condition_variable done_cv;
+        std::function<void(uint32_t)> task;
+        uint32_t job_size = 0;
+        std::atomic<uint32_t> next_task{0};
+        uint32_t num_active = 0;
+        uint64_t generation = 0;
+        bool stop = false;
+    };
+
+}
+#endif
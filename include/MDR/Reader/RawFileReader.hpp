@@ -0,0 +1,85 @@
+#ifndef _MDR_RAW_FILE_READER_HPP
+#define _MDR_RAW_FILE_READER_HPP
+
+#include "ReaderInterface.hpp"
+#include <string>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace MDR {
+    // reader of a raw binary file holding the field in row-major order
+    // boxes are read row by row with pread, so concurrent reads share one descriptor
+    template<class T>
+    class RawFileReader : public concepts::ReaderInterface<T> {
+    public:
+        RawFileReader(const std::string& filename, const std::vector<uint32_t>& dims) : filename(filename), dims(dims) {
+            fd = open(filename.c_str(), O_RDONLY);
+            if(fd < 0){
+                std::cerr << "Failed to open raw file: " << filename << std::endl;
+                exit(-1);
+            }
+            // the file holds exactly the field
+            size_t size = sizeof(T);
+            for(auto n:dims){
+                size *= n;
+            }
+            struct stat file_stat;
+            if(fstat(fd, &file_stat) || (file_stat.st_size != (off_t) size)){
+                std::cerr << "Size of raw file " << filename << " does not match the dimensions: " << size << " bytes expected" << std::endl;
+                close(fd);
+                exit(-1);
+            }
+        }
+        RawFileReader(const RawFileReader&) = delete;
+        RawFileReader& operator=(const RawFileReader&) = delete;
+
+        std::vector<uint32_t> get_dimensions() const {
+            return dims;
+        }
+
+        bool read(const std::vector<uint32_t>& begin, const std::vector<uint32_t>& box_dims, T * data) const {
+            const int num_dims = dims.size();
+            std::vector<size_t> strides(num_dims);
+            size_t stride = 1;
+            for(int i=num_dims-1; i>=0; i--){
+                strides[i] = stride;
+                stride *= dims[i];
+            }
+            const size_t row_bytes = box_dims[num_dims - 1] * sizeof(T);
+            std::vector<uint32_t> index(num_dims, 0);
+            while(true){
+                size_t offset = 0;
+                for(int i=0; i<num_dims; i++){
+                    offset += (begin[i] + index[i]) * strides[i];
+                }
+                if(pread(fd, data, row_bytes, offset * sizeof(T)) != (ssize_t) row_bytes){
+                    std::cerr << "Failed to read from raw file: " << filename << std::endl;
+                    return false;
+                }
+                data += box_dims[num_dims - 1];
+                int d = num_dims - 2;
+                while((d >= 0) && (++index[d] == box_dims[d])){
+                    index[d] = 0;
+                    d --;
+                }
+                if(d < 0) break;
+            }
+            return true;
+        }
+
+        ~RawFileReader(){
+            close(fd);
+        }
+
+        void print() const {
+            std::cout << "Raw file reader." << std::endl;
+        }
+    private:
+        std::string filename;
+        std::vector<uint32_t> dims;
+        int fd = -1;
+    };
+}
+#endif
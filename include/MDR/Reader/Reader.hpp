@@ -0,0 +1,6 @@
+#ifndef _MDR_READER_HPP
+#define _MDR_READER_HPP
+
+#include "RawFileReader.hpp"
+
+#endif
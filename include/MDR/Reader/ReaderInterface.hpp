@@ -0,0 +1,26 @@
+#ifndef _MDR_READER_INTERFACE_HPP
+#define _MDR_READER_INTERFACE_HPP
+
+#include <vector>
+#include <cstdint>
+
+namespace MDR {
+    namespace concepts {
+
+        // source of the input field for out-of-core refactoring: boxes of the field are read on demand
+        template<class T>
+        class ReaderInterface {
+        public:
+
+            virtual ~ReaderInterface() = default;
+
+            virtual std::vector<uint32_t> get_dimensions() const = 0;
+
+            // read the box of dims at begin into the compact array data; may be called concurrently
+            virtual bool read(const std::vector<uint32_t>& begin, const std::vector<uint32_t>& dims, T * data) const = 0;
+
+            virtual void print() const = 0;
+        };
+    }
+}
+#endif
@@ -11,6 +11,7 @@
 #include "MDR/SizeInterpreter/SizeInterpreter.hpp"
 #include "MDR/LosslessCompressor/LevelCompressor.hpp"
 #include "MDR/RefactorUtils.hpp"
+#include "RegionOfInterest.hpp"
 
 namespace MDR {
     // a decomposition-based scientific data reconstructor: inverse operator of composed refactor
@@ -24,68 +25,15 @@ namespace MDR {
             return reconstruct(tolerance, -1);
         }
         // reconstruct data from encoded streams
+        // with max_level, only levels up to max_level are retrieved and the result is the compact grid
+        // of that level (get_current_dimensions()); later calls refine it or upgrade it to finer levels
         T * reconstruct(double tolerance, int max_level=-1){
-            // Timer timer;
-            // timer.start();
-            std::vector<std::vector<double>> level_abs_errors;
+            if(!set_mode(MODE_FIELD)) return NULL;
             uint8_t target_level = level_error_bounds.size() - 1;
-            std::vector<std::vector<double>>& level_errors = level_squared_errors;
-            if(std::is_base_of<MaxErrorEstimator<T>, ErrorEstimator>::value){
-                // std::cout << "ErrorEstimator is base of MaxErrorEstimator, computing absolute error" << std::endl;
-                MaxErrorCollector<T> collector = MaxErrorCollector<T>();
-                for(int i=0; i<=target_level; i++){
-                    auto collected_error = collector.collect_level_error(NULL, 0, level_sizes[i].size(), level_error_bounds[i]);
-                    level_abs_errors.push_back(collected_error);
-                }
-                level_errors = level_abs_errors;
-            }
-            else if(std::is_base_of<SquaredErrorEstimator<T>, ErrorEstimator>::value){
-                std::cout << "ErrorEstimator is base of SquaredErrorEstimator, using level squared error directly" << std::endl;
-            }
-            else{
-                std::cerr << "Customized error estimator not supported yet" << std::endl;
-                exit(-1);
-            }
-            // timer.end();
-            // timer.print("Preprocessing");    
-
-            // timer.start();
-            auto prev_level_num_bitplanes(level_num_bitplanes);
-            if(max_level == -1 || (max_level >= level_num_bitplanes.size())){
-                auto retrieve_sizes = interpreter.interpret_retrieve_size(level_sizes, level_errors, tolerance, level_num_bitplanes);
-                level_components = retriever.retrieve_level_components(level_sizes, retrieve_sizes, prev_level_num_bitplanes, level_num_bitplanes);                
-            }
-            else{
-                std::vector<std::vector<uint32_t>> tmp_level_sizes;
-                std::vector<std::vector<double>> tmp_level_errors;
-                std::vector<uint8_t> tmp_level_num_bitplanes;
-                for(int i=0; i<=max_level; i++){
-                    tmp_level_sizes.push_back(level_sizes[i]);
-                    tmp_level_errors.push_back(level_errors[i]);
-                    tmp_level_num_bitplanes.push_back(level_num_bitplanes[i]);
-                }
-                auto retrieve_sizes = interpreter.interpret_retrieve_size(tmp_level_sizes, tmp_level_errors, tolerance, tmp_level_num_bitplanes);
-                level_components = retriever.retrieve_level_components(tmp_level_sizes, retrieve_sizes, prev_level_num_bitplanes, tmp_level_num_bitplanes);                
-                // add level_num_bitplanes
-                for(int i=0; i<=max_level; i++){
-                    level_num_bitplanes[i] = tmp_level_num_bitplanes[i];
-                }
-            }
-
-            // check whether to reconstruct to full resolution
-            int skipped_level = 0;
-            for(int i=0; i<=target_level; i++){
-                if(level_num_bitplanes[target_level - i] != 0){
-                    skipped_level = i;
-                    break;
-                }
-            }
-            // TODO: uncomment skip level to reconstruct low resolution data
-            // target_level -= skipped_level;
-            // timer.end();
-            // timer.print("Interpret and retrieval");
-            int reconstruct_level = target_level - skipped_level;
-            // std::cout << "skipped_level = " << skipped_level << ", target_level = " << +target_level << std::endl;
+            auto prev_level_num_bitplanes = retrieve(tolerance, max_level);
+            // resolution of the result: max_level or full, and never lower than the current one
+            int reconstruct_level = ((max_level == -1) || (max_level > target_level)) ? target_level : max_level;
+            reconstruct_level = std::max(reconstruct_level, current_level);
 
             bool success = reconstruct(reconstruct_level, prev_level_num_bitplanes);
             retriever.release();
@@ -105,7 +53,7 @@ namespace MDR {
         // reconstruct progressively based on available data
         T * progressive_reconstruct(double tolerance, int max_level=-1){
             // std::vector<T> cur_data(data);
-            reconstruct(tolerance, max_level);
+            if(!reconstruct(tolerance, max_level)) return NULL;
             // TODO: add resolution changes
             // if(cur_data.size() == data.size()){
             //     for(int i=0; i<data.size(); i++){
@@ -120,12 +68,52 @@ namespace MDR {
             // }
             return data.data();
         }
+        // reconstruct the box [roi_begin, roi_end) of the full grid progressively, returning the compact box
+        // only the coefficients whose basis function support touches the box are decoded and recomposed,
+        // so the decomposer must use a hierarchical (interpolating) basis
+        // a reconstructor serves either one box or the full field, whichever it reconstructs first: the other returns NULL
+        T * reconstruct_roi(double tolerance, const std::vector<uint32_t>& roi_begin, const std::vector<uint32_t>& roi_end){
+            if(roi.empty()){
+                if((roi_begin.size() != dimensions.size()) || (roi_end.size() != dimensions.size())){
+                    std::cerr << "Region of interest does not match the dimensions" << std::endl;
+                    return NULL;
+                }
+                for(int i=0; i<dimensions.size(); i++){
+                    if((roi_begin[i] >= roi_end[i]) || (roi_end[i] > dimensions[i])){
+                        std::cerr << "Region of interest is empty or out of the grid" << std::endl;
+                        return NULL;
+                    }
+                }
+                if(!set_mode(MODE_ROI)) return NULL;
+                roi = RegionOfInterest(compute_level_dims(dimensions, level_num.size() - 1), roi_begin, roi_end);
+                roi_coefficients = std::vector<T>(roi.get_sub_size(), 0);
+            }
+            else if(!roi.is_box(roi_begin, roi_end)){
+                std::cerr << "Region of interest cannot change during progressive reconstruction" << std::endl;
+                return NULL;
+            }
+            auto prev_level_num_bitplanes = retrieve(tolerance, -1);
+            bool success = decode_roi(prev_level_num_bitplanes);
+            retriever.release();
+            if(!success){
+                std::cerr << "Reconstruct unsuccessful, return NULL pointer" << std::endl;
+                return NULL;
+            }
+            std::vector<T> sub_data(roi_coefficients);
+            decomposer.recompose(sub_data.data(), roi.get_sub_dims(), level_num.size() - 1);
+            roi_data.resize(roi.size());
+            roi.extract(sub_data.data(), roi_data.data());
+            return roi_data.data();
+        }
+
         // TODO: do not overwrite
         T * recompose_to_full(){
-            clear_data(data.data(), current_dimensions, dimensions, dimensions);
             int target_level = level_num.size() - 1;
+            if(current_level < target_level) resize_data(dimensions);
             std::cout << "recompose to full for " << target_level - current_level << " levels!\n"; 
-            std::cout << "dimensions: " << dimensions[0] << " " << dimensions[1] << " " << dimensions[2] << "\n";
+            std::cout << "dimensions:";
+            for(auto d:dimensions) std::cout << " " << d;
+            std::cout << "\n";
             decomposer.recompose(data.data(), dimensions, target_level - current_level, this->strides); 
             return data.data();
         }
@@ -133,6 +121,8 @@ namespace MDR {
         void load_metadata(){
             uint8_t * metadata = retriever.load_metadata();
             uint8_t const * metadata_pos = metadata;
+            int version = deserialize_version(metadata_pos);
+            if(version < 0) exit(-1);
             uint8_t num_dims = *(metadata_pos ++);
             deserialize(metadata_pos, num_dims, dimensions);
             uint8_t num_levels = *(metadata_pos ++);
@@ -142,14 +132,16 @@ namespace MDR {
             deserialize(metadata_pos, num_levels, stopping_indices);
             deserialize(metadata_pos, num_levels, level_num);
             negabinary = *(metadata_pos ++);
+            if(version >= 1) deserialize(metadata_pos, num_levels, level_range_offsets);
+            else level_range_offsets = std::vector<std::vector<uint32_t>>(num_levels);
+            if(version >= 1) deserialize(metadata_pos, num_levels, level_codecs);
+            else level_codecs = std::vector<std::vector<uint8_t>>(num_levels);
+            if(version >= 2) deserialize(metadata_pos, num_levels, level_dictionary_sets);
+            else level_dictionary_sets = std::vector<uint32_t>(num_levels, 0);
             level_num_bitplanes = std::vector<uint8_t>(num_levels, 0);
-            strides = std::vector<uint32_t>(dimensions.size());
-            uint32_t stride = 1;
-            for(int i=dimensions.size()-1; i>=0; i--){
-                strides[i] = stride;
-                stride *= dimensions[i];
-            }
-            data = std::vector<T>(stride, 0);
+            // data is allocated at the reconstructed resolution
+            strides.clear();
+            data.clear();
             free(metadata);
         }
 
@@ -169,6 +161,10 @@ namespace MDR {
             return retriever.get_retrieved_size();
         }
 
+        const ScratchBuffer& get_scratch_buffer() const {
+            return scratch_buffer;
+        }
+
         std::vector<uint32_t> get_offsets(){
             return retriever.get_offsets();
         }
@@ -184,79 +180,141 @@ namespace MDR {
             std::cout << "Retriever: "; retriever.print();
         }
     private:
+        // reconstructions of the field and of a region of interest both progress level_num_bitplanes,
+        // so the first one used is the only one allowed
+        enum ReconstructMode { MODE_NONE, MODE_FIELD, MODE_ROI };
+
+        // record the mode on first use; false if the reconstructor is in the other mode
+        bool set_mode(ReconstructMode new_mode){
+            if(mode == MODE_NONE) mode = new_mode;
+            if(mode != new_mode){
+                if(new_mode == MODE_ROI) std::cerr << "Region of interest cannot be reconstructed after full reconstructions" << std::endl;
+                else std::cerr << "Full reconstruction cannot follow reconstructions of a region of interest" << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        // retrieve the bitplanes of levels up to max_level (-1: all) that the tolerance needs, returning the
+        // previous numbers of bitplanes
+        std::vector<uint8_t> retrieve(double tolerance, int max_level){
+            // Timer timer;
+            // timer.start();
+            std::vector<std::vector<double>> level_abs_errors;
+            uint8_t target_level = level_error_bounds.size() - 1;
+            std::vector<std::vector<double>>& level_errors = level_squared_errors;
+            if(std::is_base_of<MaxErrorEstimator<T>, ErrorEstimator>::value){
+                // std::cout << "ErrorEstimator is base of MaxErrorEstimator, computing absolute error" << std::endl;
+                MaxErrorCollector<T> collector = MaxErrorCollector<T>();
+                for(int i=0; i<=target_level; i++){
+                    auto collected_error = collector.collect_level_error(NULL, 0, level_sizes[i].size(), level_error_bounds[i]);
+                    level_abs_errors.push_back(collected_error);
+                }
+                level_errors = level_abs_errors;
+            }
+            else if(std::is_base_of<SquaredErrorEstimator<T>, ErrorEstimator>::value){
+                std::cout << "ErrorEstimator is base of SquaredErrorEstimator, using level squared error directly" << std::endl;
+            }
+            else{
+                std::cerr << "Customized error estimator not supported yet" << std::endl;
+                exit(-1);
+            }
+            // timer.end();
+            // timer.print("Preprocessing");    
+
+            // timer.start();
+            auto prev_level_num_bitplanes(level_num_bitplanes);
+            if(max_level == -1 || (max_level >= level_num_bitplanes.size())){
+                auto retrieve_sizes = interpreter.interpret_retrieve_size(level_sizes, level_errors, tolerance, level_num_bitplanes);
+                level_components = retriever.retrieve_level_components(level_sizes, retrieve_sizes, prev_level_num_bitplanes, level_num_bitplanes);                
+            }
+            else{
+                std::vector<std::vector<uint32_t>> tmp_level_sizes;
+                std::vector<std::vector<double>> tmp_level_errors;
+                std::vector<uint8_t> tmp_level_num_bitplanes;
+                for(int i=0; i<=max_level; i++){
+                    tmp_level_sizes.push_back(level_sizes[i]);
+                    tmp_level_errors.push_back(level_errors[i]);
+                    tmp_level_num_bitplanes.push_back(level_num_bitplanes[i]);
+                }
+                auto retrieve_sizes = interpreter.interpret_retrieve_size(tmp_level_sizes, tmp_level_errors, tolerance, tmp_level_num_bitplanes);
+                level_components = retriever.retrieve_level_components(tmp_level_sizes, retrieve_sizes, prev_level_num_bitplanes, tmp_level_num_bitplanes);                
+                // add level_num_bitplanes
+                for(int i=0; i<=max_level; i++){
+                    level_num_bitplanes[i] = tmp_level_num_bitplanes[i];
+                }
+            }
+            // timer.end();
+            // timer.print("Interpret and retrieval");
+            return prev_level_num_bitplanes;
+        }
+
         bool reconstruct(uint8_t target_level, const std::vector<uint8_t>& prev_level_num_bitplanes, bool progressive=true){
             auto num_levels = level_num.size();
             auto level_dims = compute_level_dims(dimensions, num_levels - 1);
             auto reconstruct_dimensions = level_dims[target_level];
+            if(target_level > current_level) resize_data(reconstruct_dimensions);
+            // levels are decompressed into the scratch buffer, reused across levels and reconstructions
+            compressor.set_scratch_buffer(&scratch_buffer);
             // std::cout << "target_level = " << +target_level << ", dims = " << reconstruct_dimensions[0] << " " << reconstruct_dimensions[1] << " " << reconstruct_dimensions[2] << std::endl;
-            // update with stride
-            std::vector<T> cur_data(data);
-            memset(data.data(), 0, data.size() * sizeof(T));
             // std::cout << "Test 1" << std::endl;
             // std::cout << "current_level = " << current_level << std::endl;
             auto level_elements = compute_level_elements(level_dims, target_level);
             std::vector<uint32_t> dims_dummy(reconstruct_dimensions.size(), 0);
             // std::cout << "Test 2" << std::endl;
+            // levels up to current_level are already in data: the deltas of their new bitplanes are decoded into
+            // the delta grid, recomposed (the transform is linear) and accumulated into data in place
+            bool updated = false;
             for(int i=0; i<=current_level; i++){
-                // std::cout << "i=" << i << " ";
-                if(level_num_bitplanes[i] - prev_level_num_bitplanes[i] > 0){
-                    // std::cout << "Test 2b" << " ";
-                    compressor.decompress_level(level_components[i], level_sizes[i], prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], stopping_indices[i]);
-                    int level_exp = 0;
-                    if(negabinary) frexp(level_error_bounds[i] / 4, &level_exp);
-                    else frexp(level_error_bounds[i], &level_exp);
-                    // std::cout << "Test 2c" << " ";
-                    auto level_decoded_data = encoder.progressive_decode(level_components[i], level_elements[i], level_exp, prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], i);
-                    compressor.decompress_release();
-                    // std::cout << "Test 2d" << std::endl;
-                    const std::vector<uint32_t>& prev_dims = (i == 0) ? dims_dummy : level_dims[i - 1];
-                    interleaver.reposition(level_decoded_data, reconstruct_dimensions, level_dims[i], prev_dims, data.data(), this->strides);
-                    free(level_decoded_data);                    
-                }
+                if(level_num_bitplanes[i] - prev_level_num_bitplanes[i] > 0) updated = true;
             }
-            // std::cout << "Test 3" << std::endl;
-            // decompose data to current level
-            if(current_level >= 0){
-                if(current_level) decomposer.recompose(data.data(), current_dimensions, current_level, this->strides);
-                // std::cout << "update data\n";
-                // update data with strides
-                if(current_dimensions.size() == 1){
-                    for(int i=0; i<current_dimensions[0]; i++){
-                        data[i] += cur_data[i];
+            if(updated){
+                // allocated once, every element of the current box is overwritten below
+                if(delta.size() != data.size()) delta = std::vector<T>(data.size());
+                for(int i=0; i<=current_level; i++){
+                    const std::vector<uint32_t>& prev_dims = (i == 0) ? dims_dummy : level_dims[i - 1];
+                    if(level_num_bitplanes[i] - prev_level_num_bitplanes[i] > 0){
+                        if(!compressor.decompress_level(level_components[i], level_sizes[i], prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], stopping_indices[i], level_codecs[i], level_dictionary_sets[i], i)) return false;
+                        int level_exp = 0;
+                        if(negabinary) frexp(level_error_bounds[i] / 4, &level_exp);
+                        else frexp(level_error_bounds[i], &level_exp);
+                        auto level_view = interleaver.level_view(reconstruct_dimensions, level_dims[i], prev_dims, delta.data(), this->strides);
+                        encoder.progressive_decode(level_components[i], level_elements[i], level_exp, prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], i, level_range_offsets[i], level_view);
+                        compressor.decompress_release();
+                    }
+                    else{
+                        // no new bitplanes: zero delta
+                        clear_data(delta.data(), prev_dims, level_dims[i], reconstruct_dimensions);
                     }
                 }
-                else if(current_dimensions.size() == 3){
-                    for(int i=0; i<current_dimensions[0]; i++){
-                        for(int j=0; j<current_dimensions[1]; j++){
-                            for(int k=0; k<current_dimensions[2]; k++){
-                                data[i*this->strides[0] + j*this->strides[1] + k] += cur_data[i*this->strides[0] + j*this->strides[1] + k];
-                            }
+                if(current_level) decomposer.recompose(delta.data(), current_dimensions, current_level, this->strides);
+                LevelShape shape(reconstruct_dimensions, current_dimensions, dims_dummy, this->strides);
+                for(uint32_t i=0; i<shape.fine[0]; i++){
+                    shape.for_each_span(i, [&](size_t offset, uint32_t length){
+                        T * dst = data.data() + offset;
+                        T const * src = delta.data() + offset;
+                        for(uint32_t t=0; t<length; t++){
+                            dst[t] += src[t];
                         }
-                    }                    
-                }
-                else{
-                    std::cout << "dimension higher than 4 is not supported in update data\n";
-                    exit(-1);
+                    });
                 }
             }
-            // std::cout << "Test 4" << std::endl;
-            // std::cout << "decompose to target_level\n";
             // decompose data to target level
             for(int i=current_level+1; i<=target_level; i++){
                 // std::cout << "i=" << i << " ";
-                compressor.decompress_level(level_components[i], level_sizes[i], prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], stopping_indices[i]);
+                if(!compressor.decompress_level(level_components[i], level_sizes[i], prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], stopping_indices[i], level_codecs[i], level_dictionary_sets[i], i)) return false;
                 int level_exp = 0;
                 if(negabinary) frexp(level_error_bounds[i] / 4, &level_exp);
                 else frexp(level_error_bounds[i], &level_exp);
-                auto level_decoded_data = encoder.progressive_decode(level_components[i], level_elements[i], level_exp, prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], i);
-                compressor.decompress_release();
+                // decode straight into the output grid
                 const std::vector<uint32_t>& prev_dims = (i == 0) ? dims_dummy : level_dims[i - 1];
-                interleaver.reposition(level_decoded_data, reconstruct_dimensions, level_dims[i], prev_dims, data.data(), this->strides);
-                free(level_decoded_data);                    
+                auto level_view = interleaver.level_view(reconstruct_dimensions, level_dims[i], prev_dims, data.data(), this->strides);
+                encoder.progressive_decode(level_components[i], level_elements[i], level_exp, prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], i, level_range_offsets[i], level_view);
+                compressor.decompress_release();
             }
             // std::cout << "Test 5" << std::endl;
             if(current_level >= 0){
-                decomposer.recompose(data.data(), reconstruct_dimensions, target_level - current_level, this->strides);                
+                if(target_level > current_level) decomposer.recompose(data.data(), reconstruct_dimensions, target_level - current_level, this->strides);                
             }
             else{
                 decomposer.recompose(data.data(), reconstruct_dimensions, target_level, this->strides);
@@ -265,18 +323,106 @@ namespace MDR {
             return true;
         }
 
-        void clear_data(T * dst, const std::vector<uint32_t>& coarse_dims, const std::vector<uint32_t>& fine_dims, const std::vector<uint32_t>& dims){
-            for(int i=0; i<fine_dims[0]; i++){
-                for(int j=0; j<fine_dims[1]; j++){
-                    for(int k=0; k<fine_dims[2]; k++){
-                        if((i<coarse_dims[0]) && (j<coarse_dims[1]) && (k<coarse_dims[2])){
-
+        // add the new bitplanes of the coefficients in the region of interest to roi_coefficients
+        bool decode_roi(const std::vector<uint8_t>& prev_level_num_bitplanes){
+            auto num_levels = level_num.size();
+            auto level_dims = compute_level_dims(dimensions, num_levels - 1);
+            auto level_elements = compute_level_elements(level_dims, num_levels - 1);
+            std::vector<uint32_t> dims_dummy(dimensions.size(), 0);
+            compressor.set_scratch_buffer(&scratch_buffer);
+            for(int i=0; i<num_levels; i++){
+                if(level_num_bitplanes[i] - prev_level_num_bitplanes[i] == 0) continue;
+                if(!compressor.decompress_level(level_components[i], level_sizes[i], prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], stopping_indices[i], level_codecs[i], level_dictionary_sets[i], i)) return false;
+                int level_exp = 0;
+                if(negabinary) frexp(level_error_bounds[i] / 4, &level_exp);
+                else frexp(level_error_bounds[i], &level_exp);
+                const std::vector<uint32_t>& prev_dims = (i == 0) ? dims_dummy : level_dims[i - 1];
+                const auto& runs = roi.get_runs(i);
+                std::vector<T> level_box;
+                // the order of the view only
+                auto level_view = interleaver.level_view(level_dims[i], level_dims[i], prev_dims, NULL);
+                if(level_view.raster()){
+                    // only the runs are decoded
+                    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+                    size_t num_values = 0;
+                    for(const auto& run:runs){
+                        ranges.push_back({run.element, run.count});
+                        num_values += run.count;
+                    }
+                    std::vector<T> values(num_values);
+                    encoder.progressive_decode(level_components[i], level_elements[i], level_exp, prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], i, level_range_offsets[i], ranges, values.data());
+                    T const * values_pos = values.data();
+                    for(const auto& run:runs){
+                        T * dst = roi_coefficients.data() + run.sub_offset;
+                        for(uint32_t t=0; t<run.count; t++){
+                            dst[t] += values_pos[t];
                         }
-                        else{
-                            dst[i*dims[1]*dims[2] + j*dims[2] + k] = 0;
+                        values_pos += run.count;
+                    }
+                }
+                else{
+                    // elements in other orders are not located: the level is decoded into its box
+                    size_t box_size = 1;
+                    for(auto n:level_dims[i]){
+                        box_size *= n;
+                    }
+                    level_box.resize(box_size);
+                    level_view = interleaver.level_view(level_dims[i], level_dims[i], prev_dims, level_box.data());
+                    encoder.progressive_decode(level_components[i], level_elements[i], level_exp, prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], i, level_range_offsets[i], level_view);
+                    // views that gather the level store it in level_box when released
+                    level_view = LevelView<T>();
+                    for(const auto& run:runs){
+                        T * dst = roi_coefficients.data() + run.sub_offset;
+                        T const * src = level_box.data() + run.offset;
+                        for(uint32_t t=0; t<run.count; t++){
+                            dst[t] += src[t];
                         }
                     }
                 }
+                compressor.decompress_release();
+            }
+            return true;
+        }
+
+        // grow data to the compact grid of dims, keeping the current box
+        void resize_data(const std::vector<uint32_t>& dims){
+            std::vector<uint32_t> grid_strides(dims.size());
+            size_t stride = 1;
+            for(int i=dims.size()-1; i>=0; i--){
+                grid_strides[i] = stride;
+                stride *= dims[i];
+            }
+            std::vector<T> grid(stride, 0);
+            if(current_level >= 0){
+                // rows of the last dimension of the current box
+                const int last = dims.size() - 1;
+                size_t num_rows = 1;
+                for(int i=0; i<last; i++){
+                    num_rows *= current_dimensions[i];
+                }
+                for(size_t row=0; row<num_rows; row++){
+                    size_t remaining = row;
+                    size_t src = 0;
+                    size_t dst = 0;
+                    for(int i=last-1; i>=0; i--){
+                        uint32_t index = remaining % current_dimensions[i];
+                        remaining /= current_dimensions[i];
+                        src += index * strides[i];
+                        dst += index * grid_strides[i];
+                    }
+                    memcpy(grid.data() + dst, data.data() + src, current_dimensions[last] * sizeof(T));
+                }
+            }
+            data.swap(grid);
+            strides = grid_strides;
+        }
+
+        void clear_data(T * dst, const std::vector<uint32_t>& coarse_dims, const std::vector<uint32_t>& fine_dims, const std::vector<uint32_t>& dims){
+            LevelShape shape(dims, fine_dims, coarse_dims);
+            for(uint32_t i=0; i<shape.fine[0]; i++){
+                shape.for_each_span(i, [&](size_t offset, uint32_t length){
+                    memset(dst + offset, 0, length * sizeof(T));
+                });
             }
         }
 
@@ -286,7 +432,16 @@ namespace MDR {
         SizeInterpreter interpreter;
         Retriever retriever;
         Compressor compressor;
+        ScratchBuffer scratch_buffer;
         std::vector<T> data;
+        // recomposed deltas of the new bitplanes
+        std::vector<T> delta;
+        // mode of the reconstructions, set by the first one
+        ReconstructMode mode = MODE_NONE;
+        // region of interest, its coefficients in the sub-grid and the reconstructed box
+        RegionOfInterest roi;
+        std::vector<T> roi_coefficients;
+        std::vector<T> roi_data;
         std::vector<uint32_t> dimensions;
         std::vector<uint32_t> current_dimensions;
         std::vector<T> level_error_bounds;
@@ -296,6 +451,9 @@ namespace MDR {
         std::vector<std::vector<uint32_t>> level_sizes;
         std::vector<uint32_t> level_num;
         std::vector<std::vector<double>> level_squared_errors;
+        std::vector<std::vector<uint32_t>> level_range_offsets;
+        std::vector<std::vector<uint8_t>> level_codecs;
+        std::vector<uint32_t> level_dictionary_sets;
         int current_level = -1;
         std::vector<uint32_t> strides;
         bool negabinary = true;
@@ -11,6 +11,7 @@
 #include "MDR/SizeInterpreter/SizeInterpreter.hpp"
 #include "MDR/LosslessCompressor/LevelCompressor.hpp"
 #include "MDR/RefactorUtils.hpp"
+#include "RegionOfInterest.hpp"
 
 namespace MDR {
     // a decomposition-based scientific data reconstructor: inverse operator of composed refactor
@@ -20,70 +21,32 @@ namespace MDR {
         OrderedReconstructor(Decomposer decomposer, Interleaver interleaver, Encoder encoder, Compressor compressor, SizeInterpreter interpreter, Retriever retriever)
             : decomposer(decomposer), interleaver(interleaver), encoder(encoder), compressor(compressor), interpreter(interpreter), retriever(retriever){}
 
+        // bytes of the ordered buffer needed to reconstruct to tolerance: the metadata and the chunks
+        // up to the first step within tolerance; buffer needs to hold the metadata only
+        size_t get_buffer_prefix_size(double tolerance, const uint8_t *buffer)
+        {
+            if (!buffer_initialized && !load_buffer_metadata(buffer)) return 0;
+            size_t size = sizeof(uint32_t) + metadata_size_from_buffer;
+            std::vector<uint8_t> num_bitplanes(level_sizes.size(), 0);
+            for (size_t i = 0; i < chunk_order.size(); i++) {
+                size_t lv = chunk_order[i];
+                size += level_sizes[lv][num_bitplanes[lv]++];
+                if (error_perstep[i] <= tolerance) break;
+            }
+            return size;
+        }
+
+        // buffer only needs to hold the prefix of get_buffer_prefix_size(tolerance), and may move between calls
+        // (e.g. when it grows to a longer prefix) as long as the bytes already used are the same
         T * reconstruct_from_buffer(double tolerance, const uint8_t *buffer)
         {
             if (!buffer_initialized) {
-                if (buffer == NULL) {
-                    std::cerr << "reconstruct_from_buffer: buffer is NULL" << std::endl;
-                    return NULL;
-                }
+                if (!load_buffer_metadata(buffer)) return NULL;
+            } else if (buffer != NULL && buffer != buffer_base) {
                 buffer_base = buffer;
-                const uint8_t *p = buffer_base;
-
-                // get metadata_size
-                std::memcpy(&metadata_size_from_buffer, p, sizeof(uint32_t));
-                p += sizeof(uint32_t);
-
-                const uint8_t *metadata = p;
-                data_base_from_buffer = p + metadata_size_from_buffer;
-
-                // ---- get metadata and initialize the structure ----
-                {
-                    const uint8_t *mp = metadata;
-
-                    uint8_t num_dims = *(mp++);
-                    deserialize(mp, num_dims, dimensions);
-
-                    uint8_t num_levels = *(mp++);
-                    deserialize(mp, num_levels, level_error_bounds);
-                    deserialize(mp, num_levels, level_sizes);
-                    deserialize(mp, num_levels, stopping_indices);
-
-                    negabinary = (*(mp++) != 0);
-
-                    uint16_t chunk_num = 0;
-                    std::memcpy(&chunk_num, mp, sizeof(uint16_t));
-                    mp += sizeof(uint16_t);
-                    deserialize(mp, chunk_num, chunk_order);
-                    deserialize(mp, chunk_num, error_perstep);
-
-                    // progressive
-                    level_num_bitplanes = std::vector<uint8_t>(num_levels, 0);
-                    level_num           = std::vector<uint32_t>(num_levels, 1);
-                    level_components    =
-                        std::vector<std::vector<const uint8_t *>>(num_levels);
-
-                    strides = std::vector<uint32_t>(dimensions.size());
-                    uint32_t stride = 1;
-                    for (int i = static_cast<int>(dimensions.size()) - 1; i >= 0; i--) {
-                        strides[i] = stride;
-                        stride *= dimensions[i];
-                    }
-                    data = std::vector<T>(stride, 0);
-
-                    num_chunks = 0;
-                    chunk_sizes.clear();
-                    current_level = -1;
-                }
-
-                buffer_initialized = true;
-            } else {
-                if (buffer != NULL && buffer != buffer_base) {
-                    std::cerr << "reconstruct_from_buffer: buffer pointer changed, "
-                                "progressive reconstruction assumes same buffer!"
-                            << std::endl;
-                }
+                data_base_from_buffer = buffer + sizeof(uint32_t) + metadata_size_from_buffer;
             }
+            if (!set_mode(MODE_FIELD)) return NULL;
 
             if (!error_preprocessed) {
                 std::vector<std::vector<double>> level_abs_errors;
@@ -93,7 +56,7 @@ namespace MDR {
                     level_squared_errors;
 
                 if (std::is_base_of<MaxErrorEstimator<T>, ErrorEstimator>::value) {
-                    std::cout << "Using absolute error" << std::endl;
+                    if(verbose) std::cout << "Using absolute error" << std::endl;
                     MaxErrorCollector<T> collector = MaxErrorCollector<T>();
                     level_abs_errors.clear();
                     for (int i = 0; i <= target_level; i++) {
@@ -106,7 +69,7 @@ namespace MDR {
                     level_errors = level_abs_errors;
                 }
                 else if (std::is_base_of<SquaredErrorEstimator<T>, ErrorEstimator>::value) {
-                    std::cout << "Using squared error" << std::endl;
+                    if(verbose) std::cout << "Using squared error" << std::endl;
                 }
                 else {
                     std::cerr << "Customized error estimator not supported yet"
@@ -169,14 +132,8 @@ namespace MDR {
 
             uint8_t target_level =
                 static_cast<uint8_t>(level_error_bounds.size() - 1);
-            int skipped_level = 0;
-            for (int i = 0; i <= target_level; i++) {
-                if (level_num_bitplanes[target_level - i] != 0) {
-                    skipped_level = i;
-                    break;
-                }
-            }
-            int reconstruct_level = static_cast<int>(target_level) - skipped_level;
+            // the ordered stream interleaves the levels, so the result is always at full resolution
+            int reconstruct_level = target_level;
 
             bool success =
                 reconstruct(static_cast<uint8_t>(reconstruct_level),
@@ -195,83 +152,12 @@ namespace MDR {
 
         // reconstruct data from encoded streams
         T * reconstruct(double tolerance){
-            // Timer timer;
-            // timer.start();
-            std::vector<std::vector<double>> level_abs_errors;
+            if(!set_mode(MODE_FIELD)) return NULL;
             uint8_t target_level = level_error_bounds.size() - 1;
-            std::vector<std::vector<double>>& level_errors = level_squared_errors;
-            if(std::is_base_of<MaxErrorEstimator<T>, ErrorEstimator>::value){
-                std::cout << "Using absolute error" << std::endl;
-                MaxErrorCollector<T> collector = MaxErrorCollector<T>();
-                for(int i=0; i<=target_level; i++){
-                    auto collected_error = collector.collect_level_error(NULL, 0, level_sizes[i].size(), level_error_bounds[i]);
-                    level_abs_errors.push_back(collected_error);
-                }
-                level_errors = level_abs_errors;
-            }
-            else if(std::is_base_of<SquaredErrorEstimator<T>, ErrorEstimator>::value){
-                std::cout << "Using squared error" << std::endl;
-            }
-            else{
-                std::cerr << "Customized error estimator not supported yet" << std::endl;
-                exit(-1);
-            }
-            // timer.end();
-            // timer.print("Preprocessing");            
-            // timer.start();
-
-            auto prev_level_num_bitplanes(level_num_bitplanes);
-            size_t retrieve_size = 0;
-            size_t prev_num_chunks = num_chunks;            
-            double best_error = error_perstep.back();
-            if (tolerance < best_error) {
-                tolerance = best_error;
-            }
-            if (prev_num_chunks > 0 && error_perstep[prev_num_chunks - 1] <= tolerance) {
-                return data.data();
-            }
-
-            for (size_t i = prev_num_chunks; i < chunk_order.size(); i++)
-            {
-                size_t lv = chunk_order[i];
-                size_t sz = level_sizes[lv][level_num_bitplanes[lv]++];
-                chunk_sizes.push_back(sz);
-                retrieve_size += sz;
-                if (error_perstep[i] <= tolerance) {
-                    num_chunks = i + 1;
-                    break;
-                }
-            }
-            if (retrieve_size > 0 && num_chunks == prev_num_chunks) {
-                num_chunks = chunk_order.size();
-            }
-            uint8_t* ordered_components = retriever.retrieve_components(retrieve_size);
-            size_t offset = 0;
-
-            level_components.clear();
-            level_components = std::vector<std::vector<const uint8_t*>>(level_num.size());
-            
-            for (size_t i = prev_num_chunks; i < num_chunks; i++)
-            {
-                size_t lv = chunk_order[i];
-                level_components[lv].push_back(ordered_components + offset);
-                offset += chunk_sizes[i];
-            }
-                        
-            // check whether to reconstruct to full resolution
-            int skipped_level = 0;
-            for(int i=0; i<=target_level; i++){
-                if(level_num_bitplanes[target_level - i] != 0){
-                    skipped_level = i;
-                    break;
-                }
-            }
-            // TODO: uncomment skip level to reconstruct low resolution data
-            // target_level -= skipped_level;
-            // timer.end();
-            // timer.print("Interpret and retrieval");
-            int reconstruct_level = target_level - skipped_level;
-            // std::cout << "skipped_level = " << skipped_level << ", target_level = " << +target_level << std::endl;
+            std::vector<uint8_t> prev_level_num_bitplanes;
+            if(!retrieve(tolerance, prev_level_num_bitplanes)) return data.data();
+            // the ordered stream interleaves the levels, so the result is always at full resolution
+            int reconstruct_level = target_level;
 
             bool success = reconstruct(reconstruct_level, prev_level_num_bitplanes);
             retriever.release();
@@ -290,21 +176,63 @@ namespace MDR {
         }
         // reconstruct progressively based on available data
         T * progressive_reconstruct(double tolerance, int max_level=-1){
-            reconstruct(tolerance);
-            return data.data();
+            return reconstruct(tolerance);
         }
+        // reconstruct the box [roi_begin, roi_end) of the full grid progressively, returning the compact box
+        // only the coefficients whose basis function support touches the box are decoded and recomposed,
+        // so the decomposer must use a hierarchical (interpolating) basis
+        // a reconstructor serves either one box or the full field, whichever it reconstructs first: the other returns NULL
+        T * reconstruct_roi(double tolerance, const std::vector<uint32_t>& roi_begin, const std::vector<uint32_t>& roi_end){
+            if(roi.empty()){
+                if((roi_begin.size() != dimensions.size()) || (roi_end.size() != dimensions.size())){
+                    std::cerr << "Region of interest does not match the dimensions" << std::endl;
+                    return NULL;
+                }
+                for(int i=0; i<dimensions.size(); i++){
+                    if((roi_begin[i] >= roi_end[i]) || (roi_end[i] > dimensions[i])){
+                        std::cerr << "Region of interest is empty or out of the grid" << std::endl;
+                        return NULL;
+                    }
+                }
+                if(!set_mode(MODE_ROI)) return NULL;
+                roi = RegionOfInterest(compute_level_dims(dimensions, level_num.size() - 1, verbose), roi_begin, roi_end);
+                roi_coefficients = std::vector<T>(roi.get_sub_size(), 0);
+            }
+            else if(!roi.is_box(roi_begin, roi_end)){
+                std::cerr << "Region of interest cannot change during progressive reconstruction" << std::endl;
+                return NULL;
+            }
+            std::vector<uint8_t> prev_level_num_bitplanes;
+            if(!retrieve(tolerance, prev_level_num_bitplanes)) return roi_data.data();
+            bool success = decode_roi(prev_level_num_bitplanes);
+            retriever.release();
+            if(!success){
+                std::cerr << "Reconstruct unsuccessful, return NULL pointer" << std::endl;
+                return NULL;
+            }
+            std::vector<T> sub_data(roi_coefficients);
+            decomposer.recompose(sub_data.data(), roi.get_sub_dims(), level_num.size() - 1);
+            roi_data.resize(roi.size());
+            roi.extract(sub_data.data(), roi_data.data());
+            return roi_data.data();
+        }
+
         // TODO: do not overwrite
         T * recompose_to_full(){
-            clear_data(data.data(), current_dimensions, dimensions, dimensions);
             int target_level = level_num.size() - 1;
+            if(current_level < target_level) resize_data(dimensions);
             std::cout << "recompose to full for " << target_level - current_level << " levels!\n"; 
-            std::cout << "dimensions: " << dimensions[0] << " " << dimensions[1] << " " << dimensions[2] << "\n";
+            std::cout << "dimensions:";
+            for(auto d:dimensions) std::cout << " " << d;
+            std::cout << "\n";
             decomposer.recompose(data.data(), dimensions, target_level - current_level, this->strides); 
             return data.data();
         }
 
         void retrieve_metadata(uint8_t* metadata){
             const uint8_t * p = metadata;
+            int version = deserialize_version(p);
+            if(version < 0) exit(-1);
             uint8_t num_dims = *(p++);
             deserialize(p, num_dims, dimensions);
             uint8_t num_levels = *(p++);
@@ -318,23 +246,27 @@ namespace MDR {
             p += sizeof(uint16_t);
             deserialize(p, chunk_num, chunk_order);
             deserialize(p, chunk_num, error_perstep);
+            if(version >= 1) deserialize(p, num_levels, level_range_offsets);
+            else level_range_offsets = std::vector<std::vector<uint32_t>>(num_levels);
+            if(version >= 1) deserialize(p, num_levels, level_codecs);
+            else level_codecs = std::vector<std::vector<uint8_t>>(num_levels);
+            if(version >= 2) deserialize(p, num_levels, level_dictionary_sets);
+            else level_dictionary_sets = std::vector<uint32_t>(num_levels, 0);
 
             level_num_bitplanes = std::vector<uint8_t>(num_levels, 0);
             level_num = std::vector<uint32_t>(num_levels, 1);
             level_components = std::vector<std::vector<const uint8_t*>>(num_levels);
-            strides = std::vector<uint32_t>(dimensions.size());
-            uint32_t stride = 1;
-            for(int i=dimensions.size()-1; i>=0; i--){
-                strides[i] = stride;
-                stride *= dimensions[i];
-            }
-            data = std::vector<T>(stride, 0);
+            // data is allocated at the reconstructed resolution
+            strides.clear();
+            data.clear();
             free(metadata);
         }
 
         void load_metadata(){
             uint8_t * metadata = retriever.load_metadata();
             const uint8_t * p = metadata;
+            int version = deserialize_version(p);
+            if(version < 0) exit(-1);
             uint8_t num_dims = *(p++);
             deserialize(p, num_dims, dimensions);
             uint8_t num_levels = *(p++);
@@ -348,17 +280,19 @@ namespace MDR {
             p += sizeof(uint16_t);
             deserialize(p, chunk_num, chunk_order);
             deserialize(p, chunk_num, error_perstep);
+            if(version >= 1) deserialize(p, num_levels, level_range_offsets);
+            else level_range_offsets = std::vector<std::vector<uint32_t>>(num_levels);
+            if(version >= 1) deserialize(p, num_levels, level_codecs);
+            else level_codecs = std::vector<std::vector<uint8_t>>(num_levels);
+            if(version >= 2) deserialize(p, num_levels, level_dictionary_sets);
+            else level_dictionary_sets = std::vector<uint32_t>(num_levels, 0);
 
             level_num_bitplanes = std::vector<uint8_t>(num_levels, 0);
             level_num = std::vector<uint32_t>(num_levels, 1);
             level_components = std::vector<std::vector<const uint8_t*>>(num_levels);
-            strides = std::vector<uint32_t>(dimensions.size());
-            uint32_t stride = 1;
-            for(int i=dimensions.size()-1; i>=0; i--){
-                strides[i] = stride;
-                stride *= dimensions[i];
-            }
-            data = std::vector<T>(stride, 0);
+            // data is allocated at the reconstructed resolution
+            strides.clear();
+            data.clear();
             free(metadata);
         }
 
@@ -378,6 +312,10 @@ namespace MDR {
             return retriever.get_retrieved_size();
         }
 
+        const ScratchBuffer& get_scratch_buffer() const {
+            return scratch_buffer;
+        }
+
         std::vector<uint32_t> get_offsets(){
             return retriever.get_offsets();
         }
@@ -393,82 +331,224 @@ namespace MDR {
             std::cout << "Retriever: "; retriever.print();
         }
     private:        
+        // reconstructions of the field and of a region of interest both progress level_num_bitplanes,
+        // so the first one used is the only one allowed
+        enum ReconstructMode { MODE_NONE, MODE_FIELD, MODE_ROI };
+
+        // record the mode on first use; false if the reconstructor is in the other mode
+        bool set_mode(ReconstructMode new_mode){
+            if(mode == MODE_NONE) mode = new_mode;
+            if(mode != new_mode){
+                if(new_mode == MODE_ROI) std::cerr << "Region of interest cannot be reconstructed after full reconstructions" << std::endl;
+                else std::cerr << "Full reconstruction cannot follow reconstructions of a region of interest" << std::endl;
+                return false;
+            }
+            return true;
+        }
+
+        // parse the metadata at the start of an ordered buffer
+        bool load_buffer_metadata(const uint8_t *buffer)
+        {
+            if (buffer == NULL) {
+                std::cerr << "reconstruct_from_buffer: buffer is NULL" << std::endl;
+                return false;
+            }
+            buffer_base = buffer;
+            const uint8_t *p = buffer_base;
+
+            // get metadata_size
+            std::memcpy(&metadata_size_from_buffer, p, sizeof(uint32_t));
+            p += sizeof(uint32_t);
+
+            const uint8_t *metadata = p;
+            data_base_from_buffer = p + metadata_size_from_buffer;
+
+            // ---- get metadata and initialize the structure ----
+            {
+                const uint8_t *mp = metadata;
+
+                int version = deserialize_version(mp);
+                if (version < 0) return false;
+                uint8_t num_dims = *(mp++);
+                deserialize(mp, num_dims, dimensions);
+
+                uint8_t num_levels = *(mp++);
+                deserialize(mp, num_levels, level_error_bounds);
+                deserialize(mp, num_levels, level_sizes);
+                deserialize(mp, num_levels, stopping_indices);
+
+                negabinary = (*(mp++) != 0);
+
+                uint16_t chunk_num = 0;
+                std::memcpy(&chunk_num, mp, sizeof(uint16_t));
+                mp += sizeof(uint16_t);
+                deserialize(mp, chunk_num, chunk_order);
+                deserialize(mp, chunk_num, error_perstep);
+                if (version >= 1) deserialize(mp, num_levels, level_range_offsets);
+                else level_range_offsets = std::vector<std::vector<uint32_t>>(num_levels);
+                if (version >= 1) deserialize(mp, num_levels, level_codecs);
+                else level_codecs = std::vector<std::vector<uint8_t>>(num_levels);
+                if (version >= 2) deserialize(mp, num_levels, level_dictionary_sets);
+                else level_dictionary_sets = std::vector<uint32_t>(num_levels, 0);
+
+                // progressive
+                level_num_bitplanes = std::vector<uint8_t>(num_levels, 0);
+                level_num           = std::vector<uint32_t>(num_levels, 1);
+                level_components    =
+                    std::vector<std::vector<const uint8_t *>>(num_levels);
+
+                // data is allocated at the reconstructed resolution
+                strides.clear();
+                data.clear();
+
+                num_chunks = 0;
+                chunk_sizes.clear();
+                current_level = -1;
+            }
+
+            buffer_initialized = true;
+            return true;
+        }
+
+        // retrieve the chunks that the tolerance needs, recording the previous numbers of bitplanes;
+        // false if no chunk is needed
+        bool retrieve(double tolerance, std::vector<uint8_t>& prev_level_num_bitplanes){
+            // Timer timer;
+            // timer.start();
+            std::vector<std::vector<double>> level_abs_errors;
+            uint8_t target_level = level_error_bounds.size() - 1;
+            std::vector<std::vector<double>>& level_errors = level_squared_errors;
+            if(std::is_base_of<MaxErrorEstimator<T>, ErrorEstimator>::value){
+                if(verbose) std::cout << "Using absolute error" << std::endl;
+                MaxErrorCollector<T> collector = MaxErrorCollector<T>();
+                for(int i=0; i<=target_level; i++){
+                    auto collected_error = collector.collect_level_error(NULL, 0, level_sizes[i].size(), level_error_bounds[i]);
+                    level_abs_errors.push_back(collected_error);
+                }
+                level_errors = level_abs_errors;
+            }
+            else if(std::is_base_of<SquaredErrorEstimator<T>, ErrorEstimator>::value){
+                if(verbose) std::cout << "Using squared error" << std::endl;
+            }
+            else{
+                std::cerr << "Customized error estimator not supported yet" << std::endl;
+                exit(-1);
+            }
+            // timer.end();
+            // timer.print("Preprocessing");            
+            // timer.start();
+
+            prev_level_num_bitplanes = level_num_bitplanes;
+            size_t retrieve_size = 0;
+            size_t prev_num_chunks = num_chunks;            
+            double best_error = error_perstep.back();
+            if (tolerance < best_error) {
+                tolerance = best_error;
+            }
+            if (prev_num_chunks > 0 && error_perstep[prev_num_chunks - 1] <= tolerance) {
+                return false;
+            }
+
+            for (size_t i = prev_num_chunks; i < chunk_order.size(); i++)
+            {
+                size_t lv = chunk_order[i];
+                size_t sz = level_sizes[lv][level_num_bitplanes[lv]++];
+                chunk_sizes.push_back(sz);
+                retrieve_size += sz;
+                if (error_perstep[i] <= tolerance) {
+                    num_chunks = i + 1;
+                    break;
+                }
+            }
+            if (retrieve_size > 0 && num_chunks == prev_num_chunks) {
+                num_chunks = chunk_order.size();
+            }
+            uint8_t* ordered_components = retriever.retrieve_components(retrieve_size);
+            size_t offset = 0;
+
+            level_components.clear();
+            level_components = std::vector<std::vector<const uint8_t*>>(level_num.size());
+            
+            for (size_t i = prev_num_chunks; i < num_chunks; i++)
+            {
+                size_t lv = chunk_order[i];
+                level_components[lv].push_back(ordered_components + offset);
+                offset += chunk_sizes[i];
+            }
+                        
+            // timer.end();
+            // timer.print("Interpret and retrieval");
+            return true;
+        }
+
         bool reconstruct(uint8_t target_level, const std::vector<uint8_t>& prev_level_num_bitplanes, bool progressive=true){
             auto num_levels = level_num.size();
-            auto level_dims = compute_level_dims(dimensions, num_levels - 1);
+            auto level_dims = compute_level_dims(dimensions, num_levels - 1, verbose);
             auto reconstruct_dimensions = level_dims[target_level];
+            if(target_level > current_level) resize_data(reconstruct_dimensions);
+            // levels are decompressed into the scratch buffer, reused across levels and reconstructions
+            compressor.set_scratch_buffer(&scratch_buffer);
             // std::cout << "target_level = " << +target_level << ", dims = " << reconstruct_dimensions[0] << " " << reconstruct_dimensions[1] << " " << reconstruct_dimensions[2] << std::endl;
-            // update with stride
-            std::vector<T> cur_data(data);
-            memset(data.data(), 0, data.size() * sizeof(T));
             // std::cout << "Test 1" << std::endl;
 
             // std::cout << "current_level = " << current_level << std::endl;
-            auto level_elements = compute_level_elements(level_dims, target_level);
+            auto level_elements = compute_level_elements(level_dims, target_level, verbose);
             std::vector<uint32_t> dims_dummy(reconstruct_dimensions.size(), 0);
             // std::cout << "Test 2" << std::endl;
             // std::cout << "current level =" << (int)current_level << std::endl;
+            // levels up to current_level are already in data: the deltas of their new bitplanes are decoded into
+            // the delta grid, recomposed (the transform is linear) and accumulated into data in place
+            bool updated = false;
             for(int i=0; i<=current_level; i++){
-                // std::cout << "i=" << i << " ";
-                if(level_num_bitplanes[i] - prev_level_num_bitplanes[i] > 0){
-                    // std::cout << "Test 2b" << " ";
-                    compressor.decompress_level(level_components[i], level_sizes[i], prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], stopping_indices[i]);
-                    int level_exp = 0;
-                    if(negabinary) frexp(level_error_bounds[i] / 4, &level_exp);
-                    else frexp(level_error_bounds[i], &level_exp);
-                    // std::cout << "Test 2c" << " ";
-                    auto level_decoded_data = encoder.progressive_decode(level_components[i], level_elements[i], level_exp, prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], i);
-                    compressor.decompress_release();
-                    // std::cout << "Test 2d" << std::endl;
-                    const std::vector<uint32_t>& prev_dims = (i == 0) ? dims_dummy : level_dims[i - 1];
-                    interleaver.reposition(level_decoded_data, reconstruct_dimensions, level_dims[i], prev_dims, data.data(), this->strides);
-                    free(level_decoded_data);                    
-                }
+                if(level_num_bitplanes[i] - prev_level_num_bitplanes[i] > 0) updated = true;
             }
-            // std::cout << "Test 3" << std::endl;
-            // decompose data to current level
-            if(current_level >= 0){
-                if(current_level) decomposer.recompose(data.data(), current_dimensions, current_level, this->strides);
-                // std::cout << "update data\n";
-                // update data with strides
-                if(current_dimensions.size() == 1){
-                    for(int i=0; i<current_dimensions[0]; i++){
-                        data[i] += cur_data[i];
+            if(updated){
+                // allocated once, every element of the current box is overwritten below
+                if(delta.size() != data.size()) delta = std::vector<T>(data.size());
+                for(int i=0; i<=current_level; i++){
+                    const std::vector<uint32_t>& prev_dims = (i == 0) ? dims_dummy : level_dims[i - 1];
+                    if(level_num_bitplanes[i] - prev_level_num_bitplanes[i] > 0){
+                        if(!compressor.decompress_level(level_components[i], level_sizes[i], prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], stopping_indices[i], level_codecs[i], level_dictionary_sets[i], i)) return false;
+                        int level_exp = 0;
+                        if(negabinary) frexp(level_error_bounds[i] / 4, &level_exp);
+                        else frexp(level_error_bounds[i], &level_exp);
+                        auto level_view = interleaver.level_view(reconstruct_dimensions, level_dims[i], prev_dims, delta.data(), this->strides);
+                        encoder.progressive_decode(level_components[i], level_elements[i], level_exp, prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], i, level_range_offsets[i], level_view);
+                        compressor.decompress_release();
+                    }
+                    else{
+                        // no new bitplanes: zero delta
+                        clear_data(delta.data(), prev_dims, level_dims[i], reconstruct_dimensions);
                     }
                 }
-                else if(current_dimensions.size() == 3){
-                    for(int i=0; i<current_dimensions[0]; i++){
-                        for(int j=0; j<current_dimensions[1]; j++){
-                            for(int k=0; k<current_dimensions[2]; k++){
-                                data[i*this->strides[0] + j*this->strides[1] + k] += cur_data[i*this->strides[0] + j*this->strides[1] + k];
-                            }
+                if(current_level) decomposer.recompose(delta.data(), current_dimensions, current_level, this->strides);
+                LevelShape shape(reconstruct_dimensions, current_dimensions, dims_dummy, this->strides);
+                for(uint32_t i=0; i<shape.fine[0]; i++){
+                    shape.for_each_span(i, [&](size_t offset, uint32_t length){
+                        T * dst = data.data() + offset;
+                        T const * src = delta.data() + offset;
+                        for(uint32_t t=0; t<length; t++){
+                            dst[t] += src[t];
                         }
-                    }                    
-                }
-                else{
-                    std::cout << "dimension higher than 4 is not supported in update data\n";
-                    exit(-1);
+                    });
                 }
             }
-            // std::cout << "Test 4" << std::endl;
-            // std::cout << "target level =" << (int)target_level << std::endl;
-            // std::cout << "decompose to target_level\n";
             // decompose data to target level
             for(int i=current_level+1; i<=target_level; i++){
                 // std::cout << "i=" << i << " ";
-                compressor.decompress_level(level_components[i], level_sizes[i], prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], stopping_indices[i]);
+                if(!compressor.decompress_level(level_components[i], level_sizes[i], prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], stopping_indices[i], level_codecs[i], level_dictionary_sets[i], i)) return false;
                 int level_exp = 0;
                 if(negabinary) frexp(level_error_bounds[i] / 4, &level_exp);
                 else frexp(level_error_bounds[i], &level_exp);
-                auto level_decoded_data = encoder.progressive_decode(level_components[i], level_elements[i], level_exp, prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], i);
-                compressor.decompress_release();
+                // decode straight into the output grid
                 const std::vector<uint32_t>& prev_dims = (i == 0) ? dims_dummy : level_dims[i - 1];
-                interleaver.reposition(level_decoded_data, reconstruct_dimensions, level_dims[i], prev_dims, data.data(), this->strides);
-                free(level_decoded_data);                    
+                auto level_view = interleaver.level_view(reconstruct_dimensions, level_dims[i], prev_dims, data.data(), this->strides);
+                encoder.progressive_decode(level_components[i], level_elements[i], level_exp, prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], i, level_range_offsets[i], level_view);
+                compressor.decompress_release();
             }
             // std::cout << "Test 5" << std::endl;
             if(current_level >= 0){
-                decomposer.recompose(data.data(), reconstruct_dimensions, target_level - current_level, this->strides);                
+                if(target_level > current_level) decomposer.recompose(data.data(), reconstruct_dimensions, target_level - current_level, this->strides);                
             }
             else{
                 decomposer.recompose(data.data(), reconstruct_dimensions, target_level, this->strides);
@@ -478,18 +558,106 @@ namespace MDR {
 
         }
 
-        void clear_data(T * dst, const std::vector<uint32_t>& coarse_dims, const std::vector<uint32_t>& fine_dims, const std::vector<uint32_t>& dims){
-            for(int i=0; i<fine_dims[0]; i++){
-                for(int j=0; j<fine_dims[1]; j++){
-                    for(int k=0; k<fine_dims[2]; k++){
-                        if((i<coarse_dims[0]) && (j<coarse_dims[1]) && (k<coarse_dims[2])){
-
+        // add the new bitplanes of the coefficients in the region of interest to roi_coefficients
+        bool decode_roi(const std::vector<uint8_t>& prev_level_num_bitplanes){
+            auto num_levels = level_num.size();
+            auto level_dims = compute_level_dims(dimensions, num_levels - 1, verbose);
+            auto level_elements = compute_level_elements(level_dims, num_levels - 1, verbose);
+            std::vector<uint32_t> dims_dummy(dimensions.size(), 0);
+            compressor.set_scratch_buffer(&scratch_buffer);
+            for(int i=0; i<num_levels; i++){
+                if(level_num_bitplanes[i] - prev_level_num_bitplanes[i] == 0) continue;
+                if(!compressor.decompress_level(level_components[i], level_sizes[i], prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], stopping_indices[i], level_codecs[i], level_dictionary_sets[i], i)) return false;
+                int level_exp = 0;
+                if(negabinary) frexp(level_error_bounds[i] / 4, &level_exp);
+                else frexp(level_error_bounds[i], &level_exp);
+                const std::vector<uint32_t>& prev_dims = (i == 0) ? dims_dummy : level_dims[i - 1];
+                const auto& runs = roi.get_runs(i);
+                std::vector<T> level_box;
+                // the order of the view only
+                auto level_view = interleaver.level_view(level_dims[i], level_dims[i], prev_dims, NULL);
+                if(level_view.raster()){
+                    // only the runs are decoded
+                    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+                    size_t num_values = 0;
+                    for(const auto& run:runs){
+                        ranges.push_back({run.element, run.count});
+                        num_values += run.count;
+                    }
+                    std::vector<T> values(num_values);
+                    encoder.progressive_decode(level_components[i], level_elements[i], level_exp, prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], i, level_range_offsets[i], ranges, values.data());
+                    T const * values_pos = values.data();
+                    for(const auto& run:runs){
+                        T * dst = roi_coefficients.data() + run.sub_offset;
+                        for(uint32_t t=0; t<run.count; t++){
+                            dst[t] += values_pos[t];
                         }
-                        else{
-                            dst[i*dims[1]*dims[2] + j*dims[2] + k] = 0;
+                        values_pos += run.count;
+                    }
+                }
+                else{
+                    // elements in other orders are not located: the level is decoded into its box
+                    size_t box_size = 1;
+                    for(auto n:level_dims[i]){
+                        box_size *= n;
+                    }
+                    level_box.resize(box_size);
+                    level_view = interleaver.level_view(level_dims[i], level_dims[i], prev_dims, level_box.data());
+                    encoder.progressive_decode(level_components[i], level_elements[i], level_exp, prev_level_num_bitplanes[i], level_num_bitplanes[i] - prev_level_num_bitplanes[i], i, level_range_offsets[i], level_view);
+                    // views that gather the level store it in level_box when released
+                    level_view = LevelView<T>();
+                    for(const auto& run:runs){
+                        T * dst = roi_coefficients.data() + run.sub_offset;
+                        T const * src = level_box.data() + run.offset;
+                        for(uint32_t t=0; t<run.count; t++){
+                            dst[t] += src[t];
                         }
                     }
                 }
+                compressor.decompress_release();
+            }
+            return true;
+        }
+
+        // grow data to the compact grid of dims, keeping the current box
+        void resize_data(const std::vector<uint32_t>& dims){
+            std::vector<uint32_t> grid_strides(dims.size());
+            size_t stride = 1;
+            for(int i=dims.size()-1; i>=0; i--){
+                grid_strides[i] = stride;
+                stride *= dims[i];
+            }
+            std::vector<T> grid(stride, 0);
+            if(current_level >= 0){
+                // rows of the last dimension of the current box
+                const int last = dims.size() - 1;
+                size_t num_rows = 1;
+                for(int i=0; i<last; i++){
+                    num_rows *= current_dimensions[i];
+                }
+                for(size_t row=0; row<num_rows; row++){
+                    size_t remaining = row;
+                    size_t src = 0;
+                    size_t dst = 0;
+                    for(int i=last-1; i>=0; i--){
+                        uint32_t index = remaining % current_dimensions[i];
+                        remaining /= current_dimensions[i];
+                        src += index * strides[i];
+                        dst += index * grid_strides[i];
+                    }
+                    memcpy(grid.data() + dst, data.data() + src, current_dimensions[last] * sizeof(T));
+                }
+            }
+            data.swap(grid);
+            strides = grid_strides;
+        }
+
+        void clear_data(T * dst, const std::vector<uint32_t>& coarse_dims, const std::vector<uint32_t>& fine_dims, const std::vector<uint32_t>& dims){
+            LevelShape shape(dims, fine_dims, coarse_dims);
+            for(uint32_t i=0; i<shape.fine[0]; i++){
+                shape.for_each_span(i, [&](size_t offset, uint32_t length){
+                    memset(dst + offset, 0, length * sizeof(T));
+                });
             }
         }
 
@@ -499,7 +667,16 @@ namespace MDR {
         SizeInterpreter interpreter;
         Retriever retriever;
         Compressor compressor;
+        ScratchBuffer scratch_buffer;
         std::vector<T> data;
+        // recomposed deltas of the new bitplanes
+        std::vector<T> delta;
+        // mode of the reconstructions, set by the first one
+        ReconstructMode mode = MODE_NONE;
+        // region of interest, its coefficients in the sub-grid and the reconstructed box
+        RegionOfInterest roi;
+        std::vector<T> roi_coefficients;
+        std::vector<T> roi_data;
         std::vector<uint32_t> dimensions;
         std::vector<uint32_t> current_dimensions;
         std::vector<T> level_error_bounds;
@@ -516,13 +693,18 @@ namespace MDR {
         std::vector<uint8_t> chunk_order;
         std::vector<double> error_perstep;
         std::vector<uint32_t> chunk_sizes;
+        std::vector<std::vector<uint32_t>> level_range_offsets;
+        std::vector<std::vector<uint8_t>> level_codecs;
+        std::vector<uint32_t> level_dictionary_sets;
 
         bool buffer_initialized = false;          // 是否已经解析过 buffer 的 metadata
         bool error_preprocessed = false;         // 是否已经做过误差预处理
         const uint8_t *buffer_base = nullptr;    // 整个 buffer 的起始地址
         const uint8_t *data_base_from_buffer = nullptr; // data 区起始地址
         uint32_t metadata_size_from_buffer = 0;  // 记录 metadata 大小（可选）
-
+    public:
+        // print progress
+        bool verbose = true;
     };
 }
 #endif
@@ -3,5 +3,6 @@
 
 #include "ComposedReconstructor.hpp"
 #include "OrderedReconstructor.hpp"
+#include "TiledReconstructor.hpp"
 
 #endif
@@ -0,0 +1,207 @@
+#ifndef _MDR_REGION_OF_INTEREST_HPP
+#define _MDR_REGION_OF_INTEREST_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "MDR/Interleaver/LevelShape.hpp"
+
+namespace MDR {
+    // box [begin, end) of the full grid and the coefficients that reconstruct it with a hierarchical basis:
+    // a coefficient is needed when the support of its basis function touches the box
+    // the needed nodes of every level are grown to a box whose coarse nodes are the box of the next coarser level,
+    // so they form a smaller grid (the sub-grid) with the same hierarchy, which the decomposer recomposes on its own
+    class RegionOfInterest {
+    public:
+        // coefficients of a level that are in the sub-grid: elements [element, element + count) of the level
+        // in raster interleaving order, at offset in the level box and at sub_offset in the sub-grid
+        struct Run {
+            uint32_t element;
+            uint32_t count;
+            size_t offset;
+            size_t sub_offset;
+        };
+
+        RegionOfInterest(){}
+
+        // level_dims from the coarsest level to the full grid
+        RegionOfInterest(const std::vector<std::vector<uint32_t>>& level_dims, const std::vector<uint32_t>& begin, const std::vector<uint32_t>& end) : begin(begin), end(end) {
+            const int num_dims = begin.size();
+            const int num_levels = level_dims.size();
+            // sub-grid of every level: [lo, hi] in the indices of the level
+            std::vector<std::vector<uint32_t>> lo(num_levels, std::vector<uint32_t>(num_dims));
+            std::vector<std::vector<uint32_t>> hi(num_levels, std::vector<uint32_t>(num_dims));
+            for(int d=0; d<num_dims; d++){
+                // coarse nodes interpolating the needed nodes, from the finest level
+                uint32_t needed_lo = begin[d];
+                uint32_t needed_hi = end[d] - 1;
+                for(int l=num_levels-1; l>0; l--){
+                    const uint32_t n = level_dims[l][d];
+                    const uint32_t nc = level_dims[l - 1][d];
+                    needed_lo = needed_lo / 2;
+                    needed_hi = (needed_hi == n - 1) ? nc - 1 : std::min((needed_hi + 1) / 2, nc - 1);
+                }
+                // at least one interval on the coarsest level
+                if((needed_lo == needed_hi) && (level_dims[0][d] > 1)){
+                    if(needed_hi + 1 < level_dims[0][d]) needed_hi ++;
+                    else needed_lo --;
+                }
+                lo[0][d] = needed_lo;
+                hi[0][d] = needed_hi;
+                for(int l=1; l<num_levels; l++){
+                    lo[l][d] = 2 * lo[l - 1][d];
+                    hi[l][d] = (hi[l - 1][d] == level_dims[l - 1][d] - 1) ? level_dims[l][d] - 1 : 2 * hi[l - 1][d];
+                }
+            }
+            sub_begin = lo[num_levels - 1];
+            sub_dims = std::vector<uint32_t>(num_dims);
+            for(int d=0; d<num_dims; d++){
+                sub_dims[d] = hi[num_levels - 1][d] - lo[num_levels - 1][d] + 1;
+            }
+            const std::vector<uint32_t> sub_strides = natural_strides(sub_dims);
+            runs = std::vector<std::vector<Run>>(num_levels);
+            for(int l=0; l<num_levels; l++){
+                // per dimension, the coarse nodes (positions before nc) and the other nodes (positions from nc)
+                // of the sub-grid are contiguous in the reordered level and in the reordered sub-grid
+                // the coarsest level is not reordered: all its nodes are taken as the other nodes
+                std::vector<uint32_t> position[2], sub_position[2], count[2];
+                for(int part=0; part<2; part++){
+                    position[part] = sub_position[part] = count[part] = std::vector<uint32_t>(num_dims, 0);
+                }
+                for(int d=0; d<num_dims; d++){
+                    const uint32_t n = hi[l][d] - lo[l][d] + 1;
+                    if(l == 0){
+                        position[1][d] = lo[l][d];
+                        count[1][d] = n;
+                        continue;
+                    }
+                    const uint32_t num_coarse = (n >> 1) + 1;
+                    position[0][d] = lo[l - 1][d];
+                    count[0][d] = num_coarse;
+                    position[1][d] = level_dims[l - 1][d] + lo[l - 1][d];
+                    sub_position[1][d] = num_coarse;
+                    count[1][d] = n - num_coarse;
+                }
+                const std::vector<uint32_t> dims_dummy(num_dims, 0);
+                LevelShape shape(level_dims[l], level_dims[l], (l == 0) ? dims_dummy : level_dims[l - 1]);
+                const std::vector<uint32_t> level_strides = natural_strides(level_dims[l]);
+                // boxes of the parts with the other nodes in at least one dimension
+                for(uint32_t parts=1; parts<(1u << num_dims); parts++){
+                    std::vector<uint32_t> box_position(num_dims), box_sub_position(num_dims), box_count(num_dims);
+                    bool empty = false;
+                    for(int d=0; d<num_dims; d++){
+                        const int part = (parts >> d) & 1u;
+                        box_position[d] = position[part][d];
+                        box_sub_position[d] = sub_position[part][d];
+                        box_count[d] = count[part][d];
+                        empty = empty || (box_count[d] == 0);
+                    }
+                    if(empty) continue;
+                    // rows of the last dimension, which are contiguous in the level
+                    std::vector<uint32_t> index(num_dims, 0);
+                    std::vector<uint32_t> row(num_dims);
+                    while(true){
+                        size_t offset = 0;
+                        size_t sub_offset = 0;
+                        for(int d=0; d<num_dims; d++){
+                            row[d] = box_position[d] + index[d];
+                            offset += row[d] * level_strides[d];
+                            sub_offset += (box_sub_position[d] + index[d]) * sub_strides[d];
+                        }
+                        runs[l].push_back({(uint32_t) shape.element_index(row), box_count[num_dims - 1], offset, sub_offset});
+                        int d = num_dims - 2;
+                        while((d >= 0) && (++index[d] == box_count[d])){
+                            index[d] = 0;
+                            d --;
+                        }
+                        if(d < 0) break;
+                    }
+                }
+                std::sort(runs[l].begin(), runs[l].end(), [](const Run& a, const Run& b){
+                    return a.element < b.element;
+                });
+            }
+        }
+
+        bool empty() const {
+            return runs.empty();
+        }
+
+        bool is_box(const std::vector<uint32_t>& box_begin, const std::vector<uint32_t>& box_end) const {
+            return (box_begin == begin) && (box_end == end);
+        }
+
+        const std::vector<uint32_t>& get_sub_dims() const {
+            return sub_dims;
+        }
+
+        size_t get_sub_size() const {
+            return product(sub_dims);
+        }
+
+        // number of elements in the box
+        size_t size() const {
+            size_t size = 1;
+            for(int d=0; d<begin.size(); d++){
+                size *= end[d] - begin[d];
+            }
+            return size;
+        }
+
+        // runs of level, sorted by element
+        const std::vector<Run>& get_runs(int level) const {
+            return runs[level];
+        }
+
+        // copy the box out of the recomposed sub-grid
+        template <class T>
+        void extract(T const * sub, T * box) const {
+            const int num_dims = begin.size();
+            const std::vector<uint32_t> sub_strides = natural_strides(sub_dims);
+            const uint32_t length = end[num_dims - 1] - begin[num_dims - 1];
+            std::vector<uint32_t> index(num_dims, 0);
+            while(true){
+                size_t sub_offset = 0;
+                for(int d=0; d<num_dims; d++){
+                    sub_offset += (begin[d] - sub_begin[d] + index[d]) * sub_strides[d];
+                }
+                memcpy(box, sub + sub_offset, length * sizeof(T));
+                box += length;
+                int d = num_dims - 2;
+                while((d >= 0) && (++index[d] == end[d] - begin[d])){
+                    index[d] = 0;
+                    d --;
+                }
+                if(d < 0) break;
+            }
+        }
+
+    private:
+        static std::vector<uint32_t> natural_strides(const std::vector<uint32_t>& dims){
+            std::vector<uint32_t> strides(dims.size());
+            uint32_t stride = 1;
+            for(int d=dims.size()-1; d>=0; d--){
+                strides[d] = stride;
+                stride *= dims[d];
+            }
+            return strides;
+        }
+
+        static size_t product(const std::vector<uint32_t>& dims){
+            size_t size = 1;
+            for(auto n:dims){
+                size *= n;
+            }
+            return size;
+        }
+
+        std::vector<uint32_t> begin;
+        std::vector<uint32_t> end;
+        // origin of the sub-grid in the full grid, and its dimensions
+        std::vector<uint32_t> sub_begin;
+        std::vector<uint32_t> sub_dims;
+        std::vector<std::vector<Run>> runs;
+    };
+}
+#endif
@@ -0,0 +1,186 @@
+#ifndef _MDR_TILED_RECONSTRUCTOR_HPP
+#define _MDR_TILED_RECONSTRUCTOR_HPP
+
+#include "OrderedReconstructor.hpp"
+#include "MDR/TileContainer.hpp"
+#include "MDR/ParallelUtils.hpp"
+#include <memory>
+
+namespace MDR {
+    // reconstructor of a tiled refactor: any subset of tiles is reconstructed progressively at its own tolerance,
+    // tiles in parallel; of every tile, only the prefix of its ordered buffer that the tolerance needs is read,
+    // and it is extended by later requests at lower tolerances
+    // as for the refactor, the components should be single-threaded
+    template<class T, class Decomposer, class Interleaver, class Encoder, class Compressor, class SizeInterpreter, class ErrorEstimator>
+    class TiledReconstructor {
+    public:
+        TiledReconstructor(Decomposer decomposer, Interleaver interleaver, Encoder encoder, Compressor compressor, SizeInterpreter interpreter, const std::string& container_file, int num_threads=1)
+            : decomposer(decomposer), interleaver(interleaver), encoder(encoder), compressor(compressor), interpreter(interpreter), container_file(container_file), thread_pool(std::make_shared<ThreadPool>(num_threads)) {}
+
+        // read the tile index
+        void load_metadata(){
+            if(!container.load(container_file)){
+                exit(-1);
+            }
+            tiles = std::vector<Tile>(container.get_num_tiles());
+            data.clear();
+        }
+
+        // reconstruct tile_ids progressively, tile_ids[i] to tolerances[i]
+        bool reconstruct_tiles(const std::vector<uint32_t>& tile_ids, const std::vector<double>& tolerances){
+            if(tile_ids.size() != tolerances.size()){
+                std::cerr << "Number of tolerances does not match the number of tiles" << std::endl;
+                return false;
+            }
+            std::vector<bool> requested(tiles.size(), false);
+            for(auto t:tile_ids){
+                if(t >= tiles.size()){
+                    std::cerr << "Tile " << t << " is out of the container" << std::endl;
+                    return false;
+                }
+                if(requested[t]){
+                    std::cerr << "Tile " << t << " is requested more than once" << std::endl;
+                    return false;
+                }
+                requested[t] = true;
+            }
+            if(!retrieve(tile_ids, tolerances)) return false;
+            std::atomic<bool> success(true);
+            thread_pool->parallel_for(tile_ids.size(), [&](uint32_t i){
+                Tile& tile = tiles[tile_ids[i]];
+                tile.data = tile.reconstructor->reconstruct_from_buffer(tolerances[i], tile.buffer.data());
+                if(tile.data == NULL) success = false;
+            });
+            return success;
+        }
+
+        // reconstruct tile_ids as reconstruct_tiles and return the full grid,
+        // where tiles that were never reconstructed are 0
+        T * reconstruct(const std::vector<uint32_t>& tile_ids, const std::vector<double>& tolerances){
+            if(!reconstruct_tiles(tile_ids, tolerances)){
+                std::cerr << "Reconstruct unsuccessful, return NULL pointer" << std::endl;
+                return NULL;
+            }
+            if(data.empty()){
+                size_t num_elements = 1;
+                for(auto n:container.get_dimensions()){
+                    num_elements *= n;
+                }
+                data = std::vector<T>(num_elements, 0);
+            }
+            thread_pool->parallel_for(tile_ids.size(), [&](uint32_t i){
+                container.insert(tiles[tile_ids[i]].data, tile_ids[i], data.data());
+            });
+            return data.data();
+        }
+
+        // reconstruct every tile to tolerance
+        T * reconstruct(double tolerance){
+            std::vector<uint32_t> tile_ids(tiles.size());
+            for(uint32_t t=0; t<tile_ids.size(); t++){
+                tile_ids[t] = t;
+            }
+            return reconstruct(tile_ids, std::vector<double>(tile_ids.size(), tolerance));
+        }
+
+        // compact data of a reconstructed tile (NULL if it was not reconstructed)
+        T const * get_tile_data(uint32_t tile) const {
+            return tiles[tile].data;
+        }
+
+        const TileContainer& get_container() const {
+            return container;
+        }
+
+        std::vector<uint32_t> get_dimensions(){
+            return container.get_dimensions();
+        }
+
+        // bytes of the tiles read from the container: the retrieved prefixes
+        size_t get_retrieved_size(){
+            return retrieved_size;
+        }
+
+        ~TiledReconstructor(){}
+
+        void print() const {
+            std::cout << "Tiled reconstructor with " << thread_pool->get_num_threads() << " threads." << std::endl;
+        }
+    private:
+        using TileReconstructor = OrderedReconstructor<T, Decomposer, Interleaver, Encoder, Compressor, SizeInterpreter, ErrorEstimator, OrderedFileRetriever>;
+
+        // retrieved prefix of the refactored buffer of a tile and the reconstructor that keeps its progressive state
+        struct Tile {
+            std::vector<uint8_t> buffer;
+            std::unique_ptr<TileReconstructor> reconstructor;
+            T * data = NULL;
+        };
+
+        // extend the retrieved prefixes of tile_ids to what tolerances need, in file order;
+        // the metadata of a tile is read first on its first use
+        bool retrieve(const std::vector<uint32_t>& tile_ids, const std::vector<double>& tolerances){
+            std::vector<uint32_t> order(tile_ids.size());
+            for(uint32_t i=0; i<order.size(); i++){
+                order[i] = i;
+            }
+            std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b){ return tile_ids[a] < tile_ids[b]; });
+            FILE * file = fopen(container_file.c_str(), "rb");
+            if(!file){
+                std::cerr << "Failed to open tile container: " << container_file << std::endl;
+                return false;
+            }
+            for(auto i:order){
+                const uint32_t t = tile_ids[i];
+                Tile& tile = tiles[t];
+                bool success = tile.reconstructor || retrieve_metadata(file, t);
+                size_t prefix_size = success ? tile.reconstructor->get_buffer_prefix_size(tolerances[i], tile.buffer.data()) : 0;
+                if(!prefix_size || !extend(file, t, prefix_size)){
+                    fclose(file);
+                    std::cerr << "Failed to read tile " << t << std::endl;
+                    return false;
+                }
+            }
+            fclose(file);
+            return true;
+        }
+
+        // read the metadata of tile and create its reconstructor
+        bool retrieve_metadata(FILE * file, uint32_t tile){
+            uint32_t metadata_size = 0;
+            if(!extend(file, tile, sizeof(uint32_t))) return false;
+            memcpy(&metadata_size, tiles[tile].buffer.data(), sizeof(uint32_t));
+            if(!extend(file, tile, sizeof(uint32_t) + metadata_size)) return false;
+            // tiles are reconstructed from their buffers, the retriever is not used
+            tiles[tile].reconstructor = std::unique_ptr<TileReconstructor>(new TileReconstructor(decomposer, interleaver, encoder, compressor, interpreter, OrderedFileRetriever("", "")));
+            tiles[tile].reconstructor->verbose = false;
+            return true;
+        }
+
+        // grow the retrieved prefix of tile to size bytes
+        bool extend(FILE * file, uint32_t tile, size_t size){
+            std::vector<uint8_t>& buffer = tiles[tile].buffer;
+            const size_t retrieved = buffer.size();
+            if(size <= retrieved) return true;
+            buffer.resize(size);
+            if(!container.read_tile(file, tile, retrieved, size - retrieved, buffer.data() + retrieved)){
+                buffer.resize(retrieved);
+                return false;
+            }
+            retrieved_size += size - retrieved;
+            return true;
+        }
+
+        Decomposer decomposer;
+        Interleaver interleaver;
+        Encoder encoder;
+        Compressor compressor;
+        SizeInterpreter interpreter;
+        std::string container_file;
+        TileContainer container;
+        std::vector<Tile> tiles;
+        std::vector<T> data;
+        size_t retrieved_size = 0;
+        std::shared_ptr<ThreadPool> thread_pool;
+    };
+}
+#endif
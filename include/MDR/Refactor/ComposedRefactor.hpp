@@ -19,16 +19,22 @@ namespace MDR {
             : decomposer(decomposer), interleaver(interleaver), encoder(encoder), compressor(compressor), collector(collector), writer(writer) {}
 
         void refactor(T const * data_, const std::vector<uint32_t>& dims, uint8_t target_level, uint8_t num_bitplanes){
-            Timer timer;
-            timer.start();
-            dimensions = dims;
             uint32_t num_elements = 1;
-            for(const auto& dim:dimensions){
+            for(const auto& dim:dims){
                 num_elements *= dim;
             }
             data = std::vector<T>(data_, data_ + num_elements);
+            refactor_inplace(data.data(), dims, target_level, num_bitplanes);
+        }
+
+        // refactor without copying the input: data_ is consumed, holding the decomposed coefficients afterwards
+        // strides (in elements, per dimension) refactor the dims subarray of a larger array starting at data_
+        void refactor_inplace(T * data_, const std::vector<uint32_t>& dims, uint8_t target_level, uint8_t num_bitplanes, std::vector<uint32_t> strides=std::vector<uint32_t>()){
+            Timer timer;
+            timer.start();
+            dimensions = dims;
             // if refactor successfully
-            if(refactor(target_level, num_bitplanes)){
+            if(decompose_and_encode(data_, strides, target_level, num_bitplanes)){
                 timer.end();
                 timer.print("Refactor");
                 timer.start();
@@ -40,19 +46,24 @@ namespace MDR {
             write_metadata();
             for(int i=0; i<level_components.size(); i++){
                 for(int j=0; j<level_components[i].size(); j++){
-                    free(level_components[i][j]);                    
+                    stream_pool.release(level_components[i][j]);                    
                 }
             }
         }
 
         void write_metadata() const {
-            uint32_t metadata_size = sizeof(uint8_t) + get_size(dimensions) // dimensions
+            uint32_t metadata_size = sizeof(uint8_t) // version
+                            + sizeof(uint8_t) + get_size(dimensions) // dimensions
                             + sizeof(uint8_t) + get_size(level_error_bounds) 
                             // + get_size(level_squared_errors) 
                             + get_size(level_sizes) // level information
-                            + get_size(stopping_indices) + get_size(level_num) + 1; // one byte for whether negabinary encoding is used 
+                            + get_size(stopping_indices) + get_size(level_num) + 1 // one byte for whether negabinary encoding is used 
+                            + get_size(level_range_offsets) // element range offsets for parallel decoding
+                            + get_size(level_codecs) // codec of every bitplane
+                            + get_size(level_dictionary_sets); // dictionary set of every level
             uint8_t * metadata = (uint8_t *) malloc(metadata_size);
             uint8_t * metadata_pos = metadata;
+            serialize_version(metadata_pos);
             *(metadata_pos ++) = (uint8_t) dimensions.size();
             serialize(dimensions, metadata_pos);
             *(metadata_pos ++) = (uint8_t) level_error_bounds.size();
@@ -62,10 +73,18 @@ namespace MDR {
             serialize(stopping_indices, metadata_pos);
             serialize(level_num, metadata_pos);
             *(metadata_pos ++) = (uint8_t) negabinary;
+            serialize(level_range_offsets, metadata_pos);
+            serialize(level_codecs, metadata_pos);
+            serialize(level_dictionary_sets, metadata_pos);
             writer.write_metadata(metadata, metadata_size);
             free(metadata);
         }
 
+        // pool of the level stream buffers, reused across refactor calls
+        const StreamPool& get_stream_pool() const {
+            return stream_pool;
+        }
+
         ~ComposedRefactor(){}
 
         void print() const {
@@ -75,7 +94,7 @@ namespace MDR {
             std::cout << "Encoder: "; encoder.print();
         }
     private:
-        bool refactor(uint8_t target_level, uint8_t num_bitplanes){
+        bool decompose_and_encode(T * data_, const std::vector<uint32_t>& strides, uint8_t target_level, uint8_t num_bitplanes){
             uint8_t max_level = log2(*min_element(dimensions.begin(), dimensions.end())) - 1;
             if(target_level > max_level){
                 std::cerr << "Target level is higher than " << max_level << std::endl;
@@ -84,16 +103,23 @@ namespace MDR {
             // Timer timer;
             // decompose data hierarchically
             // timer.start();
-            decomposer.decompose(data.data(), dimensions, target_level);
+            decomposer.decompose(data_, dimensions, target_level, strides);
             // MGARD::writefile("decomposed_coeff.dat", data.data(), data.size());
             // timer.end();
             // timer.print("Decompose");
 
+            // stream buffers of the previous refactor are recycled
+            stream_pool.reset();
+            encoder.set_stream_pool(&stream_pool);
+            compressor.set_stream_pool(&stream_pool);
             // encode level by level
             level_error_bounds.clear();
             level_squared_errors.clear();
             level_components.clear();
             level_sizes.clear();
+            level_range_offsets.clear();
+            level_codecs.clear();
+            level_dictionary_sets.clear();
             auto level_dims = compute_level_dims(dimensions, target_level);
             auto level_elements = compute_level_elements(level_dims, target_level);
             std::vector<uint32_t> dims_dummy(dimensions.size(), 0);
@@ -101,11 +127,13 @@ namespace MDR {
             for(int i=0; i<=target_level; i++){
                 // timer.start();
                 const std::vector<uint32_t>& prev_dims = (i == 0) ? dims_dummy : level_dims[i - 1];
-                T * buffer = (T *) malloc(level_elements[i] * sizeof(T));
-                // extract level i component
-                interleaver.interleave(data.data(), dimensions, level_dims[i], prev_dims, reinterpret_cast<T*>(buffer));
+                // level i component in the decomposed data, encoded from there without an interleaved copy
+                auto level = interleaver.level_view(dimensions, level_dims[i], prev_dims, data_, strides);
                 // compute max coefficient as level error bound
-                T level_max_error = compute_max_abs_value(reinterpret_cast<T*>(buffer), level_elements[i]);
+                T level_max_error = 0;
+                level.for_each_span([&](T const * span, uint32_t length){
+                    level_max_error = std::max(level_max_error, Quantizer::max_abs(span, length));
+                });
                 // std::cout << "\nlevel " << i << " max error = " << level_max_error << std::endl;
                 // MGARD::writefile(("level_" + std::to_string(i) + "_coeff.dat").c_str(), buffer, level_elements[i]);
                 if(negabinary) level_error_bounds.push_back(level_max_error * 4);
@@ -120,19 +148,23 @@ namespace MDR {
                 int level_exp = 0;
                 frexp(level_max_error, &level_exp);
                 std::vector<uint32_t> stream_sizes;
+                std::vector<uint32_t> range_offsets;
                 // std::vector<double> level_sq_err;
-                auto streams = encoder.encode(buffer, level_elements[i], level_exp, num_bitplanes, stream_sizes);
-                free(buffer);
+                auto streams = encoder.encode(level, level_elements[i], level_exp, num_bitplanes, stream_sizes, range_offsets);
                 // level_squared_errors.push_back(level_sq_err);
                 // timer.end();
                 // timer.print("Encoding");
                 // timer.start();
                 // lossless compression
-                uint8_t stopping_index = compressor.compress_level(streams, stream_sizes);
+                std::vector<uint8_t> codecs;
+                uint8_t stopping_index = compressor.compress_level(streams, stream_sizes, codecs, i);
                 stopping_indices.push_back(stopping_index);
+                level_codecs.push_back(codecs);
+                level_dictionary_sets.push_back(compressor.get_dictionary_set(i));
                 // record encoded level data and size
                 level_components.push_back(streams);
                 level_sizes.push_back(stream_sizes);
+                level_range_offsets.push_back(range_offsets);
                 // timer.end();
                 // timer.print("Lossless time");
             }
@@ -154,6 +186,10 @@ namespace MDR {
         std::vector<std::vector<uint32_t>> level_sizes;
         std::vector<uint32_t> level_num;
         std::vector<std::vector<double>> level_squared_errors;
+        std::vector<std::vector<uint32_t>> level_range_offsets;
+        std::vector<std::vector<uint8_t>> level_codecs;
+        std::vector<uint32_t> level_dictionary_sets;
+        StreamPool stream_pool;
     public:
         bool negabinary = false;
     };
@@ -23,34 +23,48 @@ namespace MDR {
             : decomposer(decomposer), interleaver(interleaver), encoder(encoder), compressor(compressor), collector(collector), error_estimator(error_estimator), writer(writer) {}
 
         // buffer: [metadata_size(uint32_t)][metadata][data]
-        // return buffer size
+        // return buffer size, or 0 if the refactored data does not fit in capacity bytes
         uint32_t refactor_to_buffer(T const * data_,
                                      const std::vector<uint32_t> &dims,
                                      uint8_t target_level,
                                      uint8_t num_bitplanes,
-                                     uint8_t * buffer)
+                                     uint8_t * buffer,
+                                     size_t capacity = SIZE_MAX)
         {
-            Timer timer;
-            timer.start();
-            dimensions = dims;
             uint32_t num_elements = 1;
-            for (const auto &dim : dimensions)
+            for (const auto &dim : dims)
             {
                 num_elements *= dim;
             }
             data = std::vector<T>(data_, data_ + num_elements);
+            return refactor_to_buffer_inplace(data.data(), dims, target_level, num_bitplanes, buffer, capacity);
+        }
+
+        // refactor_to_buffer without copying the input: data_ is consumed, holding the decomposed coefficients afterwards
+        // strides (in elements, per dimension) refactor the dims subarray of a larger array starting at data_
+        uint32_t refactor_to_buffer_inplace(T * data_,
+                                     const std::vector<uint32_t> &dims,
+                                     uint8_t target_level,
+                                     uint8_t num_bitplanes,
+                                     uint8_t * buffer,
+                                     size_t capacity,
+                                     std::vector<uint32_t> strides = std::vector<uint32_t>())
+        {
+            Timer timer;
+            timer.start();
+            dimensions = dims;
 
-            if (refactor(target_level, num_bitplanes))
+            if (decompose_and_encode(data_, strides, target_level, num_bitplanes))
             {
                 timer.end();
-                timer.print("Refactor");
+                if(verbose) timer.print("Refactor");
             }
 
             std::vector<std::vector<double>> level_abs_errors;
             std::vector<std::vector<double>> &level_errors = level_squared_errors;
             if (std::is_base_of<MaxErrorEstimator<T>, ErrorEstimator>::value)
             {
-                std::cout << "Computing absolute error" << std::endl;
+                if(verbose) std::cout << "Computing absolute error" << std::endl;
                 MaxErrorCollector<T> collector = MaxErrorCollector<T>();
                 for (int i = 0; i <= target_level; i++)
                 {
@@ -64,7 +78,7 @@ namespace MDR {
             }
             else if (std::is_base_of<SquaredErrorEstimator<T>, ErrorEstimator>::value)
             {
-                std::cout << "Using level squared error directly" << std::endl;
+                if(verbose) std::cout << "Using level squared error directly" << std::endl;
             }
             else
             {
@@ -89,12 +103,18 @@ namespace MDR {
                 consumed[lev] = j + 1;
             }
 
-            // 64 bit to 32 bit
-            uint32_t data_size = static_cast<uint32_t>(total_data_size_64);
-
             // buffer size = sizeof(uint32_t) + metadata + data
-            uint32_t buffer_size = static_cast<uint32_t>(sizeof(uint32_t)) +
-                          metadata_size + data_size;
+            uint64_t total_size_64 = sizeof(uint32_t) + metadata_size + total_data_size_64;
+            if (total_size_64 > std::min<uint64_t>(capacity, UINT32_MAX))
+            {
+                std::cerr << "Refactored data of " << total_size_64
+                          << " bytes exceeds the buffer capacity of "
+                          << capacity << " bytes" << std::endl;
+                free(metadata);
+                release_level_components();
+                return 0;
+            }
+            uint32_t buffer_size = static_cast<uint32_t>(total_size_64);
 
             // buffer shoule be already allocated
             uint8_t *p = buffer;
@@ -124,31 +144,30 @@ namespace MDR {
             }
 
             free(metadata);
-            for (int i = 0; i < static_cast<int>(level_components.size()); i++)
-            {
-                for (int j = 0; j < static_cast<int>(level_components[i].size());
-                     j++)
-                {
-                    free(level_components[i][j]);
-                }
-            }
+            release_level_components();
 
             return buffer_size;
         }
 
         void refactor(T const * data_, const std::vector<uint32_t>& dims, uint8_t target_level, uint8_t num_bitplanes){
-            Timer timer;
-            timer.start();
-            dimensions = dims;
             uint32_t num_elements = 1;
-            for(const auto& dim:dimensions){
+            for(const auto& dim:dims){
                 num_elements *= dim;
             }
             data = std::vector<T>(data_, data_ + num_elements);
+            refactor_inplace(data.data(), dims, target_level, num_bitplanes);
+        }
+
+        // refactor without copying the input: data_ is consumed, holding the decomposed coefficients afterwards
+        // strides (in elements, per dimension) refactor the dims subarray of a larger array starting at data_
+        void refactor_inplace(T * data_, const std::vector<uint32_t>& dims, uint8_t target_level, uint8_t num_bitplanes, std::vector<uint32_t> strides=std::vector<uint32_t>()){
+            Timer timer;
+            timer.start();
+            dimensions = dims;
             // if refactor successfully
-            if(refactor(target_level, num_bitplanes)){
+            if(decompose_and_encode(data_, strides, target_level, num_bitplanes)){
                 timer.end();
-                timer.print("Refactor");
+                if(verbose) timer.print("Refactor");
                 // timer.start();
                 // level_num = writer.write_level_components(level_components, level_sizes);
                 // timer.end();
@@ -159,7 +178,7 @@ namespace MDR {
             std::vector<std::vector<double>> level_abs_errors;
             std::vector<std::vector<double>>& level_errors = level_squared_errors;
             if(std::is_base_of<MaxErrorEstimator<T>, ErrorEstimator>::value){
-                std::cout << "Computing absolute error" << std::endl;
+                if(verbose) std::cout << "Computing absolute error" << std::endl;
                 MaxErrorCollector<T> collector = MaxErrorCollector<T>();
                 for(int i=0; i<=target_level; i++){
                     auto collected_error = collector.collect_level_error(NULL, 0, level_sizes[i].size(), level_error_bounds[i]);
@@ -168,7 +187,7 @@ namespace MDR {
                 level_errors = level_abs_errors;
             }
             else if(std::is_base_of<SquaredErrorEstimator<T>, ErrorEstimator>::value){
-                std::cout << "Using level squared error directly" << std::endl;
+                if(verbose) std::cout << "Using level squared error directly" << std::endl;
             }
             else{
                 std::cerr << "Customized error estimator not supported yet" << std::endl;
@@ -206,27 +225,33 @@ namespace MDR {
             
             // level_num.clear();
             // level_num.push_back(1);
-            for(int i=0; i<level_components.size(); i++){
-                for(int j=0; j<level_components[i].size(); j++){
-                    free(level_components[i][j]);                    
-                }
-            }
+            release_level_components();
+        }
+
+        // pool of the level stream buffers, reused across refactor calls
+        const StreamPool& get_stream_pool() const {
+            return stream_pool;
         }
 
         uint8_t * get_metadata(uint32_t& metadata_size) const {
             metadata_size =
-                sizeof(uint8_t)  + get_size(dimensions)
+                sizeof(uint8_t)      // version
+                + sizeof(uint8_t)  + get_size(dimensions)
                 + sizeof(uint8_t)  + get_size(level_error_bounds)  
                 + get_size(level_sizes)                            
                 + get_size(stopping_indices)
                 + sizeof(uint8_t)    // negabinary
                 + sizeof(uint16_t)   // chunk_num
                 + get_size(chunk_order)                                     
-                + get_size(error_perstep);                            
+                + get_size(error_perstep)
+                + get_size(level_range_offsets)      // element range offsets for parallel decoding
+                + get_size(level_codecs)             // codec of every bitplane
+                + get_size(level_dictionary_sets);   // dictionary set of every level
 
             uint8_t* metadata = static_cast<uint8_t*>(malloc(metadata_size));
             uint8_t* p = metadata;
 
+            serialize_version(p);
             *(p++) = dimensions.size();
             serialize(dimensions, p);
             *(p++) = level_error_bounds.size();
@@ -240,6 +265,9 @@ namespace MDR {
             p += sizeof(uint16_t);
             serialize(chunk_order, p);
             serialize(error_perstep, p);
+            serialize(level_range_offsets, p);
+            serialize(level_codecs, p);
+            serialize(level_dictionary_sets, p);
 
             return metadata;
         }
@@ -261,6 +289,15 @@ namespace MDR {
             std::cout << "Encoder: "; encoder.print();
         }
     private:
+        // return the encoded level streams to the pool
+        void release_level_components(){
+            for(int i=0; i<level_components.size(); i++){
+                for(int j=0; j<level_components[i].size(); j++){
+                    stream_pool.release(level_components[i][j]);
+                }
+            }
+        }
+
         std::vector<uint8_t> get_chunks_order(const std::vector<std::vector<double>>& level_errors, std::vector<double>& error_perstep) const {
             // for(int i=0; i<level_errors.size(); i++){
             //     for(int j=0; j<level_errors[i].size(); j++){
@@ -323,7 +360,7 @@ namespace MDR {
             return order;
         }
 
-        bool refactor(uint8_t target_level, uint8_t num_bitplanes){
+        bool decompose_and_encode(T * data_, const std::vector<uint32_t>& strides, uint8_t target_level, uint8_t num_bitplanes){
             uint8_t max_level = log2(*min_element(dimensions.begin(), dimensions.end())) - 1;
             if(target_level > max_level){
                 std::cerr << "Target level is higher than " << max_level << std::endl;
@@ -332,28 +369,37 @@ namespace MDR {
             // Timer timer;
             // decompose data hierarchically
             // timer.start();
-            decomposer.decompose(data.data(), dimensions, target_level);
+            decomposer.decompose(data_, dimensions, target_level, strides);
             // MGARD::writefile("decomposed_coeff.dat", data.data(), data.size());
             // timer.end();
             // timer.print("Decompose");
 
+            // stream buffers of the previous refactor are recycled
+            stream_pool.reset();
+            encoder.set_stream_pool(&stream_pool);
+            compressor.set_stream_pool(&stream_pool);
             // encode level by level
             level_error_bounds.clear();
             level_squared_errors.clear();
             level_components.clear();
             level_sizes.clear();
-            auto level_dims = compute_level_dims(dimensions, target_level);
-            auto level_elements = compute_level_elements(level_dims, target_level);
+            level_range_offsets.clear();
+            level_codecs.clear();
+            level_dictionary_sets.clear();
+            auto level_dims = compute_level_dims(dimensions, target_level, verbose);
+            auto level_elements = compute_level_elements(level_dims, target_level, verbose);
             std::vector<uint32_t> dims_dummy(dimensions.size(), 0);
             SquaredErrorCollector<T> s_collector = SquaredErrorCollector<T>();
             for(int i=0; i<=target_level; i++){
                 // timer.start();
                 const std::vector<uint32_t>& prev_dims = (i == 0) ? dims_dummy : level_dims[i - 1];
-                T * buffer = (T *) malloc(level_elements[i] * sizeof(T));
-                // extract level i component
-                interleaver.interleave(data.data(), dimensions, level_dims[i], prev_dims, reinterpret_cast<T*>(buffer));
+                // level i component in the decomposed data, encoded from there without an interleaved copy
+                auto level = interleaver.level_view(dimensions, level_dims[i], prev_dims, data_, strides);
                 // compute max coefficient as level error bound
-                T level_max_error = compute_max_abs_value(reinterpret_cast<T*>(buffer), level_elements[i]);
+                T level_max_error = 0;
+                level.for_each_span([&](T const * span, uint32_t length){
+                    level_max_error = std::max(level_max_error, Quantizer::max_abs(span, length));
+                });
                 // std::cout << "\nlevel " << i << " max error = " << level_max_error << std::endl;
                 // MGARD::writefile(("level_" + std::to_string(i) + "_coeff.dat").c_str(), buffer, level_elements[i]);
                 if(negabinary) level_error_bounds.push_back(level_max_error * 4);
@@ -368,19 +414,23 @@ namespace MDR {
                 int level_exp = 0;
                 frexp(level_max_error, &level_exp);
                 std::vector<uint32_t> stream_sizes;
+                std::vector<uint32_t> range_offsets;
                 // std::vector<double> level_sq_err;
-                auto streams = encoder.encode(buffer, level_elements[i], level_exp, num_bitplanes, stream_sizes);
-                free(buffer);
+                auto streams = encoder.encode(level, level_elements[i], level_exp, num_bitplanes, stream_sizes, range_offsets);
                 // level_squared_errors.push_back(level_sq_err);
                 // timer.end();
                 // timer.print("Encoding");
                 // timer.start();
                 // lossless compression
-                uint8_t stopping_index = compressor.compress_level(streams, stream_sizes);
+                std::vector<uint8_t> codecs;
+                uint8_t stopping_index = compressor.compress_level(streams, stream_sizes, codecs, i);
                 stopping_indices.push_back(stopping_index);
+                level_codecs.push_back(codecs);
+                level_dictionary_sets.push_back(compressor.get_dictionary_set(i));
                 // record encoded level data and size
                 level_components.push_back(streams);
                 level_sizes.push_back(stream_sizes);
+                level_range_offsets.push_back(range_offsets);
                 // timer.end();
                 // timer.print("Lossless time");
             }
@@ -404,8 +454,14 @@ namespace MDR {
         std::vector<std::vector<double>> level_squared_errors;
         std::vector<uint8_t> chunk_order;
         std::vector<double> error_perstep;
+        std::vector<std::vector<uint32_t>> level_range_offsets;
+        std::vector<std::vector<uint8_t>> level_codecs;
+        std::vector<uint32_t> level_dictionary_sets;
+        StreamPool stream_pool;
     public:
         bool negabinary = false;
+        // print timings and progress
+        bool verbose = true;
     };
 }
 #endif
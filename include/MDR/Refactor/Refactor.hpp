@@ -3,5 +3,6 @@
 
 #include "ComposedRefactor.hpp"
 #include "OrderedRefactor.hpp"
+#include "TiledRefactor.hpp"
 
 #endif
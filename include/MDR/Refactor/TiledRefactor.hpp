@@ -0,0 +1,146 @@
+#ifndef _MDR_TILED_REFACTOR_HPP
+#define _MDR_TILED_REFACTOR_HPP
+
+#include "OrderedRefactor.hpp"
+#include "MDR/TileContainer.hpp"
+#include "MDR/ParallelUtils.hpp"
+#include "MDR/Reader/Reader.hpp"
+
+namespace MDR {
+    // a refactor that cuts the grid into fixed-size tiles and refactors every tile as its own ordered hierarchy,
+    // so tiles are refactored in parallel and retrieved independently from one container file
+    // every tile task works on copies of the components: they should be single-threaded,
+    // as components sharing a multi-threaded pool serialize the tiles
+    template<class T, class Decomposer, class Interleaver, class Encoder, class Compressor, class ErrorCollector, class ErrorEstimator>
+    class TiledRefactor {
+    public:
+        TiledRefactor(Decomposer decomposer, Interleaver interleaver, Encoder encoder, Compressor compressor, ErrorCollector collector, ErrorEstimator error_estimator, const std::string& container_file, int num_threads=1)
+            : decomposer(decomposer), interleaver(interleaver), encoder(encoder), compressor(compressor), collector(collector), error_estimator(error_estimator), container_file(container_file), thread_pool(std::make_shared<ThreadPool>(num_threads)) {}
+
+        // refactor data of dims in tiles of tile_dims, each to at most target_level levels
+        // return the container size
+        uint64_t refactor(T const * data, const std::vector<uint32_t>& dims, const std::vector<uint32_t>& tile_dims, uint8_t target_level, uint8_t num_bitplanes){
+            return refactor_tiles(dims, tile_dims, target_level, num_bitplanes, [&](uint32_t t, T * tile_data){
+                container.extract(data, t, tile_data);
+                return true;
+            });
+        }
+
+        // out-of-core refactor: every tile is read from reader when it is refactored and written to the container
+        // as soon as it is done, so the field is never held in memory
+        template <class Reader>
+        uint64_t refactor(const Reader& reader, const std::vector<uint32_t>& tile_dims, uint8_t target_level, uint8_t num_bitplanes){
+            return refactor_tiles(reader.get_dimensions(), tile_dims, target_level, num_bitplanes, [&](uint32_t t, T * tile_data){
+                return reader.read(container.get_tile_begin(t), container.get_tile_dims(t), tile_data);
+            });
+        }
+
+        // estimated peak memory of refactoring a tile of num_elements: the tile, the scratch of the decomposition,
+        // the encoded streams and the buffer they are ordered into
+        static size_t tile_footprint(size_t num_elements, uint8_t num_bitplanes){
+            return 2 * num_elements * sizeof(T) + 2 * buffer_capacity(num_elements, num_bitplanes);
+        }
+
+        const TileContainer& get_container() const {
+            return container;
+        }
+
+        ~TiledRefactor(){}
+
+        void print() const {
+            std::cout << "Tiled refactor with " << thread_pool->get_num_threads() << " threads." << std::endl;
+        }
+    private:
+        // refactor the tiles with read_tile(tile, tile_data) filling a tile, appending each tile to the container when done
+        // tiles are claimed one at a time, so threads finishing early take the remaining tiles;
+        // the number of tiles in flight is bounded by memory_budget
+        template <class ReadTile>
+        uint64_t refactor_tiles(const std::vector<uint32_t>& dims, const std::vector<uint32_t>& tile_dims, uint8_t target_level, uint8_t num_bitplanes, ReadTile read_tile){
+            if((tile_dims.size() != dims.size()) || std::count(tile_dims.begin(), tile_dims.end(), 0)){
+                std::cerr << "Tile dimensions do not match the dimensions" << std::endl;
+                exit(-1);
+            }
+            Timer timer;
+            timer.start();
+            container = TileContainer(dims, tile_dims);
+            const uint32_t num_tiles = container.get_num_tiles();
+            const size_t max_tile_size = container.get_tile_size(0);
+            const size_t footprint = tile_footprint(max_tile_size, num_bitplanes);
+            uint32_t num_workers = std::min<uint32_t>(thread_pool->get_num_threads(), num_tiles);
+            if(memory_budget){
+                if(footprint > memory_budget){
+                    std::cerr << "A tile needs about " << footprint << " bytes, more than the memory budget of " << memory_budget << " bytes" << std::endl;
+                    exit(-1);
+                }
+                num_workers = std::min<size_t>(num_workers, memory_budget / footprint);
+            }
+            FILE * file = container.open_write(container_file);
+            if(!file){
+                exit(-1);
+            }
+            std::atomic<uint32_t> next_tile(0);
+            std::atomic<bool> success(true);
+            std::mutex write_mutex;
+            thread_pool->parallel_for(num_workers, [&](uint32_t){
+                std::vector<T> tile_data(max_tile_size);
+                const size_t capacity = buffer_capacity(max_tile_size, num_bitplanes);
+                std::vector<uint8_t> buffer(capacity);
+                for(uint32_t t=next_tile++; t<num_tiles; t=next_tile++){
+                    std::vector<uint32_t> tile_size = container.get_tile_dims(t);
+                    if(!read_tile(t, tile_data.data())){
+                        success = false;
+                        continue;
+                    }
+                    auto tile_refactor = OrderedRefactor<T, Decomposer, Interleaver, Encoder, Compressor, ErrorCollector, ErrorEstimator, OrderedFileWriter>(decomposer, interleaver, encoder, compressor, collector, error_estimator, OrderedFileWriter("", ""));
+                    tile_refactor.negabinary = negabinary;
+                    tile_refactor.verbose = false;
+                    uint32_t buffer_size = tile_refactor.refactor_to_buffer_inplace(tile_data.data(), tile_size, tile_level(tile_size, target_level), num_bitplanes, buffer.data(), capacity);
+                    if(!buffer_size){
+                        std::cerr << "Tile " << t << " does not fit in its buffer" << std::endl;
+                        success = false;
+                        continue;
+                    }
+                    std::lock_guard<std::mutex> lock(write_mutex);
+                    if(!container.append(file, t, buffer.data(), buffer_size)) success = false;
+                }
+            });
+            if(!container.close_write(file) || !success){
+                std::cerr << "Failed to write tile container: " << container_file << std::endl;
+                exit(-1);
+            }
+            uint64_t container_size = 0;
+            for(uint32_t t=0; t<num_tiles; t++){
+                container_size += container.get_buffer_size(t);
+            }
+            timer.end();
+            timer.print("Tiled refactor");
+            return container_size;
+        }
+
+        // upper bound of the refactored buffer of a tile: bitplanes of the levels, their compression overhead and the metadata
+        static size_t buffer_capacity(size_t num_elements, uint8_t num_bitplanes){
+            return 2 * num_elements * std::max<size_t>(sizeof(T), num_bitplanes / 8 + 1) + 65536;
+        }
+
+        // levels a tile can be decomposed to, as limited by OrderedRefactor: small tiles at the end of the grid get fewer levels
+        static uint8_t tile_level(const std::vector<uint32_t>& tile_size, uint8_t target_level){
+            int max_level = (int) log2(*std::min_element(tile_size.begin(), tile_size.end())) - 1;
+            return std::max(0, std::min<int>(target_level, max_level));
+        }
+
+        Decomposer decomposer;
+        Interleaver interleaver;
+        Encoder encoder;
+        Compressor compressor;
+        ErrorCollector collector;
+        ErrorEstimator error_estimator;
+        std::string container_file;
+        TileContainer container;
+        std::shared_ptr<ThreadPool> thread_pool;
+    public:
+        bool negabinary = false;
+        // bound in bytes of the memory used by the tiles in flight (0: one tile per thread)
+        size_t memory_budget = 0;
+    };
+}
+#endif
@@ -2,8 +2,10 @@
 #define _MDR_REFACTOR_UTILS_HPP
 
 #include <cassert>
+#include <iostream>
 #include <vector>
 #include <cmath>
+#include <cstring>
 #include <ctime>
 
 namespace MDR {
@@ -17,8 +19,9 @@ namespace MDR {
     /*
         @params dims: input dimensions
         @params target_level: the target decomposition level
+        @params verbose: print when done
     */
-    std::vector<std::vector<uint32_t>> compute_level_dims(const std::vector<uint32_t>& dims, uint32_t target_level){
+    std::vector<std::vector<uint32_t>> compute_level_dims(const std::vector<uint32_t>& dims, uint32_t target_level, bool verbose=true){
         std::vector<std::vector<uint32_t>> level_dims;
         for(int i=0; i<=target_level; i++){
             level_dims.push_back(std::vector<uint32_t>(dims.size()));
@@ -30,7 +33,7 @@ namespace MDR {
                 n = (n >> 1) + 1;
             }
         }
-        std::cout << "Compute level dims success\n";
+        if(verbose) std::cout << "Compute level dims success\n";
         return level_dims;
     }
 
@@ -39,7 +42,7 @@ namespace MDR {
         @params level_dims: dimensions for all levels
         @params target_level: the target decomposition level
     */
-    std::vector<uint32_t> compute_level_elements(const std::vector<std::vector<uint32_t>>& level_dims, int target_level){
+    std::vector<uint32_t> compute_level_elements(const std::vector<std::vector<uint32_t>>& level_dims, int target_level, bool verbose=true){
         assert(level_dims.size());
         uint8_t num_dims = level_dims[0].size();
         std::vector<uint32_t> level_elements(level_dims.size());
@@ -56,7 +59,7 @@ namespace MDR {
             level_elements[i] = num_elements - pre_num_elements;
             pre_num_elements = num_elements;
         }
-        std::cout << "Compute level elements success\n";
+        if(verbose) std::cout << "Compute level elements success\n";
         return level_elements;
     }
 
@@ -102,10 +105,11 @@ namespace MDR {
     void serialize(const std::vector<std::vector<T>>& vec, uint8_t *& buffer_pos){
         uint8_t const * const start = buffer_pos;
         for(int i=0; i<vec.size(); i++){
-            *reinterpret_cast<uint32_t*>(buffer_pos) = vec[i].size();
+            const uint32_t num = vec[i].size();
+            memcpy(buffer_pos, &num, sizeof(uint32_t));
             buffer_pos += sizeof(uint32_t);
-            memcpy(buffer_pos, vec[i].data(), vec[i].size() * sizeof(T));
-            buffer_pos += vec[i].size() * sizeof(T);
+            if(num) memcpy(buffer_pos, vec[i].data(), num * sizeof(T));
+            buffer_pos += num * sizeof(T);
         }
     }
     template <class T>
@@ -118,7 +122,8 @@ namespace MDR {
     void deserialize(uint8_t const *& buffer_pos, uint32_t num_levels, std::vector<std::vector<T>>& vec){
         vec.clear();
         for(int i=0; i<num_levels; i++){
-            uint32_t num = *reinterpret_cast<const uint32_t*>(buffer_pos);
+            uint32_t num = 0;
+            memcpy(&num, buffer_pos, sizeof(uint32_t));
             buffer_pos += sizeof(uint32_t);
             std::vector<T> level_vec = std::vector<T>(reinterpret_cast<const T *>(buffer_pos), reinterpret_cast<const T *>(buffer_pos) + num);
             vec.push_back(level_vec);
@@ -126,6 +131,28 @@ namespace MDR {
         }
     }
 
+    // Metadata versioning
+    // versioned metadata starts with METADATA_VERSION_FLAG | version, legacy metadata starts with the number
+    // of dimensions, which never has the flag set; fields added after the legacy format are read by version
+    #define METADATA_VERSION_FLAG 0x80
+    // 1: element range offsets for parallel decoding and the codec of every bitplane
+    // 2: the dictionary set of every level
+    #define METADATA_VERSION 2
+
+    inline void serialize_version(uint8_t *& buffer_pos){
+        *(buffer_pos ++) = METADATA_VERSION_FLAG | METADATA_VERSION;
+    }
+    // return the version of the metadata, 0 for legacy metadata, -1 if it is newer than supported
+    inline int deserialize_version(uint8_t const *& buffer_pos){
+        if(!(*buffer_pos & METADATA_VERSION_FLAG)) return 0;
+        int version = *(buffer_pos ++) & ~METADATA_VERSION_FLAG;
+        if(version > METADATA_VERSION){
+            std::cerr << "Metadata version " << version << " is not supported" << std::endl;
+            return -1;
+        }
+        return version;
+    }
+
     // print vector
     template <class T>
     void print_vec(const std::vector<T>& vec){
@@ -0,0 +1,59 @@
+#ifndef _MDR_SCRATCH_BUFFER_HPP
+#define _MDR_SCRATCH_BUFFER_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+namespace MDR {
+
+    // growable scratch region that the decompressed streams of a level are carved from
+    // the region only grows, so once it fits the largest level, decompression allocates no more memory
+    class ScratchBuffer {
+    public:
+        ScratchBuffer(){}
+        // region owned by one buffer: copies start empty
+        ScratchBuffer(const ScratchBuffer&) : ScratchBuffer() {}
+        ScratchBuffer& operator=(const ScratchBuffer&){ return *this; }
+        ~ScratchBuffer(){
+            free(region);
+        }
+
+        // pieces[i] of at least sizes[i] bytes rounded up to whole SCRATCH_ALIGNMENT-aligned blocks;
+        // pieces of previous carves become invalid
+        void carve(const std::vector<size_t>& sizes, std::vector<uint8_t*>& pieces){
+            size_t total = 0;
+            for(auto size:sizes){
+                total += get_aligned_size(size);
+            }
+            if(total > capacity){
+                free(region);
+                capacity = get_aligned_size(std::max(total, capacity + capacity / 2));
+                region = (uint8_t *) aligned_alloc(SCRATCH_ALIGNMENT, capacity);
+                num_allocations ++;
+            }
+            pieces.resize(sizes.size());
+            size_t offset = 0;
+            for(int i=0; i<sizes.size(); i++){
+                pieces[i] = region + offset;
+                offset += get_aligned_size(sizes[i]);
+            }
+        }
+
+        size_t get_capacity() const { return capacity; }
+        // number of times the region was allocated
+        size_t get_num_allocations() const { return num_allocations; }
+
+    private:
+        static size_t get_aligned_size(size_t size){
+            return (size + SCRATCH_ALIGNMENT - 1) / SCRATCH_ALIGNMENT * SCRATCH_ALIGNMENT;
+        }
+
+        static const size_t SCRATCH_ALIGNMENT = 64;
+        uint8_t * region = NULL;
+        size_t capacity = 0;
+        size_t num_allocations = 0;
+    };
+}
+#endif
@@ -0,0 +1,110 @@
+#ifndef _MDR_STREAM_POOL_HPP
+#define _MDR_STREAM_POOL_HPP
+
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace MDR {
+
+    // pool of stream buffers shared by the encoders and level compressors of a refactor
+    // buffers are recycled by power-of-two size class instead of being returned to the system,
+    // so repeated refactor calls reuse the buffers of previous calls
+    class StreamPool {
+    public:
+        StreamPool(){}
+        // buffers are owned by one pool: copies start empty
+        StreamPool(const StreamPool&) : StreamPool() {}
+        StreamPool& operator=(const StreamPool&){ return *this; }
+        ~StreamPool(){
+            reset();
+            for(auto& free_list:free_lists){
+                for(auto buffer:free_list){
+                    free(buffer);
+                }
+            }
+        }
+
+        // buffer of at least size bytes; thread-safe
+        uint8_t * allocate(size_t size){
+            uint8_t size_class = get_size_class(size);
+            std::lock_guard<std::mutex> lock(mutex);
+            num_requests ++;
+            if(free_lists.size() <= size_class) free_lists.resize(size_class + 1);
+            uint8_t * buffer = NULL;
+            if(free_lists[size_class].size()){
+                buffer = free_lists[size_class].back();
+                free_lists[size_class].pop_back();
+            }
+            else{
+                buffer = (uint8_t *) malloc((size_t) 1 << size_class);
+                num_system_allocations ++;
+            }
+            in_use[buffer] = size_class;
+            return buffer;
+        }
+
+        // zero-initialized buffer of at least size bytes
+        uint8_t * allocate_zeroed(size_t size){
+            uint8_t * buffer = allocate(size);
+            memset(buffer, 0, size);
+            return buffer;
+        }
+
+        // recycle a buffer from allocate; buffers not from this pool are freed
+        void release(void * buffer){
+            if(buffer == NULL) return;
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = in_use.find(reinterpret_cast<uint8_t *>(buffer));
+            if(it == in_use.end()){
+                free(buffer);
+                return;
+            }
+            free_lists[it->second].push_back(it->first);
+            in_use.erase(it);
+        }
+
+        // recycle all buffers in use, which become invalid
+        void reset(){
+            std::lock_guard<std::mutex> lock(mutex);
+            for(const auto& buffer:in_use){
+                free_lists[buffer.second].push_back(buffer.first);
+            }
+            in_use.clear();
+        }
+
+        // number of buffers requested and number of them served by system allocation
+        size_t get_num_requests() const { return num_requests; }
+        size_t get_num_system_allocations() const { return num_system_allocations; }
+
+    private:
+        static uint8_t get_size_class(size_t size){
+            uint8_t size_class = MIN_SIZE_CLASS;
+            while(((size_t) 1 << size_class) < size) size_class ++;
+            return size_class;
+        }
+
+        static const uint8_t MIN_SIZE_CLASS = 12;
+        std::mutex mutex;
+        std::vector<std::vector<uint8_t *>> free_lists;
+        std::unordered_map<uint8_t *, uint8_t> in_use;
+        size_t num_requests = 0;
+        size_t num_system_allocations = 0;
+    };
+
+    // stream buffer from pool, or from the system without a pool
+    inline uint8_t * allocate_stream(StreamPool * pool, size_t size){
+        return pool ? pool->allocate(size) : (uint8_t *) malloc(size);
+    }
+    inline uint8_t * allocate_zeroed_stream(StreamPool * pool, size_t size){
+        return pool ? pool->allocate_zeroed(size) : (uint8_t *) calloc(size, 1);
+    }
+    inline void release_stream(StreamPool * pool, void * buffer){
+        if(pool) pool->release(buffer);
+        else free(buffer);
+    }
+}
+#endif
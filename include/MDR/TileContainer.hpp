@@ -0,0 +1,224 @@
+#ifndef _MDR_TILE_CONTAINER_HPP
+#define _MDR_TILE_CONTAINER_HPP
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+namespace MDR {
+    // a grid cut into fixed-size tiles (the last tiles of a dimension may be smaller), numbered in raster order,
+    // and the container file that stores every tile as an independent refactored buffer:
+    // [num_dims(uint8_t)][dims][tile_dims][num_tiles(uint32_t)][tile offsets(uint64_t)][tile sizes(uint64_t)][tile buffers]
+    // offsets are from the start of the file, so any part of a tile is read with one seek;
+    // tile buffers are appended in any order as the tiles are refactored, and the index is written last
+    class TileContainer {
+    public:
+        TileContainer(){}
+
+        TileContainer(const std::vector<uint32_t>& dims, const std::vector<uint32_t>& tile_dims) : dims(dims), tile_dims(tile_dims) {
+            grid_dims = std::vector<uint32_t>(dims.size());
+            for(int i=0; i<dims.size(); i++){
+                grid_dims[i] = (dims[i] + tile_dims[i] - 1) / tile_dims[i];
+            }
+        }
+
+        uint32_t get_num_tiles() const {
+            uint32_t num_tiles = 1;
+            for(auto n:grid_dims){
+                num_tiles *= n;
+            }
+            return num_tiles;
+        }
+
+        const std::vector<uint32_t>& get_dimensions() const {
+            return dims;
+        }
+
+        const std::vector<uint32_t>& get_tile_dimensions() const {
+            return tile_dims;
+        }
+
+        // origin of tile in the grid
+        std::vector<uint32_t> get_tile_begin(uint32_t tile) const {
+            std::vector<uint32_t> begin(dims.size());
+            for(int i=dims.size()-1; i>=0; i--){
+                begin[i] = (tile % grid_dims[i]) * tile_dims[i];
+                tile /= grid_dims[i];
+            }
+            return begin;
+        }
+
+        // dimensions of tile, clipped at the end of the grid
+        std::vector<uint32_t> get_tile_dims(uint32_t tile) const {
+            std::vector<uint32_t> begin = get_tile_begin(tile);
+            std::vector<uint32_t> size(dims.size());
+            for(int i=0; i<dims.size(); i++){
+                size[i] = std::min(tile_dims[i], dims[i] - begin[i]);
+            }
+            return size;
+        }
+
+        size_t get_tile_size(uint32_t tile) const {
+            size_t size = 1;
+            for(auto n:get_tile_dims(tile)){
+                size *= n;
+            }
+            return size;
+        }
+
+        // copy tile out of the grid into a compact array
+        template <class T>
+        void extract(T const * data, uint32_t tile, T * tile_data) const {
+            for_each_row(tile, [&](size_t offset, uint32_t length){
+                memcpy(tile_data, data + offset, length * sizeof(T));
+                tile_data += length;
+            });
+        }
+
+        // copy a compact tile array into the grid
+        template <class T>
+        void insert(T const * tile_data, uint32_t tile, T * data) const {
+            for_each_row(tile, [&](size_t offset, uint32_t length){
+                memcpy(data + offset, tile_data, length * sizeof(T));
+                tile_data += length;
+            });
+        }
+
+        // size in bytes of the refactored buffer of tile in the container
+        uint64_t get_buffer_size(uint32_t tile) const {
+            return sizes[tile];
+        }
+
+        // create the container with room for the index; the tiles are appended after it
+        FILE * open_write(const std::string& filename){
+            FILE * file = fopen(filename.c_str(), "wb");
+            if(!file){
+                std::cerr << "Failed to open tile container: " << filename << std::endl;
+                return NULL;
+            }
+            std::vector<uint8_t> header = serialize_header();
+            offsets = std::vector<uint64_t>(get_num_tiles(), 0);
+            sizes = std::vector<uint64_t>(get_num_tiles(), 0);
+            fwrite(header.data(), 1, header.size(), file);
+            fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), file);
+            fwrite(sizes.data(), sizeof(uint64_t), sizes.size(), file);
+            end = header.size() + 2 * offsets.size() * sizeof(uint64_t);
+            return file;
+        }
+
+        // append the buffer of tile at the end of the container; appends must not run concurrently
+        bool append(FILE * file, uint32_t tile, uint8_t const * buffer, uint64_t size){
+            offsets[tile] = end;
+            sizes[tile] = size;
+            end += size;
+            return fwrite(buffer, 1, size, file) == size;
+        }
+
+        // write the index and close the container
+        bool close_write(FILE * file){
+            bool success = !fseek(file, static_cast<long>(serialize_header().size()), SEEK_SET);
+            success = success && (fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), file) == offsets.size());
+            success = success && (fwrite(sizes.data(), sizeof(uint64_t), sizes.size(), file) == sizes.size());
+            fclose(file);
+            return success;
+        }
+
+        // read the header and the tile index of a container
+        bool load(const std::string& filename){
+            FILE * file = fopen(filename.c_str(), "rb");
+            if(!file){
+                std::cerr << "Failed to open tile container: " << filename << std::endl;
+                return false;
+            }
+            uint8_t num_dims = 0;
+            bool success = fread(&num_dims, sizeof(uint8_t), 1, file) == 1;
+            std::vector<uint32_t> container_dims(num_dims), container_tile_dims(num_dims);
+            success = success && (fread(container_dims.data(), sizeof(uint32_t), num_dims, file) == num_dims);
+            success = success && (fread(container_tile_dims.data(), sizeof(uint32_t), num_dims, file) == num_dims);
+            uint32_t num_tiles = 0;
+            success = success && (fread(&num_tiles, sizeof(uint32_t), 1, file) == 1);
+            if(success){
+                *this = TileContainer(container_dims, container_tile_dims);
+                offsets = std::vector<uint64_t>(num_tiles);
+                sizes = std::vector<uint64_t>(num_tiles);
+                success = (num_tiles == get_num_tiles()) && (fread(offsets.data(), sizeof(uint64_t), num_tiles, file) == num_tiles);
+                success = success && (fread(sizes.data(), sizeof(uint64_t), num_tiles, file) == num_tiles);
+            }
+            fclose(file);
+            if(!success){
+                std::cerr << "Corrupted tile container: " << filename << std::endl;
+            }
+            return success;
+        }
+
+        // read bytes [begin, begin + size) of the refactored buffer of tile from an open container into buffer
+        bool read_tile(FILE * file, uint32_t tile, uint64_t begin, uint64_t size, uint8_t * buffer) const {
+            if(begin + size > get_buffer_size(tile)){
+                std::cerr << "Read beyond the buffer of tile " << tile << std::endl;
+                return false;
+            }
+            if(fseek(file, static_cast<long>(offsets[tile] + begin), SEEK_SET)){
+                std::cerr << "Errors in fseek while retrieving tile " << tile << std::endl;
+                return false;
+            }
+            return fread(buffer, 1, size, file) == size;
+        }
+
+    private:
+        std::vector<uint8_t> serialize_header() const {
+            const uint8_t num_dims = dims.size();
+            const uint32_t num_tiles = get_num_tiles();
+            std::vector<uint8_t> header(sizeof(uint8_t) + 2 * num_dims * sizeof(uint32_t) + sizeof(uint32_t));
+            uint8_t * p = header.data();
+            *(p++) = num_dims;
+            memcpy(p, dims.data(), num_dims * sizeof(uint32_t));
+            p += num_dims * sizeof(uint32_t);
+            memcpy(p, tile_dims.data(), num_dims * sizeof(uint32_t));
+            p += num_dims * sizeof(uint32_t);
+            memcpy(p, &num_tiles, sizeof(uint32_t));
+            return header;
+        }
+
+        // f(grid offset, length) for the rows of the last dimension in tile, in order
+        template <class Func>
+        void for_each_row(uint32_t tile, Func f) const {
+            const int num_dims = dims.size();
+            const std::vector<uint32_t> begin = get_tile_begin(tile);
+            const std::vector<uint32_t> size = get_tile_dims(tile);
+            std::vector<size_t> strides(num_dims);
+            size_t stride = 1;
+            for(int i=num_dims-1; i>=0; i--){
+                strides[i] = stride;
+                stride *= dims[i];
+            }
+            std::vector<uint32_t> index(num_dims, 0);
+            while(true){
+                size_t offset = 0;
+                for(int i=0; i<num_dims; i++){
+                    offset += (begin[i] + index[i]) * strides[i];
+                }
+                f(offset, size[num_dims - 1]);
+                int d = num_dims - 2;
+                while((d >= 0) && (++index[d] == size[d])){
+                    index[d] = 0;
+                    d --;
+                }
+                if(d < 0) break;
+            }
+        }
+
+        std::vector<uint32_t> dims;
+        std::vector<uint32_t> tile_dims;
+        // number of tiles in every dimension
+        std::vector<uint32_t> grid_dims;
+        std::vector<uint64_t> offsets;
+        std::vector<uint64_t> sizes;
+        // end of the container being written
+        uint64_t end = 0;
+    };
+}
+#endif
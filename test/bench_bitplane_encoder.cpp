@@ -0,0 +1,82 @@
+#include <iostream>
+#include <ctime>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include "MDR/BitplaneEncoder/BitplaneEncoder.hpp"
+
+// encoding and decoding throughput of the bitplane encoders
+// encoders with kernels specialized on the bitplane count are timed with both the specialized and the generic kernels
+
+using namespace std;
+
+double get_time(const struct timespec& start, const struct timespec& end){
+    return (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec)/(double)1000000000;
+}
+
+template <class T, class Encoder>
+void benchmark(string name, const vector<T>& data, int num_bitplanes, int num_repeats, Encoder encoder){
+    T max_val = 0;
+    for(int i=0; i<data.size(); i++){
+        max_val = max(max_val, (T) fabs(data[i]));
+    }
+    int exp = 0;
+    frexp(max_val, &exp);
+    double encode_time = 0;
+    double decode_time = 0;
+    struct timespec start, end;
+    for(int r=0; r<num_repeats; r++){
+        vector<uint32_t> stream_sizes;
+        clock_gettime(CLOCK_REALTIME, &start);
+        auto streams = encoder.encode(data.data(), data.size(), exp, num_bitplanes, stream_sizes);
+        clock_gettime(CLOCK_REALTIME, &end);
+        encode_time = (r == 0) ? get_time(start, end) : min(encode_time, get_time(start, end));
+        vector<uint8_t const *> const_streams(streams.begin(), streams.end());
+        clock_gettime(CLOCK_REALTIME, &start);
+        T * decoded = encoder.decode(const_streams, data.size(), exp, num_bitplanes);
+        clock_gettime(CLOCK_REALTIME, &end);
+        decode_time = (r == 0) ? get_time(start, end) : min(decode_time, get_time(start, end));
+        free(decoded);
+        for(int i=0; i<streams.size(); i++){
+            free(streams[i]);
+        }
+    }
+    double size_mb = data.size() * sizeof(T) / 1048576.0;
+    cout << name << " (" << num_bitplanes << " bitplanes): encode " << encode_time << " s (" << size_mb / encode_time << " MB/s), decode " << decode_time << " s (" << size_mb / decode_time << " MB/s)" << endl;
+}
+
+template <class T, class Encoder>
+void compare_kernels(string name, const vector<T>& data, int num_bitplanes, int num_repeats, Encoder encoder){
+    encoder.set_fixed_bitplane_kernels(true);
+    benchmark(name + " specialized", data, num_bitplanes, num_repeats, encoder);
+    encoder.set_fixed_bitplane_kernels(false);
+    benchmark(name + " generic", data, num_bitplanes, num_repeats, encoder);
+}
+
+int main(int argc, char ** argv){
+    if(argc < 2){
+        cout << "usage: " << argv[0] << " num_elements [num_repeats]" << endl;
+        return 0;
+    }
+    size_t num_elements = atol(argv[1]);
+    int num_repeats = (argc > 2) ? atoi(argv[2]) : 5;
+    mt19937_64 generator(0);
+    normal_distribution<double> distribution(0, 1);
+    vector<double> data(num_elements);
+    for(int i=0; i<num_elements; i++){
+        data[i] = distribution(generator);
+    }
+    vector<float> data_f(data.begin(), data.end());
+
+    benchmark("Grouped<double, uint64_t>", data, 60, num_repeats, MDR::GroupedBPEncoder<double, uint64_t>());
+    benchmark("Grouped<double, uint32_t>", data, 60, num_repeats, MDR::GroupedBPEncoder<double, uint32_t>());
+    benchmark("Grouped<float, uint32_t>", data_f, 32, num_repeats, MDR::GroupedBPEncoder<float, uint32_t>());
+    benchmark("NegaBinary<double, uint64_t>", data, 60, num_repeats, MDR::NegaBinaryBPEncoder<double, uint64_t>());
+    compare_kernels("NegaBinary<float, uint32_t>", data_f, 32, num_repeats, MDR::NegaBinaryBPEncoder<float, uint32_t>());
+    benchmark("PerBit<double, uint32_t>", data, 60, num_repeats, MDR::PerBitBPEncoder<double, uint32_t>());
+    compare_kernels("PerBit<float, uint32_t>", data_f, 32, num_repeats, MDR::PerBitBPEncoder<float, uint32_t>());
+    return 0;
+}
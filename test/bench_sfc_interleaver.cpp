@@ -0,0 +1,96 @@
+#include <iostream>
+#include <ctime>
+#include <cstdlib>
+#include <vector>
+#include <cmath>
+#include <string>
+#include "utils.hpp"
+#include "MDR/Refactor/Refactor.hpp"
+#include "MDR/Reconstructor/Reconstructor.hpp"
+
+// bytes retrieved per tolerance with the direct (raster) and the SFC (tiled Morton) interleaver
+// the data is refactored once with each interleaver and reconstructed progressively at the given tolerances;
+// both retrieve the same bitplanes, so the difference is the compressed size of the bitplanes
+
+using namespace std;
+using T = float;
+using T_stream = uint32_t;
+
+template <class Interleaver>
+void refactor(const vector<T>& data, const vector<uint32_t>& dims, int target_level, int num_bitplanes, string prefix, Interleaver interleaver){
+    vector<string> files;
+    for(int i=0; i<=target_level; i++){
+        files.push_back(prefix + "level_" + to_string(i) + ".bin");
+    }
+    auto decomposer = MDR::MGARDHierarchicalDecomposer<T>();
+    auto encoder = MDR::NegaBinaryBPEncoder<T, T_stream>();
+    auto compressor = MDR::AdaptiveLevelCompressor(64);
+    auto collector = MDR::SquaredErrorCollector<T>();
+    auto writer = MDR::ConcatLevelFileWriter(prefix + "metadata.bin", files);
+    auto refactor = MDR::ComposedRefactor<T, decltype(decomposer), Interleaver, decltype(encoder), decltype(compressor), decltype(collector), decltype(writer)>(decomposer, interleaver, encoder, compressor, collector, writer);
+    refactor.negabinary = true;
+    refactor.refactor(data.data(), dims, target_level, num_bitplanes);
+}
+
+// retrieved size and maximal error at every tolerance
+template <class Interleaver>
+void reconstruct(const vector<T>& data, int target_level, const vector<double>& tolerance, string prefix, Interleaver interleaver, vector<size_t>& retrieved_sizes, vector<double>& max_errors){
+    vector<string> files;
+    for(int i=0; i<=target_level; i++){
+        files.push_back(prefix + "level_" + to_string(i) + ".bin");
+    }
+    auto decomposer = MDR::MGARDHierarchicalDecomposer<T>();
+    auto encoder = MDR::NegaBinaryBPEncoder<T, T_stream>();
+    auto compressor = MDR::AdaptiveLevelCompressor(64);
+    auto retriever = MDR::ConcatLevelFileRetriever(prefix + "metadata.bin", files);
+    auto estimator = MDR::MaxErrorEstimatorHB<T>();
+    auto interpreter = MDR::SignExcludeGreedyBasedSizeInterpreter<MDR::MaxErrorEstimatorHB<T>>(estimator);
+    auto reconstructor = MDR::ComposedReconstructor<T, decltype(decomposer), Interleaver, decltype(encoder), decltype(compressor), decltype(interpreter), decltype(estimator), decltype(retriever)>(decomposer, interleaver, encoder, compressor, interpreter, retriever);
+    reconstructor.load_metadata();
+    for(int i=0; i<tolerance.size(); i++){
+        auto reconstructed_data = reconstructor.progressive_reconstruct(tolerance[i], -1);
+        double max_error = 0;
+        for(size_t j=0; j<data.size(); j++){
+            max_error = max(max_error, (double) fabs(data[j] - reconstructed_data[j]));
+        }
+        retrieved_sizes.push_back(reconstructor.get_retrieved_size());
+        max_errors.push_back(max_error);
+    }
+}
+
+int main(int argc, char ** argv){
+    if(argc < 7){
+        cout << "usage: " << argv[0] << " filename target_level num_bitplanes num_dims dims... num_tolerance tolerances..." << endl;
+        return 0;
+    }
+    int argv_id = 1;
+    string filename = string(argv[argv_id ++]);
+    int target_level = atoi(argv[argv_id ++]);
+    int num_bitplanes = min(atoi(argv[argv_id ++]), 32);
+    if(num_bitplanes % 2 == 1) num_bitplanes += 1;
+    int num_dims = atoi(argv[argv_id ++]);
+    vector<uint32_t> dims(num_dims, 0);
+    for(int i=0; i<num_dims; i++){
+        dims[i] = atoi(argv[argv_id ++]);
+    }
+    int num_tolerance = atoi(argv[argv_id ++]);
+    vector<double> tolerance(num_tolerance, 0);
+    for(int i=0; i<num_tolerance; i++){
+        tolerance[i] = atof(argv[argv_id ++]);
+    }
+    size_t num_elements = 0;
+    auto data = MGARD::readfile<T>(filename.c_str(), num_elements);
+
+    refactor(data, dims, target_level, num_bitplanes, "refactored_data/direct_", MDR::DirectInterleaver<T>());
+    refactor(data, dims, target_level, num_bitplanes, "refactored_data/sfc_", MDR::SFCInterleaver<T>());
+    vector<size_t> direct_sizes, sfc_sizes;
+    vector<double> direct_errors, sfc_errors;
+    reconstruct(data, target_level, tolerance, "refactored_data/direct_", MDR::DirectInterleaver<T>(), direct_sizes, direct_errors);
+    reconstruct(data, target_level, tolerance, "refactored_data/sfc_", MDR::SFCInterleaver<T>(), sfc_sizes, sfc_errors);
+
+    cout << "tolerance\tdirect bytes\tsfc bytes\tsfc/direct\tdirect max error\tsfc max error" << endl;
+    for(int i=0; i<num_tolerance; i++){
+        cout << tolerance[i] << "\t" << direct_sizes[i] << "\t" << sfc_sizes[i] << "\t" << sfc_sizes[i] * 100.0 / direct_sizes[i] << "%\t" << direct_errors[i] << "\t" << sfc_errors[i] << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,103 @@
+#include <iostream>
+#include <ctime>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include "MDR/BitplaneEncoder/BitplaneEncoder.hpp"
+#include "MDR/LosslessCompressor/LevelCompressor.hpp"
+#include "MDR/StreamPool.hpp"
+
+// stream buffer allocations of repeated refactors with and without a stream pool
+// each refactor encodes and compresses the levels of a 3D hierarchy the way ComposedRefactor does;
+// without the pool every requested buffer is a system allocation
+
+using namespace std;
+
+double get_time(const struct timespec& start, const struct timespec& end){
+    return (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec)/(double)1000000000;
+}
+
+template <class T, class Encoder, class Compressor>
+double refactor_levels(const vector<T>& data, const vector<uint32_t>& level_elements, int num_bitplanes, Encoder& encoder, Compressor& compressor, MDR::StreamPool * pool){
+    struct timespec start, end;
+    clock_gettime(CLOCK_REALTIME, &start);
+    if(pool) pool->reset();
+    encoder.set_stream_pool(pool);
+    compressor.set_stream_pool(pool);
+    vector<vector<uint8_t *>> level_components;
+    uint32_t offset = 0;
+    for(int i=0; i<level_elements.size(); i++){
+        T * buffer = reinterpret_cast<T *>(MDR::allocate_stream(pool, level_elements[i] * sizeof(T)));
+        memcpy(buffer, data.data() + offset, level_elements[i] * sizeof(T));
+        offset += level_elements[i];
+        T max_val = 0;
+        for(int j=0; j<level_elements[i]; j++){
+            max_val = max(max_val, (T) fabs(buffer[j]));
+        }
+        int exp = 0;
+        frexp(max_val, &exp);
+        vector<uint32_t> stream_sizes;
+        vector<uint32_t> range_offsets;
+        auto streams = encoder.encode(buffer, level_elements[i], exp, num_bitplanes, stream_sizes, range_offsets);
+        MDR::release_stream(pool, buffer);
+        compressor.compress_level(streams, stream_sizes);
+        level_components.push_back(streams);
+    }
+    for(int i=0; i<level_components.size(); i++){
+        for(int j=0; j<level_components[i].size(); j++){
+            MDR::release_stream(pool, level_components[i][j]);
+        }
+    }
+    clock_gettime(CLOCK_REALTIME, &end);
+    return get_time(start, end);
+}
+
+template <class T, class Encoder>
+void benchmark(string name, const vector<T>& data, const vector<uint32_t>& level_elements, int num_bitplanes, int num_refactors, Encoder encoder){
+    MDR::AdaptiveLevelCompressor compressor(64);
+    double malloc_time = 0;
+    for(int r=0; r<num_refactors; r++){
+        malloc_time += refactor_levels(data, level_elements, num_bitplanes, encoder, compressor, NULL);
+    }
+    MDR::StreamPool pool;
+    double pool_time = 0;
+    for(int r=0; r<num_refactors; r++){
+        pool_time += refactor_levels(data, level_elements, num_bitplanes, encoder, compressor, &pool);
+    }
+    cout << name << ": " << num_refactors << " refactors, " << pool.get_num_requests() << " stream buffers" << endl;
+    cout << "  without pool: " << pool.get_num_requests() << " system allocations, " << malloc_time << " s" << endl;
+    cout << "  with pool:    " << pool.get_num_system_allocations() << " system allocations, " << pool_time << " s" << endl;
+}
+
+int main(int argc, char ** argv){
+    if(argc < 2){
+        cout << "usage: " << argv[0] << " num_elements [num_refactors]" << endl;
+        return 0;
+    }
+    uint32_t num_elements = atol(argv[1]);
+    int num_refactors = (argc > 2) ? atoi(argv[2]) : 10;
+    // level sizes of a 3D hierarchy with 4 levels, coarsest first
+    const int num_levels = 4;
+    vector<uint32_t> level_elements;
+    uint32_t prev_elements = 0;
+    for(int i=0; i<num_levels; i++){
+        uint32_t elements = num_elements >> (3 * (num_levels - 1 - i));
+        level_elements.push_back(elements - prev_elements);
+        prev_elements = elements;
+    }
+    mt19937_64 generator(0);
+    normal_distribution<double> distribution(0, 1);
+    vector<double> data(prev_elements);
+    for(int i=0; i<data.size(); i++){
+        data[i] = distribution(generator);
+    }
+    vector<float> data_f(data.begin(), data.end());
+
+    benchmark("Grouped<double, uint32_t>", data, level_elements, 60, num_refactors, MDR::GroupedBPEncoder<double, uint32_t>());
+    benchmark("NegaBinary<float, uint32_t>", data_f, level_elements, 32, num_refactors, MDR::NegaBinaryBPEncoder<float, uint32_t>());
+    benchmark("PerBit<float, uint32_t>", data_f, level_elements, 32, num_refactors, MDR::PerBitBPEncoder<float, uint32_t>());
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include <iostream>
+#include <ctime>
+#include <cstdlib>
+#include <vector>
+#include <cmath>
+#include <string>
+#include <sys/resource.h>
+#include "utils.hpp"
+#include "MDR/Refactor/Refactor.hpp"
+#include "MDR/Reconstructor/Reconstructor.hpp"
+
+// scaling of the tiled refactor and reconstructor against the tile size and the number of threads
+// the data is refactored in cubic tiles of every given edge with every given number of threads, then all tiles
+// and a single tile are reconstructed to the tolerance, reporting the bytes retrieved for all tiles;
+// with a memory budget (MB), the tiles are streamed from the file by RawFileReader instead of being cut from
+// the field in memory, which is only read for the reconstructions after all refactors;
+// the peak RSS of the process when every refactor is done and the table are printed at the end
+
+using namespace std;
+using T = float;
+using T_stream = uint32_t;
+
+struct Result {
+    uint32_t tile_edge;
+    int num_threads;
+    uint32_t num_tiles;
+    uint64_t container_size;
+    double refactor_time;
+    double reconstruct_time;
+    double tile_time;
+    size_t retrieved_size;
+    double max_error;
+    // ru_maxrss after the refactor (KB)
+    long peak_rss;
+};
+
+double elapsed(const struct timespec& start, const struct timespec& end){
+    return (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1000000000.0;
+}
+
+// refactor data, or the file through a RawFileReader when data is NULL
+Result refactor(T const * data, const string& filename, size_t memory_budget, const vector<uint32_t>& dims, int target_level, int num_bitplanes, uint32_t tile_edge, int num_threads, string container_file){
+    Result result = {tile_edge, num_threads};
+    vector<uint32_t> tile_dims(dims.size(), tile_edge);
+    // single-threaded components: the parallelism is over the tiles
+    auto decomposer = MDR::ParallelHierarchicalDecomposer<T>(1);
+    auto interleaver = MDR::DirectInterleaver<T>();
+    auto encoder = MDR::NegaBinaryBPEncoder<T, T_stream>();
+    auto compressor = MDR::AdaptiveLevelCompressor(64);
+    auto collector = MDR::MaxErrorCollector<T>();
+    auto estimator = MDR::MaxErrorEstimatorHB<T>();
+    auto refactor = MDR::TiledRefactor<T, decltype(decomposer), decltype(interleaver), decltype(encoder), decltype(compressor), decltype(collector), decltype(estimator)>(decomposer, interleaver, encoder, compressor, collector, estimator, container_file, num_threads);
+    refactor.negabinary = true;
+    struct timespec start, end;
+    clock_gettime(CLOCK_REALTIME, &start);
+    if(data) result.container_size = refactor.refactor(data, dims, tile_dims, target_level, num_bitplanes);
+    else{
+        refactor.memory_budget = memory_budget;
+        MDR::RawFileReader<T> reader(filename, dims);
+        result.container_size = refactor.refactor(reader, tile_dims, target_level, num_bitplanes);
+    }
+    clock_gettime(CLOCK_REALTIME, &end);
+    result.refactor_time = elapsed(start, end);
+    result.num_tiles = refactor.get_container().get_num_tiles();
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    result.peak_rss = usage.ru_maxrss;
+    return result;
+}
+
+void reconstruct(const vector<T>& data, double tolerance, string container_file, Result& result){
+    auto decomposer = MDR::ParallelHierarchicalDecomposer<T>(1);
+    auto interleaver = MDR::DirectInterleaver<T>();
+    auto encoder = MDR::NegaBinaryBPEncoder<T, T_stream>();
+    auto compressor = MDR::AdaptiveLevelCompressor(64);
+    auto estimator = MDR::MaxErrorEstimatorHB<T>();
+    auto interpreter = MDR::SignExcludeGreedyBasedSizeInterpreter<MDR::MaxErrorEstimatorHB<T>>(estimator);
+    const int num_threads = result.num_threads;
+    struct timespec start, end;
+    {
+        auto reconstructor = MDR::TiledReconstructor<T, decltype(decomposer), decltype(interleaver), decltype(encoder), decltype(compressor), decltype(interpreter), decltype(estimator)>(decomposer, interleaver, encoder, compressor, interpreter, container_file, num_threads);
+        clock_gettime(CLOCK_REALTIME, &start);
+        reconstructor.load_metadata();
+        auto reconstructed_data = reconstructor.reconstruct(tolerance);
+        clock_gettime(CLOCK_REALTIME, &end);
+        result.reconstruct_time = elapsed(start, end);
+        result.retrieved_size = reconstructor.get_retrieved_size();
+        result.max_error = 0;
+        for(size_t i=0; i<data.size(); i++){
+            result.max_error = max(result.max_error, (double) fabs(data[i] - reconstructed_data[i]));
+        }
+    }
+    {
+        // random access: the middle tile only
+        auto reconstructor = MDR::TiledReconstructor<T, decltype(decomposer), decltype(interleaver), decltype(encoder), decltype(compressor), decltype(interpreter), decltype(estimator)>(decomposer, interleaver, encoder, compressor, interpreter, container_file, num_threads);
+        clock_gettime(CLOCK_REALTIME, &start);
+        reconstructor.load_metadata();
+        reconstructor.reconstruct_tiles({result.num_tiles / 2}, {tolerance});
+        clock_gettime(CLOCK_REALTIME, &end);
+        result.tile_time = elapsed(start, end);
+    }
+}
+
+int main(int argc, char ** argv){
+    if(argc < 10){
+        cout << "usage: " << argv[0] << " filename target_level num_bitplanes tolerance num_dims dims... num_tile_edges tile_edges... num_thread_counts thread_counts... [memory_budget_mb]" << endl;
+        return 0;
+    }
+    int argv_id = 1;
+    string filename = string(argv[argv_id ++]);
+    int target_level = atoi(argv[argv_id ++]);
+    int num_bitplanes = min(atoi(argv[argv_id ++]), 32);
+    if(num_bitplanes % 2 == 1) num_bitplanes += 1;
+    double tolerance = atof(argv[argv_id ++]);
+    int num_dims = atoi(argv[argv_id ++]);
+    vector<uint32_t> dims(num_dims, 0);
+    for(int i=0; i<num_dims; i++){
+        dims[i] = atoi(argv[argv_id ++]);
+    }
+    int num_tile_edges = atoi(argv[argv_id ++]);
+    vector<uint32_t> tile_edges(num_tile_edges, 0);
+    for(int i=0; i<num_tile_edges; i++){
+        tile_edges[i] = atoi(argv[argv_id ++]);
+    }
+    int num_thread_counts = atoi(argv[argv_id ++]);
+    vector<int> thread_counts(num_thread_counts, 0);
+    for(int i=0; i<num_thread_counts; i++){
+        thread_counts[i] = atoi(argv[argv_id ++]);
+    }
+    // 0: the field is refactored in memory
+    size_t memory_budget = (argv_id < argc) ? atof(argv[argv_id ++]) * 1024 * 1024 : 0;
+    size_t num_elements = 0;
+    vector<T> data;
+    if(!memory_budget) data = MGARD::readfile<T>(filename.c_str(), num_elements);
+
+    vector<Result> results;
+    vector<string> container_files;
+    for(auto tile_edge:tile_edges){
+        for(auto num_threads:thread_counts){
+            container_files.push_back("refactored_data/tiled_" + to_string(tile_edge) + "_" + to_string(num_threads) + ".bin");
+            results.push_back(refactor(memory_budget ? NULL : data.data(), filename, memory_budget, dims, target_level, num_bitplanes, tile_edge, num_threads, container_files.back()));
+        }
+    }
+    if(memory_budget) data = MGARD::readfile<T>(filename.c_str(), num_elements);
+    for(int i=0; i<results.size(); i++){
+        reconstruct(data, tolerance, container_files[i], results[i]);
+    }
+
+    cout << "tile edge\tthreads\ttiles\tratio\trefactor (s)\tspeedup\tpeak RSS (MB)\treconstruct (s)\tspeedup\tone tile (s)\tretrieved\tmax error" << endl;
+    for(int i=0; i<results.size(); i++){
+        // speedups against the first thread count of the same tile size
+        const Result& base = results[i - i % num_thread_counts];
+        const Result& r = results[i];
+        cout << r.tile_edge << "\t" << r.num_threads << "\t" << r.num_tiles << "\t" << num_elements * sizeof(T) * 1.0 / r.container_size << "\t" << r.refactor_time << "\t" << base.refactor_time / r.refactor_time << "\t" << r.peak_rss / 1024.0 << "\t" << r.reconstruct_time << "\t" << base.reconstruct_time / r.reconstruct_time << "\t" << r.tile_time << "\t" << r.retrieved_size << "\t" << r.max_error << endl;
+    }
+    return 0;
+}
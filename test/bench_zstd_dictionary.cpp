@@ -0,0 +1,158 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <cmath>
+#include <random>
+#include <memory>
+#include <string>
+#include "MDR/BitplaneEncoder/BitplaneEncoder.hpp"
+#include "MDR/LosslessCompressor/LevelCompressor.hpp"
+
+// bytes retrieved at loose tolerances with and without trained ZSTD dictionaries
+// every timestep refactors the levels of a 3D hierarchy for several variables the way ComposedRefactor does;
+// a variable keeps its coefficient magnitudes across timesteps (same blocks, slowly varying fields).
+// dictionaries are trained on the first timestep, saved and reloaded, and used for the remaining ones;
+// retrieving at a loose tolerance is modelled as fetching the first k bitplanes of every level
+
+using namespace std;
+
+const int num_variables = 5;
+const int num_levels = 4;
+const int num_bitplanes = 32;
+const vector<int> retrieved_bitplanes = {1, 2, 4, 8};
+
+// coefficients of variable v at timestep t: the coefficients of the variable with a small relative variation
+vector<float> generate_coefficients(const vector<float>& coefficients, int v, int t, float variation){
+    mt19937_64 generator(v * 1000 + t);
+    normal_distribution<float> distribution(1, variation);
+    vector<float> data(coefficients.size());
+    for(int i=0; i<data.size(); i++){
+        data[i] = coefficients[i] * distribution(generator);
+    }
+    return data;
+}
+
+// compressed sizes of all bitplanes of all levels
+template <class Compressor>
+vector<vector<uint32_t>> refactor_levels(const vector<float>& data, const vector<uint32_t>& level_elements, Compressor& compressor){
+    auto encoder = MDR::PerBitBPEncoder<float, uint32_t>();
+    vector<vector<uint32_t>> level_sizes;
+    uint32_t offset = 0;
+    for(int i=0; i<level_elements.size(); i++){
+        vector<float> buffer(data.begin() + offset, data.begin() + offset + level_elements[i]);
+        offset += level_elements[i];
+        float max_val = 0;
+        for(int j=0; j<buffer.size(); j++){
+            max_val = max(max_val, fabs(buffer[j]));
+        }
+        int exp = 0;
+        frexp(max_val, &exp);
+        vector<uint32_t> stream_sizes;
+        vector<uint32_t> range_offsets;
+        auto streams = encoder.encode(buffer.data(), buffer.size(), exp, num_bitplanes, stream_sizes, range_offsets);
+        vector<uint8_t> codecs;
+        compressor.compress_level(streams, stream_sizes, codecs, i);
+        for(int j=0; j<streams.size(); j++){
+            free(streams[j]);
+        }
+        level_sizes.push_back(stream_sizes);
+    }
+    return level_sizes;
+}
+
+// bytes of the first k bitplanes of every level, for every k in retrieved_bitplanes
+void accumulate_retrieved_sizes(const vector<vector<uint32_t>>& level_sizes, vector<size_t>& retrieved_sizes){
+    for(int r=0; r<retrieved_bitplanes.size(); r++){
+        for(int i=0; i<level_sizes.size(); i++){
+            for(int j=0; j<retrieved_bitplanes[r]; j++){
+                retrieved_sizes[r] += level_sizes[i][j];
+            }
+        }
+    }
+}
+
+void print_retrieved_sizes(string name, const vector<size_t>& retrieved_sizes, const vector<size_t>& baseline, size_t dictionary_size){
+    cout << name;
+    for(int r=0; r<retrieved_bitplanes.size(); r++){
+        cout << "\t" << retrieved_sizes[r] << " (" << retrieved_sizes[r] * 100.0 / baseline[r] << "%)";
+    }
+    cout << "\tdictionaries: " << dictionary_size << " bytes" << endl;
+}
+
+int main(int argc, char ** argv){
+    if(argc < 2){
+        cout << "usage: " << argv[0] << " num_elements [num_timesteps] [variation] [dictionary_file]" << endl;
+        return 0;
+    }
+    uint32_t num_elements = atol(argv[1]);
+    int num_timesteps = (argc > 2) ? atoi(argv[2]) : 4;
+    float variation = (argc > 3) ? atof(argv[3]) : 0.05;
+    string dictionary_file = (argc > 4) ? argv[4] : "zstd_dictionaries.dat";
+    // level sizes of a 3D hierarchy, coarsest first
+    vector<uint32_t> level_elements;
+    uint32_t prev_elements = 0;
+    for(int i=0; i<num_levels; i++){
+        uint32_t elements = num_elements >> (3 * (num_levels - 1 - i));
+        level_elements.push_back(elements - prev_elements);
+        prev_elements = elements;
+    }
+    // coefficients of every variable, with magnitudes decaying with the level
+    vector<vector<float>> coefficients(num_variables);
+    for(int v=0; v<num_variables; v++){
+        mt19937_64 generator(v);
+        lognormal_distribution<float> distribution(0, 1.5);
+        uniform_int_distribution<int> sign(0, 1);
+        for(int i=0; i<num_levels; i++){
+            for(int j=0; j<level_elements[i]; j++){
+                coefficients[v].push_back(distribution(generator) * pow(0.25, i) * (sign(generator) ? 1 : -1));
+            }
+        }
+    }
+
+    // train on the first timestep: one set with a dictionary per level for all variables, and one set per variable
+    auto level_dictionaries = make_shared<MDR::ZSTDDictionaries>(true);
+    vector<shared_ptr<MDR::ZSTDDictionaries>> variable_dictionaries;
+    for(int v=0; v<num_variables; v++){
+        variable_dictionaries.push_back(make_shared<MDR::ZSTDDictionaries>(false));
+        auto data = generate_coefficients(coefficients[v], v, 0, variation);
+        MDR::DictionaryLevelCompressor level_compressor(level_dictionaries);
+        MDR::DictionaryLevelCompressor variable_compressor(variable_dictionaries[v]);
+        refactor_levels(data, level_elements, level_compressor);
+        refactor_levels(data, level_elements, variable_compressor);
+    }
+    level_dictionaries->train();
+    level_dictionaries->save(dictionary_file);
+    level_dictionaries = make_shared<MDR::ZSTDDictionaries>();
+    level_dictionaries->load(dictionary_file);
+    size_t variable_dictionary_size = 0;
+    for(int v=0; v<num_variables; v++){
+        variable_dictionaries[v]->train();
+        variable_dictionary_size += variable_dictionaries[v]->get_dictionary_size();
+    }
+
+    vector<size_t> default_sizes(retrieved_bitplanes.size(), 0);
+    vector<size_t> level_dictionary_sizes(retrieved_bitplanes.size(), 0);
+    vector<size_t> variable_dictionary_sizes(retrieved_bitplanes.size(), 0);
+    for(int t=1; t<num_timesteps; t++){
+        for(int v=0; v<num_variables; v++){
+            auto data = generate_coefficients(coefficients[v], v, t, variation);
+            MDR::DefaultLevelCompressor default_compressor;
+            MDR::DictionaryLevelCompressor level_compressor(level_dictionaries);
+            MDR::DictionaryLevelCompressor variable_compressor(variable_dictionaries[v]);
+            accumulate_retrieved_sizes(refactor_levels(data, level_elements, default_compressor), default_sizes);
+            accumulate_retrieved_sizes(refactor_levels(data, level_elements, level_compressor), level_dictionary_sizes);
+            accumulate_retrieved_sizes(refactor_levels(data, level_elements, variable_compressor), variable_dictionary_sizes);
+        }
+    }
+    cout << num_variables << " variables, " << num_timesteps - 1 << " timesteps after training, level elements";
+    for(auto n:level_elements) cout << " " << n;
+    cout << endl;
+    cout << "bytes retrieved for the first";
+    for(auto k:retrieved_bitplanes) cout << "\t" << k << " bitplanes";
+    cout << endl;
+    print_retrieved_sizes("no dictionary", default_sizes, default_sizes, 0);
+    print_retrieved_sizes("per level", level_dictionary_sizes, default_sizes, level_dictionaries->get_dictionary_size());
+    print_retrieved_sizes("per variable", variable_dictionary_sizes, default_sizes, variable_dictionary_size);
+    return 0;
+}
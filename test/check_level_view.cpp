@@ -0,0 +1,216 @@
+#include <iostream>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include "MDR/Interleaver/Interleaver.hpp"
+
+// checks the orders of the level views against reference gathers of the level elements:
+// raster order for DirectInterleaver, the tiled Morton order of MortonLayout for SFCInterleaver,
+// and the order of interleave for the default level_view of an interleaver without its own view
+
+using namespace std;
+using T = double;
+
+int num_failures = 0;
+
+void check(bool condition, const string& message){
+    if(!condition){
+        cout << "FAILED: " << message << endl;
+        num_failures ++;
+    }
+}
+
+struct Level {
+    vector<uint32_t> dims;
+    vector<uint32_t> fine;
+    vector<uint32_t> coarse;
+    vector<uint32_t> strides;
+    string name;
+};
+
+// grid offset of index in the level
+size_t grid_offset(const Level& level, const vector<uint32_t>& index){
+    vector<uint32_t> strides = level.strides;
+    if(strides.empty()){
+        strides.resize(level.dims.size());
+        uint32_t stride = 1;
+        for(int d=level.dims.size()-1; d>=0; d--){
+            strides[d] = stride;
+            stride *= level.dims[d];
+        }
+    }
+    size_t offset = 0;
+    for(int d=0; d<index.size(); d++){
+        offset += index[d] * strides[d];
+    }
+    return offset;
+}
+
+bool in_level(const Level& level, const vector<uint32_t>& index){
+    for(int d=0; d<index.size(); d++){
+        if(index[d] >= level.fine[d]) return false;
+    }
+    for(int d=0; d<index.size(); d++){
+        if(index[d] >= level.coarse[d]) return true;
+    }
+    return false;
+}
+
+// offsets of the level elements in raster order
+vector<size_t> raster_order(const Level& level){
+    vector<size_t> offsets;
+    const int num_dims = level.fine.size();
+    vector<uint32_t> index(num_dims, 0);
+    size_t num_elements = 1;
+    for(auto n:level.fine) num_elements *= n;
+    for(size_t i=0; i<num_elements; i++){
+        size_t remaining = i;
+        for(int d=num_dims-1; d>=0; d--){
+            index[d] = remaining % level.fine[d];
+            remaining /= level.fine[d];
+        }
+        if(in_level(level, index)) offsets.push_back(grid_offset(level, index));
+    }
+    return offsets;
+}
+
+// offsets of the level elements in tiled Morton order: tiles of up to 2^MORTON_TILE_BITS elements in raster order,
+// tile bits given to the dimensions in turn from the fastest while the tile fits, and code bits interleaved in the same turns
+vector<size_t> morton_order(const Level& level){
+    const int num_dims = level.fine.size();
+    vector<int> bits(num_dims, 0);
+    vector<int> turns;
+    int total_bits = 0;
+    bool grown = true;
+    while(grown && (total_bits < MORTON_TILE_BITS)){
+        grown = false;
+        for(int d=num_dims-1; (d>=0) && (total_bits < MORTON_TILE_BITS); d--){
+            if((1u << bits[d]) < level.fine[d]){
+                bits[d] ++;
+                total_bits ++;
+                grown = true;
+            }
+        }
+    }
+    for(int b=0; turns.size()<total_bits; b++){
+        for(int d=num_dims-1; d>=0; d--){
+            if(b < bits[d]) turns.push_back(d);
+        }
+    }
+    vector<uint32_t> tiles(num_dims);
+    size_t num_tiles = 1;
+    for(int d=0; d<num_dims; d++){
+        tiles[d] = (level.fine[d] + (1u << bits[d]) - 1) >> bits[d];
+        num_tiles *= tiles[d];
+    }
+    vector<size_t> offsets;
+    vector<uint32_t> index(num_dims);
+    for(size_t t=0; t<num_tiles; t++){
+        vector<uint32_t> origin(num_dims);
+        size_t remaining = t;
+        for(int d=num_dims-1; d>=0; d--){
+            origin[d] = (remaining % tiles[d]) << bits[d];
+            remaining /= tiles[d];
+        }
+        for(uint32_t code=0; code<(1u << total_bits); code++){
+            index = origin;
+            vector<int> next_bit(num_dims, 0);
+            for(int bit=0; bit<total_bits; bit++){
+                const int d = turns[bit];
+                index[d] += ((code >> bit) & 1u) << (next_bit[d] ++);
+            }
+            if(in_level(level, index)) offsets.push_back(grid_offset(level, index));
+        }
+    }
+    return offsets;
+}
+
+// an interleaver without its own level_view: the level in reverse raster order
+class ReverseInterleaver : public MDR::concepts::InterleaverInterface<T> {
+public:
+    void interleave(T const * data, const vector<uint32_t>& dims, const vector<uint32_t>& dims_fine, const vector<uint32_t>& dims_coarse, T * buffer, vector<uint32_t> strides=vector<uint32_t>()) const {
+        const size_t n = MDR::LevelShape(dims, dims_fine, dims_coarse, strides).size();
+        MDR::DirectInterleaver<T>().interleave(data, dims, dims_fine, dims_coarse, buffer, strides);
+        reverse(buffer, buffer + n);
+    }
+    void reposition(T const * buffer, const vector<uint32_t>& dims, const vector<uint32_t>& dims_fine, const vector<uint32_t>& dims_coarse, T * data, vector<uint32_t> strides=vector<uint32_t>()) const {
+        const size_t n = MDR::LevelShape(dims, dims_fine, dims_coarse, strides).size();
+        vector<T> reversed(buffer, buffer + n);
+        reverse(reversed.begin(), reversed.end());
+        MDR::DirectInterleaver<T>().reposition(reversed.data(), dims, dims_fine, dims_coarse, data, strides);
+    }
+    void print() const {}
+};
+
+// reading and writing through the level view of interleaver follow the reference order;
+// reading from a cursor placed with at() continues the same order
+template <class Interleaver>
+void check_view(const Level& level, const Interleaver& interleaver, const vector<size_t>& reference, const string& name){
+    const string message = name + " " + level.name;
+    size_t grid_size = grid_offset(level, level.dims) + 1;
+    vector<T> grid(grid_size);
+    iota(grid.begin(), grid.end(), 0);
+    const uint32_t n = reference.size();
+    vector<T> expected(n);
+    for(uint32_t i=0; i<n; i++){
+        expected[i] = grid[reference[i]];
+    }
+    {
+        auto view = interleaver.level_view(level.dims, level.fine, level.coarse, grid.data(), level.strides);
+        check(view.size() == n, message + ": size");
+        vector<T> values(n);
+        view.read(values.data(), n);
+        check(values == expected, message + ": read order");
+        const uint32_t middle = n / 3;
+        auto middle_view = view.at(middle);
+        vector<T> tail(n - middle);
+        middle_view.read(tail.data(), tail.size());
+        check(equal(tail.begin(), tail.end(), expected.begin() + middle), message + ": read from at()");
+    }
+    vector<T> interleaved(n);
+    interleaver.interleave(grid.data(), level.dims, level.fine, level.coarse, interleaved.data(), level.strides);
+    check(interleaved == expected, message + ": interleave order");
+    // write -1, -2, ... in view order; elements outside the level keep their value
+    vector<T> written(grid);
+    {
+        auto view = interleaver.level_view(level.dims, level.fine, level.coarse, written.data(), level.strides);
+        vector<T> values(n);
+        for(uint32_t i=0; i<n; i++){
+            values[i] = - (T) (i + 1);
+        }
+        const uint32_t half = n / 2;
+        view.write(values.data(), half);
+        view.write(values.data() + half, n - half);
+    }
+    vector<T> expected_written(grid);
+    for(uint32_t i=0; i<n; i++){
+        expected_written[reference[i]] = - (T) (i + 1);
+    }
+    check(written == expected_written, message + ": write order");
+}
+
+int main(int argc, char ** argv){
+    vector<Level> levels = {
+        {{1000}, {1000}, {501}, {}, "1D"},
+        {{33, 47}, {33, 47}, {17, 24}, {}, "2D odd"},
+        {{64, 64}, {64, 64}, {33, 33}, {}, "2D even"},
+        {{97, 97, 97}, {49, 49, 49}, {25, 25, 25}, {}, "3D coarser level"},
+        {{10, 70, 300}, {10, 70, 300}, {6, 36, 151}, {}, "3D flat"},
+        {{9, 9, 9, 12}, {9, 9, 9, 12}, {5, 5, 5, 7}, {}, "4D"},
+        {{17, 33, 20}, {17, 33, 20}, {9, 17, 11}, {2000, 50, 1}, "3D strided"},
+    };
+    for(const auto& level:levels){
+        const vector<size_t> raster = raster_order(level);
+        check_view(level, MDR::DirectInterleaver<T>(), raster, "DirectInterleaver");
+        check_view(level, MDR::SFCInterleaver<T>(3), morton_order(level), "SFCInterleaver");
+        vector<size_t> reversed(raster.rbegin(), raster.rend());
+        check_view(level, ReverseInterleaver(), reversed, "default level_view");
+        cout << level.name << " checked" << endl;
+    }
+    if(num_failures){
+        cout << num_failures << " checks failed" << endl;
+        return -1;
+    }
+    cout << "All checks passed" << endl;
+    return 0;
+}
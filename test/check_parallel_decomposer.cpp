@@ -0,0 +1,217 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "MDR/Decomposer/ParallelHierarchicalDecomposer.hpp"
+
+// checks ParallelHierarchicalDecomposer against a serial reference of the hierarchical basis:
+// every node is computed from a copy of the level box in the same arithmetic order, so the coefficients
+// and the recomposed data must match bit for bit on any number of threads and for strided subarrays
+
+using namespace std;
+
+int num_failures = 0;
+
+void check(bool condition, const string& message){
+    if(!condition){
+        cout << "FAILED: " << message << endl;
+        num_failures ++;
+    }
+}
+
+template <class T>
+bool equal(const vector<T>& a, const vector<T>& b){
+    return (a.size() == b.size()) && !memcmp(a.data(), b.data(), a.size() * sizeof(T));
+}
+
+// one level on the box of the natural grid of dims (the box starts at the origin)
+// forward: nodes off the coarse grid minus the interpolant of the coarse nodes, then reordered coarse first
+// backward: reordered back, then plus the interpolant
+template <class T>
+void reference_level(vector<T>& data, const vector<uint32_t>& dims, const vector<uint32_t>& box, bool forward){
+    const int num_dims = box.size();
+    const int last = num_dims - 1;
+    vector<size_t> strides(num_dims);
+    size_t stride = 1;
+    for(int d=num_dims-1; d>=0; d--){
+        strides[d] = stride;
+        stride *= dims[d];
+    }
+    size_t num_elements = 1;
+    for(auto n:box) num_elements *= n;
+    auto coarse = [&](int d, uint32_t k){
+        return (k % 2 == 0) || (k == box[d] - 1);
+    };
+    auto position = [&](int d, uint32_t k){
+        uint32_t num_coarse = (box[d] >> 1) + 1;
+        return coarse(d, k) ? ((k == box[d] - 1) ? num_coarse - 1 : k / 2) : num_coarse + k / 2;
+    };
+    auto for_each_node = [&](auto f){
+        vector<uint32_t> index(num_dims, 0);
+        for(size_t i=0; i<num_elements; i++){
+            size_t remaining = i;
+            for(int d=num_dims-1; d>=0; d--){
+                index[d] = remaining % box[d];
+                remaining /= box[d];
+            }
+            size_t offset = 0;
+            size_t reordered = 0;
+            for(int d=0; d<num_dims; d++){
+                offset += index[d] * strides[d];
+                reordered += position(d, index[d]) * strides[d];
+            }
+            f(index, offset, reordered);
+        }
+    };
+    vector<T> original(data);
+    if(!forward){
+        for_each_node([&](const vector<uint32_t>& index, size_t offset, size_t reordered){
+            data[offset] = original[reordered];
+        });
+        original = data;
+    }
+    for_each_node([&](const vector<uint32_t>& index, size_t offset, size_t reordered){
+        vector<int> fine_dims;
+        for(int d=0; d<last; d++){
+            if(!coarse(d, index[d])) fine_dims.push_back(d);
+        }
+        const bool fine_last = !coarse(last, index[last]);
+        if(fine_dims.empty() && !fine_last) return;
+        // average of the coarse neighbouring rows at column k
+        auto average = [&](uint32_t k){
+            size_t row = offset - index[last] + k;
+            if(fine_dims.empty()) return original[row];
+            T sum = 0;
+            for(uint32_t corner=0; corner<(1u << fine_dims.size()); corner++){
+                size_t neighbour = row;
+                for(int j=0; j<fine_dims.size(); j++){
+                    if((corner >> j) & 1u) neighbour += strides[fine_dims[j]];
+                    else neighbour -= strides[fine_dims[j]];
+                }
+                sum += original[neighbour];
+            }
+            return sum * ((T) 1 / (1u << fine_dims.size()));
+        };
+        T interpolant = fine_last ? (average(index[last] - 1) + average(index[last] + 1)) / 2 : average(index[last]);
+        if(forward) data[offset] = original[offset] - interpolant;
+        else data[offset] = original[offset] + interpolant;
+    });
+    if(forward){
+        original = data;
+        for_each_node([&](const vector<uint32_t>& index, size_t offset, size_t reordered){
+            data[reordered] = original[offset];
+        });
+    }
+}
+
+template <class T>
+void reference_decompose(vector<T>& data, const vector<uint32_t>& dims, int target_level, bool forward){
+    vector<vector<uint32_t>> boxes(1, dims);
+    for(int l=0; l<target_level; l++){
+        vector<uint32_t> box = boxes.back();
+        for(auto& n:box) n = (n >> 1) + 1;
+        boxes.push_back(box);
+    }
+    for(int l=0; l<target_level; l++){
+        reference_level(data, dims, boxes[forward ? l : target_level - 1 - l], forward);
+    }
+}
+
+template <class T>
+void check_shape(const vector<uint32_t>& dims, mt19937& generator){
+    const int target_level = (int) log2(*min_element(dims.begin(), dims.end())) - 1;
+    size_t num_elements = 1;
+    for(auto n:dims) num_elements *= n;
+    normal_distribution<double> distribution(0, 1);
+    vector<T> data(num_elements);
+    for(auto& v:data) v = distribution(generator);
+
+    vector<T> reference(data);
+    reference_decompose(reference, dims, target_level, true);
+    vector<T> reference_recomposed(reference);
+    reference_decompose(reference_recomposed, dims, target_level, false);
+
+    string name = to_string(dims.size()) + "D";
+    for(auto n:dims) name += " " + to_string(n);
+    for(int num_threads : {1, 3, 8}){
+        MDR::ParallelHierarchicalDecomposer<T> decomposer(num_threads);
+        vector<T> coefficients(data);
+        decomposer.decompose(coefficients.data(), dims, target_level);
+        check(equal(coefficients, reference), name + ": decompose on " + to_string(num_threads) + " threads");
+        decomposer.recompose(coefficients.data(), dims, target_level);
+        check(equal(coefficients, reference_recomposed), name + ": recompose on " + to_string(num_threads) + " threads");
+        double max_error = 0;
+        for(size_t i=0; i<num_elements; i++){
+            max_error = max(max_error, (double) fabs(coefficients[i] - data[i]));
+        }
+        check(max_error < 1e-5, name + ": round trip error " + to_string(max_error));
+    }
+    cout << name << ", " << target_level << " levels checked" << endl;
+}
+
+// a subarray decomposed in place through strides matches the same subarray decomposed on its own,
+// and nothing outside it is written
+template <class T>
+void check_strided(mt19937& generator){
+    const vector<uint32_t> grid = {30, 40, 50};
+    const vector<uint32_t> begin = {5, 3, 10};
+    const vector<uint32_t> dims = {17, 33, 20};
+    const vector<uint32_t> strides = {40 * 50, 50, 1};
+    const int target_level = 3;
+    normal_distribution<double> distribution(0, 1);
+    vector<T> data(grid[0] * grid[1] * grid[2]);
+    for(auto& v:data) v = distribution(generator);
+    const size_t base = (begin[0] * grid[1] + begin[1]) * grid[2] + begin[2];
+    auto extract = [&](const vector<T>& grid_data){
+        vector<T> subarray;
+        for(uint32_t i=0; i<dims[0]; i++){
+            for(uint32_t j=0; j<dims[1]; j++){
+                for(uint32_t k=0; k<dims[2]; k++){
+                    subarray.push_back(grid_data[base + i * strides[0] + j * strides[1] + k]);
+                }
+            }
+        }
+        return subarray;
+    };
+    MDR::ParallelHierarchicalDecomposer<T> decomposer(4);
+    vector<T> subarray = extract(data);
+    decomposer.decompose(subarray.data(), dims, target_level);
+    vector<T> strided(data);
+    decomposer.decompose(strided.data() + base, dims, target_level, strides);
+    check(equal(extract(strided), subarray), "strided decompose");
+    // zero the subarray in both to compare the rest
+    auto outside = [&](vector<T> grid_data){
+        for(uint32_t i=0; i<dims[0]; i++){
+            for(uint32_t j=0; j<dims[1]; j++){
+                for(uint32_t k=0; k<dims[2]; k++){
+                    grid_data[base + i * strides[0] + j * strides[1] + k] = 0;
+                }
+            }
+        }
+        return grid_data;
+    };
+    check(equal(outside(strided), outside(data)), "strided decompose writes outside the subarray");
+    decomposer.recompose(subarray.data(), dims, target_level);
+    decomposer.recompose(strided.data() + base, dims, target_level, strides);
+    check(equal(extract(strided), subarray), "strided recompose");
+    cout << "strided subarray checked" << endl;
+}
+
+int main(int argc, char ** argv){
+    mt19937 generator(7);
+    // odd and even sizes, with 1D boxes split into column ranges
+    vector<vector<uint32_t>> shapes = {{100}, {129}, {20000}, {17, 30}, {33, 33}, {64, 65}, {10, 13, 18}, {16, 16, 16}, {9, 9, 9, 12}};
+    for(const auto& dims:shapes){
+        check_shape<float>(dims, generator);
+    }
+    check_shape<double>({40, 33, 30}, generator);
+    check_strided<float>(generator);
+    if(num_failures){
+        cout << num_failures << " checks failed" << endl;
+        return -1;
+    }
+    cout << "All checks passed" << endl;
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <string>
+#include "MDR/Refactor/Refactor.hpp"
+#include "MDR/Reconstructor/Reconstructor.hpp"
+
+// checks that a region of interest reconstructed progressively equals the same box of the full field
+// reconstructed to the same tolerances, bit for bit, for the composed and ordered reconstructors
+// refactored data is written to check_roi_* files in the working directory
+
+using namespace std;
+using T = float;
+using T_stream = uint32_t;
+
+int num_failures = 0;
+
+void check(bool condition, const string& message){
+    if(!condition){
+        cout << "FAILED: " << message << endl;
+        num_failures ++;
+    }
+}
+
+// smooth field with noise
+vector<T> generate_data(const vector<uint32_t>& dims){
+    size_t num_elements = 1;
+    for(auto n:dims) num_elements *= n;
+    mt19937 generator(11);
+    normal_distribution<double> distribution(0, 1e-3);
+    vector<T> data(num_elements);
+    for(size_t i=0; i<num_elements; i++){
+        size_t remaining = i;
+        double value = 0;
+        for(int d=dims.size()-1; d>=0; d--){
+            value += sin(0.1 * (d + 1) * (remaining % dims[d]));
+            remaining /= dims[d];
+        }
+        data[i] = value + distribution(generator);
+    }
+    return data;
+}
+
+// the box [begin, end) of the full field compared with the compact roi
+void compare_box(T const * full, T const * roi, const vector<uint32_t>& dims, const vector<uint32_t>& begin, const vector<uint32_t>& end, const string& message){
+    if(!full || !roi){
+        check(false, message + ": reconstruction returned NULL");
+        return;
+    }
+    const int num_dims = dims.size();
+    vector<uint32_t> index(begin);
+    size_t mismatches = 0;
+    for(size_t i=0; ; i++){
+        size_t offset = 0;
+        for(int d=0; d<num_dims; d++){
+            offset = offset * dims[d] + index[d];
+        }
+        if(full[offset] != roi[i]) mismatches ++;
+        int d = num_dims - 1;
+        while((d >= 0) && (++ index[d] == end[d])){
+            index[d] = begin[d];
+            d --;
+        }
+        if(d < 0) break;
+    }
+    check(mismatches == 0, message + ": " + to_string(mismatches) + " elements differ from the full reconstruction");
+}
+
+// the roi is refined progressively, while the full field is reconstructed from scratch at every tolerance:
+// progressive full reconstructions add recomposed deltas, which may round differently in the last bit
+template <class MakeReconstructor>
+void compare_reconstructions(MakeReconstructor make_reconstructor, const vector<uint32_t>& dims, const vector<uint32_t>& begin, const vector<uint32_t>& end, const string& name){
+    auto roi = make_reconstructor();
+    roi.load_metadata();
+    for(double tolerance : {1e-1, 1e-2, 1e-3, 1e-4}){
+        auto full = make_reconstructor();
+        full.load_metadata();
+        T * full_data = full.progressive_reconstruct(tolerance, -1);
+        T * roi_data = roi.reconstruct_roi(tolerance, begin, end);
+        compare_box(full_data, roi_data, dims, begin, end, name + " tolerance " + to_string(tolerance));
+    }
+}
+
+template <class Interleaver, class Encoder>
+void check_composed(const vector<T>& data, const vector<uint32_t>& dims, const vector<uint32_t>& begin, const vector<uint32_t>& end, const string& name){
+    const int target_level = 3;
+    const string metadata_file = "check_roi_metadata.bin";
+    vector<string> files;
+    for(int i=0; i<=target_level; i++){
+        files.push_back("check_roi_level_" + to_string(i) + ".bin");
+    }
+    auto decomposer = MDR::ParallelHierarchicalDecomposer<T>();
+    auto interleaver = Interleaver();
+    auto encoder = Encoder();
+    auto compressor = MDR::DefaultLevelCompressor();
+    {
+        auto collector = MDR::MaxErrorCollector<T>();
+        auto writer = MDR::ConcatLevelFileWriter(metadata_file, files);
+        auto refactor = MDR::ComposedRefactor<T, decltype(decomposer), decltype(interleaver), decltype(encoder), decltype(compressor), decltype(collector), decltype(writer)>(decomposer, interleaver, encoder, compressor, collector, writer);
+        refactor.negabinary = std::is_same<Encoder, MDR::NegaBinaryBPEncoder<T, T_stream>>::value;
+        refactor.refactor(data.data(), dims, target_level, 32);
+    }
+    auto make_reconstructor = [&](){
+        auto retriever = MDR::ConcatLevelFileRetriever(metadata_file, files);
+        auto estimator = MDR::MaxErrorEstimatorHB<T>();
+        auto interpreter = MDR::SignExcludeGreedyBasedSizeInterpreter<MDR::MaxErrorEstimatorHB<T>>(estimator);
+        return MDR::ComposedReconstructor<T, decltype(decomposer), decltype(interleaver), decltype(encoder), decltype(compressor), decltype(interpreter), decltype(estimator), decltype(retriever)>(decomposer, interleaver, encoder, compressor, interpreter, retriever);
+    };
+    compare_reconstructions(make_reconstructor, dims, begin, end, "composed " + name);
+    cout << "composed " << name << " checked" << endl;
+}
+
+template <class Interleaver, class Encoder>
+void check_ordered(const vector<T>& data, const vector<uint32_t>& dims, const vector<uint32_t>& begin, const vector<uint32_t>& end, const string& name){
+    const int target_level = 3;
+    const string metadata_file = "check_roi_ordered_metadata.bin";
+    const string data_file = "check_roi_ordered_data.bin";
+    auto decomposer = MDR::ParallelHierarchicalDecomposer<T>();
+    auto interleaver = Interleaver();
+    auto encoder = Encoder();
+    auto compressor = MDR::DefaultLevelCompressor();
+    auto estimator = MDR::MaxErrorEstimatorHB<T>();
+    {
+        auto collector = MDR::MaxErrorCollector<T>();
+        auto writer = MDR::OrderedFileWriter(metadata_file, data_file);
+        auto refactor = MDR::OrderedRefactor<T, decltype(decomposer), decltype(interleaver), decltype(encoder), decltype(compressor), decltype(collector), decltype(estimator), decltype(writer)>(decomposer, interleaver, encoder, compressor, collector, estimator, writer);
+        refactor.negabinary = std::is_same<Encoder, MDR::NegaBinaryBPEncoder<T, T_stream>>::value;
+        refactor.verbose = false;
+        refactor.refactor(data.data(), dims, target_level, 32);
+    }
+    auto make_reconstructor = [&](){
+        auto retriever = MDR::OrderedFileRetriever(metadata_file, data_file);
+        auto interpreter = MDR::SignExcludeGreedyBasedSizeInterpreter<MDR::MaxErrorEstimatorHB<T>>(estimator);
+        return MDR::OrderedReconstructor<T, decltype(decomposer), decltype(interleaver), decltype(encoder), decltype(compressor), decltype(interpreter), decltype(estimator), decltype(retriever)>(decomposer, interleaver, encoder, compressor, interpreter, retriever);
+    };
+    compare_reconstructions(make_reconstructor, dims, begin, end, "ordered " + name);
+    cout << "ordered " << name << " checked" << endl;
+}
+
+int main(int argc, char ** argv){
+    const vector<uint32_t> dims = {41, 50, 37};
+    const vector<T> data = generate_data(dims);
+    using NegaBinary = MDR::NegaBinaryBPEncoder<T, T_stream>;
+    using PerBit = MDR::PerBitBPEncoder<T, T_stream>;
+    check_composed<MDR::DirectInterleaver<T>, NegaBinary>(data, dims, {10, 20, 3}, {30, 37, 20}, "direct negabinary inner box");
+    check_composed<MDR::DirectInterleaver<T>, NegaBinary>(data, dims, {35, 0, 30}, {41, 50, 37}, "direct negabinary corner box");
+    check_composed<MDR::SFCInterleaver<T>, NegaBinary>(data, dims, {10, 20, 3}, {30, 37, 20}, "sfc negabinary inner box");
+    check_composed<MDR::DirectInterleaver<T>, PerBit>(data, dims, {20, 25, 0}, {21, 27, 37}, "direct perbit thin box");
+    check_ordered<MDR::DirectInterleaver<T>, NegaBinary>(data, dims, {10, 20, 3}, {30, 37, 20}, "direct negabinary inner box");
+    check_ordered<MDR::SFCInterleaver<T>, PerBit>(data, dims, {0, 0, 0}, {41, 50, 37}, "sfc perbit full box");
+    // even 2D and 1D
+    const vector<uint32_t> dims_2d = {64, 100};
+    const vector<T> data_2d = generate_data(dims_2d);
+    check_composed<MDR::DirectInterleaver<T>, NegaBinary>(data_2d, dims_2d, {63, 98}, {64, 100}, "2D last element box");
+    const vector<uint32_t> dims_1d = {1000};
+    const vector<T> data_1d = generate_data(dims_1d);
+    check_composed<MDR::DirectInterleaver<T>, NegaBinary>(data_1d, dims_1d, {333}, {334}, "1D single element");
+    if(num_failures){
+        cout << num_failures << " checks failed" << endl;
+        return -1;
+    }
+    cout << "All checks passed" << endl;
+    return 0;
+}
@@ -73,13 +73,17 @@ int main(int argc, char ** argv){
     // using T = double;
     // using T_stream = uint64_t;
     auto decomposer = MDR::MGARDHierarchicalDecomposer<T>();
+    // auto decomposer = MDR::ParallelHierarchicalDecomposer<T>(8);
     auto interleaver = MDR::DirectInterleaver<T>();
     auto encoder = MDR::NegaBinaryBPEncoder<T, T_stream>();
     // auto encoder = MDR::PerBitBPEncoder<T, T_stream>();
+    // auto encoder = MDR::SignificanceMapBPEncoder<T, T_stream>();
 
     // auto compressor = MDR::DefaultLevelCompressor();
     auto compressor = MDR::AdaptiveLevelCompressor(64);
     // auto compressor = MDR::NullLevelCompressor();
+    // auto compressor = MDR::SelectiveLevelCompressor();
+    // auto compressor = MDR::ContextLevelCompressor();
 
     auto retriever = MDR::ConcatLevelFileRetriever(metadata_file, files);
     auto estimator = MDR::MaxErrorEstimatorHB<T>();
@@ -67,6 +67,7 @@ int main(int argc, char ** argv){
     // }
 
     auto decomposer = MDR::MGARDHierarchicalDecomposer<T>();
+    // auto decomposer = MDR::ParallelHierarchicalDecomposer<T>(8);
     auto interleaver = MDR::DirectInterleaver<T>();
     // auto interleaver = MDR::SFCInterleaver<T>();
     // auto interleaver = MDR::BlockedInterleaver<T>();
@@ -75,9 +76,13 @@ int main(int argc, char ** argv){
     negabinary = true;
     // auto encoder = MDR::PerBitBPEncoder<T, T_stream>();
     // negabinary = false;
+    // auto encoder = MDR::SignificanceMapBPEncoder<T, T_stream>();
+    // negabinary = false;
     // auto compressor = MDR::DefaultLevelCompressor();
     auto compressor = MDR::AdaptiveLevelCompressor(64);
     // auto compressor = MDR::NullLevelCompressor();
+    // auto compressor = MDR::SelectiveLevelCompressor();
+    // auto compressor = MDR::ContextLevelCompressor();
     auto collector = MDR::SquaredErrorCollector<T>();
     auto writer = MDR::ConcatLevelFileWriter(metadata_file, files);
     // auto writer = MDR::HPSSFileWriter(metadata_file, files, 2048, 512 * 1024 * 1024);